@@ -38,7 +38,6 @@ public:
 
   using Base::operator bool;
   using Base::begin;
-  using Base::clear;
   using Base::data;
   using Base::end;
   using Base::size;
@@ -53,6 +52,12 @@ public:
   // assemble an x86_64 instruction. defined in onejit/x64/asm.cpp
   Assembler &x64(const Node &node) noexcept;
 
+  // shorten x86_64 jmp and jcc to labels defined in this Assembler,
+  // using rel8 displacement wherever it fits.
+  // must be called after the whole function is assembled, and before linking it.
+  // defined in onejit/x64/relax.cpp
+  Assembler &x64_relax() noexcept;
+
   /**
    * low-level methods, they add raw bytes
    */
@@ -77,9 +82,27 @@ public:
     return Bytes{*this};
   }
 
-  // mark last added bytes to be filled with label relative offset
+  // remove all bytes, relocations, labels and errors
+  Assembler &clear() noexcept;
+
+  // mark last added 'size' bytes to be filled with label relative offset,
+  // or with label absolute address if size == 8.
+  // does nothing if label is invalid i.e. bool(l) == false
+  Assembler &add_relocation(Label l, uint8_t size = 4) noexcept;
+
+  // mark current position as the destination of label
   // does nothing if label is invalid i.e. bool(l) == false
-  Assembler &add_relocation(Label l) noexcept;
+  Assembler &add_label(Label l) noexcept;
+
+  // return positions to be filled with label relative offsets
+  constexpr View<Relocation> relocations() const noexcept {
+    return relocation_;
+  }
+
+  // return positions of labels added with add_label()
+  constexpr View<LabelPos> labels() const noexcept {
+    return label_;
+  }
 
   // return current assembler errors
   constexpr CRange<Error> errors() const noexcept {
@@ -97,6 +120,7 @@ private:
   void append(...) noexcept;
 
   Array<Relocation> relocation_;
+  Array<LabelPos> label_;
   Array<Error> error_;
 
 }; // class Assembler
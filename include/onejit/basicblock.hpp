@@ -50,6 +50,11 @@ public:
     return next_;
   }
 
+  // return the position where statements should be inserted at the end of this basic block:
+  // before its final jump, and before the comparison setting the flags of a conditional jump.
+  // defined in onejit/flowgraph.cpp
+  size_t insert_pos() const noexcept;
+
   void set_prev(Span<BasicBlock *> prev) noexcept {
     prev_ = prev;
   }
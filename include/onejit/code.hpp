@@ -28,6 +28,8 @@ namespace onejit {
 
 class Code : private Buffer<CodeItem> {
   friend class Node;
+  friend class ir::Const;
+  friend class ir::Node;
   using T = CodeItem;
   using Base = Buffer<T>;
 
@@ -86,6 +88,10 @@ public:
     return add_uint64(Float64Bits{f64}.bits());
   }
 
+  // overwrite already added data.
+  // returns false if byte_offset is out of bounds
+  bool set_uint64(Offset byte_offset, uint64_t u64) noexcept;
+
   Code &add_item(CodeItem data) noexcept; // same as add_uint32()
   Code &add(CodeItems data) noexcept;
   Code &add(Header header) noexcept {
@@ -122,6 +128,9 @@ public:
     length_bytes /= sizeof(T);
     if (size_ > length_bytes) {
       size_ = length_bytes;
+      if (intern_n_ != 0) {
+        forget_interned();
+      }
     }
     return *this;
   }
@@ -132,6 +141,21 @@ public:
     return truncate(2 * sizeof(T));
   }
 
+  /// \return true if hash-consing of immutable expressions is enabled
+  constexpr bool interning() const noexcept {
+    return interning_;
+  }
+
+  /**
+   * enable or disable hash-consing of immutable expressions:
+   * Const, Unary, Binary and Tuple except function calls.
+   * If enabled, creating an expression equal to an existing one
+   * returns the existing one: such expressions are stored only once,
+   * and two of them are deep_equal() only if they are identical.
+   * Disabling it also forgets all expressions already interned.
+   */
+  Code &set_interning(bool enable) noexcept;
+
   constexpr const T *data() const noexcept {
     return Base::data();
   }
@@ -144,6 +168,24 @@ public:
 
 private:
   Code &init() noexcept;
+
+  // if interning is enabled and an expression equal to node was already interned,
+  // remove node - which must be the last one added - and return the existing expression.
+  // otherwise intern node if possible and return it.
+  Node intern(Node node) noexcept;
+
+  // grow the interning hash table. return false if out of memory
+  bool grow_interned() noexcept;
+
+  // forget interned expressions beyond the end of Code
+  void forget_interned() noexcept;
+
+  // add an entry to the interning hash table, which must have room for it
+  void insert_interned(uint64_t entry) noexcept;
+
+  Array<uint64_t> intern_; // hash table: (hash << 32) | offset, or 0 if empty
+  uint32_t intern_n_;      // # entries in intern_
+  bool interning_;
 };
 
 } // namespace onejit
@@ -23,11 +23,18 @@
 #include <onejit/ir/node.hpp>
 #include <onejit/optimizer.hpp>
 #include <onejit/reg/allocator.hpp>
+#include <onejit/reg/liveness.hpp>
 #include <onestl/array.hpp>
 #include <onestl/crange.hpp>
 
 namespace onejit {
 
+struct Ssa;
+struct SwitchCase;
+
+// maximum number of tests in a Cond converted to SELECT by if-conversion
+enum : size_t { SelectMaxTests = 2 };
+
 ////////////////////////////////////////////////////////////////////////////////
 
 class Compiler {
@@ -81,6 +88,11 @@ private:
   Node compile(Block stmt, Flags flags) noexcept;
   Expr compile(Call expr, Flags flags) noexcept;
   Node compile(Cond stmt, Flags flags) noexcept;
+  // if-conversion: try to compile Cond to a branchless SELECT. return false if not possible
+  bool compile_select(Cond stmt) noexcept;
+  // if-conversion: try to compile if (tests[0]) bodies[0] else if (tests[1]) bodies[1] ...
+  // else bodies[n] to a branchless SELECT. return false if not possible
+  bool compile_select(View<Expr> tests, View<Node> bodies) noexcept;
   Expr compile(Expr expr, Flags flags) noexcept;
   Node compile(For stmt, Flags flags) noexcept;
   Node compile(If stmt, Flags flags) noexcept;
@@ -95,6 +107,7 @@ private:
   Node compile(Stmt4 stmt, Flags flags) noexcept;
   Node compile(StmtN stmt, Flags flags) noexcept;
   Node compile(Switch stmt, Flags flags) noexcept;
+  Node compile(Switch stmt, Expr expr, View<SwitchCase> cases) noexcept;
   Expr compile(Unary expr, Flags flags) noexcept;
   Expr compile(Tuple expr, Flags flags) noexcept;
 
@@ -112,6 +125,19 @@ private:
   // get current destination for "fallthrough"
   Label label_fallthrough() const noexcept;
 
+  // if all Case of Switch, except Default, have distinct Const values with the same Kind
+  // as expr, and they are enough, collect them sorted in cases and return true.
+  // otherwise return false: Switch will be compiled to a sequential compare chain
+  bool switch_cases(Switch stmt, Expr expr, Array<SwitchCase> &cases) noexcept;
+
+  // compile a dense Switch to a bounds check followed by a JumpTable
+  Compiler &switch_jump_table(Expr expr, View<SwitchCase> cases, View<Label> l_case,
+                              Label l_default) noexcept;
+
+  // compile a sparse Switch to a balanced tree of comparisons
+  Compiler &switch_compare_tree(Expr expr, View<SwitchCase> cases, View<Label> l_case,
+                                Label l_default) noexcept;
+
   Compiler &enter_case(Label l_break, Label l_fallthrough) noexcept;
   Compiler &exit_case() noexcept;
 
@@ -130,6 +156,41 @@ private:
   Compiler &add_prologue(Func &func) noexcept;
   Compiler &add_epilogue(Func &func) noexcept;
 
+  // convert compiled code to SSA (static single assignment) form:
+  // each Var is replaced by multiple versions, each assigned exactly once,
+  // and Phi merge the versions reaching the same basic block from different predecessors.
+  // defined in onejit/ssa.cpp
+  Compiler &to_ssa() noexcept;
+
+  // apply the global optimizations enabled by flags to compiled code in SSA form.
+  // defined in onejit/ssa.cpp
+  Compiler &optimize_ssa(Opt flags) noexcept;
+
+  // convert compiled code from SSA form: replace each Phi with copies at the end
+  // of its predecessors, then merge the versions of each Var back into the original Var
+  // if their live ranges do not interfere.
+  // defined in onejit/ssa.cpp
+  Compiler &from_ssa() noexcept;
+
+  // remove dead code from compiled code: assignments to Vars that are never read,
+  // statements in unreachable basic blocks, jumps to the immediately following label
+  // and unused labels. divisions and memory accesses are kept if check() requires it.
+  // defined in onejit/dce.cpp
+  Compiler &remove_dead_code() noexcept;
+
+  // create a new version of var and make it current
+  Var ssa_new_version(Ssa &ssa, Var var) noexcept;
+
+  // rename the Vars used and defined by a compiled statement to their current version
+  Node ssa_rename(Ssa &ssa, Node node) noexcept;
+
+  // return node with each Var replaced by map[var.id() - Id::FIRST], if present and valid
+  Node replace_vars(Node node, View<Var> map) noexcept;
+
+  // append to def and use the Vars defined and used by compiled statement node.
+  // passed to reg::Liveness::compute()
+  static bool def_use(Node node, Array<reg::Reg> &def, Array<reg::Reg> &use) noexcept;
+
   // add an already compiled node to compiled list
   Compiler &add(const Node &node) noexcept;
 
@@ -151,15 +212,18 @@ private:
 private:
   Optimizer optimizer_;
   reg::Allocator allocator_;
+  reg::Liveness liveness_;
   Func *func_;
 
   Array<Label> break_;       // stack of 'break' destination labels
   Array<Label> continue_;    // stack of 'continue' destination labels
   Array<Label> fallthrough_; // stack of 'fallthrough' destination labels
   Array<Node> node_;
+  Array<reg::Reg> ssa_orig_; // index is reg: reg it is a version of. empty if not in SSA form
   FlowGraph flowgraph_;
   Array<Error> error_;
   Abi abi_;
+  Opt flags_;
   bool good_; // !good_ means out of memory
 };
 
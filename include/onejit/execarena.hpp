@@ -0,0 +1,107 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * execarena.hpp
+ *
+ *  Created on Apr 02, 2021
+ *      Author Massimiliano Ghilardi
+ */
+
+#ifndef ONEJIT_EXECARENA_HPP
+#define ONEJIT_EXECARENA_HPP
+
+#include <onejit/fwd.hpp>
+#include <onestl/array.hpp>
+
+#include <cstdint> // uintptr_t
+
+namespace onejit {
+
+// allocates machine code from large mmap()ed regions.
+//
+// Memory is W^X: newly allocated code is writable but not executable,
+// and becomes executable (and no longer writable) after seal().
+// Allocating after seal() continues in the same region, starting from the next page.
+//
+// All regions are unmapped by the destructor:
+// functions allocated from an ExecArena must not be called after it is destroyed.
+class ExecArena {
+public:
+  enum : size_t {
+    default_region_size = 2 * 1024 * 1024, // one huge page on x64
+    func_align = 16,
+  };
+
+  ExecArena() noexcept;
+  explicit ExecArena(size_t region_size) noexcept;
+  ExecArena(ExecArena &&other) noexcept;
+
+  ~ExecArena() noexcept;
+
+  ExecArena &operator=(ExecArena &&other) noexcept;
+
+  // return false if some mmap(), mprotect() or allocation failed
+  constexpr explicit operator bool() const noexcept {
+    return good_;
+  }
+
+  // allocate n writable bytes, aligned to func_align.
+  // their address is final, but they are not executable until seal()
+  // return empty span if out of memory
+  Span<uint8_t> alloc(size_t n) noexcept;
+
+  // copy bytes into a writable allocation. they are not executable until seal()
+  // return address of copied bytes, or nullptr if out of memory
+  const void *add(Bytes bytes) noexcept;
+
+  // copy bytes into a writable allocation, and set func.address() to their address.
+  // they are not executable until seal()
+  // return address of copied bytes, or nullptr if out of memory
+  const void *add(Func &func, Bytes bytes) noexcept;
+
+  // make all memory returned by alloc() and add() executable and read-only.
+  // return false if mprotect() failed
+  bool seal() noexcept;
+
+  // return true if addr points inside memory returned by alloc() or add()
+  bool contains(const void *addr) const noexcept;
+
+  // convert the address returned by add() to a function pointer.
+  // example: auto f = ExecArena::to_func<int (*)(int)>(addr);
+  template <class FUNC_PTR> static FUNC_PTR to_func(const void *addr) noexcept {
+    return reinterpret_cast<FUNC_PTR>(reinterpret_cast<uintptr_t>(addr));
+  }
+
+  void swap(ExecArena &other) noexcept;
+
+private:
+  struct Region {
+    uint8_t *addr;
+    size_t size;   // mapped bytes
+    size_t used;   // allocated bytes
+    size_t sealed; // bytes already made executable. always a multiple of page size
+  };
+
+  // map a new region with at least n bytes. return false on failure
+  bool map_region(size_t n) noexcept;
+
+  static size_t page_size() noexcept;
+
+  Array<Region> regions_;
+  size_t region_size_;
+  bool good_;
+};
+
+inline void swap(ExecArena &left, ExecArena &right) noexcept {
+  left.swap(right);
+}
+
+} // namespace onejit
+
+#endif // ONEJIT_EXECARENA_HPP
@@ -39,6 +39,48 @@ public:
     return basicblocks_;
   }
 
+  enum : uint32_t { NoBlock = uint32_t(-1) };
+
+  // compute the immediate dominator of each basic block.
+  // idom index is basic block: idom[0] is 0, unreachable basic blocks have idom NoBlock.
+  // return false if out of memory
+  bool dominators(Array<uint32_t> &idom) const noexcept;
+
+  // compute the dominance frontier of each basic block from idom, the output of dominators():
+  // the basic blocks where its dominance ends, i.e. that it does not strictly dominate
+  // but that have a predecessor it dominates.
+  // the frontier of i-th basic block is frontier[start[i] ... start[i+1]-1].
+  // return false if out of memory
+  bool dominance_frontiers(View<uint32_t> idom, Array<uint32_t> &start,
+                           Array<uint32_t> &frontier) const noexcept;
+
+  // compute the dominator tree from idom, the output of dominators():
+  // the children of i-th basic block, i.e. the basic blocks it immediately dominates,
+  // are children[start[i] ... start[i+1]-1] in increasing order.
+  // return false if out of memory
+  bool dominator_tree(View<uint32_t> idom, Array<uint32_t> &start,
+                      Array<uint32_t> &children) const noexcept;
+
+  // return true if basic block a dominates basic block b.
+  // idom must be the output of dominators(), and b must be reachable
+  static bool dominates(View<uint32_t> idom, uint32_t a, uint32_t b) noexcept;
+
+  // compute the natural loops from idom, the output of dominators():
+  // for each back edge target, i.e. loop header, the basic blocks that can reach
+  // a back edge to it without passing through it.
+  // the basic blocks of i-th loop are blocks[start[i] ... start[i+1]-1]: the first one
+  // is its header, the others are in increasing order. loops are sorted by increasing size,
+  // thus inner loops come before the loops containing them.
+  // return false if out of memory
+  bool natural_loops(View<uint32_t> idom, Array<uint32_t> &start,
+                     Array<uint32_t> &blocks) const noexcept;
+
+  // compute the loop nesting depth of each basic block, i.e. how many loops contain it.
+  // a loop is the set of basic blocks that can reach a back edge, i.e. a jump to
+  // a basic block dominating the jump source, without passing through the jump target.
+  // depth index is basic block. return false if out of memory
+  bool loop_depth(Array<uint32_t> &depth) const noexcept;
+
   const Fmt &format(const Fmt &fmt) const;
 
 private:
@@ -50,11 +92,22 @@ private:
   // for every jump in basicblocks_, find the basicblocks it may jump to,
   // fill links_ accordingly, and assign a slice of it to basicblocks_[i].next_
   bool resolve_next() noexcept;
+  // append to links_ the basicblocks a jump table may jump to, skipping duplicates
+  bool resolve_jump_table(Node node, size_t link_start, size_t &link_end) noexcept;
   // using basicblocks_[*].next_, compute basicblocks_[*].prev_
   bool resolve_prev() noexcept;
 
   static bool is_label(Node node) noexcept;
 
+  // compute the depth-first postorder of basic blocks reachable from the first one.
+  // postnum index is basic block, unreachable basic blocks have postnum NoBlock.
+  // return false if out of memory
+  bool postorder(Array<uint32_t> &post, Array<uint32_t> &postnum) const noexcept;
+
+  uint32_t index(const BasicBlock *bb) const noexcept {
+    return uint32_t(bb - basicblocks_.data());
+  }
+
   // always returns false
   bool error(Node where, Chars msg) noexcept;
 
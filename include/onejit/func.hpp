@@ -35,6 +35,7 @@ class Func : private FuncHeader {
   using Base = FuncHeader;
 
   friend class Compiler;
+  friend class Optimizer;
   friend class ir::Label;
   friend class ir::Var;
   friend class x64::Compiler;
@@ -57,11 +57,13 @@ class FlowGraph;
 enum eBits : uint8_t;
 enum eKind : uint8_t;
 class Error;
+class ExecArena;
 class Func;
 enum Group : uint8_t;
 class Id;
 class Imm;
 class Kind;
+class Linker;
 class Local;
 enum Op1 : uint16_t;
 enum Op2 : uint16_t;
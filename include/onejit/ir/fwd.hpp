@@ -51,11 +51,13 @@ class FuncType;
 class Goto;
 class If;
 class JumpIf;
+class JumpTable;
 class Label;
 class Mem;
 class Name;
 class Node;
 class Header;
+class Phi;
 class Return;
 class Stmt0;
 class Stmt1;
@@ -73,6 +75,7 @@ class VarHelper;
 using ChildRanges = View<ChildRange>;
 using Cases = View<Case>;
 using Exprs = View<Expr>;
+using Labels = View<Label>;
 using Nodes = View<Node>;
 using Vars = View<Var>;
 
@@ -58,9 +58,14 @@ public:
 
   // 0 if not resolved yet
   uint64_t address() const noexcept {
-    return Base::uint64(offset_or_direct() + sizeof(CodeItem));
+    return Base::uint64(sizeof(CodeItem));
   }
 
+  // set absolute destination address. used by linker.
+  // holder must be the Code containing this Label.
+  // return false if holder is not the Code containing this Label
+  bool set_address(Code *holder, uint64_t address) const noexcept;
+
   const Fmt &format(const Fmt &fmt, Syntax syntax = Syntax::Default, size_t depth = 0) const;
 
 private:
@@ -82,10 +87,19 @@ private:
   static Label create(Code *holder, uint64_t address, uint16_t index) noexcept;
 };
 
-// position in Assembler that needs to be filled with Label relative address
+// position in Assembler that needs to be filled with Label relative address.
+// the field to fill is the 'size' bytes immediately before 'pos',
+// and the relative address is computed from 'pos'
 struct Relocation {
   size_t pos;
   Label label;
+  uint8_t size; // 1 or 4 for relative offsets, 8 for absolute addresses
+};
+
+// position in Assembler where a Label is defined
+struct LabelPos {
+  size_t pos;
+  Label label;
 };
 
 } // namespace ir
@@ -78,7 +78,7 @@ private:
 
   // downcast helper
   static constexpr bool is_allowed_op(uint16_t op) noexcept {
-    return op >= MEM_OP;
+    return op == MEM_OP || op > SELECT;
   }
 
   static Node create(Func &func, Kind kind, OpN op, Exprs args) noexcept;
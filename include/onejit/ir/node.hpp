@@ -37,9 +37,11 @@ class Node {
   friend class Call;
   friend class Const;
   friend class FuncType;
+  friend class JumpTable;
   friend class Label;
   friend class Mem;
   friend class Name;
+  friend class Phi;
   friend class Return;
   friend class Stmt0;
   friend class Stmt1;
@@ -53,6 +55,7 @@ class Node {
   friend class Var;
   friend class ::onejit::Code;
   friend class ::onejit::CodeParser;
+  friend class ::onejit::Compiler;
   friend class ::onejit::Func;
   friend class ::onejit::Optimizer;
 
@@ -113,6 +116,10 @@ public:
   // otherwise return 0. Recurses on children.
   int deep_compare(const Node &other) const noexcept;
 
+  // structural hash: trees that are deep_equal() have equal deep_hash().
+  // Recurses on children.
+  uint64_t deep_hash() const noexcept;
+
   // true if node and its children have no side effects:
   // no memory access, no function calls, no assignments
   // i.e. only arithmetic on constants and variables.
@@ -179,6 +186,9 @@ protected:
     return true;
   }
 
+  // compare the data of indirect leaf nodes with equal header
+  int deep_compare_data(const Node &other) const noexcept;
+
   constexpr CodeItem offset_or_direct() const noexcept {
     return off_or_dir_;
   }
@@ -210,6 +220,13 @@ private:
   // return false if child is only evaluated for its side effects.
   bool child_result_is_used(uint32_t i) const noexcept;
 
+  // hash header, data of leaf nodes and identity of children. used by Code::intern()
+  uint64_t shallow_hash() const noexcept;
+
+  // return true if header, data of leaf nodes and identity of children are equal.
+  // used by Code::intern()
+  bool shallow_equal(const Node &other) const noexcept;
+
   // used by Optimizer and by subclasses' create() method
   static Node create_indirect(Func &func, Header header, Nodes children) noexcept;
 
@@ -31,6 +31,7 @@ class Stmt1 : public Stmt {
   friend class Node;
   friend class ::onejit::Compiler;
   friend class ::onejit::Func;
+  friend class ::onejit::Optimizer;
   friend class ::onejit::Test;
   friend class x64::Compiler;
 
@@ -36,6 +36,7 @@ class Stmt2 : public Stmt {
   friend class Node;
   friend class ::onejit::Compiler;
   friend class ::onejit::Func;
+  friend class ::onejit::Optimizer;
   friend class x64::Compiler;
 
 public:
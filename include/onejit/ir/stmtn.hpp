@@ -232,6 +232,121 @@ private:
   }
 };
 
+////////////////////////////////////////////////////////////////////////////////
+// SSA form: merge the values of a variable coming from different basic blocks.
+// (_phi dst src_0 ... src_n-1) assigns to dst the value of src_i
+// when entering the basic block containing it from its i-th predecessor
+class Phi : public StmtN {
+  using Base = StmtN;
+  friend class Node;
+  friend class ::onejit::Func;
+
+public:
+  /**
+   * construct an invalid Phi.
+   * exists only to allow placing Phi in containers
+   * and similar uses that require a default constructor.
+   *
+   * to create a valid Phi, use one of the other constructors
+   */
+  constexpr Phi() noexcept : Base{} {
+  }
+
+  Phi(Func &func, const Var &dst, std::initializer_list<Var> srcs) noexcept
+      : Base{create(func, dst, Vars{srcs.begin(), srcs.size()})} {
+  }
+
+  Phi(Func &func, const Var &dst, Vars srcs) noexcept //
+      : Base{create(func, dst, srcs)} {
+  }
+
+  static constexpr OpStmtN op() noexcept {
+    return PHI_;
+  }
+
+  // shortcut for child_is<Var>(0)
+  Var dst() const noexcept;
+
+  // shortcut for child_is<Var>(i+1)
+  Var src(uint32_t i) const noexcept;
+
+private:
+  // downcast Node to Phi
+  constexpr explicit Phi(const Node &node) noexcept : Base{node} {
+  }
+
+  // downcast helper
+  static constexpr bool is_allowed_op(uint16_t op) noexcept {
+    return op == PHI_;
+  }
+
+  static constexpr bool child_result_is_used(uint32_t /*i*/) noexcept {
+    return true;
+  }
+
+  static Node create(Func &func, const Var &dst, Vars srcs) noexcept;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// indirect jump through a table of labels, used to compile dense Switch.
+// (_jump_table index label_0 ... label_n-1) jumps to label_index.
+// index must be >= 0 and < n: the jump table does not check it.
+//
+// x64::Compiler replaces index with (x86_mem_q table base index 8)
+// where base contains the address of table, and the assembler emits
+// the table of label absolute addresses right after the indirect jump
+class JumpTable : public StmtN {
+  using Base = StmtN;
+  friend class Node;
+  friend class ::onejit::Func;
+
+public:
+  /**
+   * construct an invalid JumpTable.
+   * exists only to allow placing JumpTable in containers
+   * and similar uses that require a default constructor.
+   *
+   * to create a valid JumpTable, use one of the other constructors
+   */
+  constexpr JumpTable() noexcept : Base{} {
+  }
+
+  JumpTable(Func &func, const Expr &index, Labels labels) noexcept //
+      : Base{create(func, index, labels)} {
+  }
+
+  static constexpr OpStmtN op() noexcept {
+    return JUMP_TABLE_;
+  }
+
+  // shortcut for child_is<Expr>(0)
+  Expr index() const noexcept;
+
+  // return number of labels
+  uint32_t size() const noexcept {
+    return children() - 1;
+  }
+
+  // shortcut for child_is<Label>(i+1)
+  Label label(uint32_t i) const noexcept;
+
+private:
+  // downcast Node to JumpTable
+  constexpr explicit JumpTable(const Node &node) noexcept : Base{node} {
+  }
+
+  // downcast helper
+  static constexpr bool is_allowed_op(uint16_t op) noexcept {
+    return op == JUMP_TABLE_;
+  }
+
+  static constexpr bool child_result_is_used(uint32_t /*i*/) noexcept {
+    return true;
+  }
+
+  static Node create(Func &func, const Expr &index, Labels labels) noexcept;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // return 0, 1 or multiple values
 class Return : public StmtN {
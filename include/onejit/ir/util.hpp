@@ -25,9 +25,11 @@ bool is_jump(Node node) noexcept;
 bool is_cond_jump(Node node) noexcept;
 bool is_uncond_jump(Node node) noexcept;
 bool is_return(Node node) noexcept;
+bool is_jump_table(Node node) noexcept;
 
 // If node is a jump, return its destination label.
-// Note: RETURN, X86_RET, ARM64_RET etc. are jumps but have no destination label
+// Note: RETURN, X86_RET, ARM64_RET etc. are jumps but have no destination label,
+// and JUMP_TABLE_ has multiple destination labels
 Label jump_label(Node node) noexcept;
 
 } // namespace ir
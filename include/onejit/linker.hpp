@@ -0,0 +1,91 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * linker.hpp
+ *
+ *  Created on Apr 03, 2021
+ *      Author Massimiliano Ghilardi
+ */
+
+#ifndef ONEJIT_LINKER_HPP
+#define ONEJIT_LINKER_HPP
+
+#include <onejit/error.hpp>
+#include <onejit/ir/label.hpp>
+#include <onestl/array.hpp>
+#include <onestl/crange.hpp>
+
+namespace onejit {
+
+// copies assembled functions into an ExecArena,
+// sets the address of their labels and patches their relocations.
+//
+// Many functions can be added and linked in a single pass:
+// calls between them are resolved because each Func address is a Label.
+class Linker {
+public:
+  Linker() noexcept;
+  Linker(Linker &&other) noexcept = default;
+
+  ~Linker() noexcept;
+
+  Linker &operator=(Linker &&other) noexcept = default;
+
+  // add an assembled function to be linked.
+  // func and assembler must not be modified or destroyed until link() returns
+  Linker &add(Func &func, const Assembler &assembler) noexcept;
+
+  // copy all added functions into arena, set the address of all their labels
+  // and patch all relocations that can be resolved.
+  // Relocations that cannot be resolved are collected in unresolved().
+  //
+  // Does not seal() the arena: caller should do it before executing the code.
+  // Then forgets the added functions, so that link() can be invoked again.
+  //
+  // return false if some errors occurred.
+  bool link(ExecArena &arena) noexcept;
+
+  // return relocations not resolved by link().
+  // their pos is the absolute address immediately after the field to fill.
+  constexpr View<Relocation> unresolved() const noexcept {
+    return unresolved_;
+  }
+
+  // return current linker errors
+  constexpr CRange<Error> errors() const noexcept {
+    return CRange<Error>{&error_};
+  }
+
+  // forget added functions, unresolved relocations and errors
+  Linker &clear() noexcept;
+
+private:
+  struct Entry {
+    Func *func;
+    const Assembler *assembler;
+    uint8_t *addr; // set by link()
+  };
+
+  // copy function code into arena, and set its labels address
+  bool load(ExecArena &arena, Entry &entry) noexcept;
+
+  // patch function relocations
+  bool relocate(const Entry &entry) noexcept;
+
+  // always returns false
+  bool error(Node where, Chars msg) noexcept;
+
+  Array<Entry> entry_;
+  Array<Relocation> unresolved_;
+  Array<Error> error_;
+};
+
+} // namespace onejit
+
+#endif // ONEJIT_LINKER_HPP
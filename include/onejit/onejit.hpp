@@ -23,8 +23,10 @@
 #include <onejit/endian.hpp>
 #include <onejit/error.hpp>
 #include <onejit/eval.hpp>
+#include <onejit/execarena.hpp>
 #include <onejit/fmt.hpp>
 #include <onejit/func.hpp>
+#include <onejit/linker.hpp>
 #include <onejit/mem.hpp>
 #include <onejit/ir.hpp>       // includes all onejit/ir/
 #include <onejit/ir/const.hpp> // redundant
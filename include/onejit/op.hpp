@@ -49,6 +49,8 @@ enum Op2 : uint16_t {
   EQL,  // ==
   GTR,  // >
   GEQ,  // >=
+
+  MULHI, // high half of the double-width product x * y
 };
 
 enum OpN : uint16_t {
@@ -63,6 +65,7 @@ enum OpN : uint16_t {
   COMMA,
   CALL,
   MEM_OP,
+  SELECT, // (select test x y) i.e. test ? x : y
 
   // numeric values of the OpN enum constants below this line MAY CHANGE WITHOUT WARNING
 
@@ -98,6 +98,11 @@ enum OpStmt1 : uint16_t {
       x(CALL, call)    /* call function. argument is relative offset, register or memory */        \
       x(CBW, cbw)      /* sign-extend %al -> %ax or %ax -> %eax or  %eax -> %rax */                \
       x(DEC, dec)      /* decrement register or memory by 1 */                                     \
+      x(DIV, div)      /* unsigned divide %rdx:%rax by register or memory, quotient in %rax,      \
+                          remainder in %rdx */                                                     \
+      x(IDIV, idiv)    /* signed divide %rdx:%rax by register or memory, quotient in %rax,        \
+                          remainder in %rdx */                                                     \
+      x(IMUL1, imul1)  /* signed multiply %rax by register or memory, result in %rdx:%rax */       \
       x(INC, inc)      /* increment register or memory by 1 */                                     \
       x(INT, int)      /* generate a call to interrupt procedure. argument is immediate */         \
       x(JA, ja)        /* jump if above */                                                         \
@@ -117,6 +122,7 @@ enum OpStmt1 : uint16_t {
       x(JP, jp)        /* jump if parity (if even) */                                              \
       x(JS, js)        /* jump if sign */                                                          \
       x(JMP, jmp)      /* unconditional jump. argument is relative offset, register or memory */   \
+      x(MUL, mul)      /* unsigned multiply %rax by register or memory, result in %rdx:%rax */     \
       x(NEG, neg)      /* negate (i.e. -x) register or memory */                                   \
       x(NOT, not)      /* invert (i.e. ^x) register or memory */                                   \
       x(POP, pop)      /* pop 2 or 8 bytes from stack into register or memory */                   \
@@ -213,9 +219,7 @@ enum OpStmt2 : uint16_t {
       x(CMPXCHG, cmpxchg)       /* compare and exchange 1, 2, 4 or 8 bytes */                      \
       x(CMPXCHG8B, cmpxchg8b)   /* compare and exchange 8 bytes */                                 \
       x(CMPXCHG16B, cmpxchg16b) /* compare and exchange 16 bytes */                                \
-      x(DIV, div)               /* unsigned divide %rdx:%rax by argument */                        \
-      x(IDIV, idiv)             /* signed divide %rdx:%rax by argument */                          \
-      x(IMUL, imul)             /* signed multiply %rdx:%rax by argument */                        \
+      x(IMUL, imul)             /* signed multiply register by register or memory */               \
       x(LEA, lea)               /* load effective address */                                       \
       x(LODS, lods)             /* load string from %rsi into %al/%ax/%eax/%rax */                 \
       x(MOV, mov)               /* general purpose move register, memory or immediate */           \
@@ -223,7 +227,6 @@ enum OpStmt2 : uint16_t {
       x(MOVS, movs)   /* move 1,2,4 or 8 bytes from mem at %rsi to mem at %rdi, and update both */ \
       x(MOVSX, movsx) /* sign-extend register or memory */                                         \
       x(MOVZX, movzx) /* zero-extend register or memory */                                         \
-      x(MUL, mul)     /* unsigned multiply %rdx:%rax by argument */                                \
       x(OR, or)       /* bitwise OR (i.e. x|y) register or memory */                               \
       x(RCL, rcl)     /* rotate left 1,2,4 or 8 bytes + carry by specified # bits */               \
       x(RCR, rcr)     /* rotate right 1,2,4 or 8 bytes + carry by specified # bits */              \
@@ -252,12 +255,16 @@ enum OpStmt2 : uint16_t {
       ONEJIT_COMMENT()    /* ------------------------------------------------------------------ */ \
       ONEJIT_COMMENT()    /* [CPUID SSE2] is required by the following instructions ----------- */ \
       ONEJIT_COMMENT()    /* ------------------------------------------------------------------ */ \
+      x(ADDSD, addsd)       /* add double */                                                       \
+      x(ADDSS, addss)       /* add float */                                                        \
       x(CVTSD2SI, cvtsd2si) /* convert double to int */                                            \
       x(CVTSD2SS, cvtsd2ss) /* convert double to float */                                          \
       x(CVTSI2SD, cvtsi2sd) /* convert int to double */                                            \
       x(CVTSI2SS, cvtsi2ss) /* convert int to float */                                             \
       x(CVTSS2SD, cvtss2sd) /* convert double to float */                                          \
       x(CVTSS2SI, cvtss2si) /* convert float to int */                                             \
+      x(CVTTSD2SI, cvttsd2si) /* convert double to int, truncating */                              \
+      x(CVTTSS2SI, cvttss2si) /* convert float to int, truncating */                               \
       x(DIVSD, divsd)       /* divide double */                                                    \
       x(DIVSS, divss)       /* divide float */                                                     \
       x(MAXPD, maxpd)       /* maximum of two %xmm packed double */                                \
@@ -285,10 +292,16 @@ enum OpStmt2 : uint16_t {
       x(MOVUPS, movups)     /* move packed float from %xmm to %xmm or unaligned memory */          \
       x(MULPD, mulpd)       /* multiply packed double from %xmm to %xmm or memory */               \
       x(MULPS, mulps)       /* multiply packed float from %xmm to %xmm or memory */                \
+      x(MULSD, mulsd)       /* multiply double */                                                  \
+      x(MULSS, mulss)       /* multiply float */                                                   \
       x(PAND, pand)         /* bitwise AND of %xmm and %xmm or memory */                           \
       x(PANDN, pandn)       /* bitwise AND-NOT of %xmm and %xmm or memory */                       \
       x(POR, por)           /* bitwise OR of %xmm and %xmm or memory */                            \
       x(PXOR, pxor)         /* bitwise XOR of %xmm and %xmm or memory */                           \
+      x(SUBSD, subsd)       /* subtract double */                                                  \
+      x(SUBSS, subss)       /* subtract float */                                                   \
+      x(UCOMISD, ucomisd)   /* compare double, set EFLAGS */                                       \
+      x(UCOMISS, ucomiss)   /* compare float, set EFLAGS */                                        \
       ONEJIT_COMMENT() /* --------------------------------------------------------------------- */ \
       ONEJIT_COMMENT() /* [CPUID SSE3] is required by the following instructions -------------- */ \
       x(LDDQU, lddqu)  /* load unaligned 128 bits into %xmm */                                     \
@@ -358,6 +371,8 @@ enum OpStmtN : uint16_t {
   // numeric values of the OpStmtN enum constants below this line MAY CHANGE WITHOUT WARNING
 
   SET_ = 6, // arguments are formal registers to set. used in function prologue and in calls.
+  PHI_ = 7, // SSA form: 1st argument is destination, others are its value from each predecessor
+  JUMP_TABLE_ = 8, // 1st argument is an index, others are the labels to jump to
 
 #define ONEJIT_OPSTMTN_X86(x) /*                                                                */ \
   x(CALL_, call_) /* call function. 1st argument is destination, others are formal registers */    \
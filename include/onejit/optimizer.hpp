@@ -18,11 +18,16 @@
 
 #include <onejit/check.hpp>
 #include <onejit/ir/node.hpp>
+#include <onejit/reg/liveness.hpp>
 #include <onestl/buffer.hpp>
 #include <onestl/crange.hpp>
 
 namespace onejit {
 
+struct Gvn;
+struct Licm;
+struct Sccp;
+
 ////////////////////////////////////////////////////////////////////////////////
 
 // optimizations
@@ -30,9 +35,27 @@ enum Opt : uint16_t {
   OptNone = 0,
   OptFoldConstant = 1 << 0,
   OptSimplifyExpr = 1 << 1,
+  // remove unreachable code, assignments to Vars that are never read and unused labels
   OptRemoveDeadCode = 1 << 2,
   // treat floating point + and * as associative. requires OptSimplifyExpr
   OptFastMath = 1 << 3,
+  // allocate registers with graph coloring. slower than the default linear scan,
+  // usually produces better code
+  OptGraphColoring = 1 << 4,
+  // convert compiled code to SSA form, apply global optimizations, and convert it back
+  OptSSA = 1 << 5,
+  // replace repeated pure expressions with the value computed by a dominating one.
+  // requires OptSSA
+  OptValueNumbering = 1 << 6,
+  // propagate constants through Vars and across basic blocks, remove conditional jumps
+  // that are always or never taken, and remove unreachable basic blocks. requires OptSSA
+  OptPropagateConstant = 1 << 7,
+  // move assignments and expressions whose value does not change inside a loop
+  // to the basic block preceding the loop. requires OptSSA
+  OptHoistInvariant = 1 << 8,
+  // compile small If and Cond that only assign cheap, side-effect free values to the same Var
+  // as branchless SELECT, i.e. conditional moves or SETcc instead of conditional jumps
+  OptIfConversion = 1 << 9,
   OptAll = 0xffff,
 };
 
@@ -55,6 +78,33 @@ public:
 
   Node optimize(Func &func, Node node, Opt flags = OptAll) noexcept;
 
+  // global value numbering of compiled code in SSA form: replace each repeated pure expression
+  // with a Var holding the value computed by a dominating occurrence of the same expression.
+  // flowgraph must have been built from nodes.
+  // defined in onejit/optimizer_gvn.cpp. return false if out of memory
+  bool number_values(Func &func, const FlowGraph &flowgraph, Array<Node> &nodes) noexcept;
+
+  // sparse conditional constant propagation of compiled code in SSA form:
+  // find the Vars with constant value and the basic blocks that are reachable
+  // assuming only such constant values, then replace the Vars with their value
+  // and remove the unreachable basic blocks and the conditional jumps with constant result.
+  // flowgraph must have been built from nodes.
+  // defined in onejit/optimizer_sccp.cpp. return false if out of memory
+  bool propagate_constants(Func &func, const FlowGraph &flowgraph, Array<Node> &nodes,
+                           Opt flags = OptAll) noexcept;
+
+  // loop-invariant code motion of compiled code in SSA form: move the assignments
+  // and the subexpressions whose value does not change inside a natural loop to the end
+  // of its preheader, i.e. the only basic block outside the loop that jumps to its header.
+  // memory loads are moved only if the loop does not write to memory.
+  // memory loads and divisions, which may trap, are moved only if the loop executes them
+  // at least once: the preheader checks the loop test before executing them.
+  // flowgraph must have been built from nodes, and def_use must collect the Vars
+  // defined by each statement.
+  // defined in onejit/optimizer_licm.cpp. return false if out of memory
+  bool hoist_invariants(Func &func, const FlowGraph &flowgraph, Array<Node> &nodes,
+                        reg::Liveness::DefUse def_use) noexcept;
+
   // false if out of memory
   constexpr explicit operator bool() const noexcept {
     return bool(nodes_);
@@ -93,11 +143,47 @@ private:
   Expr simplify_quo(Expr x, Expr y) noexcept;
   Expr simplify_rem(Expr x, Expr y) noexcept;
   Expr simplify_shift(Op2 op, Expr x, Expr y) noexcept;
+
+  // lower (/ x y) and (% x y) with integer constant y to shifts, masks and multiplications.
+  // op must be QUO or REM. defined in onejit/optimizer_div.cpp
+  Expr simplify_quo_rem(Op2 op, Expr x, Value y) noexcept;
+  Expr simplify_quo_rem_pow2(Op2 op, Expr x, bool negative, uint32_t shift) noexcept;
+  Expr simplify_quo_rem_unsigned(Op2 op, Expr x, uint64_t d) noexcept;
+  Expr simplify_quo_rem_signed(Op2 op, Expr x, Value y) noexcept;
+  Expr simplify_quo_rem_unsigned64(Op2 op, Expr x, uint64_t d) noexcept;
+  Expr simplify_quo_rem_signed64(Op2 op, Expr x, Value y) noexcept;
   Expr simplify_boolean(Op2 op, Expr x, Expr y) noexcept;
   Expr simplify_comparison(Op2 op, Expr x, Expr y) noexcept;
 
   Expr simplify_comma(Span<Expr> args) noexcept;
 
+  // visit basic blocks in dominator tree preorder, calling number_values(Gvn&, Node)
+  // on each statement. return false if out of memory
+  bool number_values(Gvn &gvn, BasicBlocks bbs, View<uint32_t> dom_start,
+                     View<uint32_t> dom_child, Span<Node> nodes) noexcept;
+  Node number_values(Gvn &gvn, Node node) noexcept;
+  Expr number_values(Gvn &gvn, Expr expr, Var dst) noexcept;
+
+  // rewrite statements after propagate_constants() computed constant Vars
+  // and reachable basic blocks. return false if out of memory
+  bool propagate_constants(Sccp &sccp, Array<Node> &nodes) noexcept;
+  Node propagate_constants(Sccp &sccp, const BasicBlock &block, Phi phi,
+                           Array<Var> &args) noexcept;
+  // rewrite (asm_cmp x y) and the conditional jump that follows it
+  Node propagate_constants(Sccp &sccp, Stmt2 cmp, Node &jump) noexcept;
+  Node propagate_constants(Sccp &sccp, Node node) noexcept;
+
+  // move the invariant statements of a natural loop to its preheader,
+  // then copy the invariant subexpressions of the remaining ones to new Vars.
+  // blocks are the basic blocks of the loop, and the first one is its header.
+  // return false if out of memory
+  bool hoist_invariants(Licm &licm, View<uint32_t> blocks, Array<Node> &nodes) noexcept;
+  Node hoist_invariants(Licm &licm, Node node, uint32_t bb) noexcept;
+  // if hoist is true and expr is invariant, copy it to a new Var assigned in the preheader
+  Expr hoist_invariants(Licm &licm, Expr expr, uint32_t bb, bool hoist) noexcept;
+  // return true if invariant expr, evaluated in basic block bb, can be moved to the preheader
+  bool is_hoistable(const Licm &licm, Expr expr, uint32_t bb) const noexcept;
+
   // convert configured Check:s to an Allow mask
   // that ignores expressions with side effects
   constexpr Allow allow_mask_pure() const noexcept {
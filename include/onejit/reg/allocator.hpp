@@ -24,7 +24,25 @@
 namespace onejit {
 namespace reg {
 
-// register allocator. uses register interference graph and Chaitin algorithm.
+// a register-to-register copy, candidate for coalescing
+struct Move {
+  Reg dst;
+  Reg src;
+};
+
+// a register that may be spilled, with its spill cost and its degree when it was added
+struct SpillCandidate {
+  uint32_t cost;
+  Degree degree;
+  Reg reg;
+};
+
+// register allocator. uses either register interference graph and Chaitin algorithm,
+// or live intervals and linear scan algorithm.
+//
+// each Reg belongs to a register class, as for example general purpose or floating point:
+// regs of different classes never interfere, and each class is colored independently
+// with its own number of colors. By default, all regs belong to class 0.
 class Allocator {
 
 public:
@@ -41,12 +59,14 @@ public:
 
   // reset Allocator and reinitialize it
   // for a (possibly) different number of registers.
+  // if with_graph is false, does not allocate the interference graph:
+  // only linear scan allocate_regs(View<Interval>, Color) can be used.
   // return false if out of memory.
-  bool reset(Size num_regs) noexcept;
+  bool reset(Size num_regs, bool with_graph = true) noexcept;
 
   // return the allocator size, i.e. the num_regs passed to constructor or reset()
   constexpr Size size() const noexcept {
-    return g_.size();
+    return colors_.size();
   }
 
   Graph &graph() {
@@ -62,11 +82,89 @@ public:
   // and reset() disables them too.
   void add_hint(Reg reg, Color color) noexcept;
 
-  // choose a color for each Reg present in graph()
-  void allocate_regs(Color num_colors) noexcept;
+  // set the register class of reg.
+  // Note: reset() sets all regs to class 0
+  void set_class(Reg reg, RegClass cls) noexcept;
+
+  // return the register class of reg
+  RegClass get_class(Reg reg) const noexcept {
+    return reg < class_.size() ? class_[reg] : 0;
+  }
+
+  // set the colors of class cls that are clobbered by function calls,
+  // i.e. the caller-saved registers. return false if out of memory.
+  // Note: reset() removes all clobbered colors
+  bool set_clobbered(RegClass cls, View<Color> colors) noexcept;
+
+  // mark reg as live across a function call:
+  // it will not be assigned the colors clobbered by calls.
+  // Note: reset() removes all marks
+  void add_call_crossing(Reg reg) noexcept;
+
+  // return true if reg was marked with add_call_crossing()
+  bool is_call_crossing(Reg reg) const noexcept {
+    return reg < crossing_.size() && crossing_[reg];
+  }
+
+  // mark reg as live across an instruction that overwrites color,
+  // as for example x86_64 mul and div overwrite %rax and %rdx:
+  // reg will not be assigned such color. color must be < 64.
+  // return false if out of memory.
+  // Note: reset() removes all marks
+  bool add_clobbered(Reg reg, Color color) noexcept;
+
+  // mark reg as rematerializable, i.e. cheaper to recompute than to reload from stack:
+  // register allocation will prefer spilling it.
+  // Note: reset() removes all marks
+  void add_remat(Reg reg) noexcept;
+
+  // set the estimated cost of spilling reg, for example its number of uses and definitions
+  // weighted by loop depth. register allocation will prefer spilling cheap registers.
+  // registers without a cost set have cost 1.
+  // Note: reset() removes all costs
+  void set_spill_cost(Reg reg, uint32_t cost) noexcept;
+
+  // return true if reg was marked with add_remat()
+  bool is_remat(Reg reg) const noexcept {
+    return reg < remat_.size() && remat_[reg];
+  }
+
+  // add a register-to-register copy dst = src.
+  // allocate_regs(Color) will try to assign the same color to both,
+  // if it can be done without causing additional spills.
+  // return false if out of memory.
+  // Note: reset() removes all moves.
+  bool add_move(Reg dst, Reg src) noexcept;
+
+  // choose a color for each Reg present in graph(),
+  // after conservatively coalescing the moves added with add_move()
+  // all regs must belong to class 0.
+  // return false if out of memory
+  bool allocate_regs(Color num_colors) noexcept {
+    return allocate_regs(View<Color>{&num_colors, 1});
+  }
+
+  // choose a color for each Reg present in graph(),
+  // after conservatively coalescing the moves added with add_move()
+  // num_colors index is register class, and its size must be <= MaxRegClass.
+  // interference graph must not connect regs of different classes.
+  // return false if out of memory
+  bool allocate_regs(View<Color> num_colors) noexcept;
+
+  // choose a color for each Reg with a non-empty live interval, using linear scan:
+  // faster than graph coloring, usually produces slightly worse code.
+  // intervals index is reg. all regs must belong to class 0
+  void allocate_regs(View<Interval> intervals, Color num_colors) noexcept {
+    allocate_regs(intervals, View<Color>{&num_colors, 1});
+  }
+
+  // choose a color for each Reg with a non-empty live interval, using linear scan.
+  // intervals index is reg, num_colors index is register class
+  // and its size must be <= MaxRegClass
+  void allocate_regs(View<Interval> intervals, View<Color> num_colors) noexcept;
 
   // return colors chosen by allocate_regs()
-  // spilled Regs will have color >= num_colors
+  // spilled Regs will have color >= num_colors of their class
   constexpr View<Color> get_colors() const noexcept {
     return colors_;
   }
@@ -79,27 +177,107 @@ public:
   }
 
 private:
-  // called by allocate_regs()
-  void init() noexcept;
+  // return the number of colors available to the class of reg
+  Color num_colors(Reg reg) const noexcept {
+    return num_colors_[get_class(reg)];
+  }
+
+  // called by allocate_regs(). return false if out of memory
+  bool init() noexcept;
+
+  // coalesce move-related regs with Briggs and George conservative tests.
+  // return false if out of memory
+  bool coalesce() noexcept;
+
+  // return true if coalescing a and b cannot make the graph uncolorable (Briggs)
+  bool can_coalesce_briggs(Reg a, Reg b, Color num_colors) const noexcept;
+
+  // return true if each neighbor of b already interferes with a
+  // or has low degree (George)
+  bool can_coalesce_george(Reg a, Reg b, Color num_colors) const noexcept;
+
+  // resize avail_colors_ to contain all the colors that allocate_regs() may need
+  void resize_avail_colors() noexcept;
+
+  // return true if color is clobbered by function calls and reg is live across them
+  bool is_clobbered(Reg reg, Color color) const noexcept;
+
+  // return lowest available color < num_colors not clobbered for reg, or NoColor
+  Color find_color(Reg reg, Color num_colors) const noexcept;
+
+  // merge b into a. return false if out of memory
+  bool combine(Reg a, Reg b) noexcept;
 
-  // find a register in g_ with degree less than specified degree
-  Reg find_degree_less_than(Degree degree) const noexcept;
+  // return the reg that b was merged into, or b itself
+  Reg alias(Reg reg) const noexcept;
+
+  // copy num_colors into num_colors_. return the number of register classes
+  size_t set_num_colors(View<Color> num_colors) noexcept;
+
+  // find a register in g_ with degree less than the number of colors of its class
+  Reg find_low_degree() const noexcept;
+
+  // return the cost of spilling reg: zero if rematerializable
+  uint32_t spill_cost(Reg reg) const noexcept;
 
   // pick a register in g_ to be spilled
-  Reg pick() const noexcept;
+  Reg pick() noexcept;
+
+  // add reg with its new degree to spill_heap_, if the latter was built by pick()
+  void spill_heap_push(Reg reg, Degree degree) noexcept;
+
+  // remove reg from g_, and move its neighbors to the bucket of their new degree
+  void remove(Reg reg) noexcept;
+
+  // insert reg in the bucket of specified degree
+  void bucket_insert(Reg reg, Degree degree) noexcept;
+
+  // remove reg from the bucket of specified degree
+  void bucket_remove(Reg reg, Degree degree) noexcept;
 
   // pop registers from stack_ and color them
-  // in the lowest color not used by some neighbor
-  void assign_colors(Color num_colors) noexcept;
+  // in the lowest color not used by some neighbor.
+  // return false if out of memory
+  bool assign_colors() noexcept;
 
   // try to find an alternate color for Reg that satisfies hints
   Color try_satisfy_hints(Reg reg) noexcept;
 
+  // linear scan: color the regs of specified class
+  void allocate_class(View<Interval> intervals, RegClass cls) noexcept;
+
+  // linear scan: remove from active_ the regs whose interval ends before pos,
+  // and mark their colors as available.
+  void expire_active(View<Interval> intervals, Size pos) noexcept;
+
+  // linear scan: insert reg into active_, keeping it sorted by interval end
+  void insert_active(View<Interval> intervals, Reg reg) noexcept;
+
   Graph g_;  // index is reg
   Graph g2_; // index is reg
   Array<Reg> stack_;
-  Array<Color> hints_;  // index is reg
-  Array<Color> colors_; // index is reg
+  Array<Reg> active_; // linear scan: regs with live intervals overlapping current position
+  // regs in g_ grouped by degree, as doubly linked lists:
+  // bucket_[degree] is the first reg, bucket_next_[reg] and bucket_prev_[reg] the others
+  Array<Reg> bucket_;      // index is degree
+  Array<Reg> bucket_next_; // index is reg
+  Array<Reg> bucket_prev_; // index is reg
+  Degree max_degree_;      // no reg in g_ has higher degree
+  // spill candidates, best one first. built by the first pick(), and updated by remove():
+  // entries whose degree differs from the current degree of their reg are stale
+  Array<SpillCandidate> spill_heap_;
+  bool spill_heap_built_;
+  Array<Move> moves_;
+  Array<Reg> alias_; // index is reg
+  Array<Color> hints_;    // index is reg
+  Array<Color> colors_;   // index is reg
+  Array<RegClass> class_; // index is reg. empty if all regs belong to class 0
+  BitSet crossing_;       // index is reg. empty if no reg is live across calls
+  BitSet remat_;          // index is reg. empty if no reg is rematerializable
+  Array<uint32_t> cost_;  // index is reg. empty if no spill costs were set
+  Array<uint64_t> clobbered_by_;        // index is reg. bit i is set if color i is clobbered
+  Array<Color> clobbered_[MaxRegClass]; // index is class
+  Color num_colors_[MaxRegClass]; // index is class
   BitSet avail_colors_;
 
 }; // class Allocator
@@ -25,13 +25,16 @@ using Degree = ::onestl::graph::Degree;
 using Reg = ::onestl::graph::Node;
 using Size = ::onestl::graph::Size;
 using Color = Reg;
+using RegClass = uint8_t;
 
 enum : Size { NoPos = ::onestl::graph::NoPos };
 enum : Reg { NoReg = NoPos };
 enum : Color { NoColor = NoPos };
+enum : RegClass { MaxRegClass = 4 };
 
 class Allocator;
 class Liveness;
+struct Interval;
 
 } // namespace reg
 } // namespace onejit
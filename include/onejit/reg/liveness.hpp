@@ -17,27 +17,151 @@
 #define ONEJIT_REG_LIVENESS_HPP
 
 #include <onejit/fwd.hpp>
+#include <onejit/reg/fwd.hpp>
+#include <onestl/array.hpp>
 #include <onestl/bitset.hpp>
 
 namespace onejit {
 namespace reg {
 
-// perform register liveness analysis
+// positions, i.e. indexes of compiled nodes, where a register is live or accessed.
+// used by linear scan register allocation. empty if start > end
+struct Interval {
+  Size start;
+  Size end;
+};
+
+// perform register liveness analysis:
+// compute which registers are live at the beginning and end of each basic block,
+// solving the usual backward dataflow equations
+//   live_out(bb) = union of live_in(succ) for each successor succ of bb
+//   live_in(bb)  = use(bb) | (live_out(bb) & ~def(bb))
+// with word-parallel BitSet operations.
 class Liveness {
 
 public:
+  // append to def and use the registers defined and used by node.
+  // registers both used and defined, as x in x += y, must be appended to both.
+  // implemented by each architecture. return false if out of memory
+  using DefUse = bool (*)(Node node, Array<Reg> &def, Array<Reg> &use);
+
   Liveness() noexcept;
 
-  Liveness(Liveness &&) noexcept = default;
+  Liveness(Liveness &&other) noexcept;
   Liveness(const Liveness &) noexcept = delete;
 
   ~Liveness() noexcept;
 
-  Liveness &operator=(Liveness &&) noexcept = default;
+  Liveness &operator=(Liveness &&other) noexcept;
   Liveness &operator=(const Liveness &) noexcept = delete;
 
+  // compute live-in and live-out registers of each basic block.
+  // return false if out of memory
+  bool compute(BasicBlocks bbs, Size num_regs, DefUse def_use) noexcept;
+
+  // return number of basic blocks analyzed by compute()
+  constexpr size_t size() const noexcept {
+    return bb_n_;
+  }
+
+  // return number of registers analyzed by compute()
+  constexpr Size num_regs() const noexcept {
+    return num_regs_;
+  }
+
+  // return registers live at the beginning of i-th basic block
+  const BitSet &live_in(size_t i) const noexcept {
+    return set_[i * SetN + In];
+  }
+
+  // return registers live at the end of i-th basic block
+  const BitSet &live_out(size_t i) const noexcept {
+    return set_[i * SetN + Out];
+  }
+
+  // compute the live interval of each register, i.e. the positions
+  // between its first and last definition, use or liveness.
+  // positions are indexes of nodes, counted from the beginning of first basic block.
+  // must be called after compute() with the same basic blocks.
+  // return false if out of memory
+  bool compute_intervals(BasicBlocks bbs) noexcept;
+
+  // return intervals computed by compute_intervals(). index is reg
+  constexpr View<Interval> intervals() const noexcept {
+    return interval_;
+  }
+
+  // collect registers defined and used by node.
+  // retrieve them with def() and use()
+  // return false if out of memory
+  bool collect(Node node) noexcept;
+
+  // return registers defined by node passed to last collect()
+  constexpr View<Reg> def() const noexcept {
+    return def_;
+  }
+
+  // return registers used by node passed to last collect()
+  constexpr View<Reg> use() const noexcept {
+    return use_;
+  }
+
+  // update live registers backward across node passed to last collect(),
+  // i.e. set live = (live & ~def()) | use()
+  void update(BitSet &live) const noexcept;
+
+  void swap(Liveness &other) noexcept;
+
+private:
+  enum : size_t {
+    Use = 0,
+    Def = 1,
+    In = 2,
+    Out = 3,
+    SetN = 4,
+  };
+
+  // ensure set_ contains at least n BitSets with size num_regs
+  bool init(size_t n, Size num_regs) noexcept;
+  void destroy() noexcept;
+
+  // compute use and def of i-th basic block
+  bool compute_use_def(size_t i, const BasicBlock &bb) noexcept;
+
+  // extend the interval of all regs present in set to include pos
+  void extend_intervals(const BitSet &set, Size pos) noexcept;
+
+  // extend the interval of reg to include pos
+  void extend_interval(Reg reg, Size pos) noexcept;
+
+  BitSet *set_; // 4 BitSets per basic block: use, def, live_in, live_out
+  size_t set_cap_;
+  size_t bb_n_;
+  Size num_regs_;
+  DefUse def_use_;
+  BitSet tmp_;
+  Array<Reg> def_;
+  Array<Reg> use_;
+  Array<Interval> interval_;
+
 }; // class Liveness
 
+inline void swap(Liveness &left, Liveness &right) noexcept {
+  left.swap(right);
+}
+
+// helpers for Liveness::DefUse implementations. all return false if out of memory
+
+// add var to regs, unless it's a physical register
+bool add_reg(Var var, Array<Reg> &regs) noexcept;
+
+// add to use all registers found inside node
+bool add_uses(Node node, Array<Reg> &use) noexcept;
+
+// if dst is a Var, it is defined - and also used if also_use is true.
+// if dst is a memory location, its address registers are used.
+bool add_dst(Node dst, Array<Reg> &def, Array<Reg> &use, bool also_use) noexcept;
+
 } // namespace reg
 } // namespace onejit
 
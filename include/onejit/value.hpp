@@ -240,6 +240,10 @@ Value operator^(Value a, Value b) noexcept;
 Value operator<<(Value a, Value b) noexcept;
 Value operator>>(Value a, Value b) noexcept;
 
+// return the high half of the double-width product a * b,
+// which is signed or unsigned depending on the kind of a and b
+Value mulhi(Value a, Value b) noexcept;
+
 /**
  * relational operators return Value{} if a and b have different kind.
  * they also use floating point comparison when a and b are floating point,
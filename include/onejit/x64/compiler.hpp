@@ -17,11 +17,15 @@
 
 #include <onejit/error.hpp>
 #include <onejit/reg/fwd.hpp>
+#include <onejit/x64/regid.hpp>
 #include <onestl/array.hpp>
 
 namespace onejit {
 namespace x64 {
 
+struct Spill;
+struct Split;
+
 ////////////////////////////////////////////////////////////////////////////////
 // compiles code from portable intermediate representation
 // (produced by onejit::Compiler::compile()) to x86_64 assembler
@@ -34,7 +38,8 @@ class Compiler {
 
 public:
   constexpr Compiler() noexcept //
-      : func_{}, allocator_{}, node_{}, flowgraph_{}, error_{}, flags_{}, good_{true} {
+      : func_{}, allocator_{}, liveness_{}, node_{}, flowgraph_{}, error_{}, flags_{}, //
+        abi_{}, good_{true} {
   }
 
   Compiler(Compiler &&other) noexcept = default;
@@ -47,14 +52,15 @@ public:
 
 private:
   // private, use onejit::Compiler::x64() instead
-  Compiler &compile(Func &func, reg::Allocator &allocator, Array<Node> &node,      //
-                    FlowGraph &flowgraph, Array<Error> &error, Opt flags, Abi abi) //
-      noexcept;
+  Compiler &compile(Func &func, reg::Allocator &allocator, reg::Liveness &liveness, //
+                    Array<Node> &node, FlowGraph &flowgraph, Array<Error> &error,  //
+                    Opt flags, Abi abi) noexcept;
 
   Compiler &compile(Assign stmt) noexcept;
   Compiler &compile(AssignCall stmt) noexcept;
   Compiler &compile(Block stmt) noexcept;
   Compiler &compile(Expr expr) noexcept;
+  Compiler &compile(JumpTable stmt) noexcept;
   Compiler &compile(Node node) noexcept;
   Compiler &compile(Return stmt) noexcept;
   Compiler &compile(Stmt1 stmt) noexcept;
@@ -67,11 +73,50 @@ private:
   Expr simplify(Tuple expr) noexcept;
   Expr simplify(Unary expr) noexcept;
 
+  // fold integer (+ ...) into label + offset + base + index * scale, computed by a single LEA
+  Expr simplify_add(Tuple expr) noexcept;
+
+  // keep integer comparison in (select test x y), it is compiled together with CMOVcc
+  Expr simplify_select(Tuple expr) noexcept;
+
   Node simplify_assign(Assign st, Expr dst, Expr src) noexcept;
   Node simplify_assign(Assign st, Expr dst, Unary src) noexcept;
   Node simplify_assign(Assign st, Expr dst, Binary src) noexcept;
   Node simplify_assign(Assign st, Expr dst, Tuple src) noexcept;
 
+  // compute src into a new Var, then copy the latter to memory dst.
+  // return st if src cannot be compiled yet
+  Node simplify_assign_mem(Assign st, Expr dst, Expr src) noexcept;
+
+  // compute dst = args[0] xop args[1] xop ... with two-argument instruction xop,
+  // i.e. dst = args[0]; dst xop= args[1]; ... and return the last instruction.
+  // if xop is a CMOVcc, each one is preceded by CMP dst, args[i]
+  Node simplify_assign_ops(Expr dst, Array<Node> &args, OpStmt2 xop, bool commutative) noexcept;
+
+  // compute dst = (op x y) where op is a comparison and dst is a Bool, using SETcc
+  Node simplify_assign_cmp(Expr dst, Op2 op, Expr x, Expr y) noexcept;
+
+  // compute dst = x zero-extended or sign-extended to the wider kind of dst
+  Node simplify_assign_extend(Var dst, Expr x) noexcept;
+
+  // compute dst = (op x y) where op is QUO or REM on integers, using DIV or IDIV
+  Node simplify_assign_div(Expr dst, Op2 op, Expr x, Expr y) noexcept;
+
+  // compute dst = (op x y) where op is SHL or SHR on integers and y is not a Const,
+  // using a shift by %cl
+  Node simplify_assign_shift(Expr dst, Op2 op, Expr x, Expr y) noexcept;
+
+  // compute dst = (cast float x) where x is an unsigned 64-bit integer:
+  // CVTSI2SD and CVTSI2SS only convert signed integers
+  Node simplify_cast_uint64_to_float(Expr dst, Var x) noexcept;
+
+  // compute dst = (cast uint64 x) where x is a float:
+  // CVTTSD2SI and CVTTSS2SI only convert to signed integers
+  Node simplify_cast_float_to_uint64(Expr dst, Var x) noexcept;
+
+  // compute dst = test ? x : y with CMP or TEST followed by MOV and CMOVcc
+  Node simplify_assign_select(Expr dst, Expr test, Expr x, Expr y) noexcept;
+
   void simplify_binary(Expr &x, Expr &y) noexcept;
 
   constexpr Func *func() const noexcept {
@@ -82,11 +127,11 @@ private:
   // otherwise copies expression result to a new local variable and returns it.
   Var to_var(Expr expr) noexcept;
 
-  // if expr is a Var or Const, does nothing and returns it
+  // if expr is a Var or a Const that fits a 32-bit immediate, does nothing and returns it
   // otherwise copies expression result to a new local variable and returns it.
   Expr to_var_const(Expr expr) noexcept;
 
-  // if expr is a Var, Mem or Const, does nothing and returns it
+  // if expr is a Var, Mem or a Const that fits a 32-bit immediate, does nothing and returns it
   // otherwise copies expression result to a new local variable and returns it.
   Expr to_var_mem_const(Expr expr) noexcept;
 
@@ -94,14 +139,100 @@ private:
   Compiler &add(Node node) noexcept;
 
   // perform register allocation
-  Compiler &allocate_regs(Abi abi) noexcept;
+  Compiler &allocate_regs() noexcept;
+
+  // return the register represented by color of register class cls
+  RegId color_reg(reg::RegClass cls, reg::Color color) const noexcept;
+
+  // return the scratch register used by spill_regs() for Vars with specified kind
+  Var scratch_reg(Kind kind) const noexcept;
+
+  // set the register class of each Var, depending on its Kind
+  Compiler &set_reg_classes() noexcept;
+
+  // split the live range of each Var live across a function call,
+  // by copying it to a new Var before the call and back after the call
+  Compiler &split_live_ranges() noexcept;
+
+  // append to splits the Vars live across each function call.
+  // requires up-to-date liveness
+  Compiler &find_call_crossing(Array<Split> &splits) noexcept;
 
+  // find rematerializable Vars, i.e. defined only once by a constant or a label address,
+  // and mark them in allocator. remat index is register, value is the defining node
+  Compiler &find_remat(Array<Node> &remat) noexcept;
+
+  // set the spill cost of each Var: its number of uses and definitions,
+  // each weighted by 8^loop_depth. requires up-to-date flowgraph
+  Compiler &set_spill_costs() noexcept;
+
+  // mark Vars live across function calls, so that they are not allocated
+  // to registers clobbered by calls. requires up-to-date liveness
+  Compiler &mark_call_crossing() noexcept;
+
+  // set the colors clobbered by function calls, i.e. the caller-saved registers of abi_
+  Compiler &set_clobbered() noexcept;
+
+  // mark Vars live while the fixed registers %rax %rcx %rdx hold a value, as around mul, div
+  // and shifts by %cl, so that they are not allocated to such registers.
+  // requires up-to-date liveness
+  Compiler &mark_fixed_clobbered() noexcept;
+
+  // build flowgraph and compute liveness of registers across basic blocks.
+  // return false if out of memory
+  bool compute_liveness() noexcept;
+
+  // compute liveness of registers across basic blocks,
+  // then add an interference edge between each defined register
+  // and each register live after the definition
   Compiler &fill_interference_graph() noexcept;
 
-  static void update_live_regs(BitSet &live, Node node) noexcept;
+  // append to def and use the registers defined and used by node.
+  // passed to reg::Liveness::compute()
+  static bool def_use(Node node, Array<reg::Reg> &def, Array<reg::Reg> &use) noexcept;
+
+  // remove register-to-register copies between Vars that were assigned the same color,
+  // i.e. the same register or the same stack slot
+  Compiler &remove_redundant_moves() noexcept;
+
+  // append to saved the callee-saved registers assigned to some Var:
+  // function prologue must save them, and epilogue must restore them
+  Compiler &find_callee_saved(Array<RegId> &saved) noexcept;
+
+  // rewrite spilled registers, i.e. Vars with color >= num_colors of their register class,
+  // as stack slots addressed by RSP, and allocate the stack frame containing them.
+  // also save the callee-saved registers returned by find_callee_saved()
+  // on function entry, and restore them before each return.
+  // uses R11 and an SSE register as scratch where x86_64 instructions need a register.
+  // spilled rematerializable registers get no stack slot: their defining node
+  // is removed and recomputed at each use.
+  // num_colors index is register class, remat is the output of find_remat()
+  Compiler &spill_regs(View<reg::Color> num_colors, View<Node> remat) noexcept;
+
+  // append node to spill_regs() output
+  void spill_add(Spill &sp, Node node) noexcept;
+
+  // if var was spilled, return its stack slot. otherwise return var
+  Expr spill_slot(const Spill &sp, Var var) noexcept;
+
+  // load var, which must be spilled, into register dst
+  void spill_load(Spill &sp, Var dst, Var var) noexcept;
+
+  // recompute a spilled rematerializable register defined by def.
+  // return its constant value if imm_ok and it fits an immediate,
+  // otherwise load it into scratch register and return the latter
+  Expr spill_remat(Spill &sp, Stmt2 def, bool imm_ok) noexcept;
+
+  // replace spilled Vars in an instruction operand.
+  // imm_ok must be true if operand can be an immediate constant
+  Expr spill_operand(Spill &sp, Expr expr, bool imm_ok = false) noexcept;
+
+  Node spill(Spill &sp, Stmt1 st) noexcept;
+  Node spill(Spill &sp, Stmt2 st) noexcept;
+  Node spill(Spill &sp, StmtN st) noexcept;
 
   // set ABI register hints for function params and results
-  Compiler &set_reg_hints(Abi abi) noexcept;
+  Compiler &set_reg_hints() noexcept;
 
   // store compiled code into function.set_compiled(X64)
   // invoked by compile(Func)
@@ -115,10 +246,12 @@ private:
 
   Func *func_;
   reg::Allocator *allocator_;
+  reg::Liveness *liveness_;
   Array<Node> *node_;
   FlowGraph *flowgraph_;
   Array<Error> *error_;
   Opt flags_;
+  Abi abi_; // autodetected, never Abi_auto or Abi_x64_auto
   bool good_; // !good_ means out of memory
 };
 
@@ -30,6 +30,7 @@ class Inst3;
 class InstN;
 class Mem;
 class Reg;
+class Scale;
 
 } // namespace x64
 } // namespace onejit
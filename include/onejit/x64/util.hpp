@@ -15,6 +15,7 @@
 #ifndef ONEJIT_X64_UTIL_HPP
 #define ONEJIT_X64_UTIL_HPP
 
+#include <onejit/fwd.hpp>
 #include <onejit/x64/fwd.hpp>
 
 namespace onejit {
@@ -34,6 +35,13 @@ public:
   static bool validate_reg(Assembler &dst, Reg reg);
 
   static bool validate_mem(Assembler &dst, Mem mem);
+
+  // return true if expr is a constant that fits a sign-extended 32-bit immediate
+  static bool is_imm32(Expr expr) noexcept;
+
+  // return the x86_64 instruction that copies a value with specified kind
+  // between registers, or between a register and memory
+  static OpStmt2 x86_mov(Kind kind) noexcept;
 };
 
 } // namespace x64
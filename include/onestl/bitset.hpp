@@ -127,6 +127,25 @@ public:
   // throws if this and src have different sizes.
   void copy(const BitSet &src);
 
+  // set this = this | other, operating on whole words.
+  // throws if this and other have different sizes.
+  // return true if this changed.
+  bool set_union(const BitSet &other);
+
+  // set this = this & ~other, operating on whole words.
+  // throws if this and other have different sizes.
+  void set_difference(const BitSet &other);
+
+  // return true if this and other have the same size and bits.
+  bool operator==(const BitSet &other) const noexcept;
+
+  bool operator!=(const BitSet &other) const noexcept {
+    return !(*this == other);
+  }
+
+  // return number of bits == true
+  size_t count() const noexcept;
+
   void swap(BitSet &other) noexcept {
     mem::swap(data_, other.data_);
     mem::swap(size_, other.size_);
@@ -142,6 +161,16 @@ private:
   bool grow_cap(size_t mincap) noexcept;
   bool realloc(size_t newcap) noexcept;
 
+  // return number of words containing size() bits
+  constexpr size_t words() const noexcept {
+    return (size_ + bitsPerT - 1) / bitsPerT;
+  }
+
+  // return mask of valid bits in last word
+  constexpr T last_word_mask() const noexcept {
+    return size_ % bitsPerT ? ~T(0) >> (bitsPerT - size_ % bitsPerT) : ~T(0);
+  }
+
   static constexpr bool get(const T *data, Index index) noexcept {
     return bool(1 & (data[index / bitsPerT] >> (index % bitsPerT)));
   }
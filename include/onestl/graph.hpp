@@ -21,7 +21,13 @@
 
 namespace onestl {
 
-/** undirected, dense graph */
+/**
+ * undirected graph.
+ *
+ * small graphs are stored as a dense size*size BitSet.
+ * graphs with more than sparse_threshold nodes are stored as
+ * per-node sorted adjacency vectors, so that memory scales with edges.
+ */
 class Graph {
 
 public:
@@ -36,11 +42,17 @@ public:
     NoPos = graph::NoPos,
   };
 
-  constexpr Graph() noexcept : bits_(), degree_() {
+  enum : Size {
+    // reset(Size) uses sparse representation if size > sparse_threshold.
+    // at 4096 nodes, dense representation needs 2 MBytes
+    sparse_threshold = 4096,
+  };
+
+  constexpr Graph() noexcept : bits_(), degree_(), adj_(), sparse_(false) {
   }
 
-  explicit Graph(Size size) noexcept //
-      : bits_(size_t(size) * size), degree_(size) {
+  explicit Graph(Size size) noexcept : Graph() {
+    reset(size);
   }
 
   Graph(const Graph &other) = delete;
@@ -58,8 +70,21 @@ public:
     return degree_.size();
   }
 
-  // resize Graph and remove all edges
-  bool reset(Size size) noexcept;
+  // return true if Graph uses sparse representation
+  constexpr bool is_sparse() const noexcept {
+    return sparse_;
+  }
+
+  // resize Graph and remove all edges.
+  // uses sparse representation if size > sparse_threshold.
+  // return false if out of memory.
+  bool reset(Size size) noexcept {
+    return reset(size, size > sparse_threshold);
+  }
+
+  // resize Graph, remove all edges, and use specified representation.
+  // return false if out of memory.
+  bool reset(Size size, bool sparse) noexcept;
 
   // return true if nodes a and b are connected, otherwise false.
   // return false also if a or b are out of bounds
@@ -67,7 +92,8 @@ public:
 
   // add or remove an edge betwen nodes a and b.
   // does nothing if a or b are out of bounds
-  void set(Node a, Node b, bool value) noexcept;
+  // return false if out of memory
+  bool set(Node a, Node b, bool value) noexcept;
 
   // return number of edges connected to specified node.
   // return 0 if node is out of bounds.
@@ -90,11 +116,37 @@ public:
   void swap(Graph &other) noexcept {
     bits_.swap(other.bits_);
     degree_.swap(other.degree_);
+    adj_.swap(other.adj_);
+    mem::swap(sparse_, other.sparse_);
   }
 
 private:
-  BitSet bits_;
+  // sorted adjacency vector of a node, used by sparse representation
+  struct Adj {
+    Node *data;
+    Size size;
+    Size cap;
+  };
+
+  // free all adjacency vectors
+  void destroy_adj() noexcept;
+
+  // return the position of first element >= node in adj
+  static Size lower_bound(const Adj &adj, Node node) noexcept;
+
+  // return true if adjacency vector of a contains b
+  bool sparse_get(Node a, Node b) const noexcept;
+
+  // insert b into adjacency vector of a. return false if out of memory
+  bool sparse_insert(Node a, Node b) noexcept;
+
+  // remove b from adjacency vector of a. return true if b was present
+  bool sparse_erase(Node a, Node b) noexcept;
+
+  BitSet bits_; // dense representation
   Array<Degree> degree_;
+  Array<Adj> adj_; // sparse representation
+  bool sparse_;
 };
 
 inline void swap(Graph &left, Graph &right) noexcept {
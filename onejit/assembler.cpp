@@ -21,8 +21,23 @@ namespace onejit {
 Assembler::~Assembler() noexcept {
 }
 
-Assembler &Assembler::add_relocation(Label l) noexcept {
-  if (l && !relocation_.append(Relocation{size(), l})) {
+Assembler &Assembler::clear() noexcept {
+  Base::clear();
+  relocation_.clear();
+  label_.clear();
+  error_.clear();
+  return *this;
+}
+
+Assembler &Assembler::add_relocation(Label l, uint8_t size) noexcept {
+  if (l && !relocation_.append(Relocation{this->size(), l, size})) {
+    good_ = false;
+  }
+  return *this;
+}
+
+Assembler &Assembler::add_label(Label l) noexcept {
+  if (l && !label_.append(LabelPos{size(), l})) {
     good_ = false;
   }
   return *this;
@@ -17,18 +17,19 @@
 #include <onejit/local.hpp>
 #include <onejit/ir/childrange.hpp>
 #include <onejit/ir/header.hpp>
+#include <onejit/op.hpp>
 
 #include <cstring>
 
 namespace onejit {
 
-Code::Code() noexcept : Base{} {
+Code::Code() noexcept : Base{}, intern_{}, intern_n_{0}, interning_{false} {
   if (reserve(64)) {
     init();
   }
 }
 
-Code::Code(size_t capacity) noexcept : Base{} {
+Code::Code(size_t capacity) noexcept : Base{}, intern_{}, intern_n_{0}, interning_{false} {
   if (reserve(capacity)) {
     init();
   }
@@ -62,6 +63,15 @@ uint64_t Code::uint64(Offset byte_offset) const noexcept {
   return x.u64;
 }
 
+bool Code::set_uint64(Offset byte_offset, uint64_t u64) noexcept {
+  const size_t index = byte_offset / sizeof(T);
+  if (index + 1 < size()) {
+    std::memcpy(Base::data() + index, &u64, sizeof(u64));
+    return true;
+  }
+  return false;
+}
+
 Code &Code::add_item(const CodeItem item) noexcept {
   return add(CodeItems{&item, 1});
 }
@@ -139,4 +149,99 @@ Code &Code::add_ranges(const ChildRanges &nodes, Offset parent_offset) noexcept
   return *this;
 }
 
+// return true if nodes with specified header can be interned
+static bool is_internable(Header header) noexcept {
+  switch (header.type()) {
+  case CONST:
+  case UNARY:
+  case BINARY:
+    return true;
+  case TUPLE:
+    // calls have side effects
+    return OpN(header.op()) != CALL;
+  default:
+    // Var and Label are created only once per Id or index,
+    // and the address of Label can be modified
+    return false;
+  }
+}
+
+Code &Code::set_interning(bool enable) noexcept {
+  if (!enable) {
+    intern_.clear();
+    intern_n_ = 0;
+  }
+  interning_ = enable;
+  return *this;
+}
+
+Node Code::intern(Node node) noexcept {
+  if (!interning_ || !node || !is_internable(node.header()) ||
+      (intern_n_ >= intern_.size() / 2 && !grow_interned())) {
+    return node;
+  }
+  const uint32_t hash = uint32_t(node.shallow_hash());
+  const size_t mask = intern_.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    const uint64_t entry = intern_[i];
+    if (entry == 0) {
+      intern_.set(i, uint64_t(hash) << 32 | node.offset_or_direct());
+      intern_n_++;
+      return node;
+    }
+    if (uint32_t(entry >> 32) != hash) {
+      continue;
+    }
+    const Offset offset = Offset(entry);
+    const Node other{Header{get(offset)}, offset, this};
+    if (node.shallow_equal(other)) {
+      // node is the last one added: remove it without touching intern_
+      size_ = node.offset_or_direct() / sizeof(T);
+      return other;
+    }
+  }
+}
+
+bool Code::grow_interned() noexcept {
+  Array<uint64_t> old;
+  old.swap(intern_);
+  if (!intern_.resize(old.size() == 0 ? 64 : old.size() * 2)) {
+    // out of memory, keep the old hash table
+    intern_.swap(old);
+    return false;
+  }
+  for (const uint64_t entry : old) {
+    if (entry != 0) {
+      insert_interned(entry);
+    }
+  }
+  return true;
+}
+
+void Code::forget_interned() noexcept {
+  const Offset len = length();
+  Array<uint64_t> old;
+  if (!old.dup(intern_)) {
+    // out of memory, forget everything
+    old.clear();
+  }
+  intern_.fill(0);
+  intern_n_ = 0;
+  for (const uint64_t entry : old) {
+    if (entry != 0 && Offset(entry) < len) {
+      insert_interned(entry);
+    }
+  }
+}
+
+void Code::insert_interned(uint64_t entry) noexcept {
+  const size_t mask = intern_.size() - 1;
+  size_t i = uint32_t(entry >> 32) & mask;
+  while (intern_[i] != 0) {
+    i = (i + 1) & mask;
+  }
+  intern_.set(i, entry);
+  intern_n_++;
+}
+
 } // namespace onejit
@@ -29,6 +29,8 @@
 #include <onejit/ir/unary.hpp>
 #include <onejit/ir/util.hpp>
 
+#include <algorithm> // std::sort()
+
 namespace onejit {
 
 enum Compiler::Flags : uint8_t {
@@ -65,8 +67,8 @@ inline Compiler::Flags &operator^=(Compiler::Flags &a, Compiler::Flags b) noexce
 ////////////////////////////////////////////////////////////////////////////////
 
 Compiler::Compiler() noexcept
-    : optimizer_{}, allocator_{}, func_{}, break_{}, continue_{}, fallthrough_{}, //
-      node_{}, flowgraph_{}, error_{}, good_{true} {
+    : optimizer_{}, allocator_{}, liveness_{}, func_{}, break_{}, continue_{}, fallthrough_{}, //
+      node_{}, ssa_orig_{}, flowgraph_{}, error_{}, abi_{}, flags_{}, good_{true} {
 }
 
 Compiler::~Compiler() noexcept {
@@ -83,6 +85,7 @@ Compiler &Compiler::compile(Func &func, Opt flags) noexcept {
   }
 
   func_ = &func;
+  flags_ = flags;
   break_.clear();
   continue_.clear();
   fallthrough_.clear();
@@ -94,9 +97,14 @@ Compiler &Compiler::compile(Func &func, Opt flags) noexcept {
 
   Node node = optimizer_.optimize(func, func.get_body(), flags);
 
-  return compile_add(node, SimplifyDefault) //
-      .add_epilogue(func)
-      .finish();
+  compile_add(node, SimplifyDefault).add_epilogue(func);
+  if (flags & OptSSA) {
+    to_ssa().optimize_ssa(flags).from_ssa();
+  }
+  if (flags & OptRemoveDeadCode) {
+    remove_dead_code();
+  }
+  return finish();
 }
 
 Compiler &Compiler::finish() noexcept {
@@ -481,6 +489,13 @@ Node Compiler::compile(If st, Flags) noexcept {
     return VoidConst;
   }
   bool have_else = else_.type() != CONST;
+  if (flags_ & OptIfConversion) {
+    const Expr tests[] = {test};
+    const Node bodies[] = {then, else_};
+    if (compile_select(View<Expr>{tests, 1}, View<Node>{bodies, have_else ? 2u : 1u})) {
+      return VoidConst;
+    }
+  }
   Label else_label{*func_};
   Label endif_label = have_else ? Label{*func_} : else_label;
 
@@ -589,6 +604,122 @@ Node Compiler::compile(Block st, Flags) noexcept {
   return VoidConst;
 }
 
+// if node is an Assign{ASSIGN, Var, src} or a Block containing only such Assign,
+// return the Assign. otherwise return Assign{}
+static Assign single_assign(Node node) noexcept {
+  if (Block block = node.is<Block>()) {
+    if (block.children() != 1) {
+      return Assign{};
+    }
+    node = block.child(0);
+  }
+  Assign assign = node.is<Assign>();
+  return assign && assign.op() == ASSIGN && assign.dst().type() == VAR ? assign : Assign{};
+}
+
+// return true if expr can be evaluated unconditionally at low cost:
+// it cannot have side effects, fault or trap, and it contains at most one operation
+static bool is_cheap_pure(Expr expr) noexcept {
+  switch (expr.type()) {
+  case VAR:
+  case CONST:
+    return true;
+  case UNARY:
+  case BINARY:
+  case TUPLE:
+    for (uint32_t i = 0, n = expr.children(); i < n; i++) {
+      const Type t = expr.child(i).type();
+      if (t != VAR && t != CONST) {
+        return false;
+      }
+    }
+    return expr.deep_pure(AllowNone);
+  default:
+    return false;
+  }
+}
+
+// return true if expr is an integer Const equal to val
+static bool is_int_const(Expr expr, uint64_t val) noexcept {
+  const Const c = expr.is<Const>();
+  return c && !c.kind().is_float() && c.val().uint64() == val;
+}
+
+bool Compiler::compile_select(Cond st) noexcept {
+  Expr tests[SelectMaxTests];
+  Node bodies[SelectMaxTests + 1];
+  size_t n = 0, n_bodies = 0;
+  for (uint32_t i = 0, end = st.children(); i + 1 < end; i += 2) {
+    const Expr test = st.child_is<Expr>(i);
+    const Const ctest = test.is<Const>();
+    if (ctest && ctest.val() && i + 2 == end) {
+      // last test is true: its body is the "else" branch
+    } else if (n < SelectMaxTests) {
+      tests[n++] = test;
+    } else {
+      return false;
+    }
+    bodies[n_bodies++] = st.child(i + 1);
+  }
+  return compile_select(View<Expr>{tests, n}, View<Node>{bodies, n_bodies});
+}
+
+bool Compiler::compile_select(View<Expr> tests, View<Node> bodies) noexcept {
+  const size_t n = tests.size();
+  if (n == 0 || n > SelectMaxTests || bodies.size() < n || bodies.size() > n + 1) {
+    return false;
+  }
+  // values[i] is assigned if tests[i] is true, values[n] if all tests are false
+  Expr values[SelectMaxTests + 1];
+  Var dst;
+  for (size_t i = 0; i < bodies.size(); i++) {
+    const Assign assign = single_assign(bodies[i]);
+    if (!assign || (dst && assign.dst() != dst) || !is_cheap_pure(assign.src())) {
+      return false;
+    }
+    dst = assign.dst().is<Var>();
+    values[i] = assign.src();
+  }
+  if (bodies.size() == n) {
+    // no "else" branch: dst keeps its value
+    values[n] = dst;
+  }
+  for (size_t i = 1; i < n; i++) {
+    // only the first test is always evaluated
+    if (!is_cheap_pure(tests[i])) {
+      return false;
+    }
+  }
+  const Kind kind = dst.kind();
+  if (kind.is_float() || kind != kind.nosimd()) {
+    // CMOVcc and SETcc only operate on scalar integers
+    return false;
+  } else if (n == 1 && is_int_const(values[0], 1) && is_int_const(values[1], 0)) {
+    // (= dst (cast test)) is computed by SETcc
+    const Expr test = compile(tests[0], SimplifyDefault);
+    add(Assign{*func_, ASSIGN, dst, kind == Bool ? test : Unary{*func_, kind, CAST, test}});
+    return true;
+  } else if (n == 1 && is_int_const(values[0], 0) && is_int_const(values[1], 1)) {
+    const Expr test = compile(Unary{*func_, NOT1, tests[0]}, SimplifyDefault);
+    add(Assign{*func_, ASSIGN, dst, kind == Bool ? test : Unary{*func_, kind, CAST, test}});
+    return true;
+  } else if (kind.bitsize() < 16) {
+    // conditional moves of 8-bit values are not available on most architectures
+    return false;
+  }
+  Expr compiled[2 * SelectMaxTests + 1];
+  for (size_t i = 0; i < n; i++) {
+    compiled[2 * i] = compile(tests[i], SimplifyDefault);
+    compiled[2 * i + 1] = compile(values[i], SimplifyDefault);
+  }
+  Expr select = compile(values[n], SimplifyDefault);
+  for (size_t i = n; i != 0; i--) {
+    select = Tuple{*func_, kind, SELECT, {compiled[2 * i - 2], compiled[2 * i - 1], select}};
+  }
+  add(Assign{*func_, ASSIGN, dst, select});
+  return true;
+}
+
 Node Compiler::compile(Cond st, Flags) noexcept {
   const size_t n = st.children();
   if (n == 0) {
@@ -596,7 +727,7 @@ Node Compiler::compile(Cond st, Flags) noexcept {
   } else if (n & 1) {
     error(st, "unexpected odd number of children in Cond: expecting an even number of them");
     add(st);
-  } else {
+  } else if (!(flags_ & OptIfConversion) || !compile_select(st)) {
     Label l_end{*func_};
     Goto goto_end = n <= 2 ? Goto{} : Goto{*func_, l_end};
     for (size_t i = 0; i < n; i += 2) {
@@ -656,6 +787,20 @@ Node Compiler::compile(Return st, Flags) noexcept {
   return VoidConst;
 }
 
+// a Case of a Switch, used to compile it to a jump table or to a balanced compare tree
+struct SwitchCase {
+  uint64_t key;   // Case value. flipped sign bit if signed, so that keys sort as unsigned
+  uint32_t index; // Case position in Switch
+};
+
+// minimum number of Case with constant value to compile a Switch
+// to a jump table or to a balanced compare tree
+enum : size_t { SwitchCaseMin = 4 };
+
+static bool operator<(const SwitchCase &a, const SwitchCase &b) noexcept {
+  return a.key < b.key;
+}
+
 Node Compiler::compile(Switch st, Flags) noexcept {
   const size_t n = st.children();
   bool have_default = false;
@@ -677,6 +822,10 @@ Node Compiler::compile(Switch st, Flags) noexcept {
   }
 
   Expr expr = to_var(st.expr());
+  Array<SwitchCase> cases;
+  if (switch_cases(st, expr, cases)) {
+    return compile(st, expr, cases);
+  }
 
   Label l_next;
   Label l_fallthrough;
@@ -733,6 +882,151 @@ Node Compiler::compile(Switch st, Flags) noexcept {
   return VoidConst;
 }
 
+bool Compiler::switch_cases(Switch st, Expr expr, Array<SwitchCase> &cases) noexcept {
+  const Kind kind = expr.kind();
+  if (!kind.is_integer()) {
+    return false;
+  }
+  const uint64_t flip = kind.is_signed() ? uint64_t(1) << 63 : 0;
+  for (uint32_t i = 1, n = st.children(); i < n; i++) {
+    Case case_i = st.child_is<Case>(i);
+    if (case_i.op() == DEFAULT) {
+      continue;
+    }
+    const Const c = case_i.expr().is<Const>();
+    if (!c || c.kind() != kind) {
+      return false;
+    } else if (!cases.append(SwitchCase{c.val().uint64() ^ flip, i})) {
+      out_of_memory(st);
+      return false;
+    }
+  }
+  if (cases.size() < SwitchCaseMin) {
+    return false;
+  }
+  std::sort(cases.begin(), cases.end());
+  for (size_t i = 1, n = cases.size(); i < n; i++) {
+    if (cases[i - 1].key == cases[i].key) {
+      // duplicate Case values: only the first one can match,
+      // let the sequential compare chain handle them
+      return false;
+    }
+  }
+  return true;
+}
+
+Node Compiler::compile(Switch st, Expr expr, View<SwitchCase> cases) noexcept {
+  const uint32_t n = st.children();
+  Array<Label> l_case;
+  if (!l_case.resize(n)) {
+    out_of_memory(st);
+    return VoidConst;
+  }
+  Label l_break{*func_};
+  Label l_default = l_break;
+  for (uint32_t i = 1; i < n; i++) {
+    l_case.set(i, Label{*func_});
+    if (st.child_is<Case>(i).op() == DEFAULT) {
+      l_default = l_case[i];
+    }
+  }
+  const uint64_t range = cases.end()[-1].key - cases[0].key;
+  // the jump table index expr - min must not wrap around to a negative value
+  const Kind kind = expr.kind();
+  const bool index_fits = !kind.is_signed() || (range >> (kind.bitsize() - 1)) == 0;
+  if (range < 2 * uint64_t(cases.size()) && index_fits) {
+    switch_jump_table(expr, cases, l_case, l_default);
+  } else {
+    switch_compare_tree(expr, cases, l_case, l_default);
+  }
+  // compile the Case bodies in their original order,
+  // so that 'fallthrough' continues with the next one
+  Goto goto_break{*func_, l_break};
+  for (uint32_t i = 1; i < n; i++) {
+    const bool is_last = i + 1 >= n;
+    add(l_case[i]);
+    // 'fallthrough' in last Case currently does 'break'
+    enter_case(l_break, is_last ? l_break : l_case[i + 1]);
+    compile_add(st.child_is<Case>(i).body(), SimplifyDefault);
+    exit_case();
+    if (!is_last) {
+      add(goto_break);
+    }
+  }
+  add(l_break);
+  return VoidConst;
+}
+
+// return the Const with specified SwitchCase key
+static Const switch_const(Func &func, Kind kind, uint64_t key) noexcept {
+  const uint64_t flip = kind.is_signed() ? uint64_t(1) << 63 : 0;
+  return Const{func, Value{kind, key ^ flip}};
+}
+
+Compiler &Compiler::switch_jump_table(Expr expr, View<SwitchCase> cases, View<Label> l_case,
+                                      Label l_default) noexcept {
+  const Kind kind = expr.kind();
+  const uint64_t min = cases[0].key, max = cases.end()[-1].key;
+  const Const c_min = switch_const(*func_, kind, min);
+  // index = expr - min, computed as expr + (-min) which is simpler to optimize
+  const Const minus_min{*func_, -c_min.val()};
+  Expr index = expr;
+  if (kind.is_signed()) {
+    // check min <= expr && expr <= max
+    compile_add(JumpIf{*func_, l_default, Binary{*func_, LSS, expr, c_min}}, SimplifyDefault);
+    compile_add(JumpIf{*func_, l_default,
+                       Binary{*func_, GTR, expr, switch_const(*func_, kind, max)}},
+                SimplifyDefault);
+    if (c_min.val().uint64() != 0) {
+      index = to_var(Tuple{*func_, ADD, expr, minus_min});
+    }
+  } else {
+    // expr - min wraps around if expr < min:
+    // a single unsigned comparison checks both bounds
+    if (min != 0) {
+      index = to_var(Tuple{*func_, ADD, expr, minus_min});
+    }
+    compile_add(JumpIf{*func_, l_default,
+                       Binary{*func_, GTR, index, Const{*func_, Value{kind, max - min}}}},
+                SimplifyDefault);
+  }
+  // holes in the table jump to Default, or to the end of Switch if there is no Default
+  Array<Label> labels;
+  if (!labels.resize(max - min + 1)) {
+    return out_of_memory(expr);
+  }
+  for (size_t i = 0, n = labels.size(); i < n; i++) {
+    labels.set(i, l_default);
+  }
+  for (const SwitchCase &c : cases) {
+    labels.set(c.key - min, l_case[c.index]);
+  }
+  return add(JumpTable{*func_, index, labels});
+}
+
+Compiler &Compiler::switch_compare_tree(Expr expr, View<SwitchCase> cases, View<Label> l_case,
+                                        Label l_default) noexcept {
+  const Kind kind = expr.kind();
+  const size_t n = cases.size();
+  if (n < SwitchCaseMin) {
+    for (const SwitchCase &c : cases) {
+      compile_add(JumpIf{*func_, l_case[c.index],
+                         Binary{*func_, EQL, expr, switch_const(*func_, kind, c.key)}},
+                  SimplifyDefault);
+    }
+    return add(Goto{*func_, l_default});
+  }
+  const size_t mid = n / 2;
+  Label l_high{*func_};
+  compile_add(JumpIf{*func_, l_high,
+                     Binary{*func_, GEQ, expr, switch_const(*func_, kind, cases[mid].key)}},
+              SimplifyDefault);
+  switch_compare_tree(expr, View<SwitchCase>{cases.data(), mid}, l_case, l_default);
+  add(l_high);
+  return switch_compare_tree(expr, View<SwitchCase>{cases.data() + mid, n - mid}, l_case,
+                             l_default);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 Label Compiler::label_break() const noexcept {
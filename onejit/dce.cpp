@@ -0,0 +1,211 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * dce.cpp
+ *
+ *  Created on Apr 13, 2021
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/compiler.hpp>
+#include <onejit/func.hpp>
+#include <onejit/ir.hpp>
+#include <onejit/ir/util.hpp>
+#include <onestl/bitset.hpp>
+
+namespace onejit {
+
+enum : size_t { NoPos = size_t(-1) };
+
+// return true if evaluating node has no side effects, and can be omitted if its result is unused.
+// differs from node.deep_pure(allow_mask) because divisions by a non-zero Const are removable
+// even if allow_mask does not contain AllowDivision
+static bool is_removable(Node node, Allow allow_mask) noexcept {
+  const Type t = node.type();
+  const uint32_t n = node.children();
+  if (t <= STMT_N) {
+    // statements exist for their side effects
+    return false;
+  } else if (n == 0) {
+    return node.deep_pure(allow_mask);
+  } else if (t == BINARY && Op2(node.op()) >= QUO && Op2(node.op()) <= REM &&
+             !(allow_mask & AllowDivision)) {
+    const Const divisor = node.child_is<Const>(1);
+    return divisor && bool(divisor.val()) && is_removable(node.child(0), allow_mask);
+  } else if ((t == MEM && !(allow_mask & AllowMemAccess)) ||
+             (t == TUPLE && OpN(node.op()) == CALL && !(allow_mask & AllowCall))) {
+    return false;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    if (!is_removable(node.child(i), allow_mask)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// return the local Var defined by node if node only computes its value, otherwise Var{}.
+// such node can be removed if the Var is not live after it
+static Var dead_store_dst(Node node, Allow allow_mask) noexcept {
+  Var dst;
+  switch (node.type()) {
+  case STMT_1:
+    if (node.op() == INC || node.op() == DEC) {
+      dst = node.child_is<Var>(0);
+    }
+    break;
+  case STMT_2:
+    if (is_assign(OpStmt2(node.op()))) {
+      const OpStmt2 op = OpStmt2(node.op());
+      const Node src = node.child(1);
+      // (/= x y) and (%= x y) divide by y: as (/ x y), they are removable
+      // only if divisions are allowed or y is a non-zero Const
+      const Const divisor = src.is<Const>();
+      if (is_removable(src, allow_mask) &&
+          ((op != QUO_ASSIGN && op != REM_ASSIGN) || (allow_mask & AllowDivision) ||
+           (divisor && bool(divisor.val())))) {
+        dst = node.child_is<Var>(0);
+      }
+    }
+    break;
+  default:
+    break;
+  }
+  return dst && dst.id().val() >= Id::FIRST ? dst : Var{};
+}
+
+// return the position of the comparison setting the flags of the conditional jump
+// at position i, or NoPos if not found
+static size_t find_cmp(View<Node> nodes, const BitSet &keep, size_t i) noexcept {
+  while (i != 0 && !keep[--i]) {
+  }
+  const Node node = nodes[i];
+  return keep[i] && node.type() == STMT_2 && node.op() == ASM_CMP ? i : NoPos;
+}
+
+// set in labels the index of each Label used by node
+static bool add_used_labels(Node node, BitSet &labels) noexcept {
+  if (Label label = node.is<Label>()) {
+    const size_t index = label.index();
+    if (index >= labels.size() && !labels.resize(index + 1)) {
+      return false;
+    }
+    labels.set(index, true);
+    return true;
+  }
+  bool ok = true;
+  for (uint32_t i = 0, n = node.children(); ok && i < n; i++) {
+    ok = add_used_labels(node.child(i), labels);
+  }
+  return ok;
+}
+
+Compiler &Compiler::remove_dead_code() noexcept {
+  const Allow allow_mask = Allow(~check()) & ~AllowCall;
+  bool changed = true;
+  while (changed && *this && node_) {
+    const reg::Reg num_regs = reg::Reg(func_->vars().size());
+    Array<uint32_t> idom;
+    BitSet keep, live;
+    if (!flowgraph_.build(node_, error_)) {
+      good_ = false;
+      return *this;
+    } else if (!liveness_.compute(flowgraph_.view(), num_regs, def_use) ||
+               !flowgraph_.dominators(idom) || !keep.resize(node_.size()) ||
+               !live.resize(num_regs)) {
+      return out_of_memory(Node{});
+    }
+    // find the dead stores and the statements in unreachable basic blocks.
+    // labels are removed later, only if unused
+    const BasicBlocks bbs = flowgraph_.view();
+    const Node *first = node_.data();
+    keep.fill(true);
+    for (size_t i = 0, n = bbs.size(); i < n; i++) {
+      const BasicBlock &block = bbs[i];
+      const size_t offset = size_t(block.data() - first);
+      if (idom[i] == FlowGraph::NoBlock) {
+        for (size_t j = 0; j < block.size(); j++) {
+          keep.set(offset + j, block[j].type() == LABEL);
+        }
+        continue;
+      }
+      live.copy(liveness_.live_out(i));
+      for (size_t j = block.size(); j != 0; j--) {
+        const Node node = block[j - 1];
+        const Var dst = dead_store_dst(node, allow_mask);
+        if (dst && !live[dst.id().val() - Id::FIRST]) {
+          // dst is never read: do not update live with the Vars used by node
+          keep.set(offset + j - 1, false);
+          continue;
+        } else if (!liveness_.collect(node)) {
+          return out_of_memory(node);
+        }
+        liveness_.update(live);
+      }
+    }
+    // remove the jumps to the immediately following labels,
+    // including the comparison setting the flags of a conditional jump
+    for (size_t i = 0, n = node_.size(); i < n; i++) {
+      const Node node = node_[i];
+      if (!keep[i] || !ir::is_jump(node)) {
+        continue;
+      }
+      const Label label = ir::jump_label(node);
+      const size_t cmp = ir::is_cond_jump(node) ? find_cmp(node_, keep, i) : NoPos;
+      if (!label || (ir::is_cond_jump(node) &&
+                     (cmp == NoPos || !is_removable(node_[cmp].child(0), allow_mask) ||
+                      !is_removable(node_[cmp].child(1), allow_mask)))) {
+        continue;
+      }
+      for (size_t k = i + 1; k < n; k++) {
+        const Label next = node_[k].is<Label>();
+        if (!keep[k]) {
+          continue;
+        } else if (!next) {
+          break;
+        } else if (next.index() == label.index()) {
+          keep.set(i, false);
+          if (cmp != NoPos) {
+            keep.set(cmp, false);
+          }
+          break;
+        }
+      }
+    }
+    // remove the unused labels, except the function address
+    BitSet used;
+    if (!used.resize(1)) {
+      return out_of_memory(Node{});
+    }
+    used.set(0, true);
+    bool ok = true;
+    for (size_t i = 0, n = node_.size(); ok && i < n; i++) {
+      const Node node = node_[i];
+      if (keep[i] && node.type() != LABEL) {
+        ok = add_used_labels(node, used);
+      }
+    }
+    Array<Node> out;
+    for (size_t i = 0, n = node_.size(); ok && i < n; i++) {
+      const Node node = node_[i];
+      const Label label = node.is<Label>();
+      if (keep[i] && (!label || (label.index() < used.size() && used[label.index()]))) {
+        ok = out.append(node);
+      }
+    }
+    if (!ok) {
+      return out_of_memory(Node{});
+    }
+    changed = out.size() != node_.size();
+    node_.swap(out);
+  }
+  return *this;
+}
+
+} // namespace onejit
@@ -156,6 +156,9 @@ Value eval_binary(Op2 op, Value x, Value y) noexcept {
   case GEQ:
     x = x >= y;
     break;
+  case MULHI:
+    x = mulhi(x, y);
+    break;
   default:
     x = Value{};
     break;
@@ -225,6 +228,11 @@ Value eval_tuple(Kind kind, OpN op, Values vs) noexcept {
       x = vs[n - 1];
     }
     break;
+  case SELECT:
+    if (vs.size() == 3 && vs[0].is_valid()) {
+      x = vs[0] ? vs[1] : vs[2];
+    }
+    break;
   default:
     break;
   }
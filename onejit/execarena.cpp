@@ -0,0 +1,176 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * execarena.cpp
+ *
+ *  Created on Apr 02, 2021
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/execarena.hpp>
+#include <onejit/func.hpp>
+#include <onejit/mem.hpp>
+
+#include <cstring> // memcpy(), memset()
+
+#ifdef __unix__
+#include <sys/mman.h> // mmap(), mprotect(), munmap()
+#include <unistd.h>   // sysconf()
+#endif
+
+namespace onejit {
+
+static constexpr size_t round_up(size_t n, size_t align) noexcept {
+  return (n + align - 1) & ~(align - 1);
+}
+
+ExecArena::ExecArena() noexcept //
+    : regions_{}, region_size_{default_region_size}, good_{true} {
+}
+
+ExecArena::ExecArena(size_t region_size) noexcept
+    : regions_{}, region_size_{round_up(region_size ? region_size : default_region_size,
+                                        page_size())},
+      good_{true} {
+}
+
+ExecArena::ExecArena(ExecArena &&other) noexcept
+    : regions_{}, region_size_{default_region_size}, good_{true} {
+  swap(other);
+}
+
+ExecArena::~ExecArena() noexcept {
+#ifdef __unix__
+  for (const Region &region : regions_) {
+    ::munmap(region.addr, region.size);
+  }
+#endif
+}
+
+ExecArena &ExecArena::operator=(ExecArena &&other) noexcept {
+  swap(other);
+  return *this;
+}
+
+void ExecArena::swap(ExecArena &other) noexcept {
+  regions_.swap(other.regions_);
+  mem::swap(region_size_, other.region_size_);
+  mem::swap(good_, other.good_);
+}
+
+size_t ExecArena::page_size() noexcept {
+#ifdef __unix__
+  static const long pagesize = ::sysconf(_SC_PAGESIZE);
+  if (pagesize > 0) {
+    return size_t(pagesize);
+  }
+#endif
+  return 4096;
+}
+
+bool ExecArena::map_region(size_t n) noexcept {
+#ifdef __unix__
+  const size_t size = n > region_size_ ? round_up(n, page_size()) : region_size_;
+  void *addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED) {
+    return good_ = false;
+  }
+#ifdef MADV_HUGEPAGE
+  // reduce iTLB pressure. failure is harmless
+  (void)::madvise(addr, size, MADV_HUGEPAGE);
+#endif
+  if (!regions_.append(Region{static_cast<uint8_t *>(addr), size, 0, 0})) {
+    ::munmap(addr, size);
+    return good_ = false;
+  }
+  return true;
+#else
+  (void)n;
+  return good_ = false;
+#endif
+}
+
+Span<uint8_t> ExecArena::alloc(size_t n) noexcept {
+  size_t i = regions_.size();
+  Region region = {};
+  size_t start = 0;
+  if (i != 0) {
+    region = regions_[--i];
+    start = round_up(region.used, func_align);
+  }
+  if (i == regions_.size() || start > region.size || region.size - start < n) {
+    i = regions_.size();
+    if (!map_region(n)) {
+      return Span<uint8_t>{};
+    }
+    region = regions_[i];
+    start = 0;
+  }
+  // fill alignment padding with int3 on x64, i.e. trap if executed
+  std::memset(region.addr + region.used, 0xCC, start - region.used);
+  region.used = start + n;
+  regions_.set(i, region);
+  return Span<uint8_t>{region.addr + start, n};
+}
+
+const void *ExecArena::add(Bytes bytes) noexcept {
+  Span<uint8_t> dst = alloc(bytes.size());
+  if (!dst.data()) {
+    return nullptr;
+  }
+  dst.copy(bytes);
+  return dst.data();
+}
+
+const void *ExecArena::add(Func &func, Bytes bytes) noexcept {
+  const void *addr = add(bytes);
+  if (addr) {
+    func.address().set_address(func.code(), reinterpret_cast<uintptr_t>(addr));
+  }
+  return addr;
+}
+
+bool ExecArena::seal() noexcept {
+  bool ok = true;
+  for (size_t i = 0, n = regions_.size(); i < n; i++) {
+    Region region = regions_[i];
+    const size_t end = round_up(region.used, page_size());
+    if (end <= region.sealed) {
+      continue;
+    }
+#ifdef __unix__
+    uint8_t *start = region.addr + region.sealed;
+    if (::mprotect(start, end - region.sealed, PROT_READ | PROT_EXEC) != 0) {
+      ok = good_ = false;
+      continue;
+    }
+#if defined(__GNUC__) && !(defined(__x86_64__) || defined(__i386__))
+    // x86 and x64 have coherent instruction caches, other archs may not
+    __builtin___clear_cache(reinterpret_cast<char *>(start),
+                            reinterpret_cast<char *>(region.addr + end));
+#endif
+#endif
+    // next allocations in this region will start from the next writable page
+    region.used = region.sealed = end;
+    regions_.set(i, region);
+  }
+  return ok;
+}
+
+bool ExecArena::contains(const void *addr) const noexcept {
+  const uint8_t *p = static_cast<const uint8_t *>(addr);
+  for (const Region &region : regions_) {
+    if (p >= region.addr && p < region.addr + region.used) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace onejit
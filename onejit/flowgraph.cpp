@@ -20,11 +20,26 @@
 #include <onejit/ir/node.hpp>
 #include <onejit/ir/util.hpp>
 #include <onejit/type.hpp>
+#include <onestl/bitset.hpp>
 
+#include <algorithm> // std::sort()
 #include <cstdio>
 
 namespace onejit {
 
+size_t BasicBlock::insert_pos() const noexcept {
+  size_t n = size();
+  if (n != 0 && ir::is_jump((*this)[n - 1])) {
+    const bool cond = ir::is_cond_jump((*this)[--n]);
+    if (cond && n != 0 && (*this)[n - 1].type() == STMT_2 && (*this)[n - 1].op() == ASM_CMP) {
+      n--;
+    }
+  }
+  return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 FlowGraph::FlowGraph() noexcept : basicblocks_{}, links_{}, error_{}, label_n_{}, link_avail_{} {
 }
 
@@ -68,7 +83,10 @@ bool FlowGraph::build_basicblocks(Span<Node> nodes) noexcept {
         break;
       }
       i++;
-      if (ir::is_uncond_jump(node)) {
+      if (ir::is_jump_table(node)) {
+        jumps += node.children() - 1;
+        break;
+      } else if (ir::is_uncond_jump(node)) {
         jumps++;
         break;
       } else if (ir::is_cond_jump(node)) {
@@ -119,7 +137,11 @@ bool FlowGraph::resolve_next() noexcept {
       // => basicblock may fallthrough to next basicblock
       links_.set(link_end++, &bb + 1);
     }
-    if (is_uncond_jump || ir::is_cond_jump(node)) {
+    if (ir::is_jump_table(node)) {
+      if (!resolve_jump_table(node, link_start, link_end)) {
+        return false;
+      }
+    } else if (is_uncond_jump || ir::is_cond_jump(node)) {
       Label label = ir::jump_label(node);
       const size_t index = label.index();
       if (!label) {
@@ -139,6 +161,28 @@ bool FlowGraph::resolve_next() noexcept {
   return true;
 }
 
+bool FlowGraph::resolve_jump_table(Node node, size_t link_start, size_t &link_end) noexcept {
+  for (uint32_t i = 1, n = node.children(); i < n; i++) {
+    const Label label = node.child_is<Label>(i);
+    const size_t index = label.index();
+    BasicBlock *to = label && index < label_n_ ? links_[index] : nullptr;
+    if (!label || index >= label_n_) {
+      return error(node, "invalid label");
+    } else if (!to) {
+      return error(node, "label not found");
+    }
+    // different entries of a jump table may contain the same label
+    size_t j = link_start;
+    while (j < link_end && links_[j] != to) {
+      j++;
+    }
+    if (j == link_end) {
+      links_.set(link_end++, to);
+    }
+  }
+  return true;
+}
+
 bool FlowGraph::resolve_prev() noexcept {
   size_t link_start = link_avail_;
   size_t link_end = link_start;
@@ -163,6 +207,271 @@ bool FlowGraph::resolve_prev() noexcept {
   return true;
 }
 
+bool FlowGraph::postorder(Array<uint32_t> &post, Array<uint32_t> &postnum) const noexcept {
+  const size_t n = basicblocks_.size();
+  // iterative depth-first visit: stack contains basic blocks and their next() to visit
+  Array<uint32_t> stack, next;
+  post.clear();
+  if (!postnum.resize(n) || !post.reserve(n) || !stack.reserve(n) || !next.reserve(n)) {
+    return false;
+  }
+  postnum.fill(NoBlock);
+  if (n == 0) {
+    return true;
+  }
+  BitSet visited;
+  if (!visited.resize(n)) {
+    return false;
+  }
+  visited.fill(false);
+  visited.set(0, true);
+  stack.append(0); // cannot fail
+  next.append(0);  // cannot fail
+  while (stack) {
+    const size_t top = stack.size() - 1;
+    const uint32_t i = stack[top];
+    const Span<BasicBlock *> to = basicblocks_[i].next();
+    if (next[top] < to.size()) {
+      const uint32_t j = index(to[next[top]]);
+      next.set(top, next[top] + 1);
+      if (!visited[j]) {
+        visited.set(j, true);
+        stack.append(j); // cannot fail
+        next.append(0);  // cannot fail
+      }
+      continue;
+    }
+    postnum.set(i, uint32_t(post.size()));
+    post.append(i); // cannot fail
+    stack.truncate(top);
+    next.truncate(top);
+  }
+  return true;
+}
+
+// find the common dominator of a and b
+static uint32_t intersect(View<uint32_t> idom, View<uint32_t> postnum, uint32_t a,
+                          uint32_t b) noexcept {
+  while (a != b) {
+    while (postnum[a] < postnum[b]) {
+      a = idom[a];
+    }
+    while (postnum[b] < postnum[a]) {
+      b = idom[b];
+    }
+  }
+  return a;
+}
+
+// iterative algorithm from Cooper, Harvey, Kennedy "A Simple, Fast Dominance Algorithm"
+bool FlowGraph::dominators(Array<uint32_t> &idom) const noexcept {
+  const size_t n = basicblocks_.size();
+  Array<uint32_t> post, postnum;
+  if (!idom.resize(n) || !postorder(post, postnum)) {
+    return false;
+  }
+  idom.fill(NoBlock);
+  if (n == 0) {
+    return true;
+  }
+  idom.set(0, 0);
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    // visit in reverse postorder, skipping the first basic block
+    for (size_t k = post.size() - 1; k != 0; k--) {
+      const uint32_t i = post[k - 1];
+      uint32_t new_idom = NoBlock;
+      for (const BasicBlock *from : basicblocks_[i].prev()) {
+        const uint32_t j = index(from);
+        if (idom[j] == NoBlock) {
+          // not processed yet, or unreachable
+          continue;
+        }
+        new_idom = new_idom == NoBlock ? j : intersect(idom, postnum, j, new_idom);
+      }
+      if (idom[i] != new_idom) {
+        idom.set(i, new_idom);
+        changed = true;
+      }
+    }
+  }
+  return true;
+}
+
+bool FlowGraph::dominance_frontiers(View<uint32_t> idom, Array<uint32_t> &start,
+                                    Array<uint32_t> &frontier) const noexcept {
+  const size_t n = basicblocks_.size();
+  // collect pairs (runner, i) meaning that i is in the dominance frontier of runner
+  Array<uint32_t> pairs, last;
+  frontier.clear();
+  if (!start.resize(n + 1) || !last.resize(n)) {
+    return false;
+  }
+  start.fill(0);
+  last.fill(NoBlock);
+  for (uint32_t i = 0; i < n; i++) {
+    const Span<BasicBlock *> prev = basicblocks_[i].prev();
+    if (prev.size() < 2 || idom[i] == NoBlock) {
+      continue;
+    }
+    for (const BasicBlock *from : prev) {
+      uint32_t runner = index(from);
+      if (idom[runner] == NoBlock) {
+        // unreachable
+        continue;
+      }
+      while (runner != idom[i] && last[runner] != i) {
+        // last[] avoids adding i twice to the same frontier
+        last.set(runner, i);
+        if (!pairs.append(runner) || !pairs.append(i)) {
+          return false;
+        }
+        start.set(runner + 1, start[runner + 1] + 1);
+        runner = idom[runner];
+      }
+    }
+  }
+  // counting sort of pairs by runner
+  for (size_t i = 0; i < n; i++) {
+    start.set(i + 1, start[i + 1] + start[i]);
+  }
+  if (!frontier.resize(pairs.size() / 2)) {
+    return false;
+  }
+  last.copy(start.view(0, n));
+  for (size_t k = 0; k < pairs.size(); k += 2) {
+    const uint32_t runner = pairs[k];
+    frontier.set(last[runner], pairs[k + 1]);
+    last.set(runner, last[runner] + 1);
+  }
+  return true;
+}
+
+bool FlowGraph::dominator_tree(View<uint32_t> idom, Array<uint32_t> &start,
+                               Array<uint32_t> &children) const noexcept {
+  const size_t n = basicblocks_.size();
+  Array<uint32_t> pos;
+  if (!start.resize(n + 1) || !pos.resize(n)) {
+    return false;
+  }
+  start.fill(0);
+  // counting sort of basic blocks by idom. the entry basic block is not a child of itself
+  for (size_t i = 1; i < n; i++) {
+    if (idom[i] != NoBlock) {
+      start.set(idom[i] + 1, start[idom[i] + 1] + 1);
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    start.set(i + 1, start[i + 1] + start[i]);
+    pos.set(i, start[i]);
+  }
+  if (!children.resize(start[n])) {
+    return false;
+  }
+  for (size_t i = 1; i < n; i++) {
+    if (idom[i] != NoBlock) {
+      children.set(pos[idom[i]], uint32_t(i));
+      pos.set(idom[i], pos[idom[i]] + 1);
+    }
+  }
+  return true;
+}
+
+bool FlowGraph::dominates(View<uint32_t> idom, uint32_t a, uint32_t b) noexcept {
+  while (b != a && b != idom[b]) {
+    b = idom[b];
+  }
+  return b == a;
+}
+
+// a natural loop found by FlowGraph::natural_loops()
+struct Loop {
+  uint32_t size;   // number of basic blocks
+  uint32_t header; // header basic block
+  uint32_t offset; // position of its basic blocks
+};
+
+bool FlowGraph::natural_loops(View<uint32_t> idom, Array<uint32_t> &start,
+                              Array<uint32_t> &blocks) const noexcept {
+  const size_t n = basicblocks_.size();
+  Array<uint32_t> todo, found;
+  Array<Loop> loops;
+  BitSet in_loop;
+  if (!in_loop.resize(n) || !todo.reserve(n)) {
+    return false;
+  }
+  for (uint32_t header = 0; header < n; header++) {
+    if (idom[header] == NoBlock) {
+      continue;
+    }
+    // all back edges to the same header belong to the same loop
+    in_loop.fill(false);
+    in_loop.set(header, true);
+    todo.clear();
+    bool is_loop = false;
+    for (const BasicBlock *from : basicblocks_[header].prev()) {
+      const uint32_t i = index(from);
+      if (idom[i] != NoBlock && dominates(idom, header, i)) {
+        is_loop = true;
+        if (!in_loop[i]) {
+          in_loop.set(i, true);
+          todo.append(i); // cannot fail
+        }
+      }
+    }
+    if (!is_loop) {
+      continue;
+    }
+    // walk backward from back edges until header
+    while (todo) {
+      const uint32_t i = todo[todo.size() - 1];
+      todo.truncate(todo.size() - 1);
+      for (const BasicBlock *from : basicblocks_[i].prev()) {
+        const uint32_t j = index(from);
+        if (idom[j] != NoBlock && !in_loop[j]) {
+          in_loop.set(j, true);
+          todo.append(j); // cannot fail
+        }
+      }
+    }
+    const uint32_t offset = uint32_t(found.size());
+    bool ok = found.append(header);
+    for (size_t i = in_loop.find(true); ok && i != BitSet::NoPos; i = in_loop.find(true, i + 1)) {
+      ok = i == header || found.append(uint32_t(i));
+    }
+    if (!ok || !loops.append(Loop{uint32_t(found.size()) - offset, header, offset})) {
+      return false;
+    }
+  }
+  // inner loops contain fewer basic blocks than the loops containing them
+  std::sort(loops.begin(), loops.end(), [](const Loop &a, const Loop &b) {
+    return a.size < b.size || (a.size == b.size && a.header < b.header);
+  });
+  start.clear();
+  blocks.clear();
+  bool ok = start.append(0);
+  for (size_t i = 0; ok && i < loops.size(); i++) {
+    const Loop loop = loops[i];
+    ok = blocks.append(View<uint32_t>{found.data() + loop.offset, loop.size}) &&
+         start.append(uint32_t(blocks.size()));
+  }
+  return ok;
+}
+
+bool FlowGraph::loop_depth(Array<uint32_t> &depth) const noexcept {
+  Array<uint32_t> idom, start, blocks;
+  if (!depth.resize(basicblocks_.size()) || !dominators(idom) ||
+      !natural_loops(idom, start, blocks)) {
+    return false;
+  }
+  depth.fill(0);
+  for (uint32_t bb : blocks) {
+    depth.set(bb, depth[bb] + 1);
+  }
+  return true;
+}
+
 bool FlowGraph::error(Node where, Chars msg) noexcept {
   if (error_) {
     error_->append(Error{where, msg});
@@ -23,6 +23,9 @@ Imm Imm::parse_indirect(Kind kind, Offset offset, const Code *holder) noexcept {
   uint64_t bits;
   if (kind.bits().val() == 64) {
     bits = holder->uint64(offset);
+  } else if (kind.is(gInt)) {
+    // same as Value: signed integers are stored sign-extended
+    bits = uint64_t(int64_t(int32_t(holder->uint32(offset))));
   } else {
     bits = holder->uint32(offset);
   }
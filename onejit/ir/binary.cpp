@@ -24,7 +24,7 @@ namespace ir {
 Node Binary::create(Func &func, Op2 op, const Expr &left, const Expr &right) {
   Kind kind = Bad;
   if (op == BAD2) {
-  } else if (op <= SHR) {
+  } else if (op <= SHR || op == MULHI) {
     kind = left.kind();
   } else if (op <= GEQ) {
     kind = Bool; // && || comparison
@@ -39,7 +39,7 @@ Node Const::create(Func &func, const Imm &imm) noexcept {
       CodeItem offset = holder->length();
 
       if (holder->add(header) && imm.write_indirect(holder)) {
-        return Node{header, offset, holder};
+        return holder->intern(Node{header, offset, holder});
       }
       holder->truncate(offset);
     }
@@ -48,6 +48,11 @@ Label Label::create(Code *holder, uint64_t address, uint16_t index) noexcept {
   return Label{};
 }
 
+bool Label::set_address(Code *holder, uint64_t address) const noexcept {
+  return holder && holder == code() &&
+         holder->set_uint64(offset_or_direct() + sizeof(CodeItem), address);
+}
+
 const Fmt &Label::format(const Fmt &fmt, Syntax /*syntax*/, size_t /*depth*/) const {
   return fmt << type() << '_' << index();
 }
@@ -134,7 +134,7 @@ Node Node::create_indirect(Func &func, Header header, Nodes children) noexcept {
     if (holder->add(header)) {
       if (!is_list(header.type()) || holder->add_uint32(n)) {
         if (holder->add(children, offset)) {
-          return Node{header, offset, holder};
+          return holder->intern(Node{header, offset, holder});
         }
       }
       holder->truncate(offset);
@@ -160,7 +160,7 @@ Node Node::create_indirect_from_ranges(Func &func, Header header,
     if (n == uint32_t(n) && holder->add(header)) {
       if (!islist || holder->add_uint32(n)) {
         if (holder->add_ranges(children, offset)) {
-          return Node{header, offset, holder};
+          return holder->intern(Node{header, offset, holder});
         }
       }
       holder->truncate(offset);
@@ -192,6 +192,9 @@ bool Node::deep_equal(const Node &other, Allow allow_mask) noexcept {
   const size_t n = children();
   if (n != other.children()) {
     return false;
+  } else if (n == 0) {
+    // indirect leaf nodes, as Var, Const, Label: compare their data
+    return deep_compare_data(other) == 0;
   }
   for (size_t i = 0; i < n; i++) {
     if (!child(i).deep_equal(other.child(i), allow_mask)) {
@@ -205,6 +208,18 @@ static constexpr int compare(size_t a, size_t b) noexcept {
   return a < b ? -1 : a > b ? 1 : 0;
 }
 
+int Node::deep_compare_data(const Node &other) const noexcept {
+  // header is equal, thus also length
+  const Offset len = length_bytes();
+  for (Offset i = sizeof(CodeItem); i < len; i += sizeof(CodeItem)) {
+    const uint32_t a = uint32(i), b = other.uint32(i);
+    if (a != b) {
+      return a < b ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
 int Node::deep_compare(const Node &other) const noexcept {
   if (header() != other.header()) {
     return header() < other.header() ? -1 : 1;
@@ -224,6 +239,10 @@ int Node::deep_compare(const Node &other) const noexcept {
   const size_t n1 = children();
   const size_t n2 = other.children();
   const size_t n = n1 < n2 ? n1 : n2;
+  if (n1 == 0 && n2 == 0) {
+    // indirect leaf nodes, as Var, Const, Label: compare their data
+    return deep_compare_data(other);
+  }
   for (size_t i = 0; i < n; i++) {
     if (int cmp = child(i).deep_compare(other.child(i))) {
       return cmp;
@@ -234,6 +253,65 @@ int Node::deep_compare(const Node &other) const noexcept {
   return compare(n1, n2);
 }
 
+static uint64_t mix_hash(uint64_t hash, uint64_t val) noexcept {
+  return (hash ^ val) * 0x100000001b3ull;
+}
+
+static constexpr uint64_t hash_seed = 0xcbf29ce484222325ull;
+
+uint64_t Node::deep_hash() const noexcept {
+  const uint32_t n = children();
+  if (is_direct() || n == 0) {
+    return shallow_hash();
+  }
+  uint64_t hash = mix_hash(hash_seed, header().item());
+  for (uint32_t i = 0; i < n; i++) {
+    hash = mix_hash(hash, child(i).deep_hash());
+  }
+  return hash;
+}
+
+uint64_t Node::shallow_hash() const noexcept {
+  uint64_t hash = mix_hash(hash_seed, header().item());
+  if (is_direct()) {
+    return mix_hash(hash, offset_or_direct());
+  }
+  const uint32_t n = children();
+  if (n == 0) {
+    // indirect leaf nodes, as Var, Const, Label: hash their data
+    const Offset len = length_bytes();
+    for (Offset i = sizeof(CodeItem); i < len; i += sizeof(CodeItem)) {
+      hash = mix_hash(hash, uint32(i));
+    }
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    const Node node = child(i);
+    hash = mix_hash(hash, node.offset_or_direct());
+  }
+  return hash;
+}
+
+bool Node::shallow_equal(const Node &other) const noexcept {
+  if (is_direct() != other.is_direct() || header() != other.header()) {
+    return false;
+  } else if (is_direct() || (code() == other.code() &&
+                             offset_or_direct() == other.offset_or_direct())) {
+    return offset_or_direct() == other.offset_or_direct();
+  }
+  const uint32_t n = children();
+  if (n != other.children()) {
+    return false;
+  } else if (n == 0) {
+    return deep_compare_data(other) == 0;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    if (child(i) != other.child(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool Node::deep_pure(Allow allow_mask) const noexcept {
   Node node = *this;
   for (;;) {
@@ -17,6 +17,7 @@
 #include <onejit/func.hpp>
 #include <onejit/ir/call.hpp>
 #include <onejit/ir/expr.hpp>
+#include <onejit/ir/label.hpp>
 #include <onejit/ir/stmt2.hpp> // Case
 #include <onejit/ir/stmtn.hpp>
 #include <onejit/space.hpp>
@@ -82,6 +83,60 @@ Node AssignCall::create(Func &func, Exprs assign_to, const Call &call) noexcept
 
 // ============================  Cond  =====================================
 
+// ============================  JumpTable  ================================
+
+Node JumpTable::create(Func &func, const Expr &index, Labels labels) noexcept {
+  const size_t n = labels.size();
+  Code *holder = func.code();
+  while (holder && n == uint32_t(n)) {
+    const Header header{STMT_N, Void, JUMP_TABLE_};
+    CodeItem offset = holder->length();
+
+    if (holder->add(header) && holder->add_uint32(add_uint32(1, n)) &&
+        holder->add(index, offset) && holder->add(labels, offset)) {
+      return Node{header, offset, holder};
+    }
+    holder->truncate(offset);
+    break;
+  }
+  return Node{};
+}
+
+Expr JumpTable::index() const noexcept {
+  return child_is<Expr>(0);
+}
+
+Label JumpTable::label(uint32_t i) const noexcept {
+  return child_is<Label>(add_uint32(1, i));
+}
+
+// ============================  Phi  ======================================
+
+Node Phi::create(Func &func, const Var &dst, Vars srcs) noexcept {
+  const size_t n = srcs.size();
+  Code *holder = func.code();
+  while (holder && n == uint32_t(n)) {
+    const Header header{STMT_N, Void, PHI_};
+    CodeItem offset = holder->length();
+
+    if (holder->add(header) && holder->add_uint32(add_uint32(1, n)) &&
+        holder->add(dst, offset) && holder->add(srcs, offset)) {
+      return Node{header, offset, holder};
+    }
+    holder->truncate(offset);
+    break;
+  }
+  return Node{};
+}
+
+Var Phi::dst() const noexcept {
+  return child_is<Var>(0);
+}
+
+Var Phi::src(uint32_t i) const noexcept {
+  return child_is<Var>(add_uint32(1, i));
+}
+
 // ============================  Return  ===================================
 
 Node Return::create(Func &func, Exprs exprs) noexcept {
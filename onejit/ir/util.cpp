@@ -29,7 +29,7 @@ bool is_uncond_jump(Node node) noexcept {
     OpStmt1 op1 = OpStmt1(node.op());
     return op1 == GOTO || op1 == X86_JMP;
   } else {
-    return is_return(node);
+    return is_return(node) || is_jump_table(node);
   }
   return false;
 }
@@ -47,6 +47,7 @@ bool is_cond_jump(Node node) noexcept {
     case ASM_JG:
     case ASM_JGE:
     case ASM_JL:
+    case ASM_JLE:
     case ASM_JNE:
 
     case X86_JA:
@@ -57,6 +58,7 @@ bool is_cond_jump(Node node) noexcept {
     case X86_JG:
     case X86_JGE:
     case X86_JL:
+    case X86_JLE:
     case X86_JNE:
     case X86_JNO:
     case X86_JNP:
@@ -95,6 +97,10 @@ bool is_return(Node node) noexcept {
   return false;
 }
 
+bool is_jump_table(Node node) noexcept {
+  return node.type() == STMT_N && node.op() == JUMP_TABLE_;
+}
+
 Label jump_label(Node node) noexcept {
   Label label;
   if (node.type() != STMT_N) {
@@ -0,0 +1,134 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * linker.cpp
+ *
+ *  Created on Apr 03, 2021
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/assembler.hpp>
+#include <onejit/execarena.hpp>
+#include <onejit/func.hpp>
+#include <onejit/linker.hpp>
+
+#include <cstring> // memcpy()
+
+namespace onejit {
+
+Linker::Linker() noexcept : entry_{}, unresolved_{}, error_{} {
+}
+
+Linker::~Linker() noexcept {
+}
+
+Linker &Linker::clear() noexcept {
+  entry_.clear();
+  unresolved_.clear();
+  error_.clear();
+  return *this;
+}
+
+Linker &Linker::add(Func &func, const Assembler &assembler) noexcept {
+  if (!func) {
+    error(Node{}, "Linker::add: invalid Func");
+  } else if (!assembler || assembler.errors()) {
+    error(func.address(), "Linker::add: Assembler has errors");
+  } else if (!entry_.append(Entry{&func, &assembler, nullptr})) {
+    error(func.address(), "out of memory");
+  }
+  return *this;
+}
+
+bool Linker::link(ExecArena &arena) noexcept {
+  bool ok = true;
+  // first, load all functions and set all label addresses
+  for (size_t i = 0, n = entry_.size(); i < n; i++) {
+    Entry entry = entry_[i];
+    ok = load(arena, entry) && ok;
+    entry_.set(i, entry);
+  }
+  // then patch relocations, including calls between functions
+  for (const Entry &entry : entry_) {
+    if (entry.addr) {
+      ok = relocate(entry) && ok;
+    }
+  }
+  entry_.clear();
+  return ok;
+}
+
+bool Linker::load(ExecArena &arena, Entry &entry) noexcept {
+  Bytes bytes = entry.assembler->bytes();
+  Span<uint8_t> dst = arena.alloc(bytes.size());
+  if (!dst.data()) {
+    return error(entry.func->address(), "Linker::link: failed to allocate executable memory");
+  }
+  dst.copy(bytes);
+  entry.addr = dst.data();
+
+  Code *holder = entry.func->code();
+  const uint64_t base = uint64_t(reinterpret_cast<uintptr_t>(entry.addr));
+  bool ok = entry.func->address().set_address(holder, base);
+  for (const LabelPos &lp : entry.assembler->labels()) {
+    ok = lp.label.set_address(holder, base + lp.pos) && ok;
+  }
+  return ok || error(entry.func->address(), "Linker::link: label belongs to a different Code");
+}
+
+bool Linker::relocate(const Entry &entry) noexcept {
+  const uint64_t base = uint64_t(reinterpret_cast<uintptr_t>(entry.addr));
+  bool ok = true;
+  for (const Relocation &reloc : entry.assembler->relocations()) {
+    const uint64_t target = reloc.label.address();
+    const uint64_t pos = base + reloc.pos;
+    if (target == 0) {
+      if (!unresolved_.append(Relocation{size_t(pos), reloc.label, reloc.size})) {
+        ok = error(reloc.label, "out of memory");
+      }
+      continue;
+    }
+    uint8_t *field = entry.addr + reloc.pos - reloc.size;
+    // the field may already contain an addend, as for example the offset in x64::Mem
+    if (reloc.size == 4) {
+      int32_t addend;
+      std::memcpy(&addend, field, sizeof(addend));
+      const int64_t rel = int64_t(target - pos) + addend;
+      if (rel != int64_t(int32_t(rel))) {
+        ok = error(reloc.label, "Linker::link: relocation out of range for rel32");
+        continue;
+      }
+      const int32_t rel32 = int32_t(rel);
+      std::memcpy(field, &rel32, sizeof(rel32));
+    } else if (reloc.size == 1) {
+      const int64_t rel = int64_t(target - pos) + int8_t(*field);
+      if (rel != int64_t(int8_t(rel))) {
+        ok = error(reloc.label, "Linker::link: relocation out of range for rel8");
+        continue;
+      }
+      *field = uint8_t(rel);
+    } else if (reloc.size == 8) {
+      // absolute address, as for example the entries of a jump table
+      uint64_t addend;
+      std::memcpy(&addend, field, sizeof(addend));
+      const uint64_t abs64 = target + addend;
+      std::memcpy(field, &abs64, sizeof(abs64));
+    } else {
+      ok = error(reloc.label, "Linker::link: unsupported relocation size");
+    }
+  }
+  return ok;
+}
+
+bool Linker::error(Node where, Chars msg) noexcept {
+  error_.append(Error{where, msg});
+  return false;
+}
+
+} // namespace onejit
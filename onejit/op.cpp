@@ -77,7 +77,9 @@ static const char op2string[] = "\1?\0\1-\0\1/\0\1%\0\2<<\2>>\2&&\2||\1<\0\2<=\2
 
 const Chars to_string(Op2 op) noexcept {
   size_t i = 0; // "?"
-  if (op <= GEQ) {
+  if (op == MULHI) {
+    return Chars{"mulhi"};
+  } else if (op <= GEQ) {
     i = op;
   }
   const char *addr = op2string + i * 3;
@@ -90,7 +92,8 @@ const Fmt &operator<<(const Fmt &fmt, Op2 op) {
 
 // ============================  OpN  ==========================================
 
-static const Chars opnstring[] = {"max", "min", "comma", "call", "mem", "x86_mem", "arm64_mem"};
+static const Chars opnstring[] = {"max", "min",    "comma",   "call", //
+                                  "mem", "select", "x86_mem", "arm64_mem"};
 
 const Chars to_string(OpN op) noexcept {
   if (op >= MAX && op - MAX < ONEJIT_N_OF(opnstring)) {
@@ -70,6 +70,12 @@ OpStmt1 negate_condjump(OpStmt1 op) noexcept {
   case ASM_JGE:
     op = ASM_JL;
     break;
+  case ASM_JL:
+    op = ASM_JGE;
+    break;
+  case ASM_JLE:
+    op = ASM_JG;
+    break;
   case ASM_JNE:
     op = ASM_JE;
     break;
@@ -264,6 +270,8 @@ static const Chars op_stmt_n_string[] = { //
     "return",
     "switch",
     "_set",
+    "_phi",
+    "_jump_table",
 #define ONEJIT_X(NAME, name) "x86_" #name,
     ONEJIT_OPSTMTN_X86(ONEJIT_X)
 #undef ONEJIT_X
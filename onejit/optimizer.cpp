@@ -258,6 +258,11 @@ Node Optimizer::simplify_assign(OpStmt2 assign_op, Expr dst, Value val) noexcept
         // optimize (-= expr -1) to (inc expr)
         return Inc{*func_, dst};
       }
+    } else if ((op == QUO || op == REM) && (flags_ & OptSimplifyExpr)) {
+      // optimize (/= x c) to (= x (/ x c)) if the division can be lowered, same for %=
+      if (Expr src = simplify_quo_rem(op, dst, val)) {
+        return Assign{*func_, ASSIGN, dst, src};
+      }
     }
   }
   return Node{};
@@ -134,6 +134,8 @@ Expr Optimizer::simplify_quo(Expr x, Expr y) noexcept {
   if (x.deep_equal(y, allow_mask_pure())) {
     // optimize (/ x x) to 1
     return One(*func_, x.kind());
+  } else if (Const c = y.is<Const>()) {
+    return simplify_quo_rem(QUO, x, c.val());
   }
   return Expr{};
 }
@@ -142,6 +144,8 @@ Expr Optimizer::simplify_rem(Expr x, Expr y) noexcept {
   if (x.deep_equal(y, allow_mask_pure())) {
     // optimize (% x x) to 0
     return Zero(x.kind());
+  } else if (Const c = y.is<Const>()) {
+    return simplify_quo_rem(REM, x, c.val());
   }
   return Expr{};
 }
@@ -0,0 +1,223 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * optimizer_div.cpp
+ *
+ *  Created on Apr 15, 2021
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/func.hpp>
+#include <onejit/ir/binary.hpp>
+#include <onejit/ir/const.hpp>
+#include <onejit/ir/tuple.hpp>
+#include <onejit/ir/unary.hpp>
+#include <onejit/optimizer.hpp>
+
+namespace onejit {
+
+static constexpr bool is_pow2(uint64_t val) noexcept {
+  return val != 0 && (val & (val - 1)) == 0;
+}
+
+// return the smallest l such that 2^l >= val
+static uint32_t log2_ceil(uint64_t val) noexcept {
+  uint32_t l = 0;
+  while (l < 64 && (uint64_t(1) << l) < val) {
+    l++;
+  }
+  return l;
+}
+
+// return 2^shift - 1
+static constexpr uint64_t mask_bits(uint32_t shift) noexcept {
+  return shift >= 64 ? ~uint64_t(0) : (uint64_t(1) << shift) - 1;
+}
+
+Expr Optimizer::simplify_quo_rem(Op2 op, Expr x, Value y) noexcept {
+  const Kind kind = x.kind();
+  if (!kind.is_integer() || kind.nosimd() != kind || y.kind() != kind) {
+    return Expr{};
+  }
+  const bool is_signed = kind.is_signed();
+  const bool negative = is_signed && y.int64() < 0;
+  const uint64_t d = negative ? 0 - y.uint64() : y.uint64();
+  // the minimum signed value is a power of two, but its absolute value is not representable
+  if (d == 0 || (is_signed && d == uint64_t(1) << (kind.bitsize() - 1))) {
+    return Expr{};
+  } else if (d == 1) {
+    if (op == REM) {
+      // optimize (% x 1) and (% x -1) to 0
+      return x.deep_pure(allow_mask_pure()) ? Expr{Zero(kind)} : Expr{};
+    }
+    // optimize (/ x 1) to x and (/ x -1) to -x
+    return negative ? Expr{Unary{*func_, NEG1, x}} : x;
+  } else if (x.type() != VAR && (is_signed || !is_pow2(d))) {
+    // all the sequences below, except unsigned division by a power of two,
+    // may evaluate x multiple times
+    return Expr{};
+  } else if (is_pow2(d)) {
+    return simplify_quo_rem_pow2(op, x, negative, log2_ceil(d));
+  }
+  return is_signed ? simplify_quo_rem_signed(op, x, y) : simplify_quo_rem_unsigned(op, x, d);
+}
+
+// return floor(hi * 2^64 / d). requires hi < d
+static uint64_t div_hi(uint64_t hi, uint64_t d) noexcept {
+  uint64_t quo = 0, rem = hi;
+  for (uint32_t i = 0; i < 64; i++) {
+    // rem < d, thus 2 * rem + 1 < 2 * d: a single subtraction suffices
+    const bool carry = rem >> 63 != 0;
+    rem <<= 1;
+    quo <<= 1;
+    if (carry || rem >= d) {
+      rem -= d;
+      quo |= 1;
+    }
+  }
+  return quo;
+}
+
+Expr Optimizer::simplify_quo_rem_pow2(Op2 op, Expr x, bool negative, uint32_t shift) noexcept {
+  const Kind kind = x.kind();
+  const Const mask{*func_, Value{kind, mask_bits(shift)}};
+  if (kind.is_unsigned()) {
+    // optimize (/ x 2^k) to (>> x k) and (% x 2^k) to (& x 2^k-1)
+    if (op == QUO) {
+      return Binary{*func_, SHR, x, Const{*func_, Value{kind, shift}}};
+    }
+    return Tuple{*func_, AND, x, mask};
+  }
+  // signed division rounds toward zero: if x < 0, add 2^k-1 before shifting.
+  // (>> x bits-1) is -1 if x < 0, otherwise 0
+  const Const sign_shift{*func_, Value{kind, kind.bitsize() - 1}};
+  const Expr bias = Tuple{*func_, AND, Binary{*func_, SHR, x, sign_shift}, mask};
+  const Expr sum = Tuple{*func_, ADD, x, bias};
+  if (op == REM) {
+    // the remainder has the sign of x, and does not depend on the sign of y
+    const Const not_mask{*func_, Value{kind, ~mask_bits(shift)}};
+    return Binary{*func_, SUB, x, Tuple{*func_, AND, sum, not_mask}};
+  }
+  const Expr quo = Binary{*func_, SHR, sum, Const{*func_, Value{kind, shift}}};
+  return negative ? Expr{Unary{*func_, NEG1, quo}} : quo;
+}
+
+// Granlund and Montgomery, "Division by Invariant Integers using Multiplication":
+// if N is the number of bits of x, d is not a power of two, l = ceil(log2(d)) and
+// m = floor(2^(N+l) / d) + 1, then x / d == (x * m) >> (N+l) for all 0 <= x < 2^N
+Expr Optimizer::simplify_quo_rem_unsigned(Op2 op, Expr x, uint64_t d) noexcept {
+  const Kind kind = x.kind();
+  const uint32_t bits = uint32_t(kind.bitsize());
+  const uint32_t l = log2_ceil(d);
+  // d is not a power of two, thus floor(2^p / d) == floor((2^p - 1) / d)
+  if (bits == 64) {
+    return simplify_quo_rem_unsigned64(op, x, d);
+  }
+  const uint64_t m = mask_bits(bits + l) / d + 1;
+  const Expr wide_x = Unary{*func_, Uint64, CAST, x};
+  Expr wide_quo;
+  if (m >> 32 == 0 || bits < 32) {
+    // x * m < 2^64
+    wide_quo = Binary{*func_, SHR, Tuple{*func_, MUL, wide_x, Const{*func_, m}},
+                      Const{*func_, uint64_t(bits + l)}};
+  } else {
+    // m has 33 bits and x * m may overflow: compute ((x * (m - 2^32)) >> 32 + x) >> l
+    const Const m_low{*func_, m - (uint64_t(1) << 32)};
+    const Expr high =
+        Binary{*func_, SHR, Tuple{*func_, MUL, wide_x, m_low}, Const{*func_, uint64_t(32)}};
+    wide_quo = Binary{*func_, SHR, Tuple{*func_, ADD, high, wide_x}, Const{*func_, uint64_t(l)}};
+  }
+  const Expr quo = Unary{*func_, kind, CAST, wide_quo};
+  if (op == QUO) {
+    return quo;
+  }
+  // x % d == x - (x / d) * d
+  return Binary{*func_, SUB, x, Tuple{*func_, MUL, quo, Const{*func_, Value{kind, d}}}};
+}
+
+// Granlund and Montgomery, "Division by Invariant Integers using Multiplication":
+// if N is the number of bits of x, |d| >= 3 is not a power of two, l = ceil(log2(|d|)) and
+// m = floor(2^(N-1+l) / |d|) + 1, then x / |d| == ((x * m) >> (N-1+l)) + (x < 0 ? 1 : 0)
+// for all -2^(N-1) <= x < 2^(N-1)
+Expr Optimizer::simplify_quo_rem_signed(Op2 op, Expr x, Value y) noexcept {
+  const Kind kind = x.kind();
+  const uint32_t bits = uint32_t(kind.bitsize());
+  const bool negative = y.int64() < 0;
+  const uint64_t d = negative ? 0 - y.uint64() : y.uint64();
+  if (bits == 64) {
+    return simplify_quo_rem_signed64(op, x, y);
+  }
+  const uint32_t p = bits - 1 + log2_ceil(d);
+  const int64_t m = int64_t((uint64_t(1) << p) / d + 1);
+  const Expr wide_x = Unary{*func_, Int64, CAST, x};
+  const Expr prod = Binary{*func_, SHR, Tuple{*func_, MUL, wide_x, Const{*func_, m}},
+                           Const{*func_, int64_t(p)}};
+  // (>> wide_x 63) is -1 if x < 0, otherwise 0
+  const Expr sign = Binary{*func_, SHR, wide_x, Const{*func_, int64_t(63)}};
+  // if y < 0, compute -(x / |y|) directly by swapping the operands of -
+  const Expr wide_quo = negative ? Binary{*func_, SUB, sign, prod} //
+                                 : Binary{*func_, SUB, prod, sign};
+  const Expr quo = Unary{*func_, kind, CAST, wide_quo};
+  if (op == QUO) {
+    return quo;
+  }
+  // x % y == x - (x / y) * y
+  return Binary{*func_, SUB, x, Tuple{*func_, MUL, quo, Const{*func_, y}}};
+}
+
+// 64-bit version of simplify_quo_rem_unsigned(): x * m does not fit a register,
+// compute its high half with MULHI
+Expr Optimizer::simplify_quo_rem_unsigned64(Op2 op, Expr x, uint64_t d) noexcept {
+  const uint32_t l = log2_ceil(d), sh = l - 1;
+  // try first m = floor(2^(64+sh) / d) + 1 which has 64 bits:
+  // x / d == (mulhi x m) >> sh if m * d - 2^(64+sh) <= 2^sh
+  const uint64_t m_floor = div_hi(uint64_t(1) << sh, d);
+  Expr quo;
+  if (m_floor != ~uint64_t(0) && (m_floor + 1) * d <= uint64_t(1) << sh) {
+    const Expr hi = Binary{*func_, MULHI, x, Const{*func_, m_floor + 1}};
+    quo = Binary{*func_, SHR, hi, Const{*func_, uint64_t(sh)}};
+  } else {
+    // m = floor(2^(64+l) / d) + 1 has 65 bits: multiply by m - 2^64 and add x without overflow,
+    // i.e. compute (t + ((x - t) >> 1)) >> (l-1) where t = (mulhi x m-2^64)
+    // 2^l - d < d, and wraps to 0 - d if l == 64
+    const uint64_t m_low = div_hi((l == 64 ? 0 : uint64_t(1) << l) - d, d) + 1;
+    const Expr t = Binary{*func_, MULHI, x, Const{*func_, m_low}};
+    const Expr half = Binary{*func_, SHR, Binary{*func_, SUB, x, t}, Const{*func_, uint64_t(1)}};
+    quo = Binary{*func_, SHR, Tuple{*func_, ADD, t, half}, Const{*func_, uint64_t(sh)}};
+  }
+  if (op == QUO) {
+    return quo;
+  }
+  // x % d == x - (x / d) * d
+  return Binary{*func_, SUB, x, Tuple{*func_, MUL, quo, Const{*func_, d}}};
+}
+
+// 64-bit version of simplify_quo_rem_signed(): m = floor(2^(63+l) / |d|) + 1 has 64 bits,
+// multiply by m - 2^64 and add x, i.e. x / |d| == ((x + (mulhi x m-2^64)) >> (l-1)) + (x < 0)
+Expr Optimizer::simplify_quo_rem_signed64(Op2 op, Expr x, Value y) noexcept {
+  const bool negative = y.int64() < 0;
+  const uint64_t d = negative ? 0 - y.uint64() : y.uint64();
+  const uint32_t sh = log2_ceil(d) - 1;
+  const int64_t m = int64_t(div_hi(uint64_t(1) << sh, d) + 1);
+  const Expr hi = Binary{*func_, MULHI, x, Const{*func_, m}};
+  const Expr prod =
+      Binary{*func_, SHR, Tuple{*func_, ADD, x, hi}, Const{*func_, int64_t(sh)}};
+  // (>> x 63) is -1 if x < 0, otherwise 0
+  const Expr sign = Binary{*func_, SHR, x, Const{*func_, int64_t(63)}};
+  // if y < 0, compute -(x / |y|) directly by swapping the operands of -
+  const Expr quo = negative ? Binary{*func_, SUB, sign, prod} //
+                            : Binary{*func_, SUB, prod, sign};
+  if (op == QUO) {
+    return quo;
+  }
+  // x % y == x - (x / y) * y
+  return Binary{*func_, SUB, x, Tuple{*func_, MUL, quo, Const{*func_, y}}};
+}
+
+} // namespace onejit
@@ -0,0 +1,239 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * optimizer_gvn.cpp
+ *
+ *  Created on Apr 11, 2021
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/flowgraph.hpp>
+#include <onejit/func.hpp>
+#include <onejit/ir.hpp>
+#include <onejit/optimizer.hpp>
+#include <onestl/bitset.hpp>
+
+namespace onejit {
+
+enum : uint32_t { NoEntry = uint32_t(-1) };
+
+// an expression available in current basic block
+struct GvnEntry {
+  uint64_t hash;
+  Expr expr;     // first occurrence of the expression
+  Var var;       // Var containing its value. set only by second pass, and only if reused
+  uint32_t prev; // previous entry in the same hash bucket, or NoEntry
+  uint32_t id;   // sequential number. visits are deterministic, thus both passes use the same ids
+};
+
+// state of number_values()
+struct Gvn {
+  Array<GvnEntry> entry;  // stack of available expressions
+  Array<uint32_t> bucket; // hash table: index of last entry in each bucket, or NoEntry
+  Array<uint32_t> found;  // first pass: ids of entries found again
+  BitSet reused;          // second pass: index is entry id, set if entry was found again
+  Array<Node> insert;     // second pass: assignments to temporary Vars
+  Array<uint32_t> range;  // second pass: range of insert[] to add before each node
+  uint32_t id;
+  bool rewrite; // false in first pass, true in second pass
+  bool good;    // false if out of memory
+};
+
+// visit state of a basic block in the dominator tree
+struct GvnFrame {
+  uint32_t bb;    // basic block
+  uint32_t child; // next child to visit in the dominator tree
+  size_t entry;   // Gvn::entry.size() when entering the basic block
+};
+
+bool Optimizer::number_values(Func &func, const FlowGraph &flowgraph,
+                              Array<Node> &nodes) noexcept {
+  const BasicBlocks bbs = flowgraph.view();
+  Array<uint32_t> idom, dom_start, dom_child;
+  if (!func || !bbs) {
+    return true;
+  } else if (!flowgraph.dominators(idom) ||
+             !flowgraph.dominator_tree(idom, dom_start, dom_child)) {
+    return false;
+  }
+  func_ = &func;
+  Gvn gvn{};
+  gvn.good = true;
+  size_t bucket_n = 16;
+  while (bucket_n < nodes.size() * 2) {
+    bucket_n *= 2;
+  }
+  if (!gvn.bucket.resize(bucket_n)) {
+    return false;
+  }
+  gvn.bucket.fill(NoEntry);
+  // first pass: find the expressions computed again where a previous computation is available
+  if (!number_values(gvn, bbs, dom_start, dom_child, nodes)) {
+    return false;
+  } else if (!gvn.found) {
+    return true;
+  } else if (!gvn.reused.resize(gvn.id) || !gvn.range.resize(nodes.size() * 2)) {
+    return false;
+  }
+  for (uint32_t id : gvn.found) {
+    gvn.reused.set(id, true);
+  }
+  // second pass: copy them to Vars at their first computation, and replace the others.
+  // the first pass left gvn.entry empty and gvn.bucket filled with NoEntry
+  gvn.rewrite = true;
+  gvn.id = 0;
+  if (!number_values(gvn, bbs, dom_start, dom_child, nodes)) {
+    return false;
+  }
+  Array<Node> out;
+  bool ok = true;
+  for (size_t i = 0, n = nodes.size(); ok && i < n; i++) {
+    for (uint32_t k = gvn.range[i * 2]; ok && k < gvn.range[i * 2 + 1]; k++) {
+      ok = out.append(gvn.insert[k]);
+    }
+    ok = ok && out.append(nodes[i]);
+  }
+  if (ok) {
+    nodes.swap(out);
+  }
+  return ok;
+}
+
+bool Optimizer::number_values(Gvn &gvn, BasicBlocks bbs, View<uint32_t> dom_start,
+                              View<uint32_t> dom_child, Span<Node> nodes) noexcept {
+  Array<GvnFrame> stack;
+  const Node *first = nodes.data();
+  const size_t mask = gvn.bucket.size() - 1;
+  uint32_t bb = 0;
+  while (gvn.good && *func_ && (bb != FlowGraph::NoBlock || stack)) {
+    if (bb != FlowGraph::NoBlock) {
+      // enter basic block bb
+      if (!stack.append(GvnFrame{bb, dom_start[bb], gvn.entry.size()})) {
+        return false;
+      }
+      const BasicBlock *block = bbs.data() + bb;
+      for (size_t j = 0, n = block->size(); j < n; j++) {
+        const size_t i = size_t(block->data() + j - first);
+        const uint32_t start = uint32_t(gvn.insert.size());
+        const Node node = number_values(gvn, (*block)[j]);
+        if (gvn.rewrite) {
+          nodes.set(i, node);
+          gvn.range.set(i * 2, start);
+          gvn.range.set(i * 2 + 1, uint32_t(gvn.insert.size()));
+        }
+      }
+      bb = FlowGraph::NoBlock;
+      continue;
+    }
+    GvnFrame top = stack[stack.size() - 1];
+    if (top.child < dom_start[top.bb + 1]) {
+      bb = dom_child[top.child++];
+      stack.set(stack.size() - 1, top);
+      continue;
+    }
+    // exit basic block: expressions it computed are no longer available
+    for (size_t k = gvn.entry.size(); k > top.entry; k--) {
+      const GvnEntry entry = gvn.entry[k - 1];
+      gvn.bucket.set(entry.hash & mask, entry.prev);
+    }
+    gvn.entry.truncate(top.entry);
+    stack.truncate(stack.size() - 1);
+  }
+  return gvn.good && *func_;
+}
+
+Node Optimizer::number_values(Gvn &gvn, Node node) noexcept {
+  if (node.type() == STMT_2 && node.op() == ASSIGN) {
+    if (Var dst = node.child_is<Var>(0)) {
+      // in SSA form, dst is assigned only here: it can hold the value of src
+      const Expr src = node.child_is<Expr>(1);
+      const Expr src2 = number_values(gvn, src, dst);
+      return src2 == src ? node : Assign{*func_, ASSIGN, dst, src2};
+    }
+  }
+  const uint32_t n = node.children();
+  Array<Node> children;
+  bool changed = false;
+  if (gvn.rewrite && !children.resize(n)) {
+    gvn.good = false;
+    return node;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    Node child = node.child(i);
+    if (Expr expr = child.is<Expr>()) {
+      child = number_values(gvn, expr, Var{});
+    }
+    if (gvn.rewrite) {
+      changed = changed || child != node.child(i);
+      children.set(i, child);
+    }
+  }
+  return changed ? Node::create_indirect(*func_, node.header(), children) : node;
+}
+
+Expr Optimizer::number_values(Gvn &gvn, Expr expr, Var dst) noexcept {
+  const uint32_t n = expr.children();
+  if (n == 0) {
+    return expr;
+  }
+  // memory may be modified between two loads from the same address:
+  // numbering Mem would need alias analysis
+  const bool pure = expr.deep_pure(allow_mask_pure() & ~AllowMemAccess);
+  const size_t mask = gvn.bucket.size() - 1;
+  const uint64_t hash = pure ? expr.deep_hash() : 0;
+  for (uint32_t k = pure ? gvn.bucket[hash & mask] : NoEntry; k != NoEntry;) {
+    GvnEntry entry = gvn.entry[k];
+    if (entry.hash == hash && entry.expr.deep_equal(expr)) {
+      if (!gvn.rewrite) {
+        gvn.good = gvn.good && gvn.found.append(entry.id);
+        return expr;
+      }
+      return entry.var ? Expr{entry.var} : expr;
+    }
+    k = entry.prev;
+  }
+  // not available: number children, then make expr available
+  Array<Node> children;
+  bool changed = false;
+  if (gvn.rewrite && !children.resize(n)) {
+    gvn.good = false;
+    return expr;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    Node child = expr.child(i);
+    if (Expr e = child.is<Expr>()) {
+      child = number_values(gvn, e, Var{});
+    }
+    if (gvn.rewrite) {
+      changed = changed || child != expr.child(i);
+      children.set(i, child);
+    }
+  }
+  Expr expr2 = changed ? Node::create_indirect(*func_, expr.header(), children).is<Expr>() : expr;
+  if (!pure) {
+    return expr2;
+  }
+  GvnEntry entry{hash, expr, Var{}, gvn.bucket[hash & mask], gvn.id++};
+  if (gvn.rewrite && gvn.reused[entry.id]) {
+    if (dst && dst.kind() == expr.kind()) {
+      entry.var = dst;
+    } else {
+      // copy the value to a temporary Var before the current statement
+      const Var var{*func_, expr.kind()};
+      gvn.good = gvn.good && var && gvn.insert.append(Assign{*func_, ASSIGN, var, expr2});
+      entry.var = var;
+      expr2 = var;
+    }
+  }
+  gvn.bucket.set(hash & mask, uint32_t(gvn.entry.size()));
+  gvn.good = gvn.good && gvn.entry.append(entry);
+  return expr2;
+}
+
+} // namespace onejit
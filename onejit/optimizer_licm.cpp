@@ -0,0 +1,506 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * optimizer_licm.cpp
+ *
+ *  Created on Apr 14, 2021
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/flowgraph.hpp>
+#include <onejit/func.hpp>
+#include <onejit/ir.hpp>
+#include <onejit/ir/util.hpp>
+#include <onejit/optimizer.hpp>
+#include <onestl/bitset.hpp>
+
+namespace onejit {
+
+enum : uint32_t { NoBlock = FlowGraph::NoBlock };
+
+// a statement moved to the end of a preheader
+struct LicmEntry {
+  Node node;
+  uint32_t bb; // preheader containing it, or NoBlock if moved again to another preheader
+};
+
+// the loop test, evaluated at the end of a preheader before the statements moved there:
+// (asm_cmp x y) (jump skip) statements... skip
+// thus statements that may trap are executed only if the loop runs at least once
+struct LicmGuard {
+  Expr x, y;    // arguments of asm_cmp
+  OpStmt1 jump; // conditional jump to skip, taken if the loop does not run
+  Label skip;
+  uint32_t bb; // preheader containing it
+};
+
+// state of hoist_invariants()
+struct Licm {
+  BasicBlocks bbs;
+  View<uint32_t> idom;
+  Array<uint32_t> pos_bb;   // index is node position: its basic block, or NoBlock if moved
+  Array<uint32_t> def_bb;   // index is reg: basic block defining it, or NoBlock
+  Array<LicmEntry> moved;   // statements moved to preheaders, in dependency order
+  Array<LicmGuard> guards;  // guards of preheaders containing statements that may trap
+  Array<uint32_t> stmt;     // statements in current loop: node positions or nodes.size() + moved[]
+  Array<uint32_t> exits;    // basic blocks in current loop with a successor outside it or none
+  Array<uint32_t> latches;  // basic blocks in current loop that jump to its header
+  BitSet in_loop;           // basic blocks in current loop
+  LicmGuard guard;          // guard of current loop. guard.x is Expr{} if not available
+  uint32_t header;          // the header of current loop
+  uint32_t preheader;       // the only basic block outside current loop that jumps to its header
+  bool store;               // true if current loop may write to memory
+  bool trap;                // true if statements that may trap were moved out of current loop
+  bool good;                // false if out of memory
+};
+
+// return the reg of a local Var, or NoBlock if var is not a local Var
+static uint32_t licm_reg(Var var) noexcept {
+  const uint32_t id = var.id().val();
+  return id >= Id::FIRST ? id - Id::FIRST : NoBlock;
+}
+
+// return true if node may write to memory or call a function
+static bool licm_store(Node node) noexcept {
+  const Type t = node.type();
+  const uint16_t op = node.op();
+  if ((t == STMT_1 && (op == INC || op == DEC)) ||
+      (t == STMT_2 && is_assign(OpStmt2(op)))) {
+    if (!node.child_is<Var>(0)) {
+      return true;
+    }
+  } else if ((t == STMT_N && op == ASSIGN_CALL) || (t == TUPLE && op == CALL)) {
+    return true;
+  }
+  for (uint32_t i = 0, n = node.children(); i < n; i++) {
+    if (licm_store(node.child(i))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// return true if the value of node does not change inside current loop,
+// i.e. if all the Vars it uses are defined outside current loop
+static bool licm_invariant(const Licm &licm, Node node) noexcept {
+  if (Var var = node.is<Var>()) {
+    const uint32_t reg = licm_reg(var);
+    if (reg == NoBlock) {
+      return false;
+    }
+    const uint32_t bb = reg < licm.def_bb.size() ? licm.def_bb[reg] : NoBlock;
+    return bb == NoBlock || !licm.in_loop[bb];
+  }
+  for (uint32_t i = 0, n = node.children(); i < n; i++) {
+    if (!licm_invariant(licm, node.child(i))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// return true if expr contains memory loads or divisions, which may trap
+static bool licm_may_trap(Expr expr) noexcept {
+  return !expr.deep_pure(AllowNone);
+}
+
+// return true if statements moved to preheader bb are executed only after its guard
+static bool licm_guarded(const Licm &licm, uint32_t bb) noexcept {
+  for (const LicmGuard &guard : licm.guards) {
+    if (guard.bb == bb) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// return the value in the preheader of an argument of the loop test
+static Expr licm_guard_arg(const Licm &licm, const BasicBlock &header, uint32_t j,
+                           Expr expr) noexcept {
+  if (expr.type() == CONST) {
+    return expr;
+  }
+  const Var var = expr.is<Var>();
+  if (!var) {
+    return Expr{};
+  }
+  for (const Node node : header) {
+    const Phi phi = node.is<Phi>();
+    if (phi && phi.dst().id() == var.id()) {
+      return j + 1 < phi.children() ? Expr{phi.src(j)} : Expr{};
+    }
+  }
+  return licm_invariant(licm, var) ? expr : Expr{};
+}
+
+// compute the guard of current loop, that evaluates in the preheader the loop test.
+// return LicmGuard{} if the header contains other statements
+// or if the loop test uses Vars whose value in the preheader is unknown
+static LicmGuard licm_guard(const Licm &licm) noexcept {
+  const BasicBlock &header = licm.bbs.data()[licm.header];
+  const size_t n = header.size();
+  const Span<BasicBlock *> next = header.next(), prev = header.prev();
+  if (n < 2 || next.size() != 2 || !ir::is_cond_jump(header[n - 1]) ||
+      header[n - 1].type() != STMT_1 || header[n - 2].type() != STMT_2 ||
+      header[n - 2].op() != ASM_CMP) {
+    return LicmGuard{};
+  }
+  for (size_t i = 0; i + 2 < n; i++) {
+    if (header[i].type() != LABEL && !header[i].is<Phi>()) {
+      return LicmGuard{};
+    }
+  }
+  // next() contains the fallthrough basic block first, then the jump destination
+  const bool fallthrough_in = licm.in_loop[uint32_t(next[0] - licm.bbs.data())];
+  const bool jump_in = licm.in_loop[uint32_t(next[1] - licm.bbs.data())];
+  uint32_t j = 0;
+  while (j < prev.size() && prev[j] != licm.bbs.data() + licm.preheader) {
+    j++;
+  }
+  const OpStmt1 op = OpStmt1(header[n - 1].op());
+  const OpStmt1 skip_op = jump_in ? negate_condjump(op) : op;
+  if (fallthrough_in == jump_in || j == prev.size() || skip_op == negate_condjump(skip_op)) {
+    return LicmGuard{};
+  }
+  const Stmt2 cmp = header[n - 2].is<Stmt2>();
+  const Expr x = licm_guard_arg(licm, header, j, cmp.child_is<Expr>(0));
+  const Expr y = licm_guard_arg(licm, header, j, cmp.child_is<Expr>(1));
+  if (!x || !y) {
+    return LicmGuard{};
+  }
+  return LicmGuard{x, y, skip_op, Label{}, licm.preheader};
+}
+
+// return true if the statements in basic block bb of current loop are executed
+// at least once after its guard: bb must dominate the latches and the exits
+// other than the header, and the header must only contain the loop test
+static bool licm_runs(const Licm &licm, uint32_t bb) noexcept {
+  if (!licm.guard.x || bb == NoBlock) {
+    return false;
+  }
+  for (uint32_t exit : licm.exits) {
+    if (exit != licm.header && !FlowGraph::dominates(licm.idom, bb, exit)) {
+      return false;
+    }
+  }
+  for (uint32_t latch : licm.latches) {
+    if (!FlowGraph::dominates(licm.idom, bb, latch)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// set the basic block defining var
+static bool licm_define(Licm &licm, Var var, uint32_t bb) noexcept {
+  const uint32_t reg = licm_reg(var);
+  if (reg == NoBlock) {
+    return true;
+  } else if (reg >= licm.def_bb.size()) {
+    const size_t n = licm.def_bb.size();
+    if (!licm.def_bb.resize(reg + 1)) {
+      return false;
+    }
+    for (size_t i = n; i < reg; i++) {
+      licm.def_bb.set(i, NoBlock);
+    }
+  }
+  licm.def_bb.set(reg, bb);
+  return true;
+}
+
+bool Optimizer::hoist_invariants(Func &func, const FlowGraph &flowgraph, Array<Node> &nodes,
+                                 reg::Liveness::DefUse def_use) noexcept {
+  const BasicBlocks bbs = flowgraph.view();
+  Array<uint32_t> idom, loop_start, loop_blocks;
+  if (!func || !bbs) {
+    return true;
+  } else if (!flowgraph.dominators(idom) ||
+             !flowgraph.natural_loops(idom, loop_start, loop_blocks)) {
+    return false;
+  } else if (loop_start.size() <= 1) {
+    return true;
+  }
+  func_ = &func;
+  Licm licm{bbs, idom, {}, {}, {}, {}, {}, {}, {}, {}, LicmGuard{}, NoBlock, NoBlock,
+            false, false, true};
+  if (!licm.pos_bb.resize(nodes.size()) || !licm.def_bb.resize(func.vars().size()) ||
+      !licm.in_loop.resize(bbs.size())) {
+    return false;
+  }
+  licm.pos_bb.fill(NoBlock);
+  licm.def_bb.fill(NoBlock);
+  // find the basic block of each statement and the basic block defining each reg
+  const Node *first = nodes.data();
+  Array<reg::Reg> def, use;
+  for (uint32_t i = 0, n = uint32_t(bbs.size()); i < n; i++) {
+    const BasicBlock &block = bbs[i];
+    const size_t offset = size_t(block.data() - first);
+    for (size_t j = 0; j < block.size(); j++) {
+      licm.pos_bb.set(offset + j, i);
+      def.clear();
+      use.clear();
+      if (!def_use(block[j], def, use)) {
+        return false;
+      }
+      for (reg::Reg reg : def) {
+        if (reg < licm.def_bb.size()) {
+          licm.def_bb.set(reg, i);
+        }
+      }
+    }
+  }
+  // inner loops come first: statements moved to their preheader
+  // can be moved again to the preheader of a loop containing them
+  for (size_t l = 0; licm.good && l + 1 < loop_start.size(); l++) {
+    const View<uint32_t> blocks{loop_blocks.data() + loop_start[l],
+                                loop_start[l + 1] - loop_start[l]};
+    if (!hoist_invariants(licm, blocks, nodes)) {
+      return false;
+    }
+  }
+  if (!licm.good || !licm.moved) {
+    return licm.good;
+  }
+  // insert moved statements at the end of their preheader
+  Array<Node> out;
+  bool ok = true;
+  for (uint32_t i = 0, n = uint32_t(bbs.size()); ok && i < n; i++) {
+    const BasicBlock &block = bbs[i];
+    const size_t offset = size_t(block.data() - first), pos = block.insert_pos();
+    const LicmGuard *guard = NULL;
+    for (const LicmGuard &g : licm.guards) {
+      guard = g.bb == i ? &g : guard;
+    }
+    for (size_t j = 0; ok && j <= block.size(); j++) {
+      if (j == pos && guard) {
+        ok = out.append(Stmt2{func, guard->x, guard->y, ASM_CMP}) &&
+             out.append(Stmt1{func, guard->skip, guard->jump});
+      }
+      for (size_t k = 0; ok && j == pos && k < licm.moved.size(); k++) {
+        const LicmEntry entry = licm.moved[k];
+        ok = entry.bb != i || out.append(entry.node);
+      }
+      if (ok && j == pos && guard) {
+        ok = out.append(guard->skip);
+      }
+      ok = ok && (j == block.size() || licm.pos_bb[offset + j] == NoBlock ||
+                  out.append(nodes[offset + j]));
+    }
+  }
+  if (ok) {
+    nodes.swap(out);
+  }
+  return ok;
+}
+
+bool Optimizer::hoist_invariants(Licm &licm, View<uint32_t> blocks,
+                                 Array<Node> &nodes) noexcept {
+  const uint32_t header = blocks[0];
+  licm.in_loop.fill(false);
+  for (uint32_t bb : blocks) {
+    licm.in_loop.set(bb, true);
+  }
+  // find the preheader. give up if the header has more predecessors outside the loop,
+  // or if they jump also elsewhere
+  licm.preheader = NoBlock;
+  for (const BasicBlock *prev : licm.bbs[header].prev()) {
+    const uint32_t bb = uint32_t(prev - licm.bbs.data());
+    if (licm.in_loop[bb]) {
+      continue;
+    } else if (licm.preheader != NoBlock || prev->next().size() != 1) {
+      return true;
+    }
+    licm.preheader = bb;
+  }
+  if (licm.preheader == NoBlock) {
+    return true;
+  }
+  // collect the statements in the loop, the basic blocks exiting from it or jumping
+  // back to its header, and whether it may write to memory
+  const Node *first = nodes.data();
+  const uint32_t n_nodes = uint32_t(nodes.size());
+  licm.stmt.clear();
+  licm.exits.clear();
+  licm.latches.clear();
+  licm.header = header;
+  licm.store = licm.trap = false;
+  bool ok = true;
+  for (uint32_t bb : blocks) {
+    const BasicBlock &block = licm.bbs[bb];
+    const uint32_t offset = uint32_t(block.data() - first);
+    for (uint32_t j = 0; ok && j < block.size(); j++) {
+      if (licm.pos_bb[offset + j] != NoBlock) {
+        licm.store = licm.store || licm_store(block[j]);
+        ok = licm.stmt.append(offset + j);
+      }
+    }
+    bool exit = block.next().empty();
+    for (const BasicBlock *next : block.next()) {
+      const uint32_t to = uint32_t(next - licm.bbs.data());
+      exit = exit || !licm.in_loop[to];
+      if (to == header) {
+        ok = ok && licm.latches.append(bb);
+      }
+    }
+    ok = ok && (!exit || licm.exits.append(bb));
+  }
+  for (uint32_t k = 0; ok && k < licm.moved.size(); k++) {
+    const LicmEntry entry = licm.moved[k];
+    if (entry.bb != NoBlock && licm.in_loop[entry.bb]) {
+      licm.store = licm.store || licm_store(entry.node);
+      ok = licm.stmt.append(n_nodes + k);
+    }
+  }
+  if (!ok) {
+    return false;
+  }
+  licm.guard = licm_guard(licm);
+  // move to the preheader the assignments (= var expr) with invariant expr,
+  // until no more can be moved: they may use Vars assigned by other moved statements.
+  // copies of a Var or Const are cheap: moving them only lengthens live ranges
+  for (bool again = true; again;) {
+    again = false;
+    for (uint32_t s : licm.stmt) {
+      const bool is_moved = s >= n_nodes;
+      const Node node = is_moved ? licm.moved[s - n_nodes].node : nodes[s];
+      const uint32_t bb = is_moved ? licm.moved[s - n_nodes].bb : licm.pos_bb[s];
+      if (bb == NoBlock || !licm.in_loop[bb] || node.type() != STMT_2 || node.op() != ASSIGN) {
+        continue;
+      }
+      const Var dst = node.child_is<Var>(0);
+      const Expr src = node.child_is<Expr>(1);
+      // statements already moved after the guard of an inner loop may not run
+      const uint32_t run_bb = is_moved && licm_guarded(licm, bb) ? NoBlock : bb;
+      if (licm_reg(dst) == NoBlock || !licm_invariant(licm, src) ||
+          src.children() == 0 || !is_hoistable(licm, src, run_bb)) {
+        continue;
+      }
+      licm.trap = licm.trap || licm_may_trap(src);
+      if (is_moved) {
+        licm.moved.set(s - n_nodes, LicmEntry{node, NoBlock});
+      } else {
+        licm.pos_bb.set(s, NoBlock);
+      }
+      if (!licm.moved.append(LicmEntry{node, licm.preheader}) ||
+          !licm_define(licm, dst, licm.preheader)) {
+        return false;
+      }
+      again = true;
+    }
+  }
+  // in the remaining statements, copy each invariant subexpression
+  // to a new Var assigned in the preheader
+  for (uint32_t s : licm.stmt) {
+    const bool is_moved = s >= n_nodes;
+    const LicmEntry entry = is_moved ? licm.moved[s - n_nodes] //
+                                     : LicmEntry{nodes[s], licm.pos_bb[s]};
+    if (entry.bb == NoBlock || !licm.in_loop[entry.bb]) {
+      continue;
+    }
+    const uint32_t run_bb = is_moved && licm_guarded(licm, entry.bb) ? NoBlock : entry.bb;
+    const Node node = hoist_invariants(licm, entry.node, run_bb);
+    if (node == entry.node) {
+      continue;
+    } else if (is_moved) {
+      licm.moved.set(s - n_nodes, LicmEntry{node, entry.bb});
+    } else {
+      nodes.set(s, node);
+    }
+  }
+  if (licm.good && licm.trap) {
+    licm.guard.skip = func_->new_label();
+    licm.good = licm.guard.skip && licm.guards.append(licm.guard);
+  }
+  return licm.good && *func_;
+}
+
+Node Optimizer::hoist_invariants(Licm &licm, Node node, uint32_t bb) noexcept {
+  const Type t = node.type();
+  const uint16_t op = node.op();
+  const uint32_t n = node.children();
+  // destinations are not copied to new Vars, although the address of a Mem destination can be
+  uint32_t ndst = 0;
+  if (t == STMT_N && op == PHI_) {
+    return node;
+  } else if ((t == STMT_1 && (op == INC || op == DEC)) ||
+             (t == STMT_2 && is_assign(OpStmt2(op)))) {
+    ndst = 1;
+  } else if (t == STMT_N && (op == SET_ || op == ASSIGN_CALL)) {
+    ndst = op == SET_ ? n : n - 1;
+  }
+  Array<Node> children;
+  bool changed = false;
+  if (!children.resize(n)) {
+    licm.good = false;
+    return node;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    const Node child = node.child(i);
+    Node child2 = child;
+    if (i < ndst) {
+      if (Mem mem = child.is<Mem>()) {
+        child2 = hoist_invariants(licm, mem, bb, false);
+      }
+    } else if (Expr expr = child.is<Expr>()) {
+      child2 = hoist_invariants(licm, expr, bb, true);
+    }
+    changed = changed || child2 != child;
+    children.set(i, child2);
+  }
+  return changed ? Node::create_indirect(*func_, node.header(), children) : node;
+}
+
+Expr Optimizer::hoist_invariants(Licm &licm, Expr expr, uint32_t bb, bool hoist) noexcept {
+  const uint32_t n = expr.children();
+  if (n == 0 || !licm.good) {
+    return expr;
+  } else if (hoist && expr.kind() != Void && licm_invariant(licm, expr) &&
+             is_hoistable(licm, expr, bb)) {
+    const Var var{*func_, expr.kind()};
+    licm.trap = licm.trap || licm_may_trap(expr);
+    licm.good = var && licm.moved.append(LicmEntry{Assign{*func_, ASSIGN, var, expr}, //
+                                                   licm.preheader}) &&
+                licm_define(licm, var, licm.preheader);
+    return licm.good ? Expr{var} : expr;
+  }
+  Array<Node> children;
+  bool changed = false;
+  if (!children.resize(n)) {
+    licm.good = false;
+    return expr;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    const Node child = expr.child(i);
+    Node child2 = child;
+    if (Expr e = child.is<Expr>()) {
+      child2 = hoist_invariants(licm, e, bb, true);
+    }
+    changed = changed || child2 != child;
+    children.set(i, child2);
+  }
+  return changed ? Node::create_indirect(*func_, expr.header(), children).is<Expr>() : expr;
+}
+
+bool Optimizer::is_hoistable(const Licm &licm, Expr expr, uint32_t bb) const noexcept {
+  if (!licm_may_trap(expr)) {
+    return true;
+  } else if (!expr.deep_pure(allow_mask_pure() | AllowMemAccess)) {
+    // checked divisions, or calls
+    return false;
+  } else if (licm.store && !expr.deep_pure(~AllowMemAccess)) {
+    // memory loads are invariant only if the loop does not write to memory
+    return false;
+  }
+  // memory loads and divisions may trap, even if not checked:
+  // move them only if the loop executes them anyway
+  return licm_runs(licm, bb);
+}
+
+} // namespace onejit
@@ -0,0 +1,614 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * optimizer_sccp.cpp
+ *
+ *  Created on Apr 12, 2021
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/eval.hpp>
+#include <onejit/flowgraph.hpp>
+#include <onejit/func.hpp>
+#include <onejit/ir.hpp>
+#include <onejit/ir/util.hpp>
+#include <onejit/optimizer.hpp>
+#include <onejit/reg/fwd.hpp>
+#include <onestl/bitset.hpp>
+
+#include <algorithm> // std::sort()
+
+namespace onejit {
+
+// lattice of values: unknown yet, constant, or not constant
+enum SccpState : uint8_t { SccpTop = 0, SccpConst = 1, SccpBottom = 2 };
+
+struct SccpCell {
+  Value val; // set only if state is SccpConst
+  SccpState state;
+};
+
+// which successors of a basic block are reachable: bitmask of the following
+enum : uint8_t { SccpFallthrough = 1, SccpJump = 2 };
+
+// a statement that reads the Var with id reg + Id::FIRST
+struct SccpUse {
+  reg::Reg reg;
+  uint32_t block; // index of basic block
+  uint32_t index; // index of statement inside basic block
+};
+
+// state of propagate_constants()
+struct Sccp {
+  Array<SccpCell> cell;       // index is reg, i.e. Var id - Id::FIRST
+  Array<uint8_t> succ;        // index is basic block: reachable successors
+  BitSet exec;                // index is basic block: set if reachable
+  Array<uint32_t> edge_start; // index is basic block: id of the edge to its first next()
+  Array<uint32_t> edge_from;  // index is edge id: basic block it starts from
+  BitSet edge_exec;           // index is edge id: set if reachable
+  Array<SccpUse> use;         // sorted by reg
+  Array<uint32_t> use_start;  // index is reg: position of its first use in use[]
+  Array<uint32_t> flow_work;  // CFG worklist: edges that became reachable
+  Array<reg::Reg> ssa_work;   // SSA worklist: regs whose cell moved down the lattice
+  BasicBlocks bbs;
+  bool ok; // false if out of memory
+};
+
+static constexpr SccpCell sccp_bottom() noexcept {
+  return SccpCell{Value{}, SccpBottom};
+}
+
+static SccpCell meet(SccpCell a, SccpCell b) noexcept {
+  if (a.state == SccpTop || (a.state == SccpConst && b.state == SccpConst && //
+                             identical(a.val, b.val))) {
+    return b;
+  } else if (b.state == SccpTop) {
+    return a;
+  }
+  return sccp_bottom();
+}
+
+// return reg of var, or NoReg if var is not a local variable
+static reg::Reg sccp_reg(const Sccp &sccp, Var var) noexcept {
+  const uint32_t id = var.id().val();
+  if (id >= Id::FIRST && id - Id::FIRST < sccp.cell.size()) {
+    return id - Id::FIRST;
+  }
+  return reg::NoReg;
+}
+
+static SccpCell sccp_eval(const Sccp &sccp, Expr expr) noexcept {
+  Value v;
+  switch (expr.type()) {
+  case CONST:
+    v = expr.is<Const>().val();
+    break;
+  case VAR: {
+    const reg::Reg r = sccp_reg(sccp, expr.is<Var>());
+    return r == reg::NoReg ? sccp_bottom() : sccp.cell[r];
+  }
+  case UNARY: {
+    const Unary unary = expr.is<Unary>();
+    const SccpCell x = sccp_eval(sccp, unary.x());
+    if (x.state != SccpConst) {
+      return x;
+    }
+    v = eval_unary(unary.kind(), unary.op(), x.val);
+    break;
+  }
+  case BINARY: {
+    const Binary binary = expr.is<Binary>();
+    const SccpCell x = sccp_eval(sccp, binary.x());
+    const SccpCell y = sccp_eval(sccp, binary.y());
+    if (x.state != SccpConst || y.state != SccpConst) {
+      return x.state == SccpBottom || y.state == SccpBottom ? sccp_bottom() : SccpCell{};
+    }
+    v = eval_binary(binary.op(), x.val, y.val);
+    break;
+  }
+  case TUPLE: {
+    Tuple tuple = expr.is<Tuple>();
+    if (!is_arithmetic(tuple.op())) {
+      return sccp_bottom();
+    }
+    bool top = false;
+    v = Value::identity(tuple.kind(), tuple.op());
+    for (uint32_t i = 0, n = tuple.children(); v.is_valid() && i < n; i++) {
+      const SccpCell x = sccp_eval(sccp, tuple.arg(i));
+      if (x.state == SccpBottom) {
+        return x;
+      }
+      top = top || x.state == SccpTop;
+      if (!top) {
+        v = eval_tuple(tuple.kind(), tuple.op(), {v, x.val});
+      }
+    }
+    if (top) {
+      return SccpCell{};
+    }
+    break;
+  }
+  default:
+    // Label, Mem, Call...
+    break;
+  }
+  return v.is_valid() ? SccpCell{v, SccpConst} : sccp_bottom();
+}
+
+// return the comparison performed by a conditional jump after (asm_cmp x y),
+// or BAD2 if unknown. also set is_signed to the signedness it assumes,
+// which is irrelevant for EQL and NEQ
+static Op2 condjump_to_comparison(OpStmt1 op, bool &is_signed) noexcept {
+  is_signed = op == ASM_JG || op == ASM_JGE || op == ASM_JL || op == ASM_JLE;
+  switch (op) {
+  case ASM_JA:
+  case ASM_JG:
+    return GTR;
+  case ASM_JAE:
+  case ASM_JGE:
+    return GEQ;
+  case ASM_JB:
+  case ASM_JL:
+    return LSS;
+  case ASM_JBE:
+  case ASM_JLE:
+    return LEQ;
+  case ASM_JE:
+    return EQL;
+  case ASM_JNE:
+    return NEQ;
+  default:
+    return BAD2;
+  }
+}
+
+// convert a conditional jump after (asm_cmp x y) to the one after (asm_cmp y x)
+static OpStmt1 swap_condjump(OpStmt1 op) noexcept {
+  switch (op) {
+  case ASM_JA:
+    return ASM_JB;
+  case ASM_JAE:
+    return ASM_JBE;
+  case ASM_JB:
+    return ASM_JA;
+  case ASM_JBE:
+    return ASM_JAE;
+  case ASM_JG:
+    return ASM_JL;
+  case ASM_JGE:
+    return ASM_JLE;
+  case ASM_JL:
+    return ASM_JG;
+  case ASM_JLE:
+    return ASM_JGE;
+  default:
+    return op;
+  }
+}
+
+// return the (asm_cmp x y) before the conditional jump ending block, or Stmt2{} if not found
+static Stmt2 sccp_cmp(const BasicBlock &block) noexcept {
+  const size_t n = block.size();
+  if (n >= 2 && ir::is_cond_jump(block[n - 1]) && block[n - 1].type() == STMT_1 &&
+      block[n - 2].type() == STMT_2 && block[n - 2].op() == ASM_CMP) {
+    return block[n - 2].is<Stmt2>();
+  }
+  return Stmt2{};
+}
+
+// return the reachable successors of block
+static uint8_t sccp_successors(const Sccp &sccp, const BasicBlock &block) noexcept {
+  const size_t n = block.size();
+  const Node last = n == 0 ? Node{} : block[n - 1];
+  if (ir::is_uncond_jump(last)) {
+    return SccpJump;
+  } else if (!ir::is_cond_jump(last)) {
+    return SccpFallthrough;
+  }
+  const Stmt2 cmp = sccp_cmp(block);
+  bool is_signed = false;
+  const Op2 op = condjump_to_comparison(OpStmt1(last.op()), is_signed);
+  if (!cmp || op == BAD2 ||
+      (op != EQL && op != NEQ && cmp.child_is<Expr>(0).kind().is_signed() != is_signed)) {
+    return SccpFallthrough | SccpJump;
+  }
+  const SccpCell x = sccp_eval(sccp, cmp.child_is<Expr>(0));
+  const SccpCell y = sccp_eval(sccp, cmp.child_is<Expr>(1));
+  if (x.state == SccpTop || y.state == SccpTop) {
+    return 0;
+  } else if (x.state == SccpBottom || y.state == SccpBottom) {
+    return SccpFallthrough | SccpJump;
+  }
+  const Value v = eval_binary(op, x.val, y.val);
+  if (!v.is_valid()) {
+    return SccpFallthrough | SccpJump;
+  }
+  return v ? SccpJump : SccpFallthrough;
+}
+
+// return true if the edge from basic block pred to basic block to is reachable
+static bool sccp_edge(const Sccp &sccp, const BasicBlock *pred, const BasicBlock *to) noexcept {
+  const uint32_t i = uint32_t(pred - sccp.bbs.data());
+  if (!sccp.exec[i]) {
+    return false;
+  }
+  const uint8_t succ = sccp.succ[i];
+  const Span<BasicBlock *> next = pred->next();
+  const size_t n = pred->size();
+  const Node last = n == 0 ? Node{} : (*pred)[n - 1];
+  if (ir::is_jump_table(last)) {
+    // next() contains all the jump destinations
+    return (succ & SccpJump) != 0;
+  }
+  // next() contains the fallthrough basic block first, then the jump destination
+  const bool has_fallthrough = !ir::is_uncond_jump(last) && i + 1 < sccp.bbs.size();
+  const bool has_jump = ir::is_jump(last) && ir::jump_label(last);
+  return ((succ & SccpFallthrough) && has_fallthrough && next[0] == to) ||
+         ((succ & SccpJump) && has_jump && next[next.size() - 1] == to);
+}
+
+static void sccp_set(Sccp &sccp, Var var, SccpCell cell) noexcept {
+  const reg::Reg r = sccp_reg(sccp, var);
+  if (r == reg::NoReg) {
+    return;
+  }
+  const SccpCell old = sccp.cell[r];
+  cell = meet(old, cell);
+  if (cell.state != old.state) {
+    sccp.cell.set(r, cell);
+    sccp.ok = sccp.ok && sccp.ssa_work.append(r);
+  }
+}
+
+// evaluate a statement, updating the cells of Vars it defines
+static void sccp_visit(Sccp &sccp, const BasicBlock &block, Node node) noexcept {
+  const uint16_t op = node.op();
+  switch (node.type()) {
+  case STMT_2:
+    if (Var var = node.child_is<Var>(0)) {
+      if (op == ASSIGN) {
+        sccp_set(sccp, var, sccp_eval(sccp, node.child_is<Expr>(1)));
+      } else if (is_assign(OpStmt2(op))) {
+        sccp_set(sccp, var, sccp_bottom());
+      }
+    }
+    break;
+  case STMT_N:
+    if (const Phi phi = node.is<Phi>()) {
+      // only the arguments from reachable predecessors matter
+      const Span<BasicBlock *> prev = block.prev();
+      SccpCell cell{};
+      for (uint32_t j = 0; j < prev.size() && j + 1 < phi.children(); j++) {
+        if (sccp_edge(sccp, prev[j], &block)) {
+          cell = meet(cell, sccp_eval(sccp, phi.src(j)));
+        }
+      }
+      sccp_set(sccp, phi.dst(), cell);
+    } else if (op == SET_ || op == ASSIGN_CALL) {
+      for (uint32_t i = 0, n = node.children(); i < n; i++) {
+        if (Var var = node.child_is<Var>(i)) {
+          sccp_set(sccp, var, sccp_bottom());
+        }
+      }
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+// append to sccp.use the Vars read by node, which is statement index of basic block
+static void sccp_collect_uses(Sccp &sccp, Node node, uint32_t block, uint32_t index) noexcept {
+  if (Var var = node.is<Var>()) {
+    const reg::Reg r = sccp_reg(sccp, var);
+    if (r != reg::NoReg) {
+      sccp.ok = sccp.ok && sccp.use.append(SccpUse{r, block, index});
+    }
+    return;
+  }
+  const uint16_t op = node.op();
+  const uint32_t n = node.children();
+  // skip the Vars defined by the statement
+  uint32_t i = 0;
+  if (node.type() == STMT_2 && is_assign(OpStmt2(op))) {
+    i = node.child(0).type() == VAR ? 1 : 0;
+  } else if (node.type() == STMT_N) {
+    i = op == PHI_ ? 1 : op == SET_ ? n : op == ASSIGN_CALL ? n - 1 : 0;
+  }
+  for (; i < n; i++) {
+    sccp_collect_uses(sccp, node.child(i), block, index);
+  }
+}
+
+// set to SccpBottom the cells of Vars never defined, as function parameters,
+// and fill the uses of each Var and the ids of CFG edges
+static bool sccp_init(Sccp &sccp, BitSet &defined) noexcept {
+  const uint32_t bb_n = uint32_t(sccp.bbs.size());
+  uint32_t edge_n = 0;
+  for (uint32_t i = 0; i < bb_n; i++) {
+    const BasicBlock &block = sccp.bbs.data()[i];
+    sccp.edge_start.set(i, edge_n);
+    for (size_t j = 0, n = block.next().size(); j < n; j++) {
+      sccp.ok = sccp.ok && sccp.edge_from.append(i);
+    }
+    edge_n += uint32_t(block.next().size());
+    for (uint32_t j = 0, n = uint32_t(block.size()); j < n; j++) {
+      const Node node = block[j];
+      Var var;
+      if (node.type() == STMT_2 && is_assign(OpStmt2(node.op()))) {
+        var = node.child_is<Var>(0);
+      } else if (node.type() == STMT_N && node.op() == PHI_) {
+        var = node.is<Phi>().dst();
+      }
+      const reg::Reg r = sccp_reg(sccp, var);
+      if (r != reg::NoReg) {
+        defined.set(r, true);
+      }
+      sccp_collect_uses(sccp, node, i, j);
+    }
+  }
+  sccp.edge_start.set(bb_n, edge_n);
+  const size_t nreg = sccp.cell.size();
+  if (!sccp.ok || !sccp.edge_exec.resize(edge_n) || !sccp.use_start.resize(nreg + 1)) {
+    return false;
+  }
+  for (reg::Reg reg = 0; reg < nreg; reg++) {
+    if (!defined[reg]) {
+      sccp.cell.set(reg, sccp_bottom());
+    }
+  }
+  std::sort(sccp.use.begin(), sccp.use.end(),
+            [](const SccpUse &a, const SccpUse &b) { return a.reg < b.reg; });
+  for (const SccpUse &use : sccp.use) {
+    sccp.use_start.inc(use.reg + 1, 1);
+  }
+  for (size_t reg = 0; reg < nreg; reg++) {
+    sccp.use_start.inc(reg + 1, sccp.use_start[reg]);
+  }
+  return true;
+}
+
+// add to the CFG worklist the edges from basic block i that became reachable
+static void sccp_update_succ(Sccp &sccp, uint32_t i) noexcept {
+  const BasicBlock &block = sccp.bbs.data()[i];
+  const uint8_t succ = sccp.succ[i] | sccp_successors(sccp, block);
+  if (succ == sccp.succ[i]) {
+    return;
+  }
+  sccp.succ.set(i, succ);
+  const Span<BasicBlock *> next = block.next();
+  for (uint32_t j = 0; j < next.size(); j++) {
+    const uint32_t edge = sccp.edge_start[i] + j;
+    if (!sccp.edge_exec[edge] && sccp_edge(sccp, &block, next[j])) {
+      sccp.ok = sccp.ok && sccp.flow_work.append(edge);
+    }
+  }
+}
+
+// evaluate all statements of basic block i, which just became reachable
+static void sccp_enter(Sccp &sccp, uint32_t i) noexcept {
+  const BasicBlock &block = sccp.bbs.data()[i];
+  sccp.exec.set(i, true);
+  for (const Node node : block) {
+    sccp_visit(sccp, block, node);
+  }
+  sccp_update_succ(sccp, i);
+}
+
+// process the CFG edge that just became reachable
+static void sccp_visit_edge(Sccp &sccp, uint32_t edge) noexcept {
+  if (sccp.edge_exec[edge]) {
+    return;
+  }
+  sccp.edge_exec.set(edge, true);
+  const uint32_t i = sccp.edge_from[edge];
+  const BasicBlock *to = sccp.bbs.data()[i].next()[edge - sccp.edge_start[i]];
+  const uint32_t k = uint32_t(to - sccp.bbs.data());
+  if (!sccp.exec[k]) {
+    sccp_enter(sccp, k);
+    return;
+  }
+  // only the Phi at the beginning of basic block can change
+  for (const Node node : *to) {
+    if (node.type() == STMT_N && node.op() == PHI_) {
+      sccp_visit(sccp, *to, node);
+    } else if (node.type() != LABEL) {
+      break;
+    }
+  }
+}
+
+// re-evaluate the reachable statements that use reg, whose cell just changed
+static void sccp_visit_uses(Sccp &sccp, reg::Reg reg) noexcept {
+  for (uint32_t u = sccp.use_start[reg], end = sccp.use_start[reg + 1]; u < end; u++) {
+    const SccpUse use = sccp.use[u];
+    if (!sccp.exec[use.block]) {
+      continue;
+    }
+    const BasicBlock &block = sccp.bbs.data()[use.block];
+    sccp_visit(sccp, block, block[use.index]);
+    if (use.index + 2 >= block.size()) {
+      // may be the (asm_cmp x y) before the conditional jump ending block
+      sccp_update_succ(sccp, use.block);
+    }
+  }
+}
+
+bool Optimizer::propagate_constants(Func &func, const FlowGraph &flowgraph, Array<Node> &nodes,
+                                    Opt flags) noexcept {
+  Sccp sccp{{}, {}, {}, {}, {}, {}, {}, {}, {}, {}, flowgraph.view(), true};
+  const uint32_t bb_n = uint32_t(sccp.bbs.size());
+  BitSet defined;
+  if (!func || !bb_n) {
+    return true;
+  } else if (!sccp.cell.resize(func.vars().size()) || !sccp.succ.resize(bb_n) ||
+             !sccp.exec.resize(bb_n) || !sccp.edge_start.resize(bb_n + 1) ||
+             !defined.resize(func.vars().size()) || !sccp_init(sccp, defined)) {
+    return false;
+  }
+  // Wegman, Zadeck: "Constant propagation with conditional branches" (1991)
+  // each cell moves down the lattice at most twice, and each edge becomes reachable once:
+  // statements are re-evaluated only when a CFG edge or an SSA def-use edge changes
+  sccp_enter(sccp, 0);
+  while (sccp.ok && (!sccp.flow_work.empty() || !sccp.ssa_work.empty())) {
+    for (size_t n; (n = sccp.flow_work.size()) != 0;) {
+      const uint32_t edge = sccp.flow_work[n - 1];
+      sccp.flow_work.truncate(n - 1);
+      sccp_visit_edge(sccp, edge);
+    }
+    for (size_t n; (n = sccp.ssa_work.size()) != 0;) {
+      const reg::Reg reg = sccp.ssa_work[n - 1];
+      sccp.ssa_work.truncate(n - 1);
+      sccp_visit_uses(sccp, reg);
+    }
+  }
+  if (!sccp.ok) {
+    return false;
+  }
+
+  func_ = &func;
+  flags_ = flags;
+  return propagate_constants(sccp, nodes);
+}
+
+bool Optimizer::propagate_constants(Sccp &sccp, Array<Node> &nodes) noexcept {
+  Array<Node> out;
+  Array<Var> args;
+  bool ok = true;
+  for (uint32_t i = 0, bb_n = uint32_t(sccp.bbs.size()); ok && i < bb_n; i++) {
+    // statements of unreachable basic blocks are removed
+    const BasicBlock *block = sccp.bbs.data() + i;
+    const size_t n = sccp.exec[i] ? block->size() : 0;
+    const Stmt2 cmp = sccp_cmp(*block);
+    const uint8_t succ = sccp.succ[i];
+    for (size_t j = 0; ok && j < n; j++) {
+      Node node = (*block)[j];
+      if (const Phi phi = node.is<Phi>()) {
+        node = propagate_constants(sccp, *block, phi, args);
+      } else if (!cmp || j + 2 < n) {
+        node = propagate_constants(sccp, node);
+      } else if (succ == SccpJump) {
+        // conditional jump always taken
+        if (j + 2 == n) {
+          continue;
+        }
+        node = Goto{*func_, ir::jump_label(node)};
+      } else if (succ == SccpFallthrough) {
+        // conditional jump never taken
+        continue;
+      } else {
+        Node jump = (*block)[++j];
+        node = propagate_constants(sccp, cmp, jump);
+        ok = node && out.append(node);
+        node = jump;
+      }
+      ok = ok && node && out.append(node);
+    }
+  }
+  if (ok && *func_) {
+    nodes.swap(out);
+  }
+  return ok && *func_;
+}
+
+Node Optimizer::propagate_constants(Sccp &sccp, const BasicBlock &block, Phi phi,
+                                    Array<Var> &args) noexcept {
+  const Var dst = phi.dst();
+  const reg::Reg r = sccp_reg(sccp, dst);
+  if (r != reg::NoReg && sccp.cell[r].state == SccpConst) {
+    return Assign{*func_, ASSIGN, dst, Const{*func_, sccp.cell[r].val}};
+  }
+  // keep only the arguments from reachable predecessors:
+  // the others will be removed, and the order of the remaining ones is unchanged
+  const Span<BasicBlock *> prev = block.prev();
+  args.clear();
+  for (uint32_t j = 0; j < prev.size() && j + 1 < phi.children(); j++) {
+    if (sccp_edge(sccp, prev[j], &block) && !args.append(phi.src(j))) {
+      return Node{};
+    }
+  }
+  if (args.size() == prev.size()) {
+    return phi;
+  } else if (args.size() == 1) {
+    return Assign{*func_, ASSIGN, dst, args[0]};
+  }
+  return Phi{*func_, dst, args};
+}
+
+Node Optimizer::propagate_constants(Sccp &sccp, Stmt2 cmp, Node &jump) noexcept {
+  // (asm_cmp x y) is rewritten only if at most one of x and y becomes constant,
+  // and in such case the constant must be y
+  Expr x = propagate_constants(sccp, cmp.child(0)).is<Expr>();
+  Expr y = propagate_constants(sccp, cmp.child(1)).is<Expr>();
+  if (!x || !y) {
+    return Node{};
+  } else if (x.type() == CONST && y.type() == CONST) {
+    return cmp;
+  } else if (x.type() == CONST) {
+    // also swap the condition of the conditional jump
+    const Expr tmp = x;
+    x = y;
+    y = tmp;
+    jump = Stmt1{*func_, ir::jump_label(jump), swap_condjump(OpStmt1(jump.op()))};
+  }
+  if (x == cmp.child(0) && y == cmp.child(1)) {
+    return cmp;
+  }
+  return Stmt2{*func_, x, y, ASM_CMP};
+}
+
+Node Optimizer::propagate_constants(Sccp &sccp, Node node) noexcept {
+  if (Var var = node.is<Var>()) {
+    const reg::Reg r = sccp_reg(sccp, var);
+    if (r != reg::NoReg && sccp.cell[r].state == SccpConst) {
+      return Const{*func_, sccp.cell[r].val};
+    }
+    return node;
+  }
+  const uint32_t n = node.children();
+  if (n == 0) {
+    return node;
+  } else if (node.type() == STMT_2 && node.op() == ASSIGN) {
+    const reg::Reg r = sccp_reg(sccp, node.child_is<Var>(0));
+    if (r != reg::NoReg && sccp.cell[r].state == SccpConst) {
+      // (= x expr) becomes (= x c), and expr is removed: computing a constant has no side effects
+      return Assign{*func_, ASSIGN, node.child_is<Var>(0), Const{*func_, sccp.cell[r].val}};
+    }
+  }
+  Array<Node> children;
+  bool changed = false;
+  if (!children.resize(n)) {
+    return Node{};
+  }
+  const bool is_stmt = node.type() <= STMT_N;
+  const uint16_t op = node.op();
+  // Vars defined by the statement must be preserved
+  const uint32_t ndst = node.type() == STMT_2 && is_assign(OpStmt2(op))       ? 1
+                        : node.type() == STMT_N && (op == SET_ || op == PHI_) ? n
+                        : node.type() == STMT_N && op == ASSIGN_CALL          ? n - 1
+                                                                              : 0;
+  for (uint32_t i = 0; i < n; i++) {
+    const Node child = node.child(i);
+    Node child2 = child;
+    if (i >= ndst || child.type() != VAR) {
+      child2 = propagate_constants(sccp, child);
+    }
+    if (!child2) {
+      return Node{};
+    } else if (child2 != child && is_stmt && child2.is<Expr>()) {
+      // fold the constants just propagated
+      child2 = optimize(child2);
+    }
+    changed = changed || child2 != child;
+    children.set(i, child2);
+  }
+  return changed ? Node::create_indirect(*func_, node.header(), children) : node;
+}
+
+} // namespace onejit
@@ -49,16 +49,18 @@ Expr Optimizer::optimize(Tuple expr, bool optimize_children) noexcept {
 
 bool Optimizer::flatten_children_tobuf(Node node, bool optimize_children) noexcept {
   bool ok = true;
+  // only associative operations can be flattened
+  const bool flatten = is_associative(OpN(node.op()));
   for (size_t i = 0, n = node.children(); ok && i < n; i++) {
     Node child = node.child(i);
     // compare type, kind, op
-    if (child.header() == node.header()) {
+    if (flatten && child.header() == node.header()) {
       ok = flatten_children_tobuf(child, optimize_children);
     } else {
       if (optimize_children) {
         child = optimize(child);
       }
-      if (child.header() == node.header()) {
+      if (flatten && child.header() == node.header()) {
         ok = flatten_children_tobuf(child, optimize_children);
       } else {
         ok = bool(nodes_.append(child));
@@ -72,7 +74,12 @@ Expr Optimizer::partial_eval_tuple(Tuple expr, Range<Node> &noderange) noexcept
   Span<Node> children = noderange.span();
   OpN op = expr.op();
   Kind kind = expr.kind();
-  if (is_associative(op) && (flags_ & OptFastMath || !kind.is_float())) {
+  if (op == SELECT && children.size() == 3 && (flags_ & OptFoldConstant)) {
+    // optimize (select true x y) to x and (select false x y) to y
+    if (Const c = children[0].is<Const>()) {
+      return children[c.val() ? 1 : 2].is<Expr>();
+    }
+  } else if (is_associative(op) && (flags_ & OptFastMath || !kind.is_float())) {
     Value identity = Value::identity(kind, op);
     size_t n = children.size();
     if (n == 0) {
@@ -14,27 +14,56 @@
  */
 
 #include <onejit/reg/allocator.hpp>
+#include <onejit/reg/liveness.hpp>
+
+#include <algorithm> // std::sort()
 
 namespace onejit {
 namespace reg {
 
-Allocator::Allocator() noexcept : g_{}, g2_{}, stack_{}, colors_{} {
+Allocator::Allocator() noexcept
+    : g_{}, g2_{}, stack_{}, active_{}, bucket_{}, bucket_next_{}, bucket_prev_{}, //
+      max_degree_{}, spill_heap_{}, spill_heap_built_{}, moves_{}, alias_{}, colors_{}, class_{},
+      crossing_{}, remat_{}, cost_{}, clobbered_by_{}, clobbered_{}, num_colors_{} {
 }
 
 Allocator::Allocator(Size num_regs) noexcept         //
-    : g_{num_regs}, g2_{num_regs}, stack_{num_regs}, //
-      hints_{}, colors_{num_regs}, avail_colors_{num_regs} {
+    : g_{num_regs}, g2_{num_regs}, stack_{num_regs}, active_{},               //
+      bucket_{size_t(num_regs) + 2}, bucket_next_{num_regs}, bucket_prev_{num_regs}, //
+      max_degree_{}, spill_heap_{}, spill_heap_built_{}, moves_{}, alias_{num_regs}, hints_{},
+      colors_{num_regs}, class_{}, crossing_{}, remat_{}, cost_{}, clobbered_by_{}, clobbered_{},
+      num_colors_{}, avail_colors_{num_regs} {
+  active_.reserve(num_regs);
+  spill_heap_.reserve(num_regs);
   hints_.reserve(num_regs);
 }
 
 Allocator::~Allocator() noexcept {
 }
 
-bool Allocator::reset(Size num_regs) noexcept {
+bool Allocator::reset(Size num_regs, bool with_graph) noexcept {
+  const Size graph_size = with_graph ? num_regs : 0;
   hints_.clear();
-  return g_.reset(num_regs) && g2_.reset(num_regs)              //
-         && stack_.resize(num_regs) && hints_.reserve(num_regs) //
-         && colors_.resize(num_regs) && avail_colors_.resize(num_regs);
+  active_.clear();
+  moves_.clear();
+  class_.clear();
+  crossing_.clear();
+  remat_.clear();
+  cost_.clear();
+  clobbered_by_.clear();
+  for (Array<Color> &clobbered : clobbered_) {
+    clobbered.clear();
+  }
+  return g_.reset(graph_size) && g2_.reset(graph_size)                   //
+         && bucket_.resize(size_t(graph_size) + 2)                         //
+         && bucket_next_.resize(graph_size) && bucket_prev_.resize(graph_size) //
+         && alias_.resize(graph_size) && spill_heap_.reserve(graph_size)      //
+         && stack_.resize(num_regs) && active_.reserve(num_regs)           //
+         && hints_.reserve(num_regs) && class_.reserve(num_regs)         //
+         && crossing_.reserve(num_regs) && remat_.reserve(num_regs)      //
+         && cost_.reserve(num_regs)                                      //
+         && colors_.resize(num_regs)                                     //
+         && avail_colors_.resize(num_regs);
 }
 
 void Allocator::add_hint(Reg reg, Color color) noexcept {
@@ -45,60 +74,377 @@ void Allocator::add_hint(Reg reg, Color color) noexcept {
   hints_.set(reg, color);
 }
 
-void Allocator::allocate_regs(Color num_colors) noexcept {
-  init();
+void Allocator::set_class(Reg reg, RegClass cls) noexcept {
+  if (!class_) {
+    class_.resize(size()); // cannot fail
+    class_.fill(0);
+  }
+  class_.set(reg, cls);
+}
+
+bool Allocator::set_clobbered(RegClass cls, View<Color> colors) noexcept {
+  // regs live across calls may need up to colors.size() additional colors
+  return cls < MaxRegClass && clobbered_[cls].dup(colors) &&
+         avail_colors_.reserve(size() + colors.size());
+}
+
+void Allocator::resize_avail_colors() noexcept {
+  size_t n = size();
+  if (crossing_) {
+    for (const Array<Color> &clobbered : clobbered_) {
+      if (n < size() + clobbered.size()) {
+        n = size() + clobbered.size();
+      }
+    }
+  }
+  if (clobbered_by_) {
+    // regs marked with add_clobbered() may need up to 64 additional colors
+    n += 64;
+  }
+  avail_colors_.resize(n); // cannot fail, set_clobbered() and add_clobbered() reserved capacity
+}
+
+void Allocator::add_call_crossing(Reg reg) noexcept {
+  if (!crossing_) {
+    crossing_.resize(size()); // cannot fail
+    crossing_.fill(false);
+  }
+  crossing_.set(reg, true);
+}
+
+bool Allocator::add_clobbered(Reg reg, Color color) noexcept {
+  if (!clobbered_by_ && (!clobbered_by_.resize(size()) || !avail_colors_.reserve(size() + 64))) {
+    return false;
+  }
+  if (color < 64) {
+    clobbered_by_.set(reg, clobbered_by_[reg] | uint64_t(1) << color);
+  }
+  return true;
+}
+
+void Allocator::add_remat(Reg reg) noexcept {
+  if (!remat_) {
+    remat_.resize(size()); // cannot fail
+    remat_.fill(false);
+  }
+  remat_.set(reg, true);
+}
+
+void Allocator::set_spill_cost(Reg reg, uint32_t cost) noexcept {
+  if (!cost_) {
+    cost_.resize(size()); // cannot fail
+    cost_.fill(1);
+  }
+  cost_.set(reg, cost);
+}
+
+bool Allocator::add_move(Reg dst, Reg src) noexcept {
+  return moves_.append(Move{dst, src});
+}
+
+bool Allocator::allocate_regs(View<Color> num_colors) noexcept {
+  set_num_colors(num_colors);
+  resize_avail_colors();
+  if (!init()) {
+    return false;
+  }
   for (;;) {
     Reg reg;
-    while ((reg = find_degree_less_than(num_colors)) != NoReg) {
+    while ((reg = find_low_degree()) != NoReg) {
       stack_.append(reg); // cannot fail
-      g_.remove(reg);
+      remove(reg);
     }
     if ((reg = pick()) == NoReg) {
       break;
     }
     stack_.append(reg); // cannot fail
-    g_.remove(reg);
+    remove(reg);
+  }
+  if (!assign_colors()) {
+    return false;
+  }
+
+  // coalesced regs get the same color as the reg they were merged into
+  for (Reg reg = 0, n = size(); reg < n; ++reg) {
+    const Reg to = alias(reg);
+    if (to != reg) {
+      colors_.set(reg, colors_[to]);
+    }
+  }
+  return true;
+}
+
+size_t Allocator::set_num_colors(View<Color> num_colors) noexcept {
+  size_t n = num_colors.size();
+  if (n > MaxRegClass) {
+    n = MaxRegClass;
+  }
+  for (size_t i = 0; i < MaxRegClass; i++) {
+    num_colors_[i] = i < n ? num_colors[i] : 0;
   }
-  assign_colors(num_colors);
+  return n;
 }
 
-void Allocator::init() noexcept {
+bool Allocator::init() noexcept {
+  const Size n = size();
   stack_.clear();
-  for (Reg reg = 0, n = size(); reg < n; ++reg) {
+  for (Reg reg = 0; reg < n; ++reg) {
     // add self-connections: needed to have g_.degree(reg) != 0
     // even after removing all other regs from g_
-    g_.set(reg, reg, true);
+    if (!g_.set(reg, reg, true)) {
+      return false;
+    }
     colors_.set(reg, NoColor);
+    alias_.set(reg, reg);
+  }
+  if (!coalesce() || !g2_.dup(g_)) {
+    return false;
+  }
+
+  spill_heap_.clear();
+  spill_heap_built_ = false;
+
+  // put each reg in the bucket of its degree
+  bucket_.fill(NoReg);
+  max_degree_ = 0;
+  for (Reg reg = n; reg != 0; --reg) {
+    // iterate backward: lower regs end up first in each bucket
+    const Degree deg = g_.degree(reg - 1);
+    bucket_insert(reg - 1, deg);
+    max_degree_ = deg > max_degree_ ? deg : max_degree_;
   }
-  g2_.dup(g_); // cannot fail
+  return true;
 }
 
-Reg Allocator::find_degree_less_than(Degree degree) const noexcept {
-  for (Reg i = 0, n = size(); i < n; i++) {
-    Degree deg_i = g_.degree(i);
-    // deg_i is increased by 2 due to self-connections
-    if (deg_i >= 2 && deg_i < 2 + Degree(degree)) {
-      return Reg(i);
+bool Allocator::coalesce() noexcept {
+  // merging two regs may enable further merges: repeat until nothing changes
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (const Move &move : moves_) {
+      const Reg a = alias(move.dst), b = alias(move.src);
+      if (a == b || a >= size() || b >= size() || g_(a, b) || get_class(a) != get_class(b)) {
+        // already coalesced, invalid, interfering or in different register classes
+        continue;
+      }
+      if (hints_) {
+        const Color hint_a = hints_[a], hint_b = hints_[b];
+        if (hint_a != NoColor && hint_b != NoColor && hint_a != hint_b) {
+          continue;
+        }
+      }
+      // if only one of a and b is live across calls, the coalesced reg will be too:
+      // it can only use the colors not clobbered by calls.
+      // this may undo live range splitting, thus only do it conservatively
+      Color num_colors = this->num_colors(a);
+      if (is_call_crossing(a) != is_call_crossing(b)) {
+        const Size clobbered = clobbered_[get_class(a)].size();
+        num_colors = clobbered < num_colors ? num_colors - clobbered : 0;
+        if (num_colors == 0) {
+          continue;
+        }
+      }
+      if (can_coalesce_george(a, b, num_colors)) {
+        if (!combine(a, b)) {
+          return false;
+        }
+        changed = true;
+      } else if (can_coalesce_george(b, a, num_colors) || can_coalesce_briggs(a, b, num_colors)) {
+        if (!combine(b, a)) {
+          return false;
+        }
+        changed = true;
+      }
     }
   }
-  return NoReg;
+  return true;
 }
 
-// pick a register in g_ to be spilled. currently picks the register with highest degree
-Reg Allocator::pick() const noexcept {
-  Reg reg = NoReg;
-  Degree deg = 0;
-  for (Reg i = 0, n = size(); i < n; i++) {
-    Degree deg_i = g_.degree(i);
-    if (deg_i > deg) {
-      reg = i;
-      deg = deg_i;
+bool Allocator::can_coalesce_briggs(Reg a, Reg b, Color num_colors) const noexcept {
+  // count neighbors of a and b having significant degree, i.e. >= num_colors.
+  // degrees are increased by 2 due to self-connections
+  Size significant = 0;
+  Reg neighbor = 0;
+  while ((neighbor = g_.first_set(a, neighbor)) != NoReg) {
+    if (neighbor != a && g_.degree(neighbor) >= 2 + Degree(num_colors)) {
+      significant++;
+    }
+    ++neighbor;
+  }
+  neighbor = 0;
+  while ((neighbor = g_.first_set(b, neighbor)) != NoReg) {
+    if (neighbor != b && !g_(a, neighbor) && g_.degree(neighbor) >= 2 + Degree(num_colors)) {
+      significant++;
+    }
+    ++neighbor;
+  }
+  return significant < num_colors;
+}
+
+bool Allocator::can_coalesce_george(Reg a, Reg b, Color num_colors) const noexcept {
+  Reg neighbor = 0;
+  while ((neighbor = g_.first_set(b, neighbor)) != NoReg) {
+    if (neighbor != b && !g_(a, neighbor) && g_.degree(neighbor) >= 2 + Degree(num_colors)) {
+      return false;
+    }
+    ++neighbor;
+  }
+  return true;
+}
+
+bool Allocator::combine(Reg a, Reg b) noexcept {
+  Reg neighbor = 0;
+  while ((neighbor = g_.first_set(b, neighbor)) != NoReg) {
+    if (neighbor != b && !g_.set(a, neighbor, true)) {
+      return false;
+    }
+    ++neighbor;
+  }
+  g_.remove(b);
+  alias_.set(b, a);
+  if (is_call_crossing(b)) {
+    crossing_.set(a, true);
+  }
+  if (clobbered_by_) {
+    clobbered_by_.set(a, clobbered_by_[a] | clobbered_by_[b]);
+  }
+  if (hints_ && hints_[a] == NoColor) {
+    hints_.set(a, hints_[b]);
+  }
+  if (cost_) {
+    const uint32_t cost = cost_[a] + cost_[b];
+    cost_.set(a, cost < cost_[a] ? ~uint32_t(0) : cost);
+  }
+  return true;
+}
+
+Reg Allocator::alias(Reg reg) const noexcept {
+  if (reg < alias_.size()) {
+    Reg to;
+    while ((to = alias_[reg]) != reg) {
+      reg = to;
     }
   }
   return reg;
 }
 
-void Allocator::assign_colors(Color num_colors) noexcept {
+void Allocator::bucket_insert(Reg reg, Degree degree) noexcept {
+  const Reg head = bucket_[degree];
+  bucket_prev_.set(reg, NoReg);
+  bucket_next_.set(reg, head);
+  if (head != NoReg) {
+    bucket_prev_.set(head, reg);
+  }
+  bucket_.set(degree, reg);
+}
+
+void Allocator::bucket_remove(Reg reg, Degree degree) noexcept {
+  const Reg prev = bucket_prev_[reg];
+  const Reg next = bucket_next_[reg];
+  if (prev != NoReg) {
+    bucket_next_.set(prev, next);
+  } else {
+    bucket_.set(degree, next);
+  }
+  if (next != NoReg) {
+    bucket_prev_.set(next, prev);
+  }
+}
+
+void Allocator::remove(Reg reg) noexcept {
+  bucket_remove(reg, g_.degree(reg));
+  // each neighbor loses one degree: move it to the lower bucket
+  Reg neighbor = 0;
+  while ((neighbor = g_.first_set(reg, neighbor)) != NoReg) {
+    if (neighbor != reg) {
+      const Degree deg = g_.degree(neighbor);
+      bucket_remove(neighbor, deg);
+      bucket_insert(neighbor, deg - 1);
+      spill_heap_push(neighbor, deg - 1);
+    }
+    ++neighbor;
+  }
+  g_.remove(reg);
+}
+
+Reg Allocator::find_low_degree() const noexcept {
+  Color max_colors = 0;
+  for (Color num_colors : num_colors_) {
+    max_colors = num_colors > max_colors ? num_colors : max_colors;
+  }
+  // degrees are increased by 2 due to self-connections
+  const Degree end = 2 + max_colors < max_degree_ + 1 ? 2 + max_colors : max_degree_ + 1;
+  for (Degree deg = 2; deg < end; deg++) {
+    for (Reg reg = bucket_[deg]; reg != NoReg; reg = bucket_next_[reg]) {
+      if (deg < 2 + num_colors(reg)) {
+        return reg;
+      }
+    }
+  }
+  return NoReg;
+}
+
+uint32_t Allocator::spill_cost(Reg reg) const noexcept {
+  if (is_remat(reg)) {
+    return 0;
+  }
+  return reg < cost_.size() ? cost_[reg] : 1;
+}
+
+// return true if spilling a is worse than spilling b, i.e. if a has higher spill cost / degree.
+// on ties, prefers the register with highest degree, then the lowest register
+static bool worse_spill(const SpillCandidate &a, const SpillCandidate &b) noexcept {
+  // compare a.cost / a.degree > b.cost / b.degree without divisions
+  const uint64_t lhs = uint64_t(a.cost) * b.degree, rhs = uint64_t(b.cost) * a.degree;
+  if (lhs != rhs) {
+    return lhs > rhs;
+  } else if (a.degree != b.degree) {
+    return a.degree < b.degree;
+  }
+  return a.reg > b.reg;
+}
+
+void Allocator::spill_heap_push(Reg reg, Degree degree) noexcept {
+  if (!spill_heap_built_) {
+    return;
+  } else if (!spill_heap_.append(SpillCandidate{spill_cost(reg), degree, reg})) {
+    // out of memory: next pick() will rebuild spill_heap_ within its reserved capacity
+    spill_heap_.clear();
+    spill_heap_built_ = false;
+    return;
+  }
+  std::push_heap(spill_heap_.begin(), spill_heap_.end(), worse_spill);
+}
+
+// pick a register in g_ to be spilled: the one with lowest spill cost / degree,
+// i.e. cheap to spill and whose removal simplifies g_ the most.
+// on ties, picks the register with highest degree
+Reg Allocator::pick() noexcept {
+  if (!spill_heap_built_) {
+    // called when simplification is stuck: the remaining regs are usually few,
+    // and each pick() after this one costs O(log n) plus the stale entries it skips
+    spill_heap_.clear();
+    for (Degree deg = 2; deg <= max_degree_; deg++) {
+      for (Reg reg = bucket_[deg]; reg != NoReg; reg = bucket_next_[reg]) {
+        // cannot fail, reset() reserved enough capacity
+        spill_heap_.append(SpillCandidate{spill_cost(reg), deg, reg});
+      }
+    }
+    std::make_heap(spill_heap_.begin(), spill_heap_.end(), worse_spill);
+    spill_heap_built_ = true;
+  }
+  while (!spill_heap_.empty()) {
+    const SpillCandidate best = spill_heap_[0];
+    std::pop_heap(spill_heap_.begin(), spill_heap_.end(), worse_spill);
+    spill_heap_.truncate(spill_heap_.size() - 1);
+    // removed regs have degree 0, and degrees only decrease: skip stale entries
+    if (g_.degree(best.reg) == best.degree) {
+      return best.reg;
+    }
+  }
+  return NoReg;
+}
+
+bool Allocator::assign_colors() noexcept {
   for (Size n = stack_.size(), i = n; i != 0; i--) {
     Reg reg = stack_[i - 1];
 
@@ -112,17 +458,36 @@ void Allocator::assign_colors(Color num_colors) noexcept {
       // if neighbor is already in g_, reconnect it to reg
       // and mark its color as occupied
       if (g_.degree(neighbor) != 0) {
-        g_.set(reg, neighbor, true);
+        if (!g_.set(reg, neighbor, true)) {
+          return false;
+        }
         avail_colors_.set(colors_[neighbor], false);
       }
       ++neighbor;
     }
     // add self-connection: needed to guarantee degree(reg) != 0
     // which is used in the while() above to check whether reg is present in g_
-    g_.set(reg, reg, true);
+    if (!g_.set(reg, reg, true)) {
+      return false;
+    }
+
+    // if reg is live across calls, do not use colors clobbered by them
+    if (is_call_crossing(reg)) {
+      for (Color clobbered : clobbered_[get_class(reg)]) {
+        avail_colors_.set(clobbered, false);
+      }
+    }
+    // same for other instructions that clobber some colors
+    const uint64_t mask = clobbered_by_ ? clobbered_by_[reg] : 0;
+    for (Color clobbered = 0; (mask >> clobbered) != 0; clobbered++) {
+      if (mask >> clobbered & 1) {
+        avail_colors_.set(clobbered, false);
+      }
+    }
 
     // use lowest available color. it may be >= num_colors i.e. spilled
     Color color = avail_colors_.find(true);
+    const Color num_colors = this->num_colors(reg);
     if (hints_) {
       Color alt_color = try_satisfy_hints(reg);
       if (alt_color != NoColor && (alt_color < num_colors || color >= num_colors)) {
@@ -131,6 +496,7 @@ void Allocator::assign_colors(Color num_colors) noexcept {
     }
     colors_.set(reg, color);
   }
+  return true;
 }
 
 Color Allocator::try_satisfy_hints(Reg reg) noexcept {
@@ -154,5 +520,121 @@ Color Allocator::try_satisfy_hints(Reg reg) noexcept {
   return avail_colors_.find(true);
 }
 
+// linear scan register allocation, see
+// Poletto, Sarkar: "Linear scan register allocation" (1999)
+void Allocator::allocate_regs(View<Interval> intervals, View<Color> num_colors) noexcept {
+  colors_.fill(NoColor);
+  resize_avail_colors();
+  for (size_t cls = 0, n = set_num_colors(num_colors); cls < n; cls++) {
+    allocate_class(intervals, RegClass(cls));
+  }
+}
+
+void Allocator::allocate_class(View<Interval> intervals, RegClass cls) noexcept {
+  const Size n = size();
+  const Color num_colors = num_colors_[cls];
+  // sort regs of class cls with non-empty interval by interval start
+  stack_.clear();
+  for (Reg reg = 0; reg < n; reg++) {
+    if (reg < intervals.size() && intervals[reg].start <= intervals[reg].end &&
+        get_class(reg) == cls) {
+      stack_.append(reg); // cannot fail
+    }
+  }
+  std::sort(stack_.begin(), stack_.end(), [intervals](Reg a, Reg b) {
+    return intervals[a].start < intervals[b].start;
+  });
+
+  // active_ contains both regs colored with registers and regs colored with spill slots
+  active_.clear();
+  avail_colors_.fill(true);
+  for (Reg reg : stack_) {
+    const Interval curr = intervals[reg];
+    expire_active(intervals, curr.start);
+
+    const Color hint = hints_ ? hints_[reg] : NoColor;
+    Color color = hint < num_colors && avail_colors_[hint] && !is_clobbered(reg, hint)
+                      ? hint
+                      : find_color(reg, num_colors);
+    if (color == NoColor) {
+      // all usable registers in use: spill the active reg with the lowest spill cost
+      // (rematerializable regs cost zero), preferring the one whose interval ends last,
+      // if its color can be used by reg and spilling it is cheaper than spilling reg
+      Reg spill = NoReg;
+      uint32_t spill_min = 0;
+      for (size_t i = active_.size(); i != 0; i--) {
+        const Reg other = active_[i - 1];
+        const Color spill_color = colors_[other];
+        if (spill_color < num_colors && !is_clobbered(reg, spill_color)) {
+          const uint32_t cost = spill_cost(other);
+          if (spill == NoReg || cost < spill_min) {
+            spill = other;
+            spill_min = cost;
+          }
+        }
+      }
+      const uint32_t reg_cost = spill_cost(reg);
+      if (spill != NoReg &&
+          (spill_min < reg_cost || (spill_min == reg_cost && intervals[spill].end > curr.end))) {
+        color = colors_[spill];
+        const Color slot = Color(avail_colors_.find(true, num_colors));
+        colors_.set(spill, slot);
+        avail_colors_.set(slot, false);
+      } else {
+        color = Color(avail_colors_.find(true, num_colors));
+      }
+    }
+    colors_.set(reg, color);
+    avail_colors_.set(color, false);
+    insert_active(intervals, reg);
+  }
+}
+
+bool Allocator::is_clobbered(Reg reg, Color color) const noexcept {
+  if (clobbered_by_ && color < 64 && (clobbered_by_[reg] >> color & 1) != 0) {
+    return true;
+  } else if (is_call_crossing(reg)) {
+    for (Color clobbered : clobbered_[get_class(reg)]) {
+      if (clobbered == color) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+Color Allocator::find_color(Reg reg, Color num_colors) const noexcept {
+  for (size_t color = avail_colors_.find(true); color < num_colors;
+       color = avail_colors_.find(true, color + 1)) {
+    if (!is_clobbered(reg, Color(color))) {
+      return Color(color);
+    }
+  }
+  return NoColor;
+}
+
+void Allocator::expire_active(View<Interval> intervals, Size pos) noexcept {
+  size_t i = 0, n = active_.size();
+  for (; i < n && intervals[active_[i]].end < pos; i++) {
+    avail_colors_.set(colors_[active_[i]], true);
+  }
+  if (i != 0) {
+    for (size_t j = i; j < n; j++) {
+      active_.set(j - i, active_[j]);
+    }
+    active_.truncate(n - i);
+  }
+}
+
+void Allocator::insert_active(View<Interval> intervals, Reg reg) noexcept {
+  const Size end = intervals[reg].end;
+  size_t i = active_.size();
+  active_.append(reg); // cannot fail, reset() reserved enough capacity
+  for (; i != 0 && intervals[active_[i - 1]].end > end; i--) {
+    active_.set(i, active_[i - 1]);
+  }
+  active_.set(i, reg);
+}
+
 } // namespace reg
 } // namespace onejit
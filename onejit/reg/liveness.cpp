@@ -0,0 +1,228 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * liveness.cpp
+ *
+ *  Created on Apr 05, 2021
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/basicblock.hpp>
+#include <onejit/ir/var.hpp>
+#include <onejit/mem.hpp>
+#include <onejit/reg/liveness.hpp>
+
+#include <new> // placement new
+
+namespace onejit {
+namespace reg {
+
+Liveness::Liveness() noexcept
+    : set_{}, set_cap_{}, bb_n_{}, num_regs_{}, def_use_{}, tmp_{}, def_{}, use_{}, interval_{} {
+}
+
+Liveness::Liveness(Liveness &&other) noexcept : Liveness{} {
+  swap(other);
+}
+
+Liveness::~Liveness() noexcept {
+  destroy();
+}
+
+Liveness &Liveness::operator=(Liveness &&other) noexcept {
+  swap(other);
+  return *this;
+}
+
+void Liveness::swap(Liveness &other) noexcept {
+  mem::swap(set_, other.set_);
+  mem::swap(set_cap_, other.set_cap_);
+  mem::swap(bb_n_, other.bb_n_);
+  mem::swap(num_regs_, other.num_regs_);
+  mem::swap(def_use_, other.def_use_);
+  tmp_.swap(other.tmp_);
+  def_.swap(other.def_);
+  use_.swap(other.use_);
+  interval_.swap(other.interval_);
+}
+
+void Liveness::destroy() noexcept {
+  for (size_t i = 0; i < set_cap_; i++) {
+    set_[i].~BitSet();
+  }
+  mem::free(set_);
+  set_ = nullptr;
+  set_cap_ = 0;
+}
+
+bool Liveness::init(size_t n, Size num_regs) noexcept {
+  if (n > set_cap_) {
+    BitSet *set = mem::alloc<BitSet>(n);
+    if (!set) {
+      return false;
+    }
+    // move existing BitSets, to reuse their memory
+    for (size_t i = 0; i < set_cap_; i++) {
+      new (set + i) BitSet{std::move(set_[i])};
+    }
+    for (size_t i = set_cap_; i < n; i++) {
+      new (set + i) BitSet{};
+    }
+    destroy();
+    set_ = set;
+    set_cap_ = n;
+  }
+  for (size_t i = 0; i < n; i++) {
+    BitSet &set = set_[i];
+    if (!set.resize(num_regs)) {
+      return false;
+    }
+    set.fill(false);
+  }
+  return tmp_.resize(num_regs);
+}
+
+bool Liveness::compute(BasicBlocks bbs, Size num_regs, DefUse def_use) noexcept {
+  const size_t n = bbs.size();
+  bb_n_ = 0;
+  num_regs_ = num_regs;
+  def_use_ = def_use;
+  if (!init(n * SetN, num_regs)) {
+    return false;
+  }
+  bb_n_ = n;
+  for (size_t i = 0; i < n; i++) {
+    if (!compute_use_def(i, bbs[i])) {
+      return false;
+    }
+  }
+  // iterate backward until fixed point: usually converges in few iterations
+  const BasicBlock *first = bbs.data();
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t i = n; i != 0; i--) {
+      BitSet *set = set_ + (i - 1) * SetN;
+      BitSet &out = set[Out];
+      for (const BasicBlock *next : bbs[i - 1].next()) {
+        out.set_union(set_[size_t(next - first) * SetN + In]);
+      }
+      tmp_.copy(out);
+      tmp_.set_difference(set[Def]);
+      tmp_.set_union(set[Use]);
+      if (tmp_ != set[In]) {
+        set[In].swap(tmp_);
+        changed = true;
+      }
+    }
+  }
+  return true;
+}
+
+bool Liveness::compute_use_def(size_t i, const BasicBlock &bb) noexcept {
+  BitSet &use = set_[i * SetN + Use];
+  BitSet &def = set_[i * SetN + Def];
+  for (size_t j = bb.size(); j != 0; j--) {
+    if (!collect(bb[j - 1])) {
+      return false;
+    }
+    for (Reg reg : def_) {
+      def.set(reg, true);
+    }
+    update(use);
+  }
+  return true;
+}
+
+bool Liveness::compute_intervals(BasicBlocks bbs) noexcept {
+  if (!interval_.resize(num_regs_)) {
+    return false;
+  }
+  interval_.fill(Interval{NoPos, 0});
+  Size pos = 0;
+  for (size_t i = 0, n = bbs.size(); i < n; i++) {
+    const BasicBlock &bb = bbs[i];
+    if (!bb) {
+      continue;
+    }
+    const Size last = pos + Size(bb.size()) - 1;
+    extend_intervals(live_in(i), pos);
+    extend_intervals(live_out(i), last);
+    for (Node node : bb) {
+      if (!collect(node)) {
+        return false;
+      }
+      for (Reg reg : def_) {
+        extend_interval(reg, pos);
+      }
+      for (Reg reg : use_) {
+        extend_interval(reg, pos);
+      }
+      pos++;
+    }
+  }
+  return true;
+}
+
+void Liveness::extend_intervals(const BitSet &set, Size pos) noexcept {
+  for (size_t reg = set.find(true); reg != BitSet::NoPos; reg = set.find(true, reg + 1)) {
+    extend_interval(Reg(reg), pos);
+  }
+}
+
+void Liveness::extend_interval(Reg reg, Size pos) noexcept {
+  Interval interval = interval_[reg];
+  if (interval.start > pos) {
+    interval.start = pos;
+  }
+  if (interval.end < pos) {
+    interval.end = pos;
+  }
+  interval_.set(reg, interval);
+}
+
+bool Liveness::collect(Node node) noexcept {
+  def_.clear();
+  use_.clear();
+  return !def_use_ || def_use_(node, def_, use_);
+}
+
+void Liveness::update(BitSet &live) const noexcept {
+  for (Reg reg : def_) {
+    live.set(reg, false);
+  }
+  for (Reg reg : use_) {
+    live.set(reg, true);
+  }
+}
+
+bool add_reg(Var var, Array<Reg> &regs) noexcept {
+  const uint32_t id = var.id().val();
+  return id < Id::FIRST || regs.append(Reg(id - Id::FIRST));
+}
+
+bool add_uses(Node node, Array<Reg> &use) noexcept {
+  if (Var var = node.is<Var>()) {
+    return add_reg(var, use);
+  }
+  bool ok = true;
+  for (uint32_t i = 0, n = node.children(); ok && i < n; i++) {
+    ok = add_uses(node.child(i), use);
+  }
+  return ok;
+}
+
+bool add_dst(Node dst, Array<Reg> &def, Array<Reg> &use, bool also_use) noexcept {
+  if (Var var = dst.is<Var>()) {
+    return add_reg(var, def) && (!also_use || add_reg(var, use));
+  }
+  return add_uses(dst, use);
+}
+
+} // namespace reg
+} // namespace onejit
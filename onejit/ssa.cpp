@@ -0,0 +1,607 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ssa.cpp
+ *
+ *  Created on Apr 10, 2021
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/compiler.hpp>
+#include <onejit/func.hpp>
+#include <onejit/ir.hpp>
+#include <onejit/reg/liveness.hpp>
+#include <onestl/bitset.hpp>
+
+namespace onejit {
+
+// a current version replaced by a newer one
+struct SsaUndo {
+  reg::Reg reg; // original reg
+  Var prev;     // its previous current version
+};
+
+// state of to_ssa()
+struct Ssa {
+  Array<Var> cur;      // index is original reg, value is its current version
+  Array<SsaUndo> undo; // log of replaced current versions
+};
+
+// visit state of a basic block in the dominator tree
+struct SsaFrame {
+  uint32_t bb;    // basic block
+  uint32_t child; // next child to visit in the dominator tree
+  size_t undo;    // Ssa::undo.size() when entering the basic block
+};
+
+bool Compiler::def_use(Node node, Array<reg::Reg> &def, Array<reg::Reg> &use) noexcept {
+  const uint16_t op = node.op();
+  const uint32_t n = node.children();
+  bool ok = true;
+  switch (node.type()) {
+  case STMT_1:
+    if (op == INC || op == DEC) {
+      return reg::add_dst(node.child(0), def, use, true);
+    }
+    break;
+  case STMT_2:
+    if (is_assign(OpStmt2(op))) {
+      return reg::add_dst(node.child(0), def, use, op != ASSIGN) &&
+             reg::add_uses(node.child(1), use);
+    }
+    break;
+  case STMT_N:
+    if (op == SET_ || op == PHI_ || op == ASSIGN_CALL) {
+      // SET_ defines all its children, PHI_ only the first one.
+      // ASSIGN_CALL defines all its children except the last one, which is a Call
+      const uint32_t ndst = op == SET_ ? n : op == PHI_ ? 1 : n - 1;
+      for (uint32_t i = 0; ok && i < n; i++) {
+        ok = i < ndst ? reg::add_dst(node.child(i), def, use, false)
+                      : reg::add_uses(node.child(i), use);
+      }
+      return ok;
+    }
+    break;
+  default:
+    break;
+  }
+  return reg::add_uses(node, use);
+}
+
+Node Compiler::replace_vars(Node node, View<Var> map) noexcept {
+  if (Var var = node.is<Var>()) {
+    const uint32_t id = var.id().val();
+    if (id >= Id::FIRST && id - Id::FIRST < map.size() && map[id - Id::FIRST]) {
+      return map[id - Id::FIRST];
+    }
+    return node;
+  }
+  const uint32_t n = node.children();
+  if (n == 0) {
+    return node;
+  }
+  Array<Node> children;
+  bool changed = false;
+  for (uint32_t i = 0; i < n; i++) {
+    const Node child = node.child(i);
+    const Node child2 = replace_vars(child, map);
+    changed = changed || child2 != child;
+    if (!children.append(child2)) {
+      out_of_memory(node);
+      return node;
+    }
+  }
+  return changed ? Node::create_indirect(*func_, node.header(), children) : node;
+}
+
+Var Compiler::ssa_new_version(Ssa &ssa, Var var) noexcept {
+  const uint32_t id = var.id().val();
+  if (id < Id::FIRST || id - Id::FIRST >= ssa.cur.size()) {
+    // not a local variable
+    return var;
+  }
+  const reg::Reg reg = id - Id::FIRST;
+  // Vars are numbered sequentially: new Var index in ssa_orig_ is its reg
+  const Var version{*func_, var.kind()};
+  if (!version || !ssa_orig_.append(reg) || !ssa.undo.append(SsaUndo{reg, ssa.cur[reg]})) {
+    out_of_memory(var);
+    return var;
+  }
+  ssa.cur.set(reg, version);
+  return version;
+}
+
+Node Compiler::ssa_rename(Ssa &ssa, Node node) noexcept {
+  const uint16_t op = node.op();
+  switch (node.type()) {
+  case STMT_1:
+    if (Var var = node.child_is<Var>(0)) {
+      if (op == INC || op == DEC) {
+        // (++ x1) becomes (= x2 (+ x1 1))
+        const Var x1 = replace_vars(var, ssa.cur).is<Var>();
+        const Const one = One(*func_, var.kind());
+        const Expr src = op == INC ? Expr{Tuple{*func_, ADD, x1, one}} //
+                                   : Expr{Binary{*func_, SUB, x1, one}};
+        return Assign{*func_, ASSIGN, ssa_new_version(ssa, var), src};
+      }
+    }
+    break;
+  case STMT_2:
+    if (Var var = node.child_is<Var>(0)) {
+      if (is_assign(OpStmt2(op))) {
+        // (+= x1 y) becomes (= x2 (+ x1 y))
+        Expr src = replace_vars(node.child(1), ssa.cur).is<Expr>();
+        if (op != ASSIGN) {
+          const Var x1 = replace_vars(var, ssa.cur).is<Var>();
+          if (Op2 op2 = to_op2(OpStmt2(op))) {
+            src = Binary{*func_, op2, x1, src};
+          } else {
+            src = Tuple{*func_, to_opn(OpStmt2(op)), x1, src};
+          }
+        }
+        return Assign{*func_, ASSIGN, ssa_new_version(ssa, var), src};
+      }
+    }
+    break;
+  case STMT_N:
+    if (op == SET_ || op == ASSIGN_CALL) {
+      // rename uses first, then create new versions of defined Vars
+      const uint32_t n = node.children(), ndst = op == SET_ ? n : n - 1;
+      Array<Expr> children;
+      for (uint32_t i = 0; i < n; i++) {
+        const Expr child = node.child_is<Expr>(i);
+        if (!children.append(i < ndst && child.type() == VAR
+                                 ? child
+                                 : replace_vars(child, ssa.cur).is<Expr>())) {
+          out_of_memory(node);
+          return node;
+        }
+      }
+      for (uint32_t i = 0; i < ndst; i++) {
+        if (Var var = children[i].is<Var>()) {
+          children.set(i, ssa_new_version(ssa, var));
+        }
+      }
+      if (op == SET_) {
+        return StmtN{*func_, Nodes{children.data(), n}, SET_};
+      }
+      return AssignCall{*func_, Exprs{children.data(), ndst}, children[ndst].is<Call>()};
+    }
+    break;
+  default:
+    break;
+  }
+  return replace_vars(node, ssa.cur);
+}
+
+// pairs contains (key, value) pairs, with each key < n.
+// sort their values by key, preserving the order of values with the same key:
+// values with key i will be stored in values[start[i] ... start[i+1]-1].
+// return false if out of memory
+static bool group_by_key(View<uint32_t> pairs, uint32_t n, Array<uint32_t> &start,
+                         Array<uint32_t> &values) noexcept {
+  Array<uint32_t> pos;
+  if (!start.resize(n + 1) || !values.resize(pairs.size() / 2) || !pos.resize(n)) {
+    return false;
+  }
+  start.fill(0);
+  for (size_t k = 0; k + 1 < pairs.size(); k += 2) {
+    start.set(pairs[k] + 1, start[pairs[k] + 1] + 1);
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    start.set(i + 1, start[i + 1] + start[i]);
+    pos.set(i, start[i]);
+  }
+  for (size_t k = 0; k + 1 < pairs.size(); k += 2) {
+    values.set(pos[pairs[k]], pairs[k + 1]);
+    pos.set(pairs[k], pos[pairs[k]] + 1);
+  }
+  return true;
+}
+
+// compute where Phi are needed: in the iterated dominance frontier
+// of the basic blocks defining each reg, only where reg is live (pruned SSA form).
+// append them to phis as pairs (basic block, reg). return false if out of memory
+static bool place_phis(const reg::Liveness &liveness, View<uint32_t> df_start, View<uint32_t> df,
+                       View<uint32_t> def_start, View<uint32_t> def_bb,
+                       Array<uint32_t> &phis) noexcept {
+  const uint32_t bb_n = uint32_t(df_start.size() - 1);
+  const reg::Reg num_regs = reg::Reg(def_start.size() - 1);
+  Array<uint32_t> work, has_phi, in_work;
+  if (!has_phi.resize(bb_n) || !in_work.resize(bb_n)) {
+    return false;
+  }
+  has_phi.fill(FlowGraph::NoBlock);
+  in_work.fill(FlowGraph::NoBlock);
+  for (reg::Reg reg = 0; reg < num_regs; reg++) {
+    work.clear();
+    for (uint32_t k = def_start[reg]; k < def_start[reg + 1]; k++) {
+      in_work.set(def_bb[k], reg);
+      if (!work.append(def_bb[k])) {
+        return false;
+      }
+    }
+    while (work) {
+      const uint32_t x = work[work.size() - 1];
+      work.truncate(work.size() - 1);
+      for (uint32_t k = df_start[x]; k < df_start[x + 1]; k++) {
+        const uint32_t y = df[k];
+        if (has_phi[y] == reg || !liveness.live_in(y)[reg]) {
+          continue;
+        }
+        has_phi.set(y, reg);
+        if (!phis.append(y) || !phis.append(reg)) {
+          return false;
+        }
+        if (in_work[y] != reg) {
+          // a Phi is a definition too
+          in_work.set(y, reg);
+          if (!work.append(y)) {
+            return false;
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+Compiler &Compiler::to_ssa() noexcept {
+  ssa_orig_.clear();
+  if (!*this || !node_) {
+    return *this;
+  }
+  const reg::Reg num_regs = reg::Reg(func_->vars().size());
+  if (!flowgraph_.build(node_, error_)) {
+    good_ = false;
+    return *this;
+  } else if (!liveness_.compute(flowgraph_.view(), num_regs, def_use)) {
+    return out_of_memory(Node{});
+  }
+  const BasicBlocks bbs = flowgraph_.view();
+  const uint32_t bb_n = uint32_t(bbs.size());
+  const Node *first = node_.data();
+
+  // collect the basic blocks defining each reg
+  Array<uint32_t> idom, df_start, df, pairs, mark, def_start, def_bb;
+  Array<reg::Reg> def, use;
+  if (!flowgraph_.dominators(idom) || !flowgraph_.dominance_frontiers(idom, df_start, df) ||
+      !mark.resize(num_regs)) {
+    return out_of_memory(Node{});
+  }
+  mark.fill(FlowGraph::NoBlock);
+  for (uint32_t i = 0; i < bb_n; i++) {
+    for (Node node : bbs[i]) {
+      def.clear();
+      use.clear();
+      if (!def_use(node, def, use)) {
+        return out_of_memory(node);
+      }
+      for (reg::Reg reg : def) {
+        if (reg < num_regs && mark[reg] != i) {
+          mark.set(reg, i);
+          if (!pairs.append(reg) || !pairs.append(i)) {
+            return out_of_memory(node);
+          }
+        }
+      }
+    }
+  }
+  // Phi of each basic block are sorted by reg
+  Array<uint32_t> phi_start, phi_reg;
+  if (!group_by_key(pairs, num_regs, def_start, def_bb)) {
+    return out_of_memory(Node{});
+  }
+  pairs.clear();
+  if (!place_phis(liveness_, df_start, df, def_start, def_bb, pairs) ||
+      !group_by_key(pairs, bb_n, phi_start, phi_reg)) {
+    return out_of_memory(Node{});
+  }
+  // children of each basic block in the dominator tree
+  Array<uint32_t> dom_start, dom_child;
+  if (!flowgraph_.dominator_tree(idom, dom_start, dom_child)) {
+    return out_of_memory(Node{});
+  }
+
+  // each Phi has one argument per predecessor, initially the original Var:
+  // arguments from unreachable predecessors are never renamed
+  Ssa ssa;
+  Array<uint32_t> arg_start;
+  Array<Var> phi_dst, phi_arg;
+  if (!ssa.cur.dup(func_->vars()) || !ssa_orig_.resize(num_regs) ||
+      !phi_dst.resize(phi_reg.size()) || !arg_start.resize(phi_reg.size() + 1)) {
+    return out_of_memory(Node{});
+  }
+  for (reg::Reg reg = 0; reg < num_regs; reg++) {
+    ssa_orig_.set(reg, reg);
+  }
+  arg_start.set(0, 0);
+  for (uint32_t i = 0; i < bb_n; i++) {
+    const uint32_t pred_n = uint32_t(bbs[i].prev().size());
+    for (uint32_t k = phi_start[i]; k < phi_start[i + 1]; k++) {
+      arg_start.set(k + 1, arg_start[k] + pred_n);
+      for (uint32_t j = 0; j < pred_n; j++) {
+        if (!phi_arg.append(ssa.cur[phi_reg[k]])) {
+          return out_of_memory(Node{});
+        }
+      }
+    }
+  }
+
+  // rename Vars visiting the dominator tree in preorder.
+  // statements of unreachable basic blocks are not renamed
+  Array<Node> renamed;
+  Array<SsaFrame> stack;
+  if (!renamed.dup(node_)) {
+    return out_of_memory(Node{});
+  }
+  uint32_t bb = 0;
+  while (*this && (bb != FlowGraph::NoBlock || stack)) {
+    if (bb != FlowGraph::NoBlock) {
+      // enter basic block bb
+      if (!stack.append(SsaFrame{bb, dom_start[bb], ssa.undo.size()})) {
+        return out_of_memory(Node{});
+      }
+      for (uint32_t k = phi_start[bb]; k < phi_start[bb + 1]; k++) {
+        phi_dst.set(k, ssa_new_version(ssa, func_->vars()[phi_reg[k]]));
+      }
+      const BasicBlock *block = bbs.data() + bb;
+      for (size_t j = 0, n = block->size(); j < n; j++) {
+        renamed.set(size_t(block->data() + j - first), ssa_rename(ssa, (*block)[j]));
+      }
+      // set the arguments of successors' Phi coming from this basic block
+      for (const BasicBlock *succ : block->next()) {
+        const uint32_t s = uint32_t(succ - bbs.data());
+        const Span<BasicBlock *> prev = succ->prev();
+        for (uint32_t j = 0; j < prev.size(); j++) {
+          for (uint32_t k = phi_start[s]; prev[j] == block && k < phi_start[s + 1]; k++) {
+            phi_arg.set(arg_start[k] + j, ssa.cur[phi_reg[k]]);
+          }
+        }
+      }
+      bb = FlowGraph::NoBlock;
+      continue;
+    }
+    SsaFrame top = stack[stack.size() - 1];
+    if (top.child < dom_start[top.bb + 1]) {
+      bb = dom_child[top.child++];
+      stack.set(stack.size() - 1, top);
+      continue;
+    }
+    // exit basic block: restore the current versions it replaced
+    for (size_t k = ssa.undo.size(); k > top.undo; k--) {
+      ssa.cur.set(ssa.undo[k - 1].reg, ssa.undo[k - 1].prev);
+    }
+    ssa.undo.truncate(top.undo);
+    stack.truncate(stack.size() - 1);
+  }
+
+  // insert Phi after the labels at the beginning of each basic block
+  Array<Node> out;
+  bool ok = bool(*this);
+  for (uint32_t i = 0; ok && i < bb_n; i++) {
+    const BasicBlock &block = bbs[i];
+    const size_t offset = size_t(block.data() - first);
+    size_t j = 0, n = block.size();
+    for (; ok && j < n && block[j].type() == LABEL; j++) {
+      ok = out.append(block[j]);
+    }
+    for (uint32_t k = phi_start[i]; ok && k < phi_start[i + 1]; k++) {
+      const Phi phi{*func_, phi_dst[k], phi_arg.view(arg_start[k], arg_start[k + 1])};
+      ok = phi && out.append(phi);
+    }
+    for (; ok && j < n; j++) {
+      ok = out.append(renamed[offset + j]);
+    }
+  }
+  if (!ok) {
+    return out_of_memory(Node{});
+  }
+  node_.swap(out);
+  return *this;
+}
+
+Compiler &Compiler::optimize_ssa(Opt flags) noexcept {
+  if (!*this || !ssa_orig_) {
+    return *this;
+  }
+  if (flags & OptPropagateConstant) {
+    if (!flowgraph_.build(node_, error_)) {
+      good_ = false;
+      return *this;
+    } else if (!optimizer_.propagate_constants(*func_, flowgraph_, node_, flags)) {
+      return out_of_memory(Node{});
+    }
+  }
+  if (flags & OptValueNumbering) {
+    if (!flowgraph_.build(node_, error_)) {
+      good_ = false;
+      return *this;
+    } else if (!optimizer_.number_values(*func_, flowgraph_, node_)) {
+      return out_of_memory(Node{});
+    }
+  }
+  if (flags & OptHoistInvariant) {
+    if (!flowgraph_.build(node_, error_)) {
+      good_ = false;
+      return *this;
+    } else if (!optimizer_.hoist_invariants(*func_, flowgraph_, node_, def_use)) {
+      return out_of_memory(Node{});
+    }
+  }
+  // new Vars created by optimizations are not versions of other Vars
+  for (size_t reg = ssa_orig_.size(), n = func_->vars().size(); reg < n; reg++) {
+    if (!ssa_orig_.append(reg::Reg(reg))) {
+      return out_of_memory(Node{});
+    }
+  }
+  return *this;
+}
+
+// simplify a statement after merging SSA versions:
+// (= x x) becomes nothing, (= x (op x y)) becomes (op= x y) and (+= x 1) becomes (++ x)
+static Node simplify_copy(Func &func, Node node) noexcept {
+  if (node.type() != STMT_2 || node.op() != ASSIGN) {
+    return node;
+  }
+  const Var dst = node.child_is<Var>(0);
+  const Expr src = node.child_is<Expr>(1);
+  if (!dst) {
+    return node;
+  } else if (src == dst) {
+    return VoidConst;
+  } else if (src.children() != 2 || src.child(0) != dst) {
+    return node;
+  }
+  const Expr y = src.child_is<Expr>(1);
+  OpStmt2 op = BAD_ST2;
+  if (src.type() == BINARY) {
+    op = to_assign_op(Op2(src.op()));
+  } else if (src.type() == TUPLE) {
+    op = to_assign_op(OpN(src.op()));
+  }
+  if (op == BAD_ST2) {
+    return node;
+  } else if (Const c = y.is<Const>()) {
+    if ((op == ADD_ASSIGN || op == SUB_ASSIGN) && c.val() == Value::one(dst.kind())) {
+      return op == ADD_ASSIGN ? Node{Inc{func, dst}} : Node{Dec{func, dst}};
+    }
+  }
+  return Assign{func, op, dst, y};
+}
+
+Compiler &Compiler::from_ssa() noexcept {
+  if (!*this || !ssa_orig_) {
+    ssa_orig_.clear();
+    return *this;
+  } else if (!flowgraph_.build(node_, error_)) {
+    good_ = false;
+    return *this;
+  }
+  const BasicBlocks bbs = flowgraph_.view();
+  const uint32_t bb_n = uint32_t(bbs.size());
+
+  // replace each (_phi x a_0 ... a_n-1) with (= x t)
+  // and insert (= t a_j) at the end of j-th predecessor.
+  // t is a new version, defined only by such copies: they are harmless
+  // even if a predecessor has multiple successors, no need to split critical edges
+  Array<Node> body, copies;
+  Array<uint32_t> pairs, copy_start, copy_index;
+  bool ok = true;
+  for (uint32_t i = 0; ok && i < bb_n; i++) {
+    const Span<BasicBlock *> prev = bbs[i].prev();
+    for (Node node : bbs[i]) {
+      const Phi phi = node.is<Phi>();
+      if (!phi) {
+        ok = body.append(node);
+        continue;
+      }
+      const Var x = phi.dst();
+      const reg::Reg orig = ssa_orig_[x.id().val() - Id::FIRST];
+      const Var t{*func_, x.kind()};
+      ok = t && ssa_orig_.append(orig) && body.append(Assign{*func_, ASSIGN, x, t});
+      for (uint32_t j = 0; ok && j < prev.size() && j + 1 < phi.children(); j++) {
+        const uint32_t pred = uint32_t(prev[j] - bbs.data());
+        ok = pairs.append(pred) && pairs.append(uint32_t(copies.size())) &&
+             copies.append(Assign{*func_, ASSIGN, t, phi.src(j)});
+      }
+    }
+  }
+  if (!ok || !group_by_key(pairs, bb_n, copy_start, copy_index)) {
+    return out_of_memory(Node{});
+  }
+  Array<Node> out;
+  const Node *first = node_.data();
+  for (uint32_t i = 0; ok && i < bb_n; i++) {
+    const BasicBlock &block = bbs[i];
+    const size_t offset = size_t(block.data() - first), pos = block.insert_pos();
+    for (size_t j = 0; ok && j <= block.size(); j++) {
+      for (uint32_t k = copy_start[i]; ok && j == pos && k < copy_start[i + 1]; k++) {
+        ok = out.append(copies[copy_index[k]]);
+      }
+      ok = ok && (j == block.size() || out.append(body[offset + j]));
+    }
+  }
+  if (!ok) {
+    return out_of_memory(Node{});
+  }
+  node_.swap(out);
+
+  // find original Vars whose versions interfere, i.e. one is defined
+  // while another is live - except for the source of a copy
+  const reg::Reg num_regs = reg::Reg(ssa_orig_.size());
+  BitSet conflict, live;
+  if (!flowgraph_.build(node_, error_)) {
+    good_ = false;
+    return *this;
+  } else if (!liveness_.compute(flowgraph_.view(), num_regs, def_use) ||
+             !conflict.resize(num_regs) || !live.resize(num_regs)) {
+    return out_of_memory(Node{});
+  }
+  const BasicBlocks bbs2 = flowgraph_.view();
+  for (size_t i = bbs2.size(); i != 0; i--) {
+    const BasicBlock &block = bbs2[i - 1];
+    live.copy(liveness_.live_out(i - 1));
+    for (size_t j = block.size(); j != 0; j--) {
+      const Node node = block[j - 1];
+      if (!liveness_.collect(node)) {
+        return out_of_memory(node);
+      }
+      const Var copy_src = node.type() == STMT_2 && node.op() == ASSIGN //
+                               ? node.child_is<Var>(1)
+                               : Var{};
+      for (reg::Reg d : liveness_.def()) {
+        for (size_t r = live.find(true); r != BitSet::NoPos; r = live.find(true, r + 1)) {
+          if (r != d && ssa_orig_[r] == ssa_orig_[d] && copy_src.id().val() != r + Id::FIRST) {
+            conflict.set(ssa_orig_[d], true);
+          }
+        }
+      }
+      liveness_.update(live);
+    }
+  }
+
+  // merge back into the original Var the versions of each original Var without conflicts.
+  // the others remain separate Vars: renumber them after the original Vars
+  Array<Var> map;
+  reg::Reg orig_n = 0;
+  while (orig_n < num_regs && ssa_orig_[orig_n] == orig_n) {
+    orig_n++;
+  }
+  if (!map.resize(num_regs)) {
+    return out_of_memory(Node{});
+  }
+  for (reg::Reg reg = orig_n; reg < num_regs; reg++) {
+    const reg::Reg orig = ssa_orig_[reg];
+    // keep the original Var for now: it will be removed by truncate() below
+    map.set(reg, orig != reg && !conflict[orig] ? func_->vars()[orig] : func_->vars()[reg]);
+  }
+  func_->vars_.truncate(orig_n);
+  for (reg::Reg reg = orig_n; ok && reg < num_regs; reg++) {
+    const reg::Reg orig = ssa_orig_[reg];
+    if (orig == reg || conflict[orig]) {
+      const Var var{*func_, map[reg].kind()};
+      map.set(reg, var);
+      ok = bool(var);
+    }
+  }
+  out.clear();
+  for (size_t i = 0, n = node_.size(); ok && i < n; i++) {
+    const Node node = simplify_copy(*func_, replace_vars(node_[i], map));
+    ok = node == VoidConst || out.append(node);
+  }
+  if (!ok) {
+    return out_of_memory(Node{});
+  }
+  ssa_orig_.clear();
+  node_.swap(out);
+  return *this;
+}
+
+} // namespace onejit
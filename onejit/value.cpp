@@ -422,6 +422,37 @@ Value operator>>(Value a, Value b) noexcept {
   }
 }
 
+// return the high 64 bits of the unsigned 128-bit product a * b
+static uint64_t mulhi_uint64(uint64_t a, uint64_t b) noexcept {
+  const uint64_t a_lo = uint32_t(a), a_hi = a >> 32;
+  const uint64_t b_lo = uint32_t(b), b_hi = b >> 32;
+  const uint64_t lo_lo = a_lo * b_lo;
+  const uint64_t hi_lo = a_hi * b_lo + (lo_lo >> 32);
+  const uint64_t lo_hi = a_lo * b_hi + uint32_t(hi_lo);
+  return a_hi * b_hi + (hi_lo >> 32) + (lo_hi >> 32);
+}
+
+Value mulhi(Value a, Value b) noexcept {
+  Kind kind = a.kind();
+  if (kind != b.kind() || !kind.is_integer()) {
+    return Value{};
+  }
+  const uint32_t bits = uint32_t(kind.bitsize());
+  if (bits < 64) {
+    // the double-width product fits 64 bits
+    if (kind.is(gInt)) {
+      return extend_or_truncate(kind, uint64_t((a.int64() * b.int64()) >> bits));
+    }
+    return extend_or_truncate(kind, (a.uint64() * b.uint64()) >> bits);
+  }
+  uint64_t hi = mulhi_uint64(a.uint64(), b.uint64());
+  if (kind.is(gInt)) {
+    // signed product: subtract the contribution of the sign bits
+    hi -= (a.int64() < 0 ? b.uint64() : 0) + (b.int64() < 0 ? a.uint64() : 0);
+  }
+  return Value{kind, hi};
+}
+
 Value operator==(Value a, Value b) noexcept {
   Kind kind = a.kind();
   bool ret;
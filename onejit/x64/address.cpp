@@ -13,6 +13,8 @@
  *      Author Massimiliano Ghilardi
  */
 
+#include <onejit/func.hpp>
+#include <onejit/ir/binary.hpp>
 #include <onejit/ir/childrange.hpp>
 #include <onejit/ir/const.hpp>
 #include <onejit/ir/label.hpp>
@@ -24,30 +26,54 @@
 namespace onejit {
 namespace x64 {
 
+// if expr is an integer Const, return its value in val and return true
+static bool int_const(Expr expr, int64_t &val) noexcept {
+  const Const c = expr.is<Const>();
+  if (!c || c.kind().is_float()) {
+    return false;
+  }
+  val = c.val().int64();
+  return true;
+}
+
 bool Address::insert(Compiler &comp, Node node) noexcept {
   if (Expr expr = node.is<Expr>()) {
+    int64_t val = 0;
     switch (expr.type()) {
     case VAR:
       break;
+    case BINARY: {
+      // fold (<< x 0...3) into index * scale
+      Binary binary = expr.is<Binary>();
+      if (index || binary.op() != SHL || !int_const(binary.y(), val) || val < 0 || val > 3) {
+        break;
+      }
+      index = comp.to_var(binary.x());
+      scale = Scale(uint8_t(1 << val));
+      return bool(index);
+    }
     case TUPLE: {
       Tuple tuple = expr.is<Tuple>();
-      if (index || tuple.op() != MUL || tuple.children() != 2) {
+      if (tuple.op() == ADD && !tuple.kind().is_float()) {
+        // fold nested sums
+        return insert(comp, ChildRange{tuple});
+      } else if (index || tuple.op() != MUL || tuple.children() != 2 ||
+                 !int_const(tuple.arg(1), val)) {
         break;
       }
       Expr x = tuple.arg(0);
-      Value y = tuple.arg(1).is<Const>().val();
-      if (!x || !y.is_valid() || y.kind().is_float()) {
-        break;
-      }
-      Var my_index = comp.to_var(x);
-      int64_t int_scale = y.int64();
       Scale my_scale;
-      // yval must be a power of two between 1 and 8
-      if (my_index && int_scale >= 0 && int_scale <= 0xff &&
-          (my_scale = Scale(uint8_t(int_scale)))) {
-        index = my_index;
+      if (!base && (val == 3 || val == 5 || val == 9)) {
+        // x * 3 = x + x * 2 and similarly for 5 and 9
+        base = index = comp.to_var(x);
+        scale = Scale(uint8_t(val - 1));
+        return bool(index);
+      }
+      // val must be a power of two between 1 and 8
+      if (x && val >= 0 && val <= 0xff && (my_scale = Scale(uint8_t(val)))) {
+        index = comp.to_var(x);
         scale = my_scale;
-        return true;
+        return bool(index);
       }
       break;
     }
@@ -58,10 +84,10 @@ bool Address::insert(Compiler &comp, Node node) noexcept {
       }
       break;
     case CONST:
-      if (offset == 0 && !expr.kind().is_float()) {
-        int64_t delta = expr.is<Const>().val().int64();
-        if (delta == int64_t(int32_t(delta))) {
-          offset = int32_t(delta);
+      if (int_const(expr, val)) {
+        const int64_t sum = offset + val;
+        if (sum == int64_t(int32_t(sum))) {
+          offset = int32_t(sum);
           return true;
         }
       }
@@ -73,11 +99,15 @@ bool Address::insert(Compiler &comp, Node node) noexcept {
     // fallback
     if (!base) {
       base = comp.to_var(expr);
-      return true;
+      return bool(base);
     } else if (!index) {
       index = comp.to_var(expr);
       scale = Scale1;
-      return true;
+      return bool(index);
+    } else if (Func *func = comp.func()) {
+      // both registers are in use: add expr to base
+      base = comp.to_var(Tuple{*func, ADD, base, expr});
+      return bool(base);
     }
   }
   return false;
@@ -39,6 +39,9 @@ static const Inst1 inst1_vec[] = {
     Inst1{"\xff\x10", "", "\xe8", Arg1::Reg | Arg1::Mem | Arg1::Val, B64, B32}, /*      call    */
     Inst1{"", "", "", Arg1::Rax, B16 | B32 | B64},                              /* TODO cbw     */
     Inst1{"\xfe\x08", "", "", Arg1::Reg | Arg1::Mem, B8 | B16 | B32 | B64, B0, EFwrite}, /* dec */
+    Inst1{"\xf6\x30", "", "", Arg1::Reg | Arg1::Mem, B8 | B16 | B32 | B64, B0, EFwrite}, /* div */
+    Inst1{"\xf6\x38", "", "", Arg1::Reg | Arg1::Mem, B8 | B16 | B32 | B64, B0, EFwrite}, /* idiv */
+    Inst1{"\xf6\x28", "", "", Arg1::Reg | Arg1::Mem, B8 | B16 | B32 | B64, B0, EFwrite}, /* imul1 */
     Inst1{"\xfe\x00", "", "", Arg1::Reg | Arg1::Mem, B8 | B16 | B32 | B64, B0, EFwrite}, /* inc */
     Inst1{"", "\xcd", "", Arg1::Val, B0, B8},                                        /* int     */
     /* ---------------------------------------------------------------------------*/ /*-------- */
@@ -62,6 +65,7 @@ static const Inst1 inst1_vec[] = {
     /* ---------------------------------------------------------------------------*/ /*-------- */
     /*     reg/mem     imm8    imm32                                              */ /*-------- */
     Inst1{"\xff\x20", "\xeb", "\xe9", Arg1::Reg | Arg1::Mem | Arg1::Val, B64, B8 | B32}, /* jmp */
+    Inst1{"\xf6\x20", "", "", Arg1::Reg | Arg1::Mem, B8 | B16 | B32 | B64, B0, EFwrite}, /* mul */
     Inst1{"\xf6\x18", "", "", Arg1::Reg | Arg1::Mem, B8 | B16 | B32 | B64, B0, EFwrite}, /* neg */
     Inst1{"\xf6\x10", "", "", Arg1::Reg | Arg1::Mem, B8 | B16 | B32 | B64, B0, EFwrite}, /* not */
     /* ---------------------------------------------------------------------------*/ /*-------- */
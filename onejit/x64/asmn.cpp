@@ -17,6 +17,10 @@
 #include <onejit/ir/stmtn.hpp>
 #include <onejit/x64/asm.hpp>
 #include <onejit/x64/inst.hpp>
+#include <onejit/x64/mem.hpp>
+#include <onejit/x64/reg.hpp>
+#include <onejit/x64/rex_byte.hpp>
+#include <onejit/x64/util.hpp>
 
 namespace onejit {
 namespace x64 {
@@ -40,7 +44,56 @@ Assembler &AsmN::emit(Assembler &dst, const InstN &inst) noexcept {
   return dst.add(inst.bytes());
 }
 
+// emit (_jump_table (x86_mem_q table base index 8) label_0 ... label_n-1)
+// as jmp *(base + index*8) followed by the table of label absolute addresses.
+// base must already contain the address of table
+static Assembler &asmn_emit_jump_table(Assembler &dst, const StmtN &st) noexcept {
+  const Mem mem = st.child_is<Mem>(0);
+  if (!mem || !mem.label()) {
+    return dst.error(st, "x64::AsmN::emit: jump table expects x86_64 memory address with label");
+  } else if (!Util::validate_mem(dst, mem)) {
+    return dst;
+  }
+  Reg base{mem.base()};
+  Reg index{mem.index()};
+  Scale scale = mem.scale();
+  if (!base || base.reg_id() == RIP) {
+    return dst.error(st, "x64::AsmN::emit: jump table expects base register with table address");
+  } else if (scale == Scale0 || !index) {
+    index = Reg{};
+    scale = Scale0;
+  }
+  const int32_t offset = mem.offset();
+  size_t offset_bytes = 0;
+  if (offset != int32_t(int8_t(offset))) {
+    offset_bytes = 4;
+  } else if (offset != 0 || rlo(base) == 5) {
+    // %rbp and %r13 as base always need an offset
+    offset_bytes = 1;
+  }
+  uint8_t buf[16] = {};
+  size_t len = 0;
+  // indirect jmp has 64-bit default size: REX byte is only needed for %r8 ... %r15
+  if ((buf[len] = rex_byte_default64(Bits64, base, index)) != 0) {
+    len++;
+  }
+  buf[len++] = 0xff;
+  buf[len] = 0x20; // ModRM.reg = 4 i.e. jmp r/m64
+  len = Util::insert_modrm_sib(buf, len, offset_bytes, base, index, scale);
+  len = Util::insert_offset_or_imm(buf, len, offset_bytes, offset);
+  dst.add(buf, len).add_label(mem.label());
+
+  const uint8_t zero[8] = {};
+  for (uint32_t i = 1, n = st.children(); i < n; i++) {
+    dst.add(zero, sizeof(zero)).add_relocation(st.child_is<Label>(i), sizeof(zero));
+  }
+  return dst;
+}
+
 Assembler &AsmN::emit(Assembler &dst, const StmtN &st) noexcept {
+  if (st.op() == JUMP_TABLE_) {
+    return asmn_emit_jump_table(dst, st);
+  }
   return emit(dst, find(st.op()));
 }
 
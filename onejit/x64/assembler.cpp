@@ -14,6 +14,7 @@
  */
 
 #include <onejit/assembler.hpp>
+#include <onejit/ir/label.hpp>
 #include <onejit/ir/stmt0.hpp>
 #include <onejit/ir/stmt1.hpp>
 #include <onejit/ir/stmt2.hpp>
@@ -36,8 +37,10 @@ Assembler &Assembler::x64(const Node &node) noexcept {
     return onejit::x64::Asm3::emit(*this, node.is<Stmt3>());
   case STMT_N:
     return onejit::x64::AsmN::emit(*this, node.is<StmtN>());
+  case LABEL:
+    return add_label(node.is<Label>());
   default:
-    return error(node, "unexpected node type in Assembler::x64, expecting Stmt[0123N]");
+    return error(node, "unexpected node type in Assembler::x64, expecting Label or Stmt[0123N]");
   }
 }
 
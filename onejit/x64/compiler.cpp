@@ -16,8 +16,13 @@
 #include <onejit/compiler.hpp>
 #include <onejit/func.hpp>
 #include <onejit/ir.hpp>
+#include <onejit/reg/allocator.hpp>
+#include <onejit/x64/address.hpp>
 #include <onejit/x64/compiler.hpp>
 #include <onejit/x64/mem.hpp>
+#include <onejit/x64/reg.hpp>
+#include <onejit/x64/regid.hpp>
+#include <onejit/x64/util.hpp>
 
 namespace onejit {
 
@@ -25,7 +30,7 @@ Compiler &Compiler::compile_x64(Func &func, Opt flags) noexcept {
   compile(func, flags);
   if (*this && error_.empty()) {
     // pass our internal buffers node_ and error_ to x64::Compiler
-    onejit::x64::Compiler{}.compile(func, allocator_, node_, flowgraph_, error_, //
+    onejit::x64::Compiler{}.compile(func, allocator_, liveness_, node_, flowgraph_, error_, //
                                     flags, abi_autodetect(abi_));
   }
   return *this;
@@ -39,9 +44,9 @@ Compiler::operator bool() const noexcept {
   return good_ && func_ && *func_;
 }
 
-Compiler &Compiler::compile(Func &func, reg::Allocator &allocator, Array<Node> &node_vec,
-                            FlowGraph &flowgraph, Array<Error> &error_vec, Opt flags,
-                            Abi abi) noexcept {
+Compiler &Compiler::compile(Func &func, reg::Allocator &allocator, reg::Liveness &liveness,
+                            Array<Node> &node_vec, FlowGraph &flowgraph, Array<Error> &error_vec,
+                            Opt flags, Abi abi) noexcept {
   if (func.get_compiled(X64)) {
     // already compiled for x86_64
     return *this;
@@ -55,46 +60,694 @@ Compiler &Compiler::compile(Func &func, reg::Allocator &allocator, Array<Node> &
   node_vec.clear();
   func_ = &func;
   allocator_ = &allocator;
+  liveness_ = &liveness;
   node_ = &node_vec;
   flowgraph_ = &flowgraph;
   error_ = &error_vec;
   flags_ = flags;
+  if ((abi & ~Abi(0xf)) != Abi_x64_auto) {
+    // not an x86_64 ABI: autodetect it
+    abi = Abi_x64_auto;
+  }
+  abi_ = abi_autodetect(abi);
   good_ = bool(func);
 
-  return compile(node).allocate_regs(abi).finish();
+  return compile(node).allocate_regs().finish();
+}
+
+// register classes: each one is colored independently
+enum : reg::RegClass {
+  GprClass = 0, // general registers
+  XmmClass = 1, // SSE registers, used by floating point and SIMD Vars
+  RegClassN = 2,
+};
+
+// x86_64 has 16 general registers, we reserve RSP and R11.
+// it also has 16 SSE registers XMM0..XMM15, we reserve one of them.
+// R11 and the reserved SSE register are the scratch registers used by spill_regs():
+// they are caller-saved in all supported ABIs, thus they never need to be preserved.
+// XMM16..XMM31 require [CPUID AVX512F] thus they are not used yet
+enum : reg::Color { num_gpr_colors = 14, num_xmm_colors = 15 };
+
+// number of colors of each register class
+static const reg::Color num_colors[RegClassN] = {num_gpr_colors, num_xmm_colors};
+
+// general register represented by each color < num_gpr_colors.
+// caller-saved registers come first, thus they are preferred
+static const RegId color_gpr[num_gpr_colors] = {
+    RAX, RCX, RDX, RSI, RDI, R8, R9, R10, RBX, RBP, R12, R13, R14, R15,
+};
+
+// return the SSE scratch register of abi:
+// XMM15 is callee-saved on Windows, where XMM5 is the last caller-saved SSE register
+static constexpr RegId xmm_scratch(Abi abi) noexcept {
+  return abi == Abi_x64_windows ? XMM5 : XMM15;
+}
+
+// return the color representing general register id, or NoColor if not allocatable
+static reg::Color gpr_color(RegId id) noexcept {
+  for (reg::Color color = 0; color < num_gpr_colors; color++) {
+    if (color_gpr[color] == id) {
+      return color;
+    }
+  }
+  return reg::NoColor;
 }
 
-Compiler &Compiler::allocate_regs(Abi abi) noexcept {
+// return the color representing SSE register id, or NoColor if id is the scratch register.
+// colors skip the scratch register
+static constexpr reg::Color xmm_color(RegId id, RegId scratch) noexcept {
+  return id == scratch ? reg::Color(reg::NoColor)
+                       : reg::Color(uint32_t(id) - uint32_t(XMM0) - uint32_t(id > scratch));
+}
+
+// return the register class of Vars with specified kind
+static constexpr reg::RegClass reg_class(Kind kind) noexcept {
+  return kind.is_float() || kind.simdn().val() > 1 ? XmmClass : GprClass;
+}
+
+RegId Compiler::color_reg(reg::RegClass cls, reg::Color color) const noexcept {
+  if (cls == GprClass) {
+    return color < num_gpr_colors ? color_gpr[color] : RegId(0);
+  } else if (color >= num_xmm_colors) {
+    return RegId(0);
+  }
+  const RegId scratch = xmm_scratch(abi_);
+  const RegId id = XMM0 + int(color);
+  return id >= scratch ? id + 1 : id;
+}
+
+Var Compiler::scratch_reg(Kind kind) const noexcept {
+  // same register class as the Vars it replaces: SIMD integers also live in SSE registers
+  return Var{Reg{kind, reg_class(kind) == XmmClass ? xmm_scratch(abi_) : R11}};
+}
+
+Compiler &Compiler::allocate_regs() noexcept {
+  split_live_ranges();
   Vars vars = func_->vars();
-  if (allocator_->reset(vars.size())) {
-    fill_interference_graph();
-    set_reg_hints(abi);
-    // x86_64 has 16 general registers, we reserve RSP and RBX
-    allocator_->allocate_regs(14);
+  const View<reg::Color> colors{num_colors, RegClassN};
+  Array<Node> remat;
+  if (!(flags_ & OptGraphColoring)) {
+    if (allocator_->reset(vars.size(), false) && compute_liveness() &&
+        liveness_->compute_intervals(flowgraph_->view())) {
+      set_reg_classes().find_remat(remat).mark_call_crossing().mark_fixed_clobbered();
+      set_clobbered().set_reg_hints().set_spill_costs();
+      allocator_->allocate_regs(liveness_->intervals(), colors);
+    }
+  } else if (allocator_->reset(vars.size())) {
+    set_reg_classes().find_remat(remat).fill_interference_graph();
+    mark_call_crossing().mark_fixed_clobbered();
+    set_clobbered().set_reg_hints().set_spill_costs();
+    if (!allocator_->allocate_regs(colors)) {
+      out_of_memory(Node{});
+    }
+  }
+  return remove_redundant_moves().spill_regs(colors, remat);
+}
+
+Compiler &Compiler::set_reg_classes() noexcept {
+  for (const Var &var : func_->vars()) {
+    const uint32_t id = var.id().val();
+    const reg::RegClass cls = reg_class(var.kind());
+    if (cls != GprClass && id >= Id::FIRST && id - Id::FIRST < allocator_->size()) {
+      allocator_->set_class(id - Id::FIRST, cls);
+    }
   }
   return *this;
 }
 
-Compiler &Compiler::fill_interference_graph() noexcept {
+// if node defines a register with a value that can be recomputed anywhere,
+// i.e. a constant or a label address, return such register. otherwise return NoReg
+static reg::Reg remat_reg(Node node) noexcept {
+  if (node.type() != STMT_2 || (node.op() != X86_MOV && node.op() != X86_LEA)) {
+    return reg::NoReg;
+  }
+  const Var dst = node.child_is<Var>(0);
+  const Node src = node.child(1);
+  const uint32_t id = dst.id().val();
+  if (!dst || id < Id::FIRST || reg_class(dst.kind()) != GprClass) {
+    return reg::NoReg;
+  }
+  bool ok = false;
+  if (node.op() == X86_MOV) {
+    ok = src.type() == LABEL || (src.type() == CONST && !src.kind().is_float());
+  } else if (Mem mem = src.is<Mem>()) {
+    ok = !mem.child_is<Var>(2) && !mem.child_is<Var>(3);
+  }
+  return ok ? reg::Reg(id - Id::FIRST) : reg::NoReg;
+}
+
+Compiler &Compiler::find_remat(Array<Node> &remat) noexcept {
+  const size_t n = allocator_->size();
+  if (!*this || !remat.resize(n)) {
+    return out_of_memory(Node{});
+  }
+  // count the definitions of each register: rematerializable ones must have exactly one
+  Array<uint8_t> ndef;
+  Array<reg::Reg> def, use;
+  if (!ndef.resize(n)) {
+    return out_of_memory(Node{});
+  }
+  for (Node node : *node_) {
+    def.clear();
+    use.clear();
+    if (!def_use(node, def, use)) {
+      return out_of_memory(node);
+    }
+    for (reg::Reg reg : def) {
+      if (reg < n && ndef[reg] < 2) {
+        ndef.set(reg, ndef[reg] + 1);
+      }
+    }
+    const reg::Reg reg = remat_reg(node);
+    if (reg < n) {
+      remat.set(reg, node);
+    }
+  }
+  for (reg::Reg reg = 0; reg < n; reg++) {
+    if (ndef[reg] == 1 && remat[reg]) {
+      allocator_->add_remat(reg);
+    } else {
+      remat.set(reg, Node{});
+    }
+  }
+  return *this;
+}
+
+enum : uint32_t {
+  max_loop_depth = 8, // deeper loops have the same spill cost weight
+};
+
+Compiler &Compiler::set_spill_costs() noexcept {
+  if (!*this) {
+    return *this;
+  }
+  Array<uint32_t> depth;
+  Array<reg::Reg> def, use;
+  if (!flowgraph_->loop_depth(depth)) {
+    return out_of_memory(Node{});
+  }
+  BasicBlocks bbs = flowgraph_->view();
+  const size_t n = allocator_->size();
+  Array<uint32_t> cost;
+  if (!cost.resize(n)) {
+    return out_of_memory(Node{});
+  }
+  for (size_t i = 0; i < bbs.size(); i++) {
+    const uint32_t weight = uint32_t(1)
+                            << (3 * (depth[i] < max_loop_depth ? depth[i] : max_loop_depth));
+    for (Node node : bbs[i]) {
+      def.clear();
+      use.clear();
+      if (!def_use(node, def, use)) {
+        return out_of_memory(node);
+      }
+      for (View<reg::Reg> regs : {View<reg::Reg>{def}, View<reg::Reg>{use}}) {
+        for (reg::Reg reg : regs) {
+          // saturate instead of overflowing
+          if (reg < n && cost[reg] <= ~weight) {
+            cost.set(reg, cost[reg] + weight);
+          }
+        }
+      }
+    }
+  }
+  for (reg::Reg reg = 0; reg < n; reg++) {
+    allocator_->set_spill_cost(reg, cost[reg]);
+  }
+  return *this;
+}
+
+// if node copies a register to another register, return them in move and return true.
+// copies from or to a view of a register with a different Kind, as 32-bit writes
+// that zero-extend a 64-bit register, are not moves: they must not be removed
+static bool is_move(Node node, Vars vars, reg::Move &move) noexcept {
+  const OpStmt2 op = OpStmt2(node.op());
+  if (node.type() != STMT_2 ||
+      (op != X86_MOV && op != X86_MOVSD && op != X86_MOVSS && op != X86_MOVDQU &&
+       op != ASSIGN)) {
+    return false;
+  }
+  Var dst = node.child_is<Var>(0), src = node.child_is<Var>(1);
+  if (!dst || !src || dst.kind() != src.kind()) {
+    return false;
+  }
+  const uint32_t dst_id = dst.id().val(), src_id = src.id().val();
+  if (dst_id < Id::FIRST || src_id < Id::FIRST) {
+    // physical registers
+    return false;
+  }
+  move = reg::Move{dst_id - Id::FIRST, src_id - Id::FIRST};
+  return move.dst < vars.size() && move.src < vars.size() && vars[move.dst].kind() == dst.kind() &&
+         vars[move.src].kind() == src.kind();
+}
+
+Compiler &Compiler::remove_redundant_moves() noexcept {
+  if (!*this) {
+    return *this;
+  }
+  View<reg::Color> colors = allocator_->get_colors();
+  const Vars vars = func_->vars();
+  Array<Node> &nodes = *node_;
+  size_t out = 0;
+  for (size_t i = 0, n = nodes.size(); i < n; i++) {
+    Node node = nodes[i];
+    reg::Move move;
+    if (is_move(node, vars, move) && move.dst < colors.size() && move.src < colors.size()) {
+      const reg::Color color = colors[move.dst];
+      if (color != reg::NoColor && color == colors[move.src] &&
+          !allocator_->is_remat(move.src)) {
+        // copy between two Vars assigned to the same register or stack slot.
+        // keep copies from rematerializable Vars: if spilled, they have no stack slot
+        continue;
+      }
+    }
+    nodes.set(out++, node);
+  }
+  if (out != nodes.size()) {
+    nodes.truncate(out);
+    // basic blocks point into nodes, rebuild them
+    good_ = good_ && flowgraph_->build(nodes, *error_);
+  }
+  return *this;
+}
+
+bool Compiler::compute_liveness() noexcept {
   if (!flowgraph_->build(*node_, *error_)) {
     good_ = false;
+  } else if (!liveness_->compute(flowgraph_->view(), allocator_->size(), def_use)) {
+    out_of_memory(Node{});
+  }
+  return good_;
+}
+
+Compiler &Compiler::fill_interference_graph() noexcept {
+  if (!compute_liveness()) {
     return *this;
   }
+  BasicBlocks bbs = flowgraph_->view();
+  reg::Liveness &liveness = *liveness_;
+  Graph &g = allocator_->graph();
   BitSet &live = allocator_->get_bitset();
-  live.fill(false);
-  // TODO propagate liveness analysis across jumps
-  for (size_t i = node_->size(); i > 0; i--) {
-    Node node = (*node_)[i - 1];
-    update_live_regs(live, node);
+  for (size_t i = bbs.size(); i != 0; i--) {
+    const BasicBlock &bb = bbs[i - 1];
+    live.copy(liveness.live_out(i - 1));
+    for (size_t j = bb.size(); j != 0; j--) {
+      if (!liveness.collect(bb[j - 1])) {
+        out_of_memory(bb[j - 1]);
+        return *this;
+      }
+      reg::Move move;
+      if (is_move(bb[j - 1], func_->vars(), move)) {
+        // dst and src of a move do not interfere, unless dst is redefined later
+        live.set(move.src, false);
+        if (!allocator_->add_move(move.dst, move.src)) {
+          out_of_memory(bb[j - 1]);
+          return *this;
+        }
+      }
+      View<reg::Reg> def = liveness.def();
+      for (size_t k = 0, n = def.size(); k < n; k++) {
+        const reg::Reg reg = def[k];
+        const reg::RegClass cls = allocator_->get_class(reg);
+        // registers defined by the same node, as _set params, interfere with each other
+        for (size_t h = k + 1; h < n; h++) {
+          if (allocator_->get_class(def[h]) == cls && !g.set(reg, def[h], true)) {
+            out_of_memory(bb[j - 1]);
+            return *this;
+          }
+        }
+        for (size_t other = live.find(true); other != BitSet::NoPos;
+             other = live.find(true, other + 1)) {
+          // registers of different classes do not interfere
+          if (other != reg && allocator_->get_class(reg::Reg(other)) == cls &&
+              !g.set(reg, reg::Reg(other), true)) {
+            out_of_memory(bb[j - 1]);
+            return *this;
+          }
+        }
+      }
+      liveness.update(live);
+    }
+  }
+  return *this;
+}
+
+// return true if the first argument of Stmt1 op is both used and defined
+static bool is_use_def(OpStmt1 op) noexcept {
+  switch (op) {
+  case INC:
+  case DEC:
+  case X86_BSWAP:
+  case X86_DEC:
+  case X86_INC:
+  case X86_NEG:
+  case X86_NOT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// return true if the first argument of Stmt1 op is only defined
+static bool is_def(OpStmt1 op) noexcept {
+  return op == X86_POP || (op >= X86_SETA && op <= X86_SETS);
+}
+
+// return true if the first argument of Stmt2 op is only defined
+static bool is_def(OpStmt2 op) noexcept {
+  switch (op) {
+  case ASSIGN:
+  case X86_BSF:
+  case X86_BSR:
+  case X86_LEA:
+  case X86_LZCNT:
+  case X86_MOV:
+  case X86_MOVD:
+  case X86_MOVQ:
+  case X86_MOVSD:
+  case X86_MOVSS:
+  case X86_MOVSX:
+  case X86_MOVZX:
+  case X86_POPCNT:
+    return true;
+  default:
+    return op >= X86_CVTSD2SI && op <= X86_CVTTSS2SI;
+  }
+}
+
+// return true if the first argument of Stmt2 op is only used
+static bool is_use(OpStmt2 op) noexcept {
+  switch (op) {
+  case CASE:
+  case DEFAULT:
+  case JUMP_IF:
+  case ASM_CMP:
+  case X86_BT:
+  case X86_CMP:
+  case X86_TEST:
+  case X86_UCOMISD:
+  case X86_UCOMISS:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool Compiler::def_use(Node node, Array<reg::Reg> &def, Array<reg::Reg> &use) noexcept {
+  const uint16_t op = node.op();
+  switch (node.type()) {
+  case STMT_1:
+    if (is_use_def(OpStmt1(op)) || is_def(OpStmt1(op))) {
+      return reg::add_dst(node.child(0), def, use, is_use_def(OpStmt1(op)));
+    }
+    break;
+  case STMT_2:
+    if (!is_use(OpStmt2(op))) {
+      return reg::add_dst(node.child(0), def, use, !is_def(OpStmt2(op))) &&
+             reg::add_uses(node.child(1), use);
+    }
+    break;
+  case STMT_3:
+    if (op == X86_IMUL3) {
+      return reg::add_dst(node.child(0), def, use, false) && reg::add_uses(node.child(1), use) &&
+             reg::add_uses(node.child(2), use);
+    }
+    break;
+  case STMT_N:
+    if (op == SET_) {
+      // all arguments are defined
+      for (uint32_t i = 0, n = node.children(); i < n; i++) {
+        if (!reg::add_dst(node.child(i), def, use, false)) {
+          return false;
+        }
+      }
+      return true;
+    } else if (op == ASSIGN_CALL) {
+      // arguments are: results to set, call
+      const uint32_t n = node.children();
+      for (uint32_t i = 0; i + 1 < n; i++) {
+        if (!reg::add_dst(node.child(i), def, use, false)) {
+          return false;
+        }
+      }
+      return n == 0 || reg::add_uses(node.child(n - 1), use);
+    } else if (op == X86_CALL_) {
+      // arguments are: function address, (_set results), params
+      bool ok = true;
+      for (uint32_t i = 0, n = node.children(); ok && i < n; i++) {
+        Node child = node.child(i);
+        ok = child.type() == STMT_N && child.op() == SET_ ? def_use(child, def, use)
+                                                          : reg::add_uses(child, use);
+      }
+      return ok;
+    }
+    break;
+  default:
+    break;
+  }
+  return reg::add_uses(node, use);
+}
+
+// general and SSE registers used to pass params or results
+struct AbiRegs {
+  const RegId *gpr;
+  const RegId *xmm;
+  uint8_t gpr_n;
+  uint8_t xmm_n;
+  bool positional; // if true, i-th param uses i-th register of either gpr or xmm
+};
+
+static const RegId sysv_param_gpr[] = {RDI, RSI, RDX, RCX, R8, R9};
+static const RegId sysv_param_xmm[] = {XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7};
+static const RegId sysv_result_gpr[] = {RAX, RDX};
+static const RegId sysv_result_xmm[] = {XMM0, XMM1};
+static const RegId windows_param_gpr[] = {RCX, RDX, R8, R9};
+
+// add hints to assign each Var to the register where abi_regs passes it
+static void add_reg_hints(reg::Allocator &allocator, Vars vars, const AbiRegs &abi_regs,
+                          RegId scratch) noexcept {
+  uint8_t gpr_i = 0, xmm_i = 0;
+  for (size_t i = 0, n = vars.size(); i < n; i++) {
+    const Var var = vars[i];
+    const uint32_t id = var.id().val();
+    // SIMD integers are passed in SSE registers too
+    const bool is_xmm = reg_class(var.kind()) == XmmClass;
+    reg::Color color = reg::NoColor;
+    if (is_xmm) {
+      if (xmm_i < abi_regs.xmm_n) {
+        color = xmm_color(abi_regs.xmm[xmm_i], scratch);
+      }
+    } else if (gpr_i < abi_regs.gpr_n) {
+      color = gpr_color(abi_regs.gpr[gpr_i]);
+    }
+    if (abi_regs.positional || is_xmm) {
+      xmm_i++;
+    }
+    if (abi_regs.positional || !is_xmm) {
+      gpr_i++;
+    }
+    if (color != reg::NoColor && id >= Id::FIRST && id - Id::FIRST < allocator.size()) {
+      allocator.add_hint(id - Id::FIRST, color);
+    }
+  }
+}
+
+// registers preserved across function calls, i.e. callee-saved
+static const RegId sysv_callee_saved[] = {RBX, RBP, R12, R13, R14, R15};
+static const RegId windows_callee_saved[] = {
+    RBX,  RBP,  RDI,  RSI,  R12,   R13,   R14,   R15,   //
+    XMM6, XMM7, XMM8, XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15,
+};
+
+// return true if id is present in regs
+static bool contains(View<RegId> regs, RegId id) noexcept {
+  for (RegId reg : regs) {
+    if (reg == id) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// return the registers preserved across function calls by abi
+static View<RegId> callee_saved_regs(Abi abi) noexcept {
+  switch (abi) {
+  case Abi_x64_sysv:
+    return View<RegId>{sysv_callee_saved, sizeof(sysv_callee_saved) / sizeof(RegId)};
+  case Abi_x64_windows:
+    return View<RegId>{windows_callee_saved, sizeof(windows_callee_saved) / sizeof(RegId)};
+  default:
+    // Abi_x64_go1 does not preserve any register across calls
+    return View<RegId>{};
+  }
+}
+
+Compiler &Compiler::find_callee_saved(Array<RegId> &saved) noexcept {
+  // bit i is set if register RAX + i was assigned to some Var
+  uint64_t used = 0;
+  View<reg::Color> colors = allocator_->get_colors();
+  for (reg::Reg reg = 0, n = reg::Reg(colors.size()); reg < n; reg++) {
+    const reg::RegClass cls = allocator_->get_class(reg);
+    const reg::Color color = colors[reg];
+    if (cls < RegClassN && color < num_colors[cls]) {
+      used |= uint64_t(1) << (uint32_t(color_reg(cls, color)) - uint32_t(RAX));
+    }
+  }
+  for (RegId id : callee_saved_regs(abi_)) {
+    if ((used >> (uint32_t(id) - uint32_t(RAX)) & 1) && !saved.append(id)) {
+      out_of_memory(Node{});
+      break;
+    }
+  }
+  return *this;
+}
+
+Compiler &Compiler::set_clobbered() noexcept {
+  const View<RegId> callee_saved = callee_saved_regs(abi_);
+  Array<reg::Color> gpr, xmm;
+  bool ok = true;
+  for (reg::Color color = 0; ok && color < num_gpr_colors; color++) {
+    ok = contains(callee_saved, color_gpr[color]) || gpr.append(color);
+  }
+  for (reg::Color color = 0; ok && color < num_xmm_colors; color++) {
+    ok = contains(callee_saved, color_reg(XmmClass, color)) || xmm.append(color);
+  }
+  if (!ok || !allocator_->set_clobbered(GprClass, gpr) ||
+      !allocator_->set_clobbered(XmmClass, xmm)) {
+    out_of_memory(Node{});
   }
   return *this;
 }
 
-void Compiler::update_live_regs(BitSet & /*live*/, Node /*node*/) noexcept {
+// return the color of node as a bitmask, if node is one of the fixed registers %rax %rcx %rdx
+static uint64_t fixed_color(Node node) noexcept {
+  const Var var = node.is<Var>();
+  const RegId id = RegId(var.id().val());
+  if (!var || (id != RAX && id != RCX && id != RDX)) {
+    return 0;
+  }
+  return uint64_t(1) << gpr_color(id);
+}
+
+// return the fixed registers found inside node, as a bitmask of colors
+static uint64_t fixed_uses(Node node) noexcept {
+  uint64_t use = fixed_color(node);
+  for (uint32_t i = 0, n = node.children(); i < n; i++) {
+    use |= fixed_uses(node.child(i));
+  }
+  return use;
+}
+
+// set def and use to the fixed registers written and read by node, as bitmasks of colors
+static void fixed_def_use(Node node, uint64_t &def, uint64_t &use) noexcept {
+  const uint64_t rax = uint64_t(1) << gpr_color(RAX), rdx = uint64_t(1) << gpr_color(RDX);
+  uint32_t i = 0;
+  def = use = 0;
+  if (node.type() == STMT_1) {
+    switch (OpStmt1(node.op())) {
+    case X86_IMUL1:
+    case X86_MUL:
+      // write %rdx:%rax = %rax * arg
+      def = rax | rdx;
+      use = rax;
+      break;
+    case X86_DIV:
+    case X86_IDIV:
+      // write %rax = %rdx:%rax / arg and %rdx = %rdx:%rax % arg
+      def = use = rax | rdx;
+      break;
+    default:
+      break;
+    }
+  } else if (node.type() == STMT_2 && (def = fixed_color(node.child(0))) != 0) {
+    i = 1;
+    // XOR of a register with itself does not read it
+    if (node.op() != X86_MOV && (node.op() != X86_XOR || node.child(0) != node.child(1))) {
+      use = def;
+    }
+  }
+  for (uint32_t n = node.children(); i < n; i++) {
+    use |= fixed_uses(node.child(i));
+  }
+}
+
+static bool has_fixed_regs(View<Node> nodes) noexcept {
+  uint64_t def, use;
+  for (Node node : nodes) {
+    fixed_def_use(node, def, use);
+    if (def != 0 || use != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Compiler &Compiler::mark_fixed_clobbered() noexcept {
+  if (!*this || !has_fixed_regs(*node_)) {
+    return *this;
+  }
+  Array<uint64_t> clobbered;
+  if (!clobbered.resize(allocator_->size())) {
+    return out_of_memory(Node{});
+  }
+  BasicBlocks bbs = flowgraph_->view();
+  reg::Liveness &liveness = *liveness_;
+  BitSet &live = allocator_->get_bitset();
+  for (size_t i = bbs.size(); i != 0; i--) {
+    const BasicBlock &bb = bbs[i - 1];
+    live.copy(liveness.live_out(i - 1));
+    // fixed registers holding a value after current node, as a bitmask of colors
+    uint64_t fixed = 0;
+    for (size_t j = bb.size(); j != 0; j--) {
+      const Node node = bb[j - 1];
+      uint64_t def, use;
+      fixed_def_use(node, def, use);
+      if (!liveness.collect(node)) {
+        return out_of_memory(node);
+      }
+      // registers live after node must not be allocated to the fixed registers it writes,
+      // and registers written by node must not be allocated to fixed registers still needed
+      if (const uint64_t mask = fixed | def) {
+        for (size_t reg = live.find(true); reg != BitSet::NoPos; reg = live.find(true, reg + 1)) {
+          clobbered.set(reg, clobbered[reg] | mask);
+        }
+      }
+      for (reg::Reg reg : liveness.def()) {
+        clobbered.set(reg, clobbered[reg] | fixed);
+      }
+      liveness.update(live);
+      fixed = (fixed & ~def) | use;
+    }
+  }
+  for (reg::Reg reg = 0, n = reg::Reg(clobbered.size()); reg < n; reg++) {
+    const uint64_t mask = allocator_->get_class(reg) == GprClass ? clobbered[reg] : 0;
+    for (reg::Color color = 0; (mask >> color) != 0; color++) {
+      if ((mask >> color & 1) && !allocator_->add_clobbered(reg, color)) {
+        return out_of_memory(Node{});
+      }
+    }
+  }
+  return *this;
 }
 
-Compiler &Compiler::set_reg_hints(Abi abi) noexcept {
-  (void)abi; // TODO implement
+Compiler &Compiler::set_reg_hints() noexcept {
+  AbiRegs params, results;
+  switch (abi_) {
+  case Abi_x64_sysv:
+    params = AbiRegs{sysv_param_gpr, sysv_param_xmm, 6, 8, false};
+    results = AbiRegs{sysv_result_gpr, sysv_result_xmm, 2, 2, false};
+    break;
+  case Abi_x64_windows:
+    params = AbiRegs{windows_param_gpr, sysv_param_xmm, 4, 4, true};
+    results = AbiRegs{sysv_result_gpr, sysv_result_xmm, 1, 1, false};
+    break;
+  default:
+    // Abi_x64_go1 passes all params and results on stack
+    return *this;
+  }
+  add_reg_hints(*allocator_, func_->params(), params, xmm_scratch(abi_));
+  add_reg_hints(*allocator_, func_->results(), results, xmm_scratch(abi_));
   return *this;
 }
 
@@ -169,7 +822,16 @@ Expr Compiler::simplify(Expr expr) noexcept {
 }
 
 Expr Compiler::simplify(onejit::Mem expr) noexcept {
-  return expr; // TODO
+  if (expr.op() != MEM_OP) {
+    // already an x64::Mem
+    return expr;
+  }
+  // fold the address arithmetic into the memory operand
+  if (Mem mem{*this, expr.kind(), ChildRange{expr}}) {
+    return mem;
+  }
+  out_of_memory(expr);
+  return expr;
 }
 
 Expr Compiler::simplify(Unary expr) noexcept {
@@ -204,7 +866,87 @@ void Compiler::simplify_binary(Expr &x, Expr &y) noexcept {
 }
 
 Expr Compiler::simplify(Tuple expr) noexcept {
-  return expr; // TODO
+  if (expr.op() == CALL) {
+    return expr; // TODO
+  } else if (expr.op() == ADD && !expr.kind().is_float()) {
+    return simplify_add(expr);
+  } else if (expr.op() == SELECT && expr.children() == 3) {
+    return simplify_select(expr);
+  }
+  Array<Node> args;
+  bool changed = false, mem = false;
+  for (uint32_t i = 0, n = expr.children(); i < n; i++) {
+    Expr x = expr.arg(i);
+    Expr simpl_x = to_var_mem_const(simplify(x));
+    if (simpl_x.type() == MEM) {
+      // x86_64 instructions accept at most one memory argument
+      if (mem) {
+        simpl_x = to_var(simpl_x);
+      }
+      mem = true;
+    }
+    changed = changed || simpl_x != x;
+    if (!args.append(simpl_x)) {
+      out_of_memory(expr);
+      return expr;
+    }
+  }
+  if (changed) {
+    return Tuple{*func_, expr.kind(), expr.op(), args};
+  }
+  return expr;
+}
+
+static bool is_int_comparison(Expr expr) noexcept {
+  const Binary b = expr.is<Binary>();
+  return b && b.op() >= LSS && b.op() <= GEQ && !b.x().kind().is_float();
+}
+
+Expr Compiler::simplify_select(Tuple expr) noexcept {
+  const Expr test = expr.arg(0), x = expr.arg(1), y = expr.arg(2);
+  // keep integer comparisons, they are computed by CMP together with CMOVcc
+  Expr simpl_test = is_int_comparison(test) ? simplify(test.is<Binary>()) : to_var(test);
+  Expr simpl_x = to_var_mem_const(simplify(x));
+  Expr simpl_y = to_var_mem_const(simplify(y));
+  if (simpl_test != test || simpl_x != x || simpl_y != y) {
+    return Tuple{*func_, expr.kind(), SELECT, {simpl_test, simpl_x, simpl_y}};
+  }
+  return expr;
+}
+
+Expr Compiler::simplify_add(Tuple expr) noexcept {
+  Address address;
+  if (!address.insert(*this, ChildRange{expr})) {
+    out_of_memory(expr);
+    return expr;
+  }
+  const Kind kind = expr.kind();
+  Node args[4];
+  uint32_t n = 0;
+  if (address.label) {
+    args[n++] = address.label;
+  }
+  if (address.offset != 0) {
+    args[n++] = Const{*func_, address.offset};
+  }
+  if (address.base) {
+    args[n++] = address.base;
+  }
+  if (address.index) {
+    args[n++] = address.scale.val() == 1
+                    ? Expr{address.index}
+                    : Expr{Tuple{*func_, MUL, address.index,
+                                 Const{Uint8, uint16_t(address.scale.val())}}};
+  }
+  if (n == 0) {
+    return Zero(kind);
+  } else if (n == 1 && args[0].type() == VAR) {
+    return args[0].is<Var>();
+  } else if (n == 1 && args[0].type() == CONST) {
+    return Const{*func_, Value{int64_t(address.offset)}.cast(kind)};
+  }
+  // label + offset + base + index * scale is computed by a single LEA
+  return Tuple{*func_, kind, ADD, Nodes{args, n}};
 }
 
 // ===============================  compile(Stmt1)  ============================
@@ -260,21 +1002,59 @@ Compiler &Compiler::compile(Assign st) noexcept {
   return add(simplify_assign(st, dst, src));
 }
 
+// return op_double if kind is Float64, op_float if kind is Float32, otherwise BAD_ST2
+static OpStmt2 sse_op(Kind kind, OpStmt2 op_double, OpStmt2 op_float) noexcept {
+  return kind == Float64 ? op_double : kind == Float32 ? op_float : BAD_ST2;
+}
+
 Node Compiler::simplify_assign(Assign st, Expr dst, Expr src) noexcept {
-  // FIXME use st.kind() to select appropriate x86_64 instruction
+  const Kind kind = dst.kind();
   OpStmt2 op = st.op();
-  if (op >= ADD_ASSIGN && op <= SHR_ASSIGN) {
-    static const OpStmt2 xop[] =
-        // FIXME: X86_DIV computes both quotient and remainder
-        {X86_ADD, X86_SUB, X86_MUL, X86_DIV, REM_ASSIGN, //
-         X86_AND, X86_OR,  X86_XOR, X86_SHL, X86_SHR};
-    op = xop[op - ADD_ASSIGN];
+  if (op >= ADD_ASSIGN && op <= SHR_ASSIGN && !kind.is_float() &&
+      (op == QUO_ASSIGN || op == REM_ASSIGN || (op >= SHL_ASSIGN && src.type() != CONST))) {
+    // integer division and shifts by a non-constant amount use fixed registers:
+    // compile them as dst = dst op src
+    const Binary binary{*func_, to_op2(op), dst, src};
+    if (dst.type() == MEM) {
+      return simplify_assign_mem(st, dst, binary);
+    }
+    return simplify_assign(st, dst, binary);
+  } else if (op >= ADD_ASSIGN && op <= SHR_ASSIGN) {
+    // integer QUO_ASSIGN and REM_ASSIGN are compiled above
+    static const OpStmt2 xop[] = {X86_ADD, X86_SUB, X86_IMUL, BAD_ST2, BAD_ST2, //
+                                  X86_AND, X86_OR,  X86_XOR,  X86_SHL, X86_SHR};
+    static const OpStmt2 xop_double[] = {X86_ADDSD, X86_SUBSD, X86_MULSD, X86_DIVSD};
+    static const OpStmt2 xop_float[] = {X86_ADDSS, X86_SUBSS, X86_MULSS, X86_DIVSS};
+    if (kind.is_float() && op <= QUO_ASSIGN) {
+      op = sse_op(kind, xop_double[op - ADD_ASSIGN], xop_float[op - ADD_ASSIGN]);
+    } else if (op == SHR_ASSIGN && kind.is_signed()) {
+      op = X86_SAR;
+    } else {
+      op = kind.is_float() ? BAD_ST2 : xop[op - ADD_ASSIGN];
+    }
+    if (op == BAD_ST2) {
+      error(st, "unsupported Assign operation");
+      return st;
+    }
     src = to_var_mem_const(src);
+    if (src.type() == CONST && (kind.is_float() || op == X86_IMUL)) {
+      // SSE instructions and two-argument IMUL do not accept immediate arguments
+      src = to_var(src);
+    }
   } else if (op == ASSIGN) {
     switch (src.type()) {
     case VAR:
     case MEM:
+      op = Util::x86_mov(kind);
+      break;
     case CONST:
+      if (kind.is_float()) {
+        src = to_var(src);
+        op = Util::x86_mov(kind);
+        break;
+      }
+      op = X86_MOV;
+      break;
     case LABEL:
       op = X86_MOV;
       break;
@@ -294,42 +1074,561 @@ Node Compiler::simplify_assign(Assign st, Expr dst, Expr src) noexcept {
   return Stmt2{*func_, dst, src, op};
 }
 
-Node Compiler::simplify_assign(Assign st, Expr dst, Unary src) noexcept {
-  // TODO
-  (void)dst;
-  (void)src;
-  return st;
+Node Compiler::simplify_assign_mem(Assign st, Expr dst, Expr src) noexcept {
+  const Var v{*func_, src.kind()};
+  const Assign assign{*func_, ASSIGN, v, src};
+  const Node node = simplify_assign(assign, v, src);
+  if (node == assign) {
+    // not supported yet
+    return st;
+  }
+  add(node);
+  return Stmt2{*func_, dst, v, Util::x86_mov(dst.kind())};
 }
 
-Node Compiler::simplify_assign(Assign st, Expr dst, Tuple src) noexcept {
+// return an operand with the narrower kind that reads the low bits of x,
+// which must be a Var or a Mem
+static Expr x86_low_bits(Func &func, Expr x, Kind kind) noexcept {
+  if (Mem mem = x.is<Mem>()) {
+    // x86_64 is little-endian: the low bits are at the same address
+    return Mem{func, kind,
+               Address{mem.label(), mem.offset(), mem.child_is<Var>(2), mem.child_is<Var>(3),
+                       mem.scale()}};
+  }
+  return Var{Reg{kind, x.is<Var>().id()}};
+}
+
+Node Compiler::simplify_assign_extend(Var dst, Expr x) noexcept {
+  const Kind xkind = x.kind();
+  if (xkind.bitsize() == 32 && !xkind.is_signed()) {
+    // MOVZX has no 32-bit to 64-bit form: writing a 32-bit register zero-extends it
+    return Stmt2{*func_, Var{Reg{xkind, dst.id()}}, x, X86_MOV};
+  }
+  return Stmt2{*func_, dst, x, xkind.is_signed() ? X86_MOVSX : X86_MOVZX};
+}
+
+Node Compiler::simplify_assign(Assign st, Expr dst, Unary src) noexcept {
+  if (dst.type() == MEM) {
+    return simplify_assign_mem(st, dst, src);
+  }
+  const Kind kind = src.kind();
+  Expr x = src.x();
+  const Kind xkind = x.kind();
+  Array<Node> args;
   switch (src.op()) {
-  case ADD:
-    if (dst.type() == VAR) {
-      if (Mem mem{*this, Ptr, ChildRange{src}}) {
-        return Stmt2{*func_, dst, mem, X86_LEA};
+  case XOR1:
+  case NEG1:
+    if (!kind.is_float()) {
+      if (dst != x) {
+        add(Stmt2{*func_, dst, x, X86_MOV});
+      }
+      return Stmt1{*func_, dst, src.op() == NEG1 ? X86_NEG : X86_NOT};
+    } else if (src.op() == NEG1) {
+      // flip the sign bit
+      const uint64_t sign = uint64_t(1) << (kind.bitsize() - 1);
+      const Var mask = to_var(Const{*func_, Value{kind, sign}});
+      if (!args.append(to_var(x)) || !args.append(mask)) {
+        out_of_memory(st);
+        return st;
       }
+      return simplify_assign_ops(dst, args, X86_PXOR, true);
+    }
+    break;
+  case NOT1:
+    if (dst != x) {
+      add(Stmt2{*func_, dst, x, X86_MOV});
+    }
+    return Stmt2{*func_, dst, One(*func_, kind), X86_XOR};
+  case CAST:
+    if (x.type() == CONST) {
+      x = to_var(x);
     }
+    if (kind.is_float() && xkind.is_float()) {
+      if (kind == xkind) {
+        return Stmt2{*func_, dst, x, Util::x86_mov(kind)};
+      }
+      return Stmt2{*func_, dst, x, kind == Float64 ? X86_CVTSS2SD : X86_CVTSD2SS};
+    } else if (kind.is_float()) {
+      if (xkind.bitsize() < 32 || xkind == Uint32) {
+        // CVTSI2SD and CVTSI2SS convert a signed 32-bit or 64-bit integer:
+        // extend narrower integers and Uint32 first
+        const Var wide{*func_, xkind == Uint32 ? Int64 : Int32};
+        add(simplify_assign_extend(wide, x));
+        x = wide;
+      } else if (xkind == Uint64 || xkind == Ptr) {
+        return simplify_cast_uint64_to_float(dst, to_var(x));
+      }
+      return Stmt2{*func_, dst, x, kind == Float64 ? X86_CVTSI2SD : X86_CVTSI2SS};
+    } else if (xkind.is_float()) {
+      const OpStmt2 cvt = xkind == Float64 ? X86_CVTTSD2SI : X86_CVTTSS2SI;
+      if (kind == Int32 || kind == Int64) {
+        return Stmt2{*func_, dst, x, cvt};
+      } else if (kind == Uint64 || kind == Ptr) {
+        return simplify_cast_float_to_uint64(dst, to_var(x));
+      }
+      // convert to a wider signed integer, then truncate it
+      const Var wide{*func_, kind == Uint32 ? Int64 : Int32};
+      add(Stmt2{*func_, wide, x, cvt});
+      return Stmt2{*func_, dst, x86_low_bits(*func_, wide, kind), X86_MOV};
+    } else if (kind.bitsize() > xkind.bitsize()) {
+      return simplify_assign_extend(dst.is<Var>(), x);
+    } else if (kind.bitsize() < xkind.bitsize()) {
+      // truncate: read the low bits of x
+      return Stmt2{*func_, dst, x86_low_bits(*func_, x, kind), X86_MOV};
+    }
+    // copy between kinds with the same size
+    return Stmt2{*func_, dst, x, X86_MOV};
+  case BITCOPY:
+    if (x.type() == CONST) {
+      return Stmt2{*func_, dst, x, X86_MOV};
+    } else if (kind.is_float() != xkind.is_float()) {
+      return Stmt2{*func_, dst, x, kind.bitsize() == 64 ? X86_MOVQ : X86_MOVD};
+    }
+    return Stmt2{*func_, dst, x, Util::x86_mov(kind)};
+  default:
     break;
-  case CALL: {
+  }
+  error(src, "unsupported Unary operation");
+  return st;
+}
+
+// return true if LEA can compute a value of specified kind:
+// it has no 8-bit form, and the 16-bit form needs an operand-size prefix
+static bool is_lea_kind(Kind kind) noexcept {
+  return kind == kind.nosimd() && !kind.is_float() && kind.bitsize() >= 32;
+}
+
+// return true if expr is an integer Const equal to 2, 3, 4, 5, 8 or 9:
+// multiplying by it is computed by a single LEA
+static bool is_lea_factor(Expr expr) noexcept {
+  const Const c = expr.is<Const>();
+  if (!c || c.kind().is_float()) {
+    return false;
+  }
+  const uint64_t val = c.val().uint64();
+  return val == 2 || val == 3 || val == 4 || val == 5 || val == 8 || val == 9;
+}
+
+Node Compiler::simplify_assign(Assign st, Expr dst, Tuple src) noexcept {
+  const OpN op = src.op();
+  const Kind kind = src.kind();
+  if (op == CALL) {
     StmtN set{*func_, Nodes{&dst, 1}, SET_};
     ChildRange ranges[] = {ChildRange{src, 0, 2},          // ftype, label
                            ChildRange{Block{*func_, set}}, // (set_ dst)
                            ChildRange{src, 2, sub_uint32(src.children(), 2)}};
     return StmtN{*func_, ChildRanges{ranges, 3}, X86_CALL_};
+  } else if (dst.type() == MEM) {
+    return simplify_assign_mem(st, dst, src);
+  } else if (op == SELECT && src.children() == 3 && !kind.is_float() && kind == kind.nosimd()) {
+    return simplify_assign_select(dst, src.arg(0), src.arg(1), src.arg(2));
+  } else if (op == ADD && is_lea_kind(kind)) {
+    if (Mem mem{*this, Ptr, ChildRange{src}}) {
+      return Stmt2{*func_, dst, mem, X86_LEA};
+    }
+  } else if (op == MUL && src.children() == 2 && is_lea_kind(kind) &&
+             is_lea_factor(src.arg(1))) {
+    Expr arg = src;
+    if (Mem mem{*this, Ptr, Exprs{&arg, 1}}) {
+      return Stmt2{*func_, dst, mem, X86_LEA};
+    }
+  }
+  OpStmt2 xop = BAD_ST2;
+  if (kind.is_float()) {
+    switch (op) {
+    case ADD:
+      xop = sse_op(kind, X86_ADDSD, X86_ADDSS);
+      break;
+    case MUL:
+      xop = sse_op(kind, X86_MULSD, X86_MULSS);
+      break;
+    case MAX:
+      xop = sse_op(kind, X86_MAXSD, X86_MAXSS);
+      break;
+    case MIN:
+      xop = sse_op(kind, X86_MINSD, X86_MINSS);
+      break;
+    default:
+      break;
+    }
+  } else {
+    static const OpStmt2 xop_int[] = {X86_ADD, X86_IMUL, X86_AND, X86_OR, X86_XOR};
+    const bool is_signed = kind.is_signed();
+    if (op >= ADD && op <= XOR) {
+      xop = xop_int[op - ADD];
+    } else if (op == MAX) {
+      // if dst < arg then dst = arg
+      xop = is_signed ? X86_CMOVL : X86_CMOVB;
+    } else if (op == MIN) {
+      // if dst > arg then dst = arg
+      xop = is_signed ? X86_CMOVG : X86_CMOVA;
+    }
   }
+  if (xop == BAD_ST2) {
+    error(src, "unsupported Tuple operation");
+    return st;
+  }
+  Array<Node> args;
+  for (uint32_t i = 0, n = src.children(); i < n; i++) {
+    if (!args.append(src.child(i))) {
+      out_of_memory(st);
+      return st;
+    }
+  }
+  if (kind.bitsize() == 8 && (xop == X86_IMUL || (xop >= X86_CMOVA && xop <= X86_CMOVS))) {
+    // two-operand IMUL and CMOVcc have no 8-bit form:
+    // compute MUL, MAX or MIN of the arguments extended to 32 bits
+    const Kind wide = kind.is_signed() ? Int32 : Uint32;
+    for (size_t i = 0, n = args.size(); i < n; i++) {
+      const Expr arg = args[i].is<Expr>();
+      if (arg.type() == CONST) {
+        args.set(i, Const{*func_, arg.is<Const>().val().cast(wide)});
+      } else {
+        const Var wide_arg{*func_, wide};
+        add(simplify_assign_extend(wide_arg, arg));
+        args.set(i, wide_arg);
+      }
+    }
+    const Var wide_dst{*func_, wide};
+    add(simplify_assign_ops(wide_dst, args, xop, true));
+    return Stmt2{*func_, dst, x86_low_bits(*func_, wide_dst, kind), X86_MOV};
+  }
+  return simplify_assign_ops(dst, args, xop, true);
+}
+
+Node Compiler::simplify_assign(Assign st, Expr dst, Binary src) noexcept {
+  const Op2 op = src.op();
+  const Expr x = src.x(), y = src.y();
+  const Kind kind = x.kind();
+  OpStmt2 xop = BAD_ST2;
+  switch (op) {
+  case SUB:
+    if (kind.is_float()) {
+      xop = sse_op(kind, X86_SUBSD, X86_SUBSS);
+      break;
+    } else if (dst.type() == VAR && x.type() == VAR && y.type() == CONST && x != dst &&
+               is_lea_kind(kind)) {
+      // compute x - c with a single LEA
+      const int64_t val = y.is<Const>().val().int64();
+      if (val >= -0x7fffffff && val <= 0x7fffffff) {
+        // -val fits a 32-bit offset
+        Expr args[] = {x, Const{*func_, int32_t(-val)}};
+        if (Mem mem{*this, Ptr, Exprs{args, 2}}) {
+          return Stmt2{*func_, dst, mem, X86_LEA};
+        }
+      }
+    }
+    xop = X86_SUB;
+    break;
+  case MULHI:
+    if (reg_class(kind) != GprClass || kind.bits() == Bits8) {
+      // the 8-bit high half is written to %ah, which cannot be allocated
+      error(src, "unsupported MULHI kind");
+      return st;
+    } else if (dst.type() == MEM) {
+      return simplify_assign_mem(st, dst, src);
+    }
+    // one-operand MUL and IMUL compute %rdx:%rax = %rax * arg
+    add(Stmt2{*func_, Var{Reg{kind, RAX}}, x, X86_MOV});
+    add(Stmt1{*func_, y.type() == CONST ? to_var(y) : y, kind.is_signed() ? X86_IMUL1 : X86_MUL});
+    return Stmt2{*func_, dst, Var{Reg{kind, RDX}}, X86_MOV};
+  case QUO:
+  case REM:
+    if (kind.is_float()) {
+      xop = op == QUO ? sse_op(kind, X86_DIVSD, X86_DIVSS) : BAD_ST2;
+      break;
+    } else if (reg_class(kind) != GprClass) {
+      break;
+    } else if (dst.type() == MEM) {
+      return simplify_assign_mem(st, dst, src);
+    }
+    return simplify_assign_div(dst, op, x, y);
+  case SHL:
+  case SHR:
+    if (kind.is_float()) {
+      break;
+    } else if (y.type() == CONST) {
+      xop = op == SHL ? X86_SHL : kind.is_signed() ? X86_SAR : X86_SHR;
+      break;
+    } else if (reg_class(kind) != GprClass) {
+      break;
+    } else if (dst.type() == MEM) {
+      return simplify_assign_mem(st, dst, src);
+    }
+    return simplify_assign_shift(dst, op, x, y);
+  case LSS:
+  case LEQ:
+  case NEQ:
+  case EQL:
+  case GTR:
+  case GEQ:
+    if (dst.type() == MEM) {
+      return simplify_assign_mem(st, dst, src);
+    }
+    return simplify_assign_cmp(dst, op, x, y);
   default:
     break;
-  } // switch
-  return st;
+  }
+  if (xop == BAD_ST2) {
+    error(src, "unsupported Binary operation");
+    return st;
+  } else if (dst.type() == MEM) {
+    return simplify_assign_mem(st, dst, src);
+  }
+  Array<Node> args;
+  if (!args.append(x) || !args.append(y)) {
+    out_of_memory(st);
+    return st;
+  }
+  return simplify_assign_ops(dst, args, xop, false);
 }
 
-Node Compiler::simplify_assign(Assign st, Expr dst, Binary src) noexcept {
-  // TODO
-  (void)dst;
-  (void)src;
-  return st;
+Node Compiler::simplify_assign_div(Expr dst, Op2 op, Expr x, Expr y) noexcept {
+  const Kind kind = x.kind();
+  if (x.type() == CONST) {
+    x = to_var(x);
+  }
+  if (y.type() == CONST) {
+    // DIV and IDIV do not accept immediate arguments
+    y = to_var(y);
+  }
+  if (kind.bitsize() == 8) {
+    // 8-bit DIV and IDIV write the remainder to %ah, which cannot be allocated:
+    // divide 32-bit integers instead
+    const Kind wide = kind.is_signed() ? Int32 : Uint32;
+    const Var wide_x{*func_, wide}, wide_y{*func_, wide}, wide_dst{*func_, wide};
+    add(simplify_assign_extend(wide_x, x));
+    add(simplify_assign_extend(wide_y, y));
+    add(simplify_assign_div(wide_dst, op, wide_x, wide_y));
+    return Stmt2{*func_, dst, x86_low_bits(*func_, wide_dst, kind), X86_MOV};
+  }
+  // DIV and IDIV divide %rdx:%rax, and write quotient to %rax and remainder to %rdx
+  const Var rax{Reg{kind, RAX}}, rdx{Reg{kind, RDX}};
+  add(Stmt2{*func_, rax, x, X86_MOV});
+  if (kind.is_signed()) {
+    // sign-extend %rax into %rdx
+    add(Stmt2{*func_, rdx, rax, X86_MOV});
+    add(Stmt2{*func_, rdx, Const{*func_, Value{kind, kind.bitsize() - 1}}, X86_SAR});
+  } else {
+    add(Stmt2{*func_, rdx, rdx, X86_XOR});
+  }
+  add(Stmt1{*func_, y, kind.is_signed() ? X86_IDIV : X86_DIV});
+  return Stmt2{*func_, dst, op == QUO ? rax : rdx, X86_MOV};
+}
+
+Node Compiler::simplify_assign_shift(Expr dst, Op2 op, Expr x, Expr y) noexcept {
+  const Kind kind = x.kind();
+  // shifts by a non-constant amount read it from %cl
+  add(Stmt2{*func_, Var{Reg{y.kind(), RCX}}, y, X86_MOV});
+  if (dst != x) {
+    add(Stmt2{*func_, dst, x, X86_MOV});
+  }
+  const OpStmt2 xop = op == SHL ? X86_SHL : kind.is_signed() ? X86_SAR : X86_SHR;
+  return Stmt2{*func_, dst, Var{Reg{Uint8, RCX}}, xop};
+}
+
+Node Compiler::simplify_cast_uint64_to_float(Expr dst, Var x) noexcept {
+  const Kind kind = dst.kind();
+  const OpStmt2 cvt = kind == Float64 ? X86_CVTSI2SD : X86_CVTSI2SS;
+  const Label big{*func_}, done{*func_};
+  add(Stmt2{*func_, x, x, X86_TEST});
+  add(Stmt1{*func_, big, X86_JS});
+  add(Stmt2{*func_, dst, x, cvt});
+  add(Stmt1{*func_, done, X86_JMP});
+  // x >= 2^63: convert x / 2 rounded to odd, i.e. (x >> 1) | (x & 1), then double it
+  add(big);
+  const Var half{*func_, x.kind()}, odd{*func_, x.kind()};
+  add(Stmt2{*func_, half, x, X86_MOV});
+  add(Stmt2{*func_, half, Const{*func_, Value{x.kind(), 1}}, X86_SHR});
+  add(Stmt2{*func_, odd, x, X86_MOV});
+  add(Stmt2{*func_, odd, Const{*func_, Value{x.kind(), 1}}, X86_AND});
+  add(Stmt2{*func_, half, odd, X86_OR});
+  add(Stmt2{*func_, dst, half, cvt});
+  add(Stmt2{*func_, dst, dst, kind == Float64 ? X86_ADDSD : X86_ADDSS});
+  return done;
+}
+
+Node Compiler::simplify_cast_float_to_uint64(Expr dst, Var x) noexcept {
+  const Kind kind = dst.kind(), xkind = x.kind();
+  const bool is_double = xkind == Float64;
+  const OpStmt2 cvt = is_double ? X86_CVTTSD2SI : X86_CVTTSS2SI;
+  // 2^63 is exactly representable both as Float64 and Float32
+  const Var limit = to_var(Const{*func_, is_double ? Value{9223372036854775808.0} //
+                                                   : Value{9223372036854775808.0f}});
+  const Label big{*func_}, done{*func_};
+  add(Stmt2{*func_, x, limit, is_double ? X86_UCOMISD : X86_UCOMISS});
+  add(Stmt1{*func_, big, X86_JAE});
+  add(Stmt2{*func_, dst, x, cvt});
+  add(Stmt1{*func_, done, X86_JMP});
+  // x >= 2^63: convert x - 2^63, then set the highest bit
+  add(big);
+  const Var tmp{*func_, xkind};
+  add(Stmt2{*func_, tmp, x, Util::x86_mov(xkind)});
+  add(Stmt2{*func_, tmp, limit, is_double ? X86_SUBSD : X86_SUBSS});
+  add(Stmt2{*func_, dst, tmp, cvt});
+  add(Stmt2{*func_, dst, to_var(Const{*func_, Value{kind, uint64_t(1) << 63}}), X86_XOR});
+  return done;
 }
 
+// return true if args[i] == dst for some i >= start
+static bool contains_dst(const Array<Node> &args, Expr dst, size_t start) noexcept {
+  for (size_t i = start, n = args.size(); i < n; i++) {
+    if (args[i] == dst) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Node Compiler::simplify_assign_ops(Expr dst, Array<Node> &args, OpStmt2 xop,
+                                   bool commutative) noexcept {
+  const size_t n = args.size();
+  const Kind kind = dst.kind();
+  const bool is_cmov = xop >= X86_CMOVA && xop <= X86_CMOVS;
+  if (n == 0) {
+    return VoidConst;
+  } else if (commutative && args[0] != dst) {
+    // if dst is also an argument, compute it first
+    for (size_t i = 1; i < n; i++) {
+      if (args[i] == dst) {
+        args.set(i, args[0]);
+        args.set(0, dst);
+        break;
+      }
+    }
+  }
+  // writing dst must not overwrite the arguments not yet read:
+  // only the first xop can read dst, and only if dst is also the first argument
+  Expr out = dst;
+  if (contains_dst(args, dst, args[0] == dst ? 2 : 1)) {
+    out = Var{*func_, kind};
+  }
+  for (size_t i = 0; i < n; i++) {
+    Expr arg = args[i].is<Expr>();
+    if (arg.type() == CONST && (kind.is_float() || xop == X86_IMUL || is_cmov)) {
+      // SSE instructions, CMOVcc and two-argument IMUL do not accept immediate arguments
+      arg = to_var(arg);
+    }
+    if (i == 0) {
+      if (arg != out) {
+        add(Stmt2{*func_, out, arg, arg.type() == CONST ? X86_MOV : Util::x86_mov(kind)});
+      }
+      continue;
+    } else if (is_cmov) {
+      add(Stmt2{*func_, out, arg, X86_CMP});
+    }
+    const Stmt2 stmt{*func_, out, arg, xop};
+    if (i + 1 == n && out == dst) {
+      return stmt;
+    }
+    add(stmt);
+  }
+  if (out == dst) {
+    // n == 1
+    return VoidConst;
+  }
+  return Stmt2{*func_, dst, out, Util::x86_mov(kind)};
+}
+
+Node Compiler::simplify_assign_cmp(Expr dst, Op2 op, Expr x, Expr y) noexcept {
+  // index is op - LSS
+  static const OpStmt1 set_signed[] = {X86_SETL, X86_SETLE, X86_SETNE,
+                                       X86_SETE, X86_SETG,  X86_SETGE};
+  static const OpStmt1 set_unsigned[] = {X86_SETB, X86_SETBE, X86_SETNE,
+                                         X86_SETE, X86_SETA,  X86_SETAE};
+  // swapping the arguments of op
+  static const Op2 swap_op[] = {GTR, GEQ, NEQ, EQL, LSS, LEQ};
+
+  const Kind kind = x.kind();
+  if (kind.is_float()) {
+    // UCOMISD and UCOMISS set the flags as an unsigned comparison,
+    // and report unordered arguments i.e. NaN with ZF = PF = CF = 1
+    if (op == LSS || op == LEQ) {
+      // x < y is y > x: the latter is false if either argument is NaN
+      Expr tmp = x;
+      x = y;
+      y = tmp;
+      op = swap_op[op - LSS];
+    }
+    x = to_var(x);
+    if (y.type() == CONST) {
+      y = to_var(y);
+    }
+    add(Stmt2{*func_, x, y, kind == Float64 ? X86_UCOMISD : X86_UCOMISS});
+    if (op == EQL || op == NEQ) {
+      // x == y requires ZF = 1 and PF = 0, x != y requires ZF = 0 or PF = 1
+      const Var parity{*func_, Bool};
+      add(Stmt1{*func_, dst, op == EQL ? X86_SETE : X86_SETNE});
+      add(Stmt1{*func_, parity, op == EQL ? X86_SETNP : X86_SETP});
+      return Stmt2{*func_, dst, parity, op == EQL ? X86_AND : X86_OR};
+    }
+    return Stmt1{*func_, dst, set_unsigned[op - LSS]};
+  }
+  if (x.type() == CONST) {
+    if (y.type() == CONST) {
+      x = to_var(x);
+    } else {
+      Expr tmp = x;
+      x = y;
+      y = tmp;
+      op = swap_op[op - LSS];
+    }
+  }
+  add(Stmt2{*func_, x, y, X86_CMP});
+  return Stmt1{*func_, dst, (kind.is_signed() ? set_signed : set_unsigned)[op - LSS]};
+}
+
+Node Compiler::simplify_assign_select(Expr dst, Expr test, Expr x, Expr y) noexcept {
+  // index is op - LSS
+  static const OpStmt2 cmov_signed[] = {X86_CMOVL, X86_CMOVLE, X86_CMOVNE,
+                                        X86_CMOVE, X86_CMOVG,  X86_CMOVGE};
+  static const OpStmt2 cmov_unsigned[] = {X86_CMOVB, X86_CMOVBE, X86_CMOVNE,
+                                          X86_CMOVE, X86_CMOVA,  X86_CMOVAE};
+  if (x == y) {
+    return x == dst ? Node{VoidConst} : Node{Stmt2{*func_, dst, x, Util::x86_mov(dst.kind())}};
+  }
+  const Binary cmp = is_int_comparison(test) ? test.is<Binary>() : Binary{};
+  Op2 op = cmp ? cmp.op() : NEQ;
+  bool negate = false;
+  if (x == dst) {
+    // dst = y; if (!test) dst = x would overwrite x: compute the negated condition instead
+    Expr tmp = x;
+    x = y;
+    y = tmp;
+    negate = true;
+  }
+  // CMOVcc does not accept immediate arguments
+  x = x.type() == MEM ? x : to_var(x);
+  if (!cmp) {
+    const Var t = to_var(test);
+    add(Stmt2{*func_, t, t, X86_TEST});
+    op = negate ? EQL : NEQ;
+  } else {
+    Expr cx = cmp.x(), cy = cmp.y();
+    if (cx.type() == CONST) {
+      if (cy.type() == CONST) {
+        cx = to_var(cx);
+      } else {
+        Expr tmp = cx;
+        cx = cy;
+        cy = tmp;
+        op = swap_comparison(op);
+      }
+    }
+    if (negate) {
+      op = not_comparison(op);
+    }
+    add(Stmt2{*func_, cx, cy, X86_CMP});
+  }
+  if (y != dst) {
+    // MOV does not modify the flags set by CMP or TEST
+    add(Stmt2{*func_, dst, y, X86_MOV});
+  }
+  const bool is_signed = cmp ? cmp.x().kind().is_signed() : false;
+  return Stmt2{*func_, dst, x, (is_signed ? cmov_signed : cmov_unsigned)[op - LSS]};
+}
+
+
 // ===============================  compile(StmtN)  ============================
 
 Compiler &Compiler::compile(StmtN st) noexcept {
@@ -338,6 +1637,8 @@ Compiler &Compiler::compile(StmtN st) noexcept {
     return compile(st.is<AssignCall>());
   case BLOCK:
     return compile(st.is<Block>());
+  case JUMP_TABLE_:
+    return compile(st.is<JumpTable>());
   case RETURN:
     return compile(st.is<Return>());
   case SET_: // used in function prologue
@@ -358,6 +1659,34 @@ Compiler &Compiler::compile(AssignCall st) noexcept {
   return add(st); // TODO
 }
 
+Compiler &Compiler::compile(JumpTable st) noexcept {
+  const Expr index = st.index();
+  if (const Const c = index.is<Const>()) {
+    const uint64_t val = c.val().uint64();
+    if (val >= st.size()) {
+      return error(st, "JumpTable index out of range");
+    }
+    return add(Stmt1{*func_, st.label(uint32_t(val)), X86_JMP});
+  }
+  // index is >= 0, thus extending it to 64 bits either with zeros or with sign is correct
+  const Var index64 = to_var(index.kind().bits() == Bits64 ? index //
+                                                           : Unary{*func_, Uint64, CAST, index});
+  // load the table address, then jump through it
+  const Label table{*func_};
+  const Var base{*func_, Uint64};
+  const Var rip{Reg{Uint64, RIP}};
+  add(Stmt2{*func_, base, Mem{*func_, Uint64, Address{table, 0, rip}}, X86_LEA});
+
+  const Mem mem{*func_, Uint64, Address{table, 0, base, index64, Scale8}};
+  Array<Label> labels;
+  for (uint32_t i = 0, n = st.size(); i < n; i++) {
+    if (!labels.append(st.label(i))) {
+      return out_of_memory(st);
+    }
+  }
+  return add(JumpTable{*func_, mem, labels});
+}
+
 Compiler &Compiler::compile(Return st) noexcept {
   ChildRange children{st, 0, st.children()};
   return add(StmtN{*func_, ChildRanges{&children, 1}, X86_RET});
@@ -369,9 +1698,26 @@ Var Compiler::to_var(Expr expr) noexcept {
   Var v = expr.is<Var>();
   if (expr && !v) {
     // copy Expr result to a Var
-    v = Var{*func_, expr.kind()};
-    // compile(Assign{...}) would cause infinite recursion
-    add(Assign{*func_, ASSIGN, v, expr});
+    const Kind kind = expr.kind();
+    v = Var{*func_, kind};
+    if (expr.type() == CONST && kind.is_float()) {
+      // SSE registers cannot be loaded from an immediate: load its bits into a general register
+      const Kind bits_kind = kind == Float64 ? Uint64 : Uint32;
+      const Var bits{*func_, bits_kind};
+      add(Stmt2{*func_, bits, Const{*func_, Value{bits_kind, expr.is<Const>().val().uint64()}},
+                X86_MOV});
+      add(Stmt2{*func_, v, bits, kind == Float64 ? X86_MOVQ : X86_MOVD});
+    } else if (expr.type() == CONST) {
+      add(Stmt2{*func_, v, expr, X86_MOV});
+    } else {
+      // compile(Assign{...}) would cause infinite recursion
+      const Expr src = simplify(expr);
+      if (Var src_var = src.is<Var>()) {
+        return src_var;
+      }
+      Assign st{*func_, ASSIGN, v, src};
+      add(simplify_assign(st, v, src));
+    }
   }
   return v;
 }
@@ -379,9 +1725,10 @@ Var Compiler::to_var(Expr expr) noexcept {
 Expr Compiler::to_var_const(Expr expr) noexcept {
   switch (expr.type()) {
   case VAR:
-  case CONST:
   case LABEL:
     return expr;
+  case CONST:
+    return Util::is_imm32(expr) ? expr : to_var(expr);
   default:
     return to_var(expr);
   }
@@ -391,9 +1738,10 @@ Expr Compiler::to_var_mem_const(Expr expr) noexcept {
   switch (expr.type()) {
   case VAR:
   case MEM:
-  case CONST:
   case LABEL:
     return expr;
+  case CONST:
+    return Util::is_imm32(expr) ? expr : to_var(expr);
   default:
     return to_var(expr);
   }
@@ -0,0 +1,180 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * relax.cpp
+ *
+ *  Created on Apr 04, 2021
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/assembler.hpp>
+#include <onejit/ir/label.hpp>
+
+namespace onejit {
+
+namespace x64 {
+
+// a jmp or jcc with rel32 displacement, that may be shortened to rel8
+struct Branch {
+  size_t reloc;   // index in Assembler relocations
+  size_t start;   // position of first instruction byte
+  size_t end;     // position after last instruction byte
+  size_t target;  // position of destination label
+  uint8_t opcode; // opcode of short form
+  bool is_short;
+};
+
+enum : size_t {
+  short_len = 2, // length of jmp or jcc with rel8 displacement
+};
+
+// given an Assembler position, return its position after shortening branches
+// whose end is <= pos. shrink[i] is the total bytes removed by branches 0 ... i
+static size_t relaxed_pos(View<Branch> branches, View<size_t> shrink, size_t pos) noexcept {
+  size_t lo = 0, hi = branches.size();
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (branches[mid].end <= pos) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo == 0 ? pos : pos - shrink[lo - 1];
+}
+
+} // namespace x64
+
+using x64::Branch;
+using x64::relaxed_pos;
+using x64::short_len;
+
+// declared in onejit/assembler.hpp
+Assembler &Assembler::x64_relax() noexcept {
+  if (!good_ || error_ || !relocation_) {
+    return *this;
+  }
+  // map each label index to its position
+  Array<LabelPos> label_pos;
+  for (const LabelPos &lp : label_) {
+    const size_t index = lp.label.index();
+    if (index >= label_pos.size() && !label_pos.resize(index + 1)) {
+      return out_of_memory(lp.label);
+    }
+    label_pos.set(index, lp);
+  }
+
+  const uint8_t *bytes = data();
+  Array<Branch> branches;
+  for (size_t i = 0, n = relocation_.size(); i < n; i++) {
+    const Relocation reloc = relocation_[i];
+    const size_t pos = reloc.pos;
+    const size_t index = reloc.label.index();
+    if (reloc.size != 4 || pos < 5 || index >= label_pos.size() ||
+        label_pos[index].label != reloc.label) {
+      // not a rel32, or label not defined in this function
+      continue;
+    }
+    // only shorten jumps whose rel32 is zero, i.e. without addend
+    if (bytes[pos - 4] | bytes[pos - 3] | bytes[pos - 2] | bytes[pos - 1]) {
+      continue;
+    }
+    Branch b = {i, 0, pos, label_pos[index].pos, 0, true};
+    if (bytes[pos - 5] == 0xe9) {
+      // jmp rel32 => jmp rel8
+      b.start = pos - 5;
+      b.opcode = 0xeb;
+    } else if (pos >= 6 && bytes[pos - 6] == 0x0f && (bytes[pos - 5] & 0xf0) == 0x80) {
+      // jcc rel32 => jcc rel8
+      b.start = pos - 6;
+      b.opcode = 0x70 | (bytes[pos - 5] & 0x0f);
+    } else {
+      continue;
+    }
+    if (!branches.append(b)) {
+      return out_of_memory(reloc.label);
+    }
+  }
+  if (!branches) {
+    return *this;
+  }
+
+  // start with all branches short, and lengthen the ones that do not fit
+  // until nothing changes. Lengthening a branch never makes another one fit,
+  // thus the loop converges.
+  Array<size_t> shrink;
+  if (!shrink.resize(branches.size())) {
+    return out_of_memory(Node{});
+  }
+  for (bool changed = true; changed;) {
+    changed = false;
+    size_t total = 0;
+    for (size_t i = 0, n = branches.size(); i < n; i++) {
+      const Branch &b = branches[i];
+      if (b.is_short) {
+        total += b.end - b.start - short_len;
+      }
+      shrink.set(i, total);
+    }
+    for (size_t i = 0, n = branches.size(); i < n; i++) {
+      Branch b = branches[i];
+      if (!b.is_short) {
+        continue;
+      }
+      const int64_t offset = int64_t(relaxed_pos(branches, shrink, b.target)) -
+                             int64_t(relaxed_pos(branches, shrink, b.end));
+      if (offset != int64_t(int8_t(offset))) {
+        b.is_short = false;
+        branches.set(i, b);
+        changed = true;
+      }
+    }
+  }
+
+  // rewrite the code
+  Buffer<uint8_t> relaxed;
+  relaxed.reserve(size());
+  size_t pos = 0;
+  for (const Branch &b : branches) {
+    if (!b.is_short) {
+      continue;
+    }
+    const uint8_t short_bytes[short_len] = {b.opcode, 0};
+    relaxed.append(View<uint8_t>{bytes + pos, b.start - pos});
+    relaxed.append(View<uint8_t>{short_bytes, short_len});
+    pos = b.end;
+  }
+  relaxed.append(View<uint8_t>{bytes + pos, size() - pos});
+  if (!relaxed) {
+    return out_of_memory(Node{});
+  }
+
+  // update relocations and labels
+  for (size_t i = 0, n = relocation_.size(); i < n; i++) {
+    Relocation reloc = relocation_[i];
+    reloc.pos = relaxed_pos(branches, shrink, reloc.pos);
+    relocation_.set(i, reloc);
+  }
+  for (const Branch &b : branches) {
+    if (b.is_short) {
+      Relocation reloc = relocation_[b.reloc];
+      reloc.size = 1;
+      relocation_.set(b.reloc, reloc);
+    }
+  }
+  for (size_t i = 0, n = label_.size(); i < n; i++) {
+    LabelPos lp = label_[i];
+    lp.pos = relaxed_pos(branches, shrink, lp.pos);
+    label_.set(i, lp);
+  }
+  Base::swap(relaxed);
+  return *this;
+}
+
+} // namespace onejit
@@ -0,0 +1,513 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * spill.cpp
+ *
+ *  Created on Apr 08, 2021
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/flowgraph.hpp>
+#include <onejit/func.hpp>
+#include <onejit/ir.hpp>
+#include <onejit/reg/allocator.hpp>
+#include <onejit/x64/address.hpp>
+#include <onejit/x64/compiler.hpp>
+#include <onejit/x64/mem.hpp>
+#include <onejit/x64/reg.hpp>
+#include <onejit/x64/util.hpp>
+
+namespace onejit {
+namespace x64 {
+
+enum : uint32_t {
+  min_slot_size = 8,   // minimum bytes of each stack slot
+  max_slot_align = 16, // RSP is aligned to 16 bytes
+  xmm_save_size = 16,  // bytes needed to save a callee-saved SSE register
+};
+
+// stack slots of a register class
+struct Slots {
+  uint32_t n;      // number of slots
+  uint32_t size;   // bytes of each slot
+  uint32_t offset; // offset of first slot from RSP
+};
+
+// state of spill_regs()
+struct Spill {
+  View<reg::Color> colors;
+  View<reg::Color> num_colors; // index is register class
+  View<Node> remat;            // index is register, value is defining node or Node{}
+  const reg::Allocator *allocator;
+  Slots slots[reg::MaxRegClass]; // index is register class
+  Array<Node> out;
+  bool scratch; // true if scratch register is in use by current node
+};
+
+// return true if op is an SSE scalar instruction that reads and writes its first argument,
+// or only reads it as UCOMISD and UCOMISS
+static bool is_sse_arith(OpStmt2 op) noexcept {
+  switch (op) {
+  case X86_ADDSD:
+  case X86_ADDSS:
+  case X86_DIVSD:
+  case X86_DIVSS:
+  case X86_MAXSD:
+  case X86_MAXSS:
+  case X86_MINSD:
+  case X86_MINSS:
+  case X86_MULSD:
+  case X86_MULSS:
+  case X86_PAND:
+  case X86_PANDN:
+  case X86_POR:
+  case X86_PXOR:
+  case X86_SUBSD:
+  case X86_SUBSS:
+  case X86_UCOMISD:
+  case X86_UCOMISS:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// return true if first argument of op must be a register
+static bool dst_must_be_reg(OpStmt2 op) noexcept {
+  switch (op) {
+  case X86_BSF:
+  case X86_BSR:
+  case X86_IMUL:
+  case X86_LEA:
+  case X86_LZCNT:
+  case X86_MOVD: // cannot copy a general register to memory
+  case X86_MOVQ:
+  case X86_MOVSX:
+  case X86_MOVZX:
+  case X86_POPCNT:
+    return true;
+  default:
+    return (op >= X86_CMOVA && op <= X86_CMOVS) || (op >= X86_CVTSD2SI && op <= X86_CVTTSS2SI) ||
+           is_sse_arith(op);
+  }
+}
+
+// return true if op reads its first argument before writing it
+static bool dst_is_used(OpStmt2 op) noexcept {
+  return op == X86_IMUL || (op >= X86_CMOVA && op <= X86_CMOVS) || is_sse_arith(op);
+}
+
+// return true if op accepts an immediate as second argument
+static bool src_can_be_imm(OpStmt2 op) noexcept {
+  switch (op) {
+  case X86_ADC:
+  case X86_ADD:
+  case X86_AND:
+  case X86_CMP:
+  case X86_MOV:
+  case X86_OR:
+  case X86_SBB:
+  case X86_SUB:
+  case X86_TEST:
+  case X86_XOR:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// return register corresponding to var, or NoReg if var is a physical register
+static reg::Reg var_reg(const Spill &sp, Var var) noexcept {
+  const uint32_t id = var.id().val();
+  if (id < Id::FIRST || id - Id::FIRST >= sp.colors.size()) {
+    return reg::NoReg;
+  }
+  return id - Id::FIRST;
+}
+
+// return true if reg was spilled, i.e. colored >= num_colors of its class
+static bool is_spilled(const Spill &sp, reg::Reg reg) noexcept {
+  if (reg == reg::NoReg) {
+    return false;
+  }
+  const reg::RegClass cls = sp.allocator->get_class(reg);
+  const reg::Color color = sp.colors[reg];
+  return color != reg::NoColor && cls < sp.num_colors.size() && color >= sp.num_colors[cls];
+}
+
+// if var is a spilled rematerializable register, return the node defining it.
+// otherwise return Stmt2{}
+static Stmt2 remat_def(const Spill &sp, Var var) noexcept {
+  const reg::Reg reg = var_reg(sp, var);
+  if (reg < sp.remat.size() && sp.remat[reg] && is_spilled(sp, reg)) {
+    return sp.remat[reg].is<Stmt2>();
+  }
+  return Stmt2{};
+}
+
+// return true if node is the definition of a spilled rematerializable register
+static bool is_remat_def(const Spill &sp, Node node) noexcept {
+  if (node.type() != STMT_2) {
+    return false;
+  }
+  Stmt2 def = remat_def(sp, node.child_is<Var>(0));
+  return def && def == node;
+}
+
+// round n up to a multiple of align, which must be a power of two
+static constexpr uint32_t round_up(uint32_t n, uint32_t align) noexcept {
+  return (n + align - 1) & ~(align - 1);
+}
+
+Compiler &Compiler::spill_regs(View<reg::Color> num_colors, View<Node> remat) noexcept {
+  if (!*this) {
+    return *this;
+  }
+  Spill sp = {allocator_->get_colors(), num_colors, remat, allocator_, {}, Array<Node>{}, false};
+  // spilled regs were colored >= num_colors of their class:
+  // colors already share slots between non-interfering regs of the same class
+  Vars vars = func_->vars();
+  bool spilled = false;
+  for (reg::Reg reg = 0, n = reg::Reg(sp.colors.size()); reg < n; reg++) {
+    if (!is_spilled(sp, reg)) {
+      continue;
+    }
+    spilled = true;
+    if (reg < remat.size() && remat[reg]) {
+      // recomputed at each use, needs no stack slot
+      continue;
+    }
+    const reg::RegClass cls = allocator_->get_class(reg);
+    const reg::Color color = sp.colors[reg];
+    Slots &slots = sp.slots[cls];
+    if (color - num_colors[cls] >= slots.n) {
+      slots.n = color - num_colors[cls] + 1;
+    }
+    const uint32_t size = reg < vars.size() ? uint32_t(vars[reg].kind().bitsize() / 8) : 0;
+    if (size > slots.size) {
+      slots.size = size;
+    }
+  }
+  Array<RegId> saved;
+  find_callee_saved(saved);
+  if (!spilled && saved.empty()) {
+    return *this;
+  }
+  uint32_t frame_size = 0;
+  for (Slots &slots : sp.slots) {
+    if (slots.n != 0) {
+      slots.size = round_up(slots.size < min_slot_size ? min_slot_size : slots.size, min_slot_size);
+      frame_size = round_up(frame_size, slots.size < max_slot_align ? slots.size : max_slot_align);
+      slots.offset = frame_size;
+      frame_size += slots.n * slots.size;
+    }
+  }
+  // callee-saved general registers are pushed, SSE registers are saved in the stack frame
+  uint32_t n_push = 0, n_xmm = 0;
+  for (RegId id : saved) {
+    (id >= XMM0 ? n_xmm : n_push)++;
+  }
+  const uint32_t xmm_offset = round_up(frame_size, max_slot_align);
+  if (n_xmm != 0) {
+    frame_size = xmm_offset + n_xmm * xmm_save_size;
+  }
+  if (n_push != 0 || frame_size != 0) {
+    // keep RSP aligned to 16 bytes: on function entry, it is 8 modulo 16.
+    // an even number of pushes needs an 8-byte padding even without stack slots
+    const uint32_t pushed = 8 + n_push * 8;
+    frame_size = round_up(frame_size + pushed, max_slot_align) - pushed;
+  }
+  const Var rsp{Reg{Uint64, RSP}};
+  const Const frame{*func_, int32_t(frame_size)};
+  const Kind xmm_kind = Uint64.simdn(2);
+
+  size_t start = 0;
+  if (node_->size() != 0 && (*node_)[0].type() == LABEL) {
+    // the function address, i.e. the label callers jump to
+    spill_add(sp, (*node_)[start++]);
+  }
+  // function prologue: save callee-saved registers, then allocate stack frame
+  for (RegId id : saved) {
+    if (id < XMM0) {
+      spill_add(sp, Stmt1{*func_, Var{Reg{Uint64, id}}, X86_PUSH});
+    }
+  }
+  if (frame_size != 0) {
+    spill_add(sp, Stmt2{*func_, rsp, frame, X86_SUB});
+  }
+  for (uint32_t i = 0, j = 0; i < saved.size(); i++) {
+    if (saved[i] >= XMM0) {
+      const Mem slot{*func_, xmm_kind, Address{int32_t(xmm_offset + j++ * xmm_save_size), rsp}};
+      spill_add(sp, Stmt2{*func_, slot, Var{Reg{xmm_kind, saved[i]}}, X86_MOVDQU});
+    }
+  }
+  for (size_t i = start, n = node_->size(); i < n; i++) {
+    Node node = (*node_)[i];
+    sp.scratch = false;
+    if (is_remat_def(sp, node)) {
+      continue;
+    }
+    const bool is_ret = node.type() == STMT_N && node.op() == X86_RET;
+    switch (node.type()) {
+    case STMT_1:
+      node = spill(sp, node.is<Stmt1>());
+      break;
+    case STMT_2:
+      node = spill(sp, node.is<Stmt2>());
+      break;
+    case STMT_N:
+      node = spill(sp, node.is<StmtN>());
+      break;
+    default:
+      // Labels and Stmt0 cannot contain Vars
+      break;
+    }
+    if (is_ret) {
+      // function epilogue: restore callee-saved registers, then deallocate stack frame.
+      // the scratch registers, which may contain spilled return values, are caller-saved
+      for (uint32_t j = 0, k = 0; j < saved.size(); j++) {
+        if (saved[j] >= XMM0) {
+          const Mem slot{*func_, xmm_kind,
+                         Address{int32_t(xmm_offset + k++ * xmm_save_size), rsp}};
+          spill_add(sp, Stmt2{*func_, Var{Reg{xmm_kind, saved[j]}}, slot, X86_MOVDQU});
+        }
+      }
+      if (frame_size != 0) {
+        spill_add(sp, Stmt2{*func_, rsp, frame, X86_ADD});
+      }
+      for (uint32_t j = saved.size(); j != 0; j--) {
+        if (saved[j - 1] < XMM0) {
+          spill_add(sp, Stmt1{*func_, Var{Reg{Uint64, saved[j - 1]}}, X86_POP});
+        }
+      }
+    }
+    spill_add(sp, node);
+  }
+  node_->swap(sp.out);
+  // basic blocks point into node_, rebuild them
+  good_ = good_ && flowgraph_->build(*node_, *error_);
+  return *this;
+}
+
+void Compiler::spill_add(Spill &sp, Node node) noexcept {
+  if (node && !sp.out.append(node)) {
+    out_of_memory(node);
+  }
+}
+
+Expr Compiler::spill_slot(const Spill &sp, Var var) noexcept {
+  const reg::Reg reg = var_reg(sp, var);
+  if (!is_spilled(sp, reg)) {
+    return var;
+  }
+  const reg::RegClass cls = sp.allocator->get_class(reg);
+  const reg::Color color = sp.colors[reg];
+  const Slots &slots = sp.slots[cls];
+  const int32_t offset = int32_t(slots.offset + (color - sp.num_colors[cls]) * slots.size);
+  return Mem{*func_, var.kind(), Address{offset, Var{Reg{Uint64, RSP}}}};
+}
+
+void Compiler::spill_load(Spill &sp, Var dst, Var var) noexcept {
+  if (Stmt2 def = remat_def(sp, var)) {
+    spill_add(sp, Stmt2{*func_, dst, def.child_is<Expr>(1), def.op()});
+  } else {
+    spill_add(sp, Stmt2{*func_, dst, spill_slot(sp, var), Util::x86_mov(dst.kind())});
+  }
+}
+
+Expr Compiler::spill_remat(Spill &sp, Stmt2 def, bool imm_ok) noexcept {
+  Expr value = def.child_is<Expr>(1);
+  if (imm_ok && Util::is_imm32(value)) {
+    return value;
+  } else if (sp.scratch) {
+    error(def, "cannot rematerialize Var: scratch register already in use");
+    return value;
+  }
+  sp.scratch = true;
+  const Var tmp = scratch_reg(def.child_is<Var>(0).kind());
+  spill_add(sp, Stmt2{*func_, tmp, value, def.op()});
+  return tmp;
+}
+
+Expr Compiler::spill_operand(Spill &sp, Expr expr, bool imm_ok) noexcept {
+  if (Var var = expr.is<Var>()) {
+    if (Stmt2 def = remat_def(sp, var)) {
+      return spill_remat(sp, def, imm_ok);
+    }
+    return spill_slot(sp, var);
+  }
+  Mem mem = expr.is<Mem>();
+  if (!mem) {
+    if (expr.type() == MEM) {
+      error(expr, "cannot spill Vars inside non-x86_64 memory address");
+    }
+    return expr;
+  }
+  Var base = mem.child_is<Var>(2);
+  Var index = mem.child_is<Var>(3);
+  const bool base_spilled = is_spilled(sp, var_reg(sp, base));
+  const bool index_spilled = is_spilled(sp, var_reg(sp, index));
+  if (!base_spilled && !index_spilled) {
+    return expr;
+  } else if (sp.scratch) {
+    error(expr, "cannot spill Vars inside memory address: scratch register already in use");
+    return expr;
+  }
+  // load spilled address registers into scratch register
+  sp.scratch = true;
+  const Var tmp = scratch_reg(Uint64);
+  Address address{mem.label(), mem.offset(), base, index, mem.scale()};
+  if (!index_spilled) {
+    spill_load(sp, tmp, base);
+    address.base = tmp;
+  } else if (!base_spilled) {
+    spill_load(sp, tmp, index);
+    address.index = tmp;
+  } else {
+    // tmp = base + index * scale
+    Expr base_value = spill_slot(sp, base);
+    if (Stmt2 def = remat_def(sp, base)) {
+      base_value = def.child_is<Expr>(1);
+      if (!Util::is_imm32(base_value)) {
+        error(expr, "cannot rematerialize Var inside memory address: need two scratch registers");
+        return expr;
+      }
+    }
+    spill_load(sp, tmp, index);
+    if (address.scale.val() != 1) {
+      spill_add(sp, Stmt2{*func_, tmp, Mem{*func_, Uint64, Address{0, Var{}, tmp, address.scale}},
+                          X86_LEA});
+    }
+    spill_add(sp, Stmt2{*func_, tmp, base_value, X86_ADD});
+    address.base = tmp;
+    address.index = Var{};
+  }
+  return Mem{*func_, mem.kind(), address};
+}
+
+Node Compiler::spill(Spill &sp, Stmt1 st) noexcept {
+  Expr arg = st.arg();
+  Expr arg2 = spill_operand(sp, arg);
+  if (arg2 == arg) {
+    return st;
+  } else if (st.op() != X86_BSWAP || arg2.type() != MEM) {
+    return Stmt1{*func_, arg2, st.op()};
+  } else if (sp.scratch) {
+    error(st, "cannot spill Var: scratch register already in use");
+    return st;
+  }
+  // bswap requires a register
+  const Var tmp = scratch_reg(arg.kind());
+  const OpStmt2 mov = Util::x86_mov(tmp.kind());
+  spill_add(sp, Stmt2{*func_, tmp, arg2, mov});
+  spill_add(sp, Stmt1{*func_, tmp, X86_BSWAP});
+  return Stmt2{*func_, arg2, tmp, mov};
+}
+
+Node Compiler::spill(Spill &sp, Stmt2 st) noexcept {
+  const OpStmt2 op = st.op();
+  Expr dst = st.child_is<Expr>(0), src = st.child_is<Expr>(1);
+  Expr src2 = spill_operand(sp, src, src_can_be_imm(op));
+  const bool src_scratch = sp.scratch;
+  sp.scratch = false;
+  Expr dst2 = spill_operand(sp, dst);
+  const bool dst_scratch = sp.scratch;
+  if (src_scratch && dst_scratch) {
+    error(st, "cannot spill Vars inside memory addresses: need two scratch registers");
+    return st;
+  }
+  sp.scratch = src_scratch || dst_scratch;
+  if (dst2 == dst && src2 == src) {
+    return st;
+  }
+  const bool dst_mem = dst2.type() == MEM, src_mem = src2.type() == MEM;
+  // writing a 32-bit view of a 64-bit Var zero-extends it: a 32-bit store would not
+  const reg::Reg dst_reg = var_reg(sp, dst.is<Var>());
+  const Vars vars = func_->vars();
+  const Var dst_full = dst_mem && dst_reg < vars.size() ? vars[dst_reg] : Var{};
+  const bool dst_zext = dst_full && dst_full.kind().bitsize() > dst.kind().bitsize();
+  if (dst_mem && (dst_zext || dst_must_be_reg(op))) {
+    // compute into scratch register, then store it
+    if (sp.scratch) {
+      error(st, "cannot spill Var: scratch register already in use");
+      return st;
+    }
+    const Var tmp = scratch_reg(dst.kind());
+    const OpStmt2 mov = Util::x86_mov(tmp.kind());
+    if (dst_is_used(op)) {
+      spill_add(sp, Stmt2{*func_, tmp, dst2, mov});
+    }
+    if (op == X86_UCOMISD || op == X86_UCOMISS) {
+      // comparisons do not write their first argument
+      return Stmt2{*func_, tmp, src2, op};
+    }
+    spill_add(sp, Stmt2{*func_, tmp, src2, op});
+    if (dst_zext) {
+      const Var full_tmp = scratch_reg(dst_full.kind());
+      return Stmt2{*func_, spill_slot(sp, dst_full), full_tmp, Util::x86_mov(full_tmp.kind())};
+    }
+    return Stmt2{*func_, dst2, tmp, mov};
+  } else if (dst_mem && src_mem) {
+    // x86_64 instructions cannot access two memory operands: load src into scratch register.
+    // src address may already use the scratch register, since loading src consumes it
+    if (dst_scratch) {
+      error(st, "cannot spill Var: scratch register already in use");
+      return st;
+    }
+    const Var tmp = scratch_reg(src.kind());
+    spill_add(sp, Stmt2{*func_, tmp, src2, Util::x86_mov(tmp.kind())});
+    src2 = tmp;
+  }
+  return Stmt2{*func_, dst2, src2, op};
+}
+
+Node Compiler::spill(Spill &sp, StmtN st) noexcept {
+  const OpStmtN op = st.op();
+  const uint32_t n = st.children();
+  Array<Node> children;
+  bool changed = false;
+  Var ret_scratch;
+  for (uint32_t i = 0; i < n; i++) {
+    Node child = st.child(i);
+    Node child2 = child;
+    if (child.type() == STMT_N && child.op() == SET_) {
+      // results of X86_CALL_
+      child2 = spill(sp, child.is<StmtN>());
+    } else if (Var var = child.is<Var>()) {
+      Stmt2 def = remat_def(sp, var);
+      child2 = def ? def.child_is<Expr>(1) : spill_slot(sp, var);
+      if (op == X86_RET && child2 != child) {
+        // return values must be loaded before deallocating the stack frame
+        if (ret_scratch) {
+          error(st, "cannot spill more than one return value");
+          return st;
+        }
+        ret_scratch = scratch_reg(var.kind());
+        spill_load(sp, ret_scratch, var);
+        child2 = ret_scratch;
+      } else if (def && def.op() == X86_LEA) {
+        // label addresses cannot be passed as memory operands
+        child2 = spill_remat(sp, def, false);
+      }
+      // for SET_ and X86_CALL_, spilled formal registers become stack slots
+      // and spilled rematerializable registers become constants or labels
+    } else if (child.type() == MEM) {
+      child2 = spill_operand(sp, child.is<Expr>());
+    }
+    changed = changed || child2 != child;
+    if (!children.append(child2)) {
+      out_of_memory(st);
+      return st;
+    }
+  }
+  return changed ? Node{StmtN{*func_, children, op}} : Node{st};
+}
+
+} // namespace x64
+} // namespace onejit
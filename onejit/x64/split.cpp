@@ -0,0 +1,137 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * split.cpp
+ *
+ *  Created on Apr 09, 2021
+ *      Author Massimiliano Ghilardi
+ */
+
+#include <onejit/flowgraph.hpp>
+#include <onejit/func.hpp>
+#include <onejit/ir.hpp>
+#include <onejit/reg/allocator.hpp>
+#include <onejit/reg/liveness.hpp>
+#include <onejit/x64/compiler.hpp>
+#include <onejit/x64/util.hpp>
+
+namespace onejit {
+namespace x64 {
+
+// a register live across a function call
+struct Split {
+  size_t pos; // index of X86_CALL_ in compiled nodes
+  reg::Reg reg;
+};
+
+static bool is_call(Node node) noexcept {
+  return node.type() == STMT_N && node.op() == X86_CALL_;
+}
+
+static bool has_calls(View<Node> nodes) noexcept {
+  for (Node node : nodes) {
+    if (is_call(node)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Compiler &Compiler::find_call_crossing(Array<Split> &splits) noexcept {
+  BasicBlocks bbs = flowgraph_->view();
+  reg::Liveness &liveness = *liveness_;
+  BitSet &live = allocator_->get_bitset();
+  const Node *first = node_->data();
+  for (size_t i = bbs.size(); i != 0; i--) {
+    const BasicBlock &bb = bbs[i - 1];
+    live.copy(liveness.live_out(i - 1));
+    for (size_t j = bb.size(); j != 0; j--) {
+      const Node node = bb[j - 1];
+      if (!liveness.collect(node)) {
+        out_of_memory(node);
+        return *this;
+      }
+      if (is_call(node)) {
+        // registers defined by the call, i.e. its results, are not live across it
+        for (reg::Reg reg : liveness.def()) {
+          live.set(reg, false);
+        }
+        const size_t pos = size_t(bb.data() + (j - 1) - first);
+        for (size_t reg = live.find(true); reg != BitSet::NoPos; reg = live.find(true, reg + 1)) {
+          if (!splits.append(Split{pos, reg::Reg(reg)})) {
+            out_of_memory(node);
+            return *this;
+          }
+        }
+      }
+      liveness.update(live);
+    }
+  }
+  return *this;
+}
+
+Compiler &Compiler::split_live_ranges() noexcept {
+  if (!*this || !has_calls(*node_) || !allocator_->reset(func_->vars().size(), false) ||
+      !compute_liveness()) {
+    return *this;
+  }
+  // collect registers live across each call.
+  // they are collected backward, i.e. sorted by decreasing pos
+  Array<Split> splits;
+  if (!find_call_crossing(splits) || !splits) {
+    return *this;
+  }
+  // around each call, copy each register live across it to a new Var
+  // and back: the register is no longer live across the call, the new Var is.
+  // the new Var can then be allocated to a callee-saved register or spilled,
+  // while the register can use caller-saved registers in the rest of its live range
+  Array<Node> out;
+  Array<Var> copies;
+  const View<Node> nodes = *node_;
+  size_t k = splits.size();
+  for (size_t pos = 0, n = nodes.size(); pos < n; pos++) {
+    const size_t end = k;
+    while (k != 0 && splits[k - 1].pos == pos) {
+      k--;
+    }
+    copies.clear();
+    for (size_t h = end; h != k; h--) {
+      const Var var = func_->vars()[splits[h - 1].reg];
+      const Var copy{*func_, var.kind()};
+      if (!copy || !copies.append(copy) ||
+          !out.append(Stmt2{*func_, copy, var, Util::x86_mov(var.kind())})) {
+        return out_of_memory(nodes[pos]);
+      }
+    }
+    if (!out.append(nodes[pos])) {
+      return out_of_memory(nodes[pos]);
+    }
+    for (size_t h = end; h != k; h--) {
+      const Var var = func_->vars()[splits[h - 1].reg];
+      if (!out.append(Stmt2{*func_, var, copies[end - h], Util::x86_mov(var.kind())})) {
+        return out_of_memory(nodes[pos]);
+      }
+    }
+  }
+  node_->swap(out);
+  return *this;
+}
+
+Compiler &Compiler::mark_call_crossing() noexcept {
+  Array<Split> splits;
+  if (*this && has_calls(*node_) && find_call_crossing(splits)) {
+    for (const Split &split : splits) {
+      allocator_->add_call_crossing(split.reg);
+    }
+  }
+  return *this;
+}
+
+} // namespace x64
+} // namespace onejit
@@ -14,6 +14,8 @@
  */
 
 #include <onejit/assembler.hpp>
+#include <onejit/ir/const.hpp>
+#include <onejit/opstmt.hpp>
 #include <onejit/x64/inst.hpp>
 #include <onejit/x64/mem.hpp>
 #include <onejit/x64/reg.hpp>
@@ -107,5 +109,20 @@ bool Util::validate_mem(Assembler &dst, Mem mem) {
   return ok;
 }
 
+bool Util::is_imm32(Expr expr) noexcept {
+  if (Const c = expr.is<Const>()) {
+    const int64_t val = c.val().int64();
+    return !c.kind().is_float() && val == int64_t(int32_t(val));
+  }
+  return false;
+}
+
+OpStmt2 Util::x86_mov(Kind kind) noexcept {
+  if (kind != kind.nosimd()) {
+    return X86_MOVDQU;
+  }
+  return kind == Float64 ? X86_MOVSD : kind == Float32 ? X86_MOVSS : X86_MOV;
+}
+
 } // namespace x64
 } // namespace onejit
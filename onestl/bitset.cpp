@@ -250,4 +250,57 @@ void BitSet::copy(const BitSet &src) {
   }
 }
 
+bool BitSet::set_union(const BitSet &other) {
+  ONESTL_BOUNDS_TINY(other.size(), ==, size());
+  const size_t n = words();
+  T changed = 0;
+  for (size_t i = 0; i < n; i++) {
+    const T prev = data_[i];
+    const T curr = prev | other.data_[i];
+    data_[i] = curr;
+    // ignore bits beyond size_
+    changed |= (prev ^ curr) & (i + 1 == n ? last_word_mask() : ~T(0));
+  }
+  return changed != 0;
+}
+
+void BitSet::set_difference(const BitSet &other) {
+  ONESTL_BOUNDS_TINY(other.size(), ==, size());
+  for (size_t i = 0, n = words(); i < n; i++) {
+    data_[i] &= ~other.data_[i];
+  }
+}
+
+bool BitSet::operator==(const BitSet &other) const noexcept {
+  if (size_ != other.size_) {
+    return false;
+  }
+  const size_t n = words();
+  if (n == 0) {
+    return true;
+  }
+  for (size_t i = 0; i + 1 < n; i++) {
+    if (data_[i] != other.data_[i]) {
+      return false;
+    }
+  }
+  // ignore bits beyond size_
+  return ((data_[n - 1] ^ other.data_[n - 1]) & last_word_mask()) == 0;
+}
+
+size_t BitSet::count() const noexcept {
+  size_t ret = 0;
+  for (size_t i = 0, n = words(); i < n; i++) {
+    T bits = data_[i];
+    if (i + 1 == n) {
+      bits &= last_word_mask();
+    }
+    while (bits) {
+      bits &= bits - 1;
+      ret++;
+    }
+  }
+  return ret;
+}
+
 } // namespace onestl
@@ -16,23 +16,60 @@
 #include <onestl/graph.hpp>
 #include <onestl/mem.hpp>
 
+#include <cstring> // memcpy(), memmove(), memset()
+
 namespace onestl {
 
 Graph::~Graph() noexcept {
+  destroy_adj();
+}
+
+void Graph::destroy_adj() noexcept {
+  for (const Adj &adj : adj_) {
+    mem::free(adj.data);
+  }
+  adj_.clear();
 }
 
-bool Graph::reset(Size nodes) noexcept {
+bool Graph::reset(Size nodes, bool sparse) noexcept {
   size_t newn = nodes;
   size_t oldn = degree_.size();
-  if (degree_.resize(newn)) {
-    if (bits_.resize(newn * newn)) {
-      bits_.fill(false);
-      std::memset(degree_.data(), '\0', newn * sizeof(Degree));
-      return true;
+  if (!degree_.resize(newn)) {
+    return false;
+  }
+  if (sparse) {
+    // reuse existing adjacency vectors
+    for (Adj &adj : adj_) {
+      adj.size = 0;
     }
-    degree_.resize(oldn);
+    const size_t olda = adj_.size();
+    // free adjacency vectors of removed nodes
+    for (size_t i = newn; i < olda; i++) {
+      mem::free(adj_[i].data);
+      adj_.set(i, Adj{});
+    }
+    if (!adj_.resize(newn)) {
+      degree_.resize(oldn);
+      return false;
+    }
+    for (size_t i = olda; i < newn; i++) {
+      adj_.set(i, Adj{});
+    }
+    // release dense representation memory
+    BitSet{}.swap(bits_);
+  } else {
+    if (!bits_.resize(newn * newn)) {
+      degree_.resize(oldn);
+      return false;
+    }
+    bits_.fill(false);
+    destroy_adj();
+  }
+  sparse_ = sparse;
+  if (newn) {
+    std::memset(degree_.data(), '\0', newn * sizeof(Degree));
   }
-  return false;
+  return true;
 }
 
 bool Graph::operator()(Node a, Node b) const noexcept {
@@ -42,28 +79,49 @@ bool Graph::operator()(Node a, Node b) const noexcept {
   const Size n = size();
   if (a >= n) {
     return false;
+  } else if (sparse_) {
+    return sparse_get(a, b);
   }
   return bits_[a + b * n];
 }
 
-void Graph::set(Node a, Node b, bool value) noexcept {
+bool Graph::set(Node a, Node b, bool value) noexcept {
   if (a < b) {
     mem::swap(a, b);
   }
   const size_t n = size(); // not Size, "* n" below could overflow
-  if (a < n) {
-    size_t offset = a + b * n;
-    bool prev = bits_[offset];
-    if (Degree delta = Degree(value) - Degree(prev)) {
-      degree_.data()[a] += delta;
-      degree_.data()[b] += delta; // even if a == b
-      bits_.set(offset, value);
-      if (a != b) {
-        // set both a->b and b->a
-        bits_.set(b + a * n, value);
+  if (a >= n) {
+    return true;
+  }
+  if (sparse_) {
+    if (value == sparse_get(a, b)) {
+      return true;
+    } else if (value) {
+      if (!sparse_insert(a, b) || (a != b && !sparse_insert(b, a))) {
+        sparse_erase(a, b);
+        return false;
       }
+    } else {
+      sparse_erase(a, b);
+      sparse_erase(b, a); // does nothing if a == b
+    }
+    const Degree delta = value ? Degree(1) : Degree(-1);
+    degree_.data()[a] += delta;
+    degree_.data()[b] += delta; // even if a == b
+    return true;
+  }
+  size_t offset = a + b * n;
+  bool prev = bits_[offset];
+  if (Degree delta = Degree(value) - Degree(prev)) {
+    degree_.data()[a] += delta;
+    degree_.data()[b] += delta; // even if a == b
+    bits_.set(offset, value);
+    if (a != b) {
+      // set both a->b and b->a
+      bits_.set(b + a * n, value);
     }
   }
+  return true;
 }
 
 Graph::Node Graph::first_set(Node node, Node first_neighbor) const noexcept {
@@ -72,6 +130,11 @@ Graph::Node Graph::first_set(Node node, Node first_neighbor) const noexcept {
     // degree(node) == 0 also catches node >= n
     return NoPos;
   }
+  if (sparse_) {
+    const Adj &adj = adj_[node];
+    Size pos = lower_bound(adj, first_neighbor);
+    return pos < adj.size ? adj.data[pos] : NoPos;
+  }
   size_t y_offset = node * n;
   size_t offset = bits_.find(true, y_offset + first_neighbor, y_offset + n);
   // NoPos is uint32_t(-1), while BitSet::NoPos is size_t(-1)
@@ -82,6 +145,22 @@ Graph::Node Graph::first_set(Node node, Node first_neighbor) const noexcept {
 }
 
 void Graph::remove(Node node) noexcept {
+  if (sparse_) {
+    if (node < size()) {
+      Adj adj = adj_[node];
+      for (Size i = 0; i < adj.size; i++) {
+        const Node other = adj.data[i];
+        if (other != node) {
+          sparse_erase(other, node);
+          degree_.data()[other]--;
+        }
+      }
+      degree_.data()[node] = 0;
+      adj.size = 0;
+      adj_.set(node, adj);
+    }
+    return;
+  }
   Degree deg = degree(node);
   Node other = Node(0);
   while (deg && (other = first_set(node, other)) != NoPos) {
@@ -95,11 +174,84 @@ bool Graph::dup(const Graph &other) noexcept {
   if (this == &other) {
     return true;
   }
-  if (!reset(other.size())) {
+  if (!reset(other.size(), other.sparse_)) {
     return false;
   }
-  bits_.copy(other.bits_);     // noexcept
   degree_.copy(other.degree_); // noexcept
+  if (!sparse_) {
+    bits_.copy(other.bits_); // noexcept
+    return true;
+  }
+  for (size_t i = 0, n = adj_.size(); i < n; i++) {
+    Adj adj = adj_[i];
+    const Adj &src = other.adj_[i];
+    if (adj.cap < src.size) {
+      Node *data = mem::realloc(adj.data, src.size);
+      if (!data) {
+        return false;
+      }
+      adj.data = data;
+      adj.cap = src.size;
+    }
+    if (src.size) {
+      std::memcpy(adj.data, src.data, src.size * sizeof(Node));
+    }
+    adj.size = src.size;
+    adj_.set(i, adj);
+  }
+  return true;
+}
+
+Graph::Size Graph::lower_bound(const Adj &adj, Node node) noexcept {
+  Size lo = 0, hi = adj.size;
+  while (lo < hi) {
+    Size mid = lo + (hi - lo) / 2;
+    if (adj.data[mid] < node) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+bool Graph::sparse_get(Node a, Node b) const noexcept {
+  const Adj &adj = adj_[a];
+  const Size pos = lower_bound(adj, b);
+  return pos < adj.size && adj.data[pos] == b;
+}
+
+bool Graph::sparse_insert(Node a, Node b) noexcept {
+  Adj adj = adj_[a];
+  const Size pos = lower_bound(adj, b);
+  if (pos < adj.size && adj.data[pos] == b) {
+    return true;
+  }
+  if (adj.size == adj.cap) {
+    const Size cap = adj.cap < 4 ? 4 : adj.cap * 2;
+    Node *data = mem::realloc(adj.data, cap);
+    if (!data) {
+      return false;
+    }
+    adj.data = data;
+    adj.cap = cap;
+  }
+  std::memmove(adj.data + pos + 1, adj.data + pos, (adj.size - pos) * sizeof(Node));
+  adj.data[pos] = b;
+  adj.size++;
+  adj_.set(a, adj);
+  return true;
+}
+
+bool Graph::sparse_erase(Node a, Node b) noexcept {
+  Adj adj = adj_[a];
+  const Size pos = lower_bound(adj, b);
+  if (pos >= adj.size || adj.data[pos] != b) {
+    return false;
+  }
+  adj.size--;
+  std::memmove(adj.data + pos, adj.data + pos + 1, (adj.size - pos) * sizeof(Node));
+  adj_.set(a, adj);
   return true;
 }
 
@@ -33,28 +33,52 @@ private:
   void dump_and_clear_code();
 
   // called by run()
-  void stl_bitset(); // test onestl::BitSet
-  void stl_graph();  // test onestl::Graph
+  void stl_bitset();           // test onestl::BitSet
+  void stl_graph(bool sparse); // test onestl::Graph
   void arch();
   void kind();
   void const_expr() const;
   void simple_expr();
   void nested_expr();
+  void intern_expr();
   void x64_expr();
   void eval_expr();
   void eval_expr_kind(Kind kind);
   void func_fib();
   void func_loop();
+  void func_loop_signed();
   void func_switch1();
   void func_switch2();
+  void func_switch3();
+  void func_switch4();
   void func_cond();
   void func_and_or();
+  void func_coalesce();
+  void func_spill();
+  void func_spill_float();
+  void func_remat();
+  void func_gvn();
+  void func_sccp();
+  void func_dce();
+  void func_licm();
+  void func_isel();
+  void func_isel_fixed();
+  void func_lea();
+  void func_select();
+  void func_div64();
   void optimize();
   void optimize_expr_kind(Kind kind);
   void optimize_assign_kind(Kind kind);
+  void optimize_div_kind(Kind kind);
   void regallocator();
+  void regallocator_linear();
+  void regallocator_classes();
+  void execarena();
+  void linker();
+  void x64_relax();
+  void x64_jump_table();
 
-  void compile(Func &func);
+  void compile(Func &func, Opt flags = OptAll);
 
   Code holder;
   Func func;
@@ -57,6 +57,18 @@ void Test::eval_expr_kind(Kind kind) {
   TEST(is_const(expr), ==, true);
   result = eval(expr);
   TEST(result, ==, expected);
+
+  if (!kind.is_float()) {
+    // run eval() on the expression (mulhi max max):
+    // high half of (2^N-1)^2 is 2^N-2, high half of (2^(N-1)-1)^2 is 2^(N-2)-1
+    const Value max = Value::max(kind);
+    expr = Binary{f, MULHI, Const{f, max}, Const{f, max}};
+    expected = kind.is_unsigned() ? max - Value::one(kind) : max >> Value::one(kind);
+
+    TEST(is_const(expr), ==, true);
+    result = eval(expr);
+    TEST(result, ==, expected);
+  }
 }
 
 } // namespace onejit
@@ -0,0 +1,227 @@
+/*
+ * onejit - JIT compiler in C++
+ *
+ * Copyright (C) 2018-2021 Massimiliano Ghilardi
+ *
+ *     This Source Code Form is subject to the terms of the Mozilla Public
+ *     License, v. 2.0. If a copy of the MPL was not distributed with this
+ *     file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * test_execarena.cpp
+ *
+ *  Created on Apr 02, 2021
+ *      Author Massimiliano Ghilardi
+ */
+
+#include "test.hpp"
+
+#include <onejit/assembler.hpp>
+#include <onejit/execarena.hpp>
+#include <onejit/func.hpp>
+#include <onejit/ir/stmt1.hpp>
+#include <onejit/ir/stmtn.hpp>
+#include <onejit/linker.hpp>
+#include <onejit/x64.hpp>
+
+namespace onejit {
+
+void Test::execarena() {
+#if defined(__unix__) && (defined(__x86_64__) || defined(__amd64__))
+  ExecArena arena{4096};
+
+  Assembler assembler;
+  // mov $42, %eax
+  // ret
+  assembler.add({0xb8, 0x2a, 0x00, 0x00, 0x00, 0xc3});
+  TEST(bool(assembler), ==, true);
+
+  Func &f = func.reset(&holder, Name{&holder, "answer"}, FuncType{&holder, {}, {Int32}});
+  TEST(f.address().address(), ==, 0);
+
+  const void *addr = arena.add(f, assembler.bytes());
+  TEST(bool(addr), ==, true);
+  TEST(f.address().address(), ==, uint64_t(reinterpret_cast<uintptr_t>(addr)));
+  TEST(arena.contains(addr), ==, true);
+
+  // lea (%rdi,%rsi,1), %eax
+  // ret
+  assembler.clear();
+  assembler.add({0x8d, 0x04, 0x37, 0xc3});
+  const void *addr2 = arena.add(assembler.bytes());
+  TEST(bool(addr2), ==, true);
+  // both functions are batched in the same region
+  TEST(uintptr_t(addr2) % ExecArena::func_align, ==, 0);
+  TEST(uintptr_t(addr2) - uintptr_t(addr), ==, ExecArena::func_align);
+
+  TEST(arena.seal(), ==, true);
+
+  int (*answer)() = ExecArena::to_func<int (*)()>(addr);
+  int (*sum)(int, int) = ExecArena::to_func<int (*)(int, int)>(addr2);
+  TEST(answer(), ==, 42);
+  TEST(sum(7, 11), ==, 18);
+
+  // adding after seal() must not touch already executable pages
+  assembler.clear();
+  assembler.add({0x31, 0xc0, 0xc3}); // xor %eax, %eax ; ret
+  const void *addr3 = arena.add(assembler.bytes());
+  TEST(bool(addr3), ==, true);
+  TEST(arena.seal(), ==, true);
+
+  int (*zero)() = ExecArena::to_func<int (*)()>(addr3);
+  TEST(zero(), ==, 0);
+  TEST(answer(), ==, 42);
+  TEST(bool(arena), ==, true);
+
+  holder.clear();
+#endif
+}
+
+void Test::linker() {
+#if defined(__unix__) && (defined(__x86_64__) || defined(__amd64__))
+  FuncType ftype{&holder, {}, {Int32}};
+  Func callee{&holder, Name{&holder, "callee"}, ftype};
+  Func caller{&holder, Name{&holder, "caller"}, ftype};
+  Func other{&holder, Name{&holder, "other"}, ftype};
+
+  Assembler asm_callee, asm_caller, asm_other;
+
+  // mov $42, %eax ; ret
+  asm_callee.x64(callee.address());
+  asm_callee.add({0xb8, 0x2a, 0x00, 0x00, 0x00, 0xc3});
+
+  // jmp l1 ; ud2 ; l1: call callee ; ret
+  Label l1{caller};
+  asm_caller.x64(caller.address());
+  asm_caller.x64(Stmt1{caller, l1, X86_JMP});
+  asm_caller.add({0x0f, 0x0b});
+  asm_caller.x64(l1);
+  asm_caller.x64(Stmt1{caller, callee.address(), X86_CALL});
+  asm_caller.add(0xc3);
+  TEST(asm_caller.labels().size(), ==, 2);
+  TEST(asm_caller.relocations().size(), ==, 2);
+
+  // jmp to a label that is never defined
+  asm_other.x64(other.address());
+  asm_other.x64(Stmt1{other, Label{other}, X86_JMP});
+
+  ExecArena arena;
+  Linker linker;
+  linker.add(caller, asm_caller).add(callee, asm_callee).add(other, asm_other);
+  TEST(linker.link(arena), ==, true);
+  TEST(linker.errors().size(), ==, 0);
+  TEST(linker.unresolved().size(), ==, 1);
+  TEST(arena.seal(), ==, true);
+
+  TEST(callee.address().address(), !=, 0);
+  TEST(l1.address(), ==, caller.address().address() + 7);
+
+  int (*f)() = ExecArena::to_func<int (*)()>(
+      reinterpret_cast<const void *>(uintptr_t(caller.address().address())));
+  TEST(f(), ==, 42);
+
+  holder.clear();
+#endif
+}
+
+void Test::x64_relax() {
+#if defined(__unix__) && (defined(__x86_64__) || defined(__amd64__))
+  Func &f = func.reset(&holder, Name{&holder, "relax"}, FuncType{&holder, {}, {Int32}});
+  Label l1{f}, l2{f}, l3{f};
+
+  Assembler assembler;
+  assembler.x64(f.address());
+  assembler.x64(Stmt1{f, l1, X86_JMP}); // short
+  assembler.add({0x0f, 0x0b});          // ud2
+  assembler.x64(l1);
+  assembler.add({0x31, 0xc0});         // xor %eax, %eax
+  assembler.x64(Stmt1{f, l2, X86_JE}); // long: must skip 200 bytes
+  assembler.add({0x0f, 0x0b});         // ud2
+  for (size_t i = 0; i < 198; i++) {
+    assembler.add(0x90); // nop
+  }
+  assembler.x64(l2);
+  assembler.add({0xb8, 0x07, 0x00, 0x00, 0x00}); // mov $7, %eax
+  assembler.add({0xb9, 0x03, 0x00, 0x00, 0x00}); // mov $3, %ecx
+  assembler.x64(l3);
+  assembler.add({0x83, 0xc0, 0x02});    // add $2, %eax
+  assembler.add({0xff, 0xc9});          // dec %ecx
+  assembler.x64(Stmt1{f, l3, X86_JNE}); // short, backward
+  assembler.add(0xc3);                  // ret
+
+  TEST(assembler.size(), ==, 237);
+  assembler.x64_relax();
+  TEST(bool(assembler), ==, true);
+  TEST(assembler.size(), ==, 230);
+
+  Bytes bytes = assembler.bytes();
+  TEST(bytes[0], ==, 0xeb);
+  TEST(bytes[4], ==, 0x31);
+  TEST(bytes[6], ==, 0x0f);
+  TEST(bytes[7], ==, 0x84);
+  TEST(bytes[227], ==, 0x75);
+  TEST(bytes[229], ==, 0xc3);
+
+  ExecArena arena;
+  Linker linker;
+  TEST(linker.add(f, assembler).link(arena), ==, true);
+  TEST(linker.unresolved().size(), ==, 0);
+  TEST(arena.seal(), ==, true);
+
+  Bytes linked{reinterpret_cast<const uint8_t *>(uintptr_t(f.address().address())), 230};
+  TEST(linked[1], ==, 0x02);   // jmp l1
+  TEST(linked[8], ==, 200);    // je l2
+  TEST(linked[228], ==, 0xf9); // jne l3
+
+  int (*relaxed)() = ExecArena::to_func<int (*)()>(linked.data());
+  TEST(relaxed(), ==, 13);
+
+  holder.clear();
+#endif
+}
+
+void Test::x64_jump_table() {
+#if defined(__unix__) && (defined(__x86_64__) || defined(__amd64__))
+  FuncType ftype{&holder, {Int32}, {Int32}};
+  Func &f = func.reset(&holder, Name{&holder, "jump_table"}, ftype);
+  Label table{f};
+  Label labels[] = {Label{f}, Label{f}, Label{f}};
+  const Var rax{x64::Reg{Uint64, x64::RAX}}, rcx{x64::Reg{Uint64, x64::RCX}};
+
+  Assembler assembler;
+  assembler.x64(f.address());
+  assembler.add({0x48, 0x63, 0xc7}); // movslq %edi, %rax
+  assembler.add({0x48, 0x8d, 0x0d, 0x00, 0x00, 0x00, 0x00}).add_relocation(table);
+  // jmp *(%rcx,%rax,8) followed by the table
+  const x64::Mem mem{f, Uint64, x64::Address{table, 0, rcx, rax, x64::Scale8}};
+  assembler.x64(JumpTable{f, mem, Labels{labels, 3}});
+  for (uint8_t i = 0; i < 3; i++) {
+    assembler.x64(labels[i]);
+    assembler.add({0xb8, uint8_t(10 * (i + 1)), 0x00, 0x00, 0x00, 0xc3}); // mov $.., %eax ; ret
+  }
+  TEST(bool(assembler), ==, true);
+  TEST(assembler.size(), ==, 3 + 7 + 3 + 3 * 8 + 3 * 6);
+  TEST(assembler.relocations().size(), ==, 4);
+
+  Bytes bytes = assembler.bytes();
+  TEST(bytes[10], ==, 0xff);
+  TEST(bytes[11], ==, 0x24);
+  TEST(bytes[12], ==, 0xc1);
+
+  ExecArena arena;
+  Linker linker;
+  TEST(linker.add(f, assembler).link(arena), ==, true);
+  TEST(linker.unresolved().size(), ==, 0);
+  TEST(arena.seal(), ==, true);
+  TEST(table.address(), ==, f.address().address() + 13);
+
+  int (*jump)(int) = ExecArena::to_func<int (*)(int)>(
+      reinterpret_cast<const void *>(uintptr_t(f.address().address())));
+  TEST(jump(0), ==, 10);
+  TEST(jump(1), ==, 20);
+  TEST(jump(2), ==, 30);
+
+  holder.clear();
+#endif
+}
+
+} // namespace onejit
@@ -197,4 +197,43 @@ void Test::nested_expr() {
   holder.clear();
 }
 
+void Test::intern_expr() {
+  for (uint8_t i = eInt8; i <= eUint64; i++) {
+    Kind k{i};
+    Var v1{func, k}, v2{func, k};
+
+    // without interning, equal trees are distinct but have equal deep_hash()
+    Expr b1 = Tuple{func, ADD, Const{func, Imm{k, 100}}, v1};
+    Expr b2 = Tuple{func, ADD, Const{func, Imm{k, 100}}, v1};
+    TEST(b1, !=, b2);
+    TEST(b1.deep_equal(b2), ==, true);
+    TEST(b1.deep_hash(), ==, b2.deep_hash());
+
+    holder.set_interning(true);
+    TEST(holder.interning(), ==, true);
+
+    // with interning, equal trees are identical and stored once
+    Expr c1 = Const{func, Imm{k, 100}};
+    Expr u1 = Unary{func, XOR1, Binary{func, SHL, Tuple{func, MUL, c1, v1}, v2}};
+    const Offset length = holder.length();
+    Expr c2 = Const{func, Imm{k, 100}};
+    Expr u2 = Unary{func, XOR1, Binary{func, SHL, Tuple{func, MUL, c2, v1}, v2}};
+    TEST(c1, ==, c2);
+    TEST(u1, ==, u2);
+    TEST(holder.length(), ==, length);
+
+    // different trees are still distinct
+    Expr u3 = Unary{func, XOR1, Binary{func, SHL, Tuple{func, MUL, c2, v2}, v2}};
+    TEST(u1, !=, u3);
+    TEST(u1.deep_equal(u3), ==, false);
+
+    holder.set_interning(false);
+    Expr u4 = Unary{func, XOR1, Binary{func, SHL, Tuple{func, MUL, c2, v1}, v2}};
+    TEST(u1, !=, u4);
+    TEST(u1.deep_equal(u4), ==, true);
+  }
+  // dump_and_clear_code();
+  holder.clear();
+}
+
 } // namespace onejit
@@ -54,7 +54,10 @@ void Test::func_fib() {
     (return 1))";
   TEST(to_string(f.get_body()), ==, expected);
 
+  // callee-saved registers depend on the ABI
+  comp.configure(CheckNone, Abi_x64_sysv);
   compile(f);
+  comp.configure(CheckNone);
 
   // (- x 1) becomes (+ x uint64_t(-1))
   // (- x 2) becomes (+ x uint64_t(-2))
@@ -69,16 +72,17 @@ void Test::func_fib() {
     (= var1005_ul (call label_0 var1004_ul))\n\
     (= var1001_ul (+ var1003_ul var1005_ul))\n\
     (return var1001_ul)\n\
-    (goto label_2)\n\
     label_1\n\
-    (= var1001_ul 1)\n\
-    (return var1001_ul)\n\
-    label_2\n\
-    (return var1001_ul))";
+    (return 1))";
   TEST(to_string(f.get_compiled(NOARCH)), ==, expected);
 
+  // two pushed callee-saved registers and no stack slots:
+  // RSP still needs 8 bytes of padding to be aligned to 16 bytes at each call
   expected = "(block\n\
     label_0\n\
+    (x86_push rbx)\n\
+    (x86_push rbp)\n\
+    (x86_sub rsp 8)\n\
     (_set var1000_ul)\n\
     (x86_cmp var1000_ul 2)\n\
     (x86_jbe label_1)\n\
@@ -87,24 +91,37 @@ void Test::func_fib() {
     (x86_lea var1004_ul (x86_mem_p -2 var1000_ul))\n\
     (x86_call_ label_0 (_set var1005_ul) var1004_ul)\n\
     (x86_lea var1001_ul (x86_mem_p var1003_ul var1005_ul 1))\n\
+    (x86_add rsp 8)\n\
+    (x86_pop rbp)\n\
+    (x86_pop rbx)\n\
     (x86_ret var1001_ul)\n\
-    (x86_jmp label_2)\n\
     label_1\n\
-    (x86_mov var1001_ul 1)\n\
-    (x86_ret var1001_ul)\n\
-    label_2\n\
-    (x86_ret var1001_ul))";
+    (x86_add rsp 8)\n\
+    (x86_pop rbp)\n\
+    (x86_pop rbx)\n\
+    (x86_ret 1))";
   TEST(to_string(f.get_compiled(X64)), ==, expected);
 
+  // var1000 and var1003 are live across calls: they are split around each call,
+  // then coalesced back and allocated to callee-saved registers, i.e. colors >= 8
+  View<reg::Color> colors = comp.allocator_.get_colors();
+  TEST(colors[0], >=, 8);
+  TEST(colors[0], <, 14);
+  TEST(colors[3], >=, 8);
+  TEST(colors[3], <, 14);
+
   expected = "(flowgraph\n\
     (bb_0\n\
         (nodes\n\
             label_0\n\
+            (x86_push rbx)\n\
+            (x86_push rbp)\n\
+            (x86_sub rsp 8)\n\
             (_set var1000_ul)\n\
             (x86_cmp var1000_ul 2)\n\
             (x86_jbe label_1)\n\
         )\n\
-        (next bb_1 bb_3)\n\
+        (next bb_1 bb_2)\n\
     )\n\
     (bb_1\n\
         (prev bb_0)\n\
@@ -114,28 +131,20 @@ void Test::func_fib() {
             (x86_lea var1004_ul (x86_mem_p -2 var1000_ul))\n\
             (x86_call_ label_0 (_set var1005_ul) var1004_ul)\n\
             (x86_lea var1001_ul (x86_mem_p var1003_ul var1005_ul 1))\n\
+            (x86_add rsp 8)\n\
+            (x86_pop rbp)\n\
+            (x86_pop rbx)\n\
             (x86_ret var1001_ul)\n\
         )\n\
     )\n\
     (bb_2\n\
-        (nodes\n\
-            (x86_jmp label_2)\n\
-        )\n\
-        (next bb_4)\n\
-    )\n\
-    (bb_3\n\
         (prev bb_0)\n\
         (nodes\n\
             label_1\n\
-            (x86_mov var1001_ul 1)\n\
-            (x86_ret var1001_ul)\n\
-        )\n\
-    )\n\
-    (bb_4\n\
-        (prev bb_2)\n\
-        (nodes\n\
-            label_2\n\
-            (x86_ret var1001_ul)\n\
+            (x86_add rsp 8)\n\
+            (x86_pop rbp)\n\
+            (x86_pop rbx)\n\
+            (x86_ret 1)\n\
         )\n\
     )\n\
 )";
@@ -198,7 +207,6 @@ void Test::func_loop() {
     label_2\n\
     (asm_cmp var1002_ul var1000_ul)\n\
     (asm_jb label_1)\n\
-    label_3\n\
     (return var1001_ul))";
   TEST(to_string(f.get_compiled(NOARCH)), ==, expected);
 
@@ -234,13 +242,173 @@ void Test::func_loop() {
     (bb_3\n\
         (prev bb_2)\n\
         (nodes\n\
-            label_3\n\
             (x86_ret var1001_ul)\n\
         )\n\
     )\n\
 )";
   TEST(to_string(comp.flowgraph_), ==, expected);
 
+  // var1000 = reg 0, var1001 = reg 1, var1002 = reg 2
+  const reg::Liveness &liveness = comp.liveness_;
+  TEST(liveness.size(), ==, 4);
+  TEST(liveness.live_in(0).count(), ==, 0);
+  TEST(liveness.live_out(0).count(), ==, 3);
+  for (size_t j = 1; j <= 2; j++) {
+    TEST(liveness.live_in(j).count(), ==, 3);
+    TEST(liveness.live_out(j).count(), ==, 3);
+  }
+  TEST(liveness.live_in(3).count(), ==, 1);
+  TEST(liveness.live_in(3)[1], ==, true);
+  TEST(liveness.live_out(3).count(), ==, 0);
+
+  // positions are node indexes in the flowgraph above
+  TEST(comp.liveness_.compute_intervals(comp.flowgraph_.view()), ==, true);
+  View<reg::Interval> intervals = liveness.intervals();
+  TEST(intervals.size(), ==, 3);
+  TEST(intervals[0].start, ==, 1);
+  TEST(intervals[0].end, ==, 10);
+  TEST(intervals[1].start, ==, 2);
+  TEST(intervals[1].end, ==, 11);
+  TEST(intervals[2].start, ==, 3);
+  TEST(intervals[2].end, ==, 10);
+
+  // bb_0 jumps to bb_2, which dominates bb_1 and bb_3
+  Array<uint32_t> idom;
+  TEST(comp.flowgraph_.dominators(idom), ==, true);
+  TEST(idom.size(), ==, 4);
+  TEST(idom[0], ==, 0);
+  TEST(idom[1], ==, 2);
+  TEST(idom[2], ==, 0);
+  TEST(idom[3], ==, 2);
+
+  // bb_1 and bb_2 are the loop: bb_1 jumps back to bb_2, which dominates it
+  Array<uint32_t> depth;
+  TEST(comp.flowgraph_.loop_depth(depth), ==, true);
+  TEST(depth.size(), ==, 4);
+  TEST(depth[0], ==, 0);
+  TEST(depth[1], ==, 1);
+  TEST(depth[2], ==, 1);
+  TEST(depth[3], ==, 0);
+
+  // the loop header bb_2 comes first
+  Array<uint32_t> loop_start, loop_blocks;
+  TEST(comp.flowgraph_.natural_loops(idom, loop_start, loop_blocks), ==, true);
+  TEST(loop_start.size(), ==, 2);
+  TEST(loop_blocks.size(), ==, 2);
+  TEST(loop_blocks[0], ==, 2);
+  TEST(loop_blocks[1], ==, 1);
+
+  // convert compiled code to SSA form and back
+  Node compiled = f.get_compiled(NOARCH);
+  comp.node_.clear();
+  for (uint32_t k = 0; k < compiled.children(); k++) {
+    comp.node_.append(compiled.child(k));
+  }
+  comp.to_ssa();
+  expected = "(block\n\
+    label_0\n\
+    (_set var1003_ul)\n\
+    (= var1004_ul 0)\n\
+    (= var1005_ul 0)\n\
+    (goto label_2)\n\
+    label_1\n\
+    (= var1008_ul (+ var1006_ul var1007_ul))\n\
+    (= var1009_ul (+ var1007_ul 1))\n\
+    label_2\n\
+    (_phi var1006_ul var1004_ul var1008_ul)\n\
+    (_phi var1007_ul var1005_ul var1009_ul)\n\
+    (asm_cmp var1007_ul var1003_ul)\n\
+    (asm_jb label_1)\n\
+    (return var1006_ul))";
+  TEST(to_string(Block{f, comp.node_}), ==, expected);
+
+  comp.from_ssa();
+  TEST(to_string(Block{f, comp.node_}), ==, to_string(compiled));
+
+  // dump_and_clear_code();
+  holder.clear();
+}
+
+void Test::func_loop_signed() {
+  Kind kind = Int64;
+  Func &f = func.reset(&holder, Name{&holder, "loop_signed"}, FuncType{&holder, {kind}, {kind}});
+  Var n = f.param(0);
+  Var total = f.result(0);
+  Var i{f, kind};
+  Const zero = Zero(kind);
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * int64_t loop_signed(int64_t n) {
+   *   int64_t total = 0, i;
+   *   for (i = 0; i <= n; i++) {
+   *     total += i;
+   *   }
+   *   return total;
+   * }
+   */
+
+  f.set_body( //
+      Block{f,
+            {Assign{f, ASSIGN, total, zero},
+             For{
+                 f,                              //
+                 Assign{f, ASSIGN, i, zero},     // init
+                 Binary{f, LEQ, i, n},           // test
+                 Inc{f, i},                      // post
+                 Assign{f, ADD_ASSIGN, total, i} // body
+             },
+             Return{f, total}}});
+
+  compile(f);
+
+  // x86_jle must be recognized as a conditional jump:
+  // bb_1 is reached from bb_2 and jumps back to it
+  Chars expected = "(flowgraph\n\
+    (bb_0\n\
+        (nodes\n\
+            label_0\n\
+            (_set var1000_l)\n\
+            (x86_mov var1001_l 0)\n\
+            (x86_mov var1002_l 0)\n\
+            (x86_jmp label_2)\n\
+        )\n\
+        (next bb_2)\n\
+    )\n\
+    (bb_1\n\
+        (prev bb_2)\n\
+        (nodes\n\
+            label_1\n\
+            (x86_add var1001_l var1002_l)\n\
+            (x86_inc var1002_l)\n\
+        )\n\
+        (next bb_2)\n\
+    )\n\
+    (bb_2\n\
+        (prev bb_0 bb_1)\n\
+        (nodes\n\
+            label_2\n\
+            (x86_cmp var1002_l var1000_l)\n\
+            (x86_jle label_1)\n\
+        )\n\
+        (next bb_3 bb_1)\n\
+    )\n\
+    (bb_3\n\
+        (prev bb_2)\n\
+        (nodes\n\
+            (x86_ret var1001_l)\n\
+        )\n\
+    )\n\
+)";
+  TEST(to_string(comp.flowgraph_), ==, expected);
+
+  Array<uint32_t> depth;
+  TEST(comp.flowgraph_.loop_depth(depth), ==, true);
+  TEST(depth.size(), ==, 4);
+  TEST(depth[1], ==, 1);
+  TEST(depth[2], ==, 1);
+
   // dump_and_clear_code();
   holder.clear();
 }
@@ -305,11 +473,9 @@ void Test::func_switch1() {
     label_2\n\
     (asm_cmp var1000_ul 1)\n\
     (asm_jne label_4)\n\
-    label_3\n\
     (= var1001_ul 2)\n\
     (goto label_1)\n\
     label_4\n\
-    label_5\n\
     (= var1001_ul (+ var1000_ul 1))\n\
     label_1\n\
     (return var1001_ul))";
@@ -345,7 +511,6 @@ void Test::func_switch1() {
     (bb_3\n\
         (prev bb_2)\n\
         (nodes\n\
-            label_3\n\
             (x86_mov var1001_ul 2)\n\
             (x86_jmp label_1)\n\
         )\n\
@@ -355,7 +520,6 @@ void Test::func_switch1() {
         (prev bb_2)\n\
         (nodes\n\
             label_4\n\
-            label_5\n\
             (x86_lea var1001_ul (x86_mem_p 1 var1000_ul))\n\
         )\n\
         (next bb_5)\n\
@@ -439,7 +603,6 @@ void Test::func_switch2() {
     label_4\n\
     (asm_cmp var1000_ul 1)\n\
     (asm_jne label_3)\n\
-    label_5\n\
     (= var1001_ul 2)\n\
     label_1\n\
     (return var1001_ul))";
@@ -492,7 +655,6 @@ void Test::func_switch2() {
     (bb_5\n\
         (prev bb_4)\n\
         (nodes\n\
-            label_5\n\
             (x86_mov var1001_ul 2)\n\
         )\n\
         (next bb_6)\n\
@@ -511,6 +673,329 @@ void Test::func_switch2() {
   holder.clear();
 }
 
+void Test::func_switch3() {
+  Kind kind = Int32;
+  Func &f = func.reset(&holder, Name{&holder, "fswitch3"}, FuncType{&holder, {kind}, {kind}});
+  Var n = f.param(0);
+  Var ret = f.result(0);
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * int32_t fswitch3(int32_t n) {
+   *   int32_t ret = 0;
+   *   switch (n) {
+   *     case -1:
+   *       ret = 7;
+   *       break;
+   *     case 0:
+   *       ret = 3;
+   *       [[fallthrough]];
+   *     case 1:
+   *       ret += n;
+   *       break;
+   *     case 2:
+   *       ret = 5;
+   *       break;
+   *     case 4:
+   *       ret = 9;
+   *       break;
+   *     default:
+   *       ret = 1;
+   *       break;
+   *   }
+   *   return ret;
+   * }
+   */
+
+  f.set_body( //
+      Block{f,
+            {Assign{f, ASSIGN, ret, Zero(kind)},
+             Switch{f,
+                    n,
+                    {Case{f, Const{f, int32_t(-1)}, Assign{f, ASSIGN, ret, Const{f, int32_t(7)}}},
+                     Case{f, Zero(kind),
+                          Block{f, {Assign{f, ASSIGN, ret, Const{f, int32_t(3)}}, Fallthrough{}}}},
+                     Case{f, One(f, kind), Assign{f, ADD_ASSIGN, ret, n}},
+                     Case{f, Two(f, kind), Assign{f, ASSIGN, ret, Const{f, int32_t(5)}}},
+                     Case{f, Const{f, int32_t(4)}, Assign{f, ASSIGN, ret, Const{f, int32_t(9)}}},
+                     Default{f, Assign{f, ASSIGN, ret, One(f, kind)}}}},
+             Return{f, ret}}});
+
+  // dense Case values: compiled to a bounds check followed by a jump table,
+  // with holes jumping to Default
+  compile(f, OptNone);
+
+  Chars expected = "(block\n\
+    label_0\n\
+    (_set var1000_i)\n\
+    (= var1001_i 0)\n\
+    (asm_cmp var1000_i -1)\n\
+    (asm_jl label_7)\n\
+    (asm_cmp var1000_i 4)\n\
+    (asm_jg label_7)\n\
+    (= var1002_i (+ var1000_i 1))\n\
+    (_jump_table var1002_i label_2 label_3 label_4 label_5 label_7 label_6)\n\
+    label_2\n\
+    (= var1001_i 7)\n\
+    (goto label_1)\n\
+    label_3\n\
+    (= var1001_i 3)\n\
+    (goto label_4)\n\
+    (goto label_1)\n\
+    label_4\n\
+    (+= var1001_i var1000_i)\n\
+    (goto label_1)\n\
+    label_5\n\
+    (= var1001_i 5)\n\
+    (goto label_1)\n\
+    label_6\n\
+    (= var1001_i 9)\n\
+    (goto label_1)\n\
+    label_7\n\
+    (= var1001_i 1)\n\
+    label_1\n\
+    (return var1001_i))";
+  TEST(to_string(f.get_compiled(NOARCH)), ==, expected);
+
+  // x86_64 loads the jump table address with a rip-relative LEA,
+  // then jumps through the table entry selected by the index
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_i)\n\
+    (x86_mov var1001_i 0)\n\
+    (x86_cmp var1000_i -1)\n\
+    (x86_jl label_7)\n\
+    (x86_cmp var1000_i 4)\n\
+    (x86_jg label_7)\n\
+    (x86_lea var1002_i (x86_mem_p 1 var1000_i))\n\
+    (x86_movsx var1003_ul var1002_i)\n\
+    (x86_lea var1004_ul (x86_mem_ul label_8 rip))\n\
+    (_jump_table (x86_mem_ul label_8 var1004_ul var1003_ul 8) label_2 label_3 label_4 label_5 label_7 label_6)\n\
+    label_2\n\
+    (x86_mov var1001_i 7)\n\
+    (x86_jmp label_1)\n\
+    label_3\n\
+    (x86_mov var1001_i 3)\n\
+    (x86_jmp label_4)\n\
+    (x86_jmp label_1)\n\
+    label_4\n\
+    (x86_add var1001_i var1000_i)\n\
+    (x86_jmp label_1)\n\
+    label_5\n\
+    (x86_mov var1001_i 5)\n\
+    (x86_jmp label_1)\n\
+    label_6\n\
+    (x86_mov var1001_i 9)\n\
+    (x86_jmp label_1)\n\
+    label_7\n\
+    (x86_mov var1001_i 1)\n\
+    label_1\n\
+    (x86_ret var1001_i))";
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * uint32_t fswitch3u(uint32_t n) {
+   *   switch (n) {
+   *     case 5: return 1;
+   *     case 6: return 2;
+   *     case 7: return 3;
+   *     case 8: return 4;
+   *     default: return 0;
+   *   }
+   * }
+   */
+  kind = Uint32;
+  Func &g = func.reset(&holder, Name{&holder, "fswitch3u"}, FuncType{&holder, {kind}, {kind}});
+  n = g.param(0);
+  ret = g.result(0);
+  g.set_body( //
+      Block{g,
+            {Switch{g,
+                    n,
+                    {Case{g, Const{g, uint32_t(5)}, Assign{g, ASSIGN, ret, Const{g, uint32_t(1)}}},
+                     Case{g, Const{g, uint32_t(6)}, Assign{g, ASSIGN, ret, Const{g, uint32_t(2)}}},
+                     Case{g, Const{g, uint32_t(7)}, Assign{g, ASSIGN, ret, Const{g, uint32_t(3)}}},
+                     Case{g, Const{g, uint32_t(8)}, Assign{g, ASSIGN, ret, Const{g, uint32_t(4)}}},
+                     Default{g, Assign{g, ASSIGN, ret, Zero(kind)}}}},
+             Return{g, ret}}});
+
+  // index = n - 5 is computed as n + (-5) truncated to 32 bits
+  compile(g, OptNone);
+
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_ui)\n\
+    (= var1002_ui (+ var1000_ui 4294967291))\n\
+    (asm_cmp var1002_ui 3)\n\
+    (asm_ja label_6)\n\
+    (_jump_table var1002_ui label_2 label_3 label_4 label_5)\n\
+    label_2\n\
+    (= var1001_ui 1)\n\
+    (goto label_1)\n\
+    label_3\n\
+    (= var1001_ui 2)\n\
+    (goto label_1)\n\
+    label_4\n\
+    (= var1001_ui 3)\n\
+    (goto label_1)\n\
+    label_5\n\
+    (= var1001_ui 4)\n\
+    (goto label_1)\n\
+    label_6\n\
+    (= var1001_ui 0)\n\
+    label_1\n\
+    (return var1001_ui))";
+  TEST(to_string(g.get_compiled(NOARCH)), ==, expected);
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * int8_t fswitch3s(int8_t n) {
+   *   switch (n) {
+   *     case -128: return 1;
+   *     case -127: return 2;
+   *     case -126: return 3;
+   *     case -125: return 4;
+   *     default: return 0;
+   *   }
+   * }
+   */
+  kind = Int8;
+  Func &h = func.reset(&holder, Name{&holder, "fswitch3s"}, FuncType{&holder, {kind}, {kind}});
+  n = h.param(0);
+  ret = h.result(0);
+  h.set_body( //
+      Block{h,
+            {Switch{h,
+                    n,
+                    {Case{h, Const{h, int8_t(-128)}, Assign{h, ASSIGN, ret, Const{h, int8_t(1)}}},
+                     Case{h, Const{h, int8_t(-127)}, Assign{h, ASSIGN, ret, Const{h, int8_t(2)}}},
+                     Case{h, Const{h, int8_t(-126)}, Assign{h, ASSIGN, ret, Const{h, int8_t(3)}}},
+                     Case{h, Const{h, int8_t(-125)}, Assign{h, ASSIGN, ret, Const{h, int8_t(4)}}},
+                     Default{h, Assign{h, ASSIGN, ret, Zero(kind)}}}},
+             Return{h, ret}}});
+
+  // index = n - (-128) is computed as n + 128, which wraps around to -128 in 8 bits
+  compile(h, OptNone);
+
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_b)\n\
+    (asm_cmp var1000_b -128)\n\
+    (asm_jl label_6)\n\
+    (asm_cmp var1000_b -125)\n\
+    (asm_jg label_6)\n\
+    (= var1002_b (+ var1000_b -128))\n\
+    (_jump_table var1002_b label_2 label_3 label_4 label_5)\n\
+    label_2\n\
+    (= var1001_b 1)\n\
+    (goto label_1)\n\
+    label_3\n\
+    (= var1001_b 2)\n\
+    (goto label_1)\n\
+    label_4\n\
+    (= var1001_b 3)\n\
+    (goto label_1)\n\
+    label_5\n\
+    (= var1001_b 4)\n\
+    (goto label_1)\n\
+    label_6\n\
+    (= var1001_b 0)\n\
+    label_1\n\
+    (return var1001_b))";
+  TEST(to_string(h.get_compiled(NOARCH)), ==, expected);
+
+  // dump_and_clear_code();
+  holder.clear();
+}
+
+void Test::func_switch4() {
+  Kind kind = Uint64;
+  Func &f = func.reset(&holder, Name{&holder, "fswitch4"}, FuncType{&holder, {kind}, {kind}});
+  Var n = f.param(0);
+  Var ret = f.result(0);
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * uint64_t fswitch4(uint64_t n) {
+   *   uint64_t ret;
+   *   switch (n) {
+   *     case 1:     ret = 2; break;
+   *     case 10:    ret = 3; break;
+   *     case 100:   ret = 5; break;
+   *     case 1000:  ret = 7; break;
+   *     case 10000: ret = 11; break;
+   *     default:    ret = 0; break;
+   *   }
+   *   return ret;
+   * }
+   */
+
+  f.set_body( //
+      Block{f,
+            {Switch{f,
+                    n,
+                    {Case{f, Const{f, uint64_t(1)}, Assign{f, ASSIGN, ret, Const{f, uint64_t(2)}}},
+                     Case{f, Const{f, uint64_t(10)}, Assign{f, ASSIGN, ret, Const{f, uint64_t(3)}}},
+                     Case{f, Const{f, uint64_t(100)}, //
+                          Assign{f, ASSIGN, ret, Const{f, uint64_t(5)}}},
+                     Case{f, Const{f, uint64_t(1000)}, //
+                          Assign{f, ASSIGN, ret, Const{f, uint64_t(7)}}},
+                     Case{f, Const{f, uint64_t(10000)}, //
+                          Assign{f, ASSIGN, ret, Const{f, uint64_t(11)}}},
+                     Default{f, Assign{f, ASSIGN, ret, Zero(kind)}}}},
+             Return{f, ret}}});
+
+  // sparse Case values: compiled to a balanced tree of comparisons
+  compile(f, OptNone);
+
+  Chars expected = "(block\n\
+    label_0\n\
+    (_set var1000_ul)\n\
+    (asm_cmp var1000_ul 100)\n\
+    (asm_jae label_8)\n\
+    (asm_cmp var1000_ul 1)\n\
+    (asm_je label_2)\n\
+    (asm_cmp var1000_ul 10)\n\
+    (asm_je label_3)\n\
+    (goto label_7)\n\
+    label_8\n\
+    (asm_cmp var1000_ul 100)\n\
+    (asm_je label_4)\n\
+    (asm_cmp var1000_ul 1000)\n\
+    (asm_je label_5)\n\
+    (asm_cmp var1000_ul 10000)\n\
+    (asm_je label_6)\n\
+    (goto label_7)\n\
+    label_2\n\
+    (= var1001_ul 2)\n\
+    (goto label_1)\n\
+    label_3\n\
+    (= var1001_ul 3)\n\
+    (goto label_1)\n\
+    label_4\n\
+    (= var1001_ul 5)\n\
+    (goto label_1)\n\
+    label_5\n\
+    (= var1001_ul 7)\n\
+    (goto label_1)\n\
+    label_6\n\
+    (= var1001_ul 11)\n\
+    (goto label_1)\n\
+    label_7\n\
+    (= var1001_ul 0)\n\
+    label_1\n\
+    (return var1001_ul))";
+  TEST(to_string(f.get_compiled(NOARCH)), ==, expected);
+
+  // dump_and_clear_code();
+  holder.clear();
+}
+
 void Test::func_cond() {
   Kind kind = Uint64;
   Func &f = func.reset(&holder, Name{&holder, "fcond"}, FuncType{&holder, {kind}, {kind}});
@@ -555,7 +1040,7 @@ void Test::func_cond() {
     (return var1001_ul))";
   TEST(to_string(f.get_body()), ==, expected);
 
-  compile(f);
+  compile(f, OptAll & ~OptIfConversion);
 
   expected = "(block\n\
     label_0\n\
@@ -678,4 +1163,1095 @@ void Test::func_and_or() {
   holder.clear();
 }
 
+void Test::func_coalesce() {
+  Kind kind = Uint64;
+  Func &f = func.reset(&holder, Name{&holder, "fcoalesce"}, FuncType{&holder, {kind}, {kind}});
+  Var n = f.param(0);
+  Var ret = f.result(0);
+  Var tmp{f, kind};
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * uint64_t fcoalesce(uint64_t n) {
+   *   uint64_t tmp = n;
+   *   tmp += tmp;
+   *   return tmp;
+   * }
+   */
+
+  f.set_body(Block{f, {Assign{f, ASSIGN, tmp, n}, //
+                       Assign{f, ADD_ASSIGN, tmp, tmp},
+                       Assign{f, ASSIGN, ret, tmp}, //
+                       Return{f, ret}}});
+
+  compile(f);
+
+  Chars expected = "(block\n\
+    label_0\n\
+    (_set var1000_ul)\n\
+    (= var1002_ul var1000_ul)\n\
+    (*= var1002_ul 2)\n\
+    (= var1001_ul var1002_ul)\n\
+    (return var1001_ul))";
+  TEST(to_string(f.get_compiled(NOARCH)), ==, expected);
+
+  // var1000, var1001 and var1002 are coalesced into the same register,
+  // thus the copies between them are removed
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_ul)\n\
+    (x86_mov var1003_ul 2)\n\
+    (x86_imul var1002_ul var1003_ul)\n\
+    (x86_ret var1001_ul))";
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+  View<reg::Color> colors = comp.allocator_.get_colors();
+  TEST(colors[0], ==, colors[1]);
+  TEST(colors[0], ==, colors[2]);
+  // the result is hinted to RAX, i.e. color 0, by both SysV and Windows ABIs
+  TEST(colors[1], ==, 0);
+
+  // dump_and_clear_code();
+  holder.clear();
+}
+
+void Test::func_spill() {
+  enum { N = 16 };
+  Kind kind = Uint64;
+  Func &f = func.reset(&holder, Name{&holder, "fspill"}, FuncType{&holder, {kind}, {kind}});
+  Var n = f.param(0);
+  Var ret = f.result(0);
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * uint64_t fspill(uint64_t n) {
+   *   uint64_t v0 = n + 1, v1 = n + 2, ... v15 = n + 16;
+   *   return v0 + v1 + ... + v15;
+   * }
+   *
+   * all v0 ... v15 are live at the same time,
+   * thus some of them must be spilled to the stack
+   */
+  Array<Node> body;
+  Var v[N];
+  for (int i = 0; i < N; i++) {
+    v[i] = Var{f, kind};
+    body.append(Assign{f, ASSIGN, v[i], Tuple{f, ADD, n, Const{f, uint64_t(i + 1)}}});
+  }
+  body.append(Assign{f, ASSIGN, ret, v[0]});
+  for (int i = 1; i < N; i++) {
+    body.append(Assign{f, ADD_ASSIGN, ret, v[i]});
+  }
+  body.append(Return{f, ret});
+  f.set_body(Block{f, body});
+
+  // register hints and callee-saved registers depend on the ABI
+  comp.configure(CheckNone, Abi_x64_sysv);
+  compile(f);
+  comp.configure(CheckNone);
+
+  View<reg::Color> colors = comp.allocator_.get_colors();
+  size_t spilled = 0;
+  for (reg::Color color : colors) {
+    spilled += color >= 14;
+  }
+  TEST(spilled, >, 0);
+  // param n is hinted to RDI, i.e. color 4, by SysV ABI
+  TEST(colors[0], ==, 4);
+
+  // spilled Vars are replaced by stack slots (x86_mem_ul offset rsp),
+  // and R11 is used as scratch register where a register is required
+  Chars expected = "(block\n\
+    label_0\n\
+    (x86_push rbx)\n\
+    (x86_push rbp)\n\
+    (x86_push r12)\n\
+    (x86_push r13)\n\
+    (x86_push r14)\n\
+    (x86_push r15)\n\
+    (x86_sub rsp 24)\n\
+    (_set var1000_ul)\n\
+    (x86_lea var1002_ul (x86_mem_p 1 var1000_ul))\n\
+    (x86_lea r11 (x86_mem_p 2 var1000_ul))\n\
+    (x86_mov (x86_mem_ul 8 rsp) r11)\n\
+    (x86_lea r11 (x86_mem_p 3 var1000_ul))\n\
+    (x86_mov (x86_mem_ul rsp) r11)\n\
+    (x86_lea var1005_ul (x86_mem_p 4 var1000_ul))\n\
+    (x86_lea var1006_ul (x86_mem_p 5 var1000_ul))\n\
+    (x86_lea var1007_ul (x86_mem_p 6 var1000_ul))\n\
+    (x86_lea var1008_ul (x86_mem_p 7 var1000_ul))\n\
+    (x86_lea var1009_ul (x86_mem_p 8 var1000_ul))\n\
+    (x86_lea var100a_ul (x86_mem_p 9 var1000_ul))\n\
+    (x86_lea var100b_ul (x86_mem_p 10 var1000_ul))\n\
+    (x86_lea var100c_ul (x86_mem_p 11 var1000_ul))\n\
+    (x86_lea var100d_ul (x86_mem_p 12 var1000_ul))\n\
+    (x86_lea var100e_ul (x86_mem_p 13 var1000_ul))\n\
+    (x86_lea var100f_ul (x86_mem_p 14 var1000_ul))\n\
+    (x86_lea var1010_ul (x86_mem_p 15 var1000_ul))\n\
+    (x86_lea var1011_ul (x86_mem_p 16 var1000_ul))\n\
+    (x86_add var1001_ul (x86_mem_ul 8 rsp))\n\
+    (x86_add var1001_ul (x86_mem_ul rsp))\n\
+    (x86_add var1001_ul var1005_ul)\n\
+    (x86_add var1001_ul var1006_ul)\n\
+    (x86_add var1001_ul var1007_ul)\n\
+    (x86_add var1001_ul var1008_ul)\n\
+    (x86_add var1001_ul var1009_ul)\n\
+    (x86_add var1001_ul var100a_ul)\n\
+    (x86_add var1001_ul var100b_ul)\n\
+    (x86_add var1001_ul var100c_ul)\n\
+    (x86_add var1001_ul var100d_ul)\n\
+    (x86_add var1001_ul var100e_ul)\n\
+    (x86_add var1001_ul var100f_ul)\n\
+    (x86_add var1001_ul var1010_ul)\n\
+    (x86_add var1001_ul var1011_ul)\n\
+    (x86_add rsp 24)\n\
+    (x86_pop r15)\n\
+    (x86_pop r14)\n\
+    (x86_pop r13)\n\
+    (x86_pop r12)\n\
+    (x86_pop rbp)\n\
+    (x86_pop rbx)\n\
+    (x86_ret var1001_ul))";
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+
+  // dump_and_clear_code();
+  holder.clear();
+}
+
+void Test::func_spill_float() {
+  enum { N = 20 };
+  Kind kind = Float64;
+  Func &f = func.reset(&holder, Name{&holder, "fspill_float"}, FuncType{&holder, {kind}, {kind}});
+  Var n = f.param(0);
+  Var ret = f.result(0);
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * double fspill_float(double n) {
+   *   double v0 = n + 1, v1 = n + 2, ... v19 = n + 20;
+   *   return v0 + v1 + ... + v19;
+   * }
+   *
+   * all v0 ... v19 are live at the same time and there are only 16 SSE registers,
+   * thus some of them must be spilled to the stack
+   */
+  Array<Node> body;
+  Var v[N];
+  for (int i = 0; i < N; i++) {
+    v[i] = Var{f, kind};
+    body.append(Assign{f, ASSIGN, v[i], Tuple{f, ADD, n, Const{f, double(i + 1)}}});
+  }
+  body.append(Assign{f, ASSIGN, ret, v[0]});
+  for (int i = 1; i < N; i++) {
+    body.append(Assign{f, ADD_ASSIGN, ret, v[i]});
+  }
+  body.append(Return{f, ret});
+  f.set_body(Block{f, body});
+
+  comp.configure(CheckNone, Abi_x64_sysv);
+  compile(f, OptAll & ~OptSSA);
+  comp.configure(CheckNone);
+
+  // spilled Float64 Vars are loaded and stored with movsd, never with mov
+  Chars expected = "(block\n\
+    label_0\n\
+    (x86_sub rsp 56)\n\
+    (_set var1000_lf)\n\
+    (x86_mov var1017_ul 4607182418800017408)\n\
+    (x86_movq var1016_lf var1017_ul)\n\
+    (x86_movsd var1002_lf var1000_lf)\n\
+    (x86_addsd var1002_lf var1016_lf)\n\
+    (x86_mov var1019_ul 4611686018427387904)\n\
+    (x86_movq var1018_lf var1019_ul)\n\
+    (x86_movsd (x86_mem_lf 32 rsp) var1000_lf)\n\
+    (x86_movsd xmm15 (x86_mem_lf 32 rsp))\n\
+    (x86_addsd xmm15 var1018_lf)\n\
+    (x86_movsd (x86_mem_lf 32 rsp) xmm15)\n\
+    (x86_mov var101b_ul 4613937818241073152)\n\
+    (x86_movq var101a_lf var101b_ul)\n\
+    (x86_movsd (x86_mem_lf 24 rsp) var1000_lf)\n\
+    (x86_movsd xmm15 (x86_mem_lf 24 rsp))\n\
+    (x86_addsd xmm15 var101a_lf)\n\
+    (x86_movsd (x86_mem_lf 24 rsp) xmm15)\n\
+    (x86_mov var101d_ul 4616189618054758400)\n\
+    (x86_movq var101c_lf var101d_ul)\n\
+    (x86_movsd (x86_mem_lf 16 rsp) var1000_lf)\n\
+    (x86_movsd xmm15 (x86_mem_lf 16 rsp))\n\
+    (x86_addsd xmm15 var101c_lf)\n\
+    (x86_movsd (x86_mem_lf 16 rsp) xmm15)\n\
+    (x86_mov var101f_ul 4617315517961601024)\n\
+    (x86_movq var101e_lf var101f_ul)\n\
+    (x86_movsd (x86_mem_lf 8 rsp) var1000_lf)\n\
+    (x86_movsd xmm15 (x86_mem_lf 8 rsp))\n\
+    (x86_addsd xmm15 var101e_lf)\n\
+    (x86_movsd (x86_mem_lf 8 rsp) xmm15)\n\
+    (x86_mov var1021_ul 4618441417868443648)\n\
+    (x86_movq var1020_lf var1021_ul)\n\
+    (x86_movsd (x86_mem_lf rsp) var1000_lf)\n\
+    (x86_movsd xmm15 (x86_mem_lf rsp))\n\
+    (x86_addsd xmm15 var1020_lf)\n\
+    (x86_movsd (x86_mem_lf rsp) xmm15)\n\
+    (x86_mov var1023_ul 4619567317775286272)\n\
+    (x86_movq var1022_lf var1023_ul)\n\
+    (x86_movsd var1008_lf var1000_lf)\n\
+    (x86_addsd var1008_lf var1022_lf)\n\
+    (x86_mov var1025_ul 4620693217682128896)\n\
+    (x86_movq var1024_lf var1025_ul)\n\
+    (x86_movsd var1009_lf var1000_lf)\n\
+    (x86_addsd var1009_lf var1024_lf)\n\
+    (x86_mov var1027_ul 4621256167635550208)\n\
+    (x86_movq var1026_lf var1027_ul)\n\
+    (x86_movsd var100a_lf var1000_lf)\n\
+    (x86_addsd var100a_lf var1026_lf)\n\
+    (x86_mov var1029_ul 4621819117588971520)\n\
+    (x86_movq var1028_lf var1029_ul)\n\
+    (x86_movsd var100b_lf var1000_lf)\n\
+    (x86_addsd var100b_lf var1028_lf)\n\
+    (x86_mov var102b_ul 4622382067542392832)\n\
+    (x86_movq var102a_lf var102b_ul)\n\
+    (x86_movsd var100c_lf var1000_lf)\n\
+    (x86_addsd var100c_lf var102a_lf)\n\
+    (x86_mov var102d_ul 4622945017495814144)\n\
+    (x86_movq var102c_lf var102d_ul)\n\
+    (x86_movsd var100d_lf var1000_lf)\n\
+    (x86_addsd var100d_lf var102c_lf)\n\
+    (x86_mov var102f_ul 4623507967449235456)\n\
+    (x86_movq var102e_lf var102f_ul)\n\
+    (x86_movsd var100e_lf var1000_lf)\n\
+    (x86_addsd var100e_lf var102e_lf)\n\
+    (x86_mov var1031_ul 4624070917402656768)\n\
+    (x86_movq var1030_lf var1031_ul)\n\
+    (x86_movsd var100f_lf var1000_lf)\n\
+    (x86_addsd var100f_lf var1030_lf)\n\
+    (x86_mov var1033_ul 4624633867356078080)\n\
+    (x86_movq var1032_lf var1033_ul)\n\
+    (x86_movsd var1010_lf var1000_lf)\n\
+    (x86_addsd var1010_lf var1032_lf)\n\
+    (x86_mov var1035_ul 4625196817309499392)\n\
+    (x86_movq var1034_lf var1035_ul)\n\
+    (x86_movsd var1011_lf var1000_lf)\n\
+    (x86_addsd var1011_lf var1034_lf)\n\
+    (x86_mov var1037_ul 4625478292286210048)\n\
+    (x86_movq var1036_lf var1037_ul)\n\
+    (x86_movsd var1012_lf var1000_lf)\n\
+    (x86_addsd var1012_lf var1036_lf)\n\
+    (x86_mov var1039_ul 4625759767262920704)\n\
+    (x86_movq var1038_lf var1039_ul)\n\
+    (x86_movsd var1013_lf var1000_lf)\n\
+    (x86_addsd var1013_lf var1038_lf)\n\
+    (x86_mov var103b_ul 4626041242239631360)\n\
+    (x86_movq xmm15 var103b_ul)\n\
+    (x86_movsd (x86_mem_lf 40 rsp) xmm15)\n\
+    (x86_movsd var1014_lf var1000_lf)\n\
+    (x86_addsd var1014_lf (x86_mem_lf 40 rsp))\n\
+    (x86_mov var103d_ul 4626322717216342016)\n\
+    (x86_movq xmm15 var103d_ul)\n\
+    (x86_movsd (x86_mem_lf 40 rsp) xmm15)\n\
+    (x86_addsd var1015_lf (x86_mem_lf 40 rsp))\n\
+    (x86_addsd var1001_lf (x86_mem_lf 32 rsp))\n\
+    (x86_addsd var1001_lf (x86_mem_lf 24 rsp))\n\
+    (x86_addsd var1001_lf (x86_mem_lf 16 rsp))\n\
+    (x86_addsd var1001_lf (x86_mem_lf 8 rsp))\n\
+    (x86_addsd var1001_lf (x86_mem_lf rsp))\n\
+    (x86_addsd var1001_lf var1008_lf)\n\
+    (x86_addsd var1001_lf var1009_lf)\n\
+    (x86_addsd var1001_lf var100a_lf)\n\
+    (x86_addsd var1001_lf var100b_lf)\n\
+    (x86_addsd var1001_lf var100c_lf)\n\
+    (x86_addsd var1001_lf var100d_lf)\n\
+    (x86_addsd var1001_lf var100e_lf)\n\
+    (x86_addsd var1001_lf var100f_lf)\n\
+    (x86_addsd var1001_lf var1010_lf)\n\
+    (x86_addsd var1001_lf var1011_lf)\n\
+    (x86_addsd var1001_lf var1012_lf)\n\
+    (x86_addsd var1001_lf var1013_lf)\n\
+    (x86_addsd var1001_lf var1014_lf)\n\
+    (x86_addsd var1001_lf var1015_lf)\n\
+    (x86_add rsp 56)\n\
+    (x86_ret var1001_lf))";
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+
+  // dump_and_clear_code();
+  holder.clear();
+}
+
+void Test::func_remat() {
+  enum { N = 16 };
+  Kind kind = Uint64;
+  Func &f = func.reset(&holder, Name{&holder, "fremat"}, FuncType{&holder, {kind}, {kind}});
+  Var n = f.param(0);
+  Var ret = f.result(0);
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * uint64_t fremat(uint64_t n) {
+   *   uint64_t c0 = 0x100000000, c1 = 12345;
+   *   uint64_t v2 = n + 3, ... v15 = n + 16;
+   *   return c0 + c1 + v2 + ... + v15;
+   * }
+   *
+   * all c0, c1, v2 ... v15 are live at the same time: c0 and c1 are constants,
+   * thus they should be spilled and recomputed instead of reloaded from the stack
+   */
+  Array<Node> body;
+  Var v[N];
+  for (int i = 0; i < N; i++) {
+    v[i] = Var{f, kind};
+    Expr init = i == 0   ? Expr{Const{f, uint64_t(0x100000000)}}
+                : i == 1 ? Expr{Const{f, uint64_t(12345)}}
+                         : Expr{Tuple{f, ADD, n, Const{f, uint64_t(i + 1)}}};
+    body.append(Assign{f, ASSIGN, v[i], init});
+  }
+  body.append(Assign{f, ASSIGN, ret, v[N - 1]});
+  for (int i = N - 1; i != 0; i--) {
+    body.append(Assign{f, ADD_ASSIGN, ret, v[i - 1]});
+  }
+  body.append(Return{f, ret});
+  f.set_body(Block{f, body});
+
+  // do not propagate c0 and c1: they must stay in Vars.
+  // callee-saved registers depend on the ABI
+  comp.configure(CheckNone, Abi_x64_sysv);
+  compile(f, OptAll & ~OptPropagateConstant);
+  comp.configure(CheckNone);
+
+  // constants are recomputed at each use, either as immediates or loaded into R11:
+  // no stack slot is needed
+  Chars expected = "(block\n\
+    label_0\n\
+    (x86_push rbx)\n\
+    (x86_push rbp)\n\
+    (x86_push r12)\n\
+    (x86_push r13)\n\
+    (x86_push r14)\n\
+    (x86_push r15)\n\
+    (x86_sub rsp 8)\n\
+    (_set var1000_ul)\n\
+    (x86_lea var1004_ul (x86_mem_p 3 var1000_ul))\n\
+    (x86_lea var1005_ul (x86_mem_p 4 var1000_ul))\n\
+    (x86_lea var1006_ul (x86_mem_p 5 var1000_ul))\n\
+    (x86_lea var1007_ul (x86_mem_p 6 var1000_ul))\n\
+    (x86_lea var1008_ul (x86_mem_p 7 var1000_ul))\n\
+    (x86_lea var1009_ul (x86_mem_p 8 var1000_ul))\n\
+    (x86_lea var100a_ul (x86_mem_p 9 var1000_ul))\n\
+    (x86_lea var100b_ul (x86_mem_p 10 var1000_ul))\n\
+    (x86_lea var100c_ul (x86_mem_p 11 var1000_ul))\n\
+    (x86_lea var100d_ul (x86_mem_p 12 var1000_ul))\n\
+    (x86_lea var100e_ul (x86_mem_p 13 var1000_ul))\n\
+    (x86_lea var100f_ul (x86_mem_p 14 var1000_ul))\n\
+    (x86_lea var1010_ul (x86_mem_p 15 var1000_ul))\n\
+    (x86_lea var1011_ul (x86_mem_p 16 var1000_ul))\n\
+    (x86_add var1001_ul var1010_ul)\n\
+    (x86_add var1001_ul var100f_ul)\n\
+    (x86_add var1001_ul var100e_ul)\n\
+    (x86_add var1001_ul var100d_ul)\n\
+    (x86_add var1001_ul var100c_ul)\n\
+    (x86_add var1001_ul var100b_ul)\n\
+    (x86_add var1001_ul var100a_ul)\n\
+    (x86_add var1001_ul var1009_ul)\n\
+    (x86_add var1001_ul var1008_ul)\n\
+    (x86_add var1001_ul var1007_ul)\n\
+    (x86_add var1001_ul var1006_ul)\n\
+    (x86_add var1001_ul var1005_ul)\n\
+    (x86_add var1001_ul var1004_ul)\n\
+    (x86_add var1001_ul 12345)\n\
+    (x86_mov r11 4294967296)\n\
+    (x86_add var1001_ul r11)\n\
+    (x86_add rsp 8)\n\
+    (x86_pop r15)\n\
+    (x86_pop r14)\n\
+    (x86_pop r13)\n\
+    (x86_pop r12)\n\
+    (x86_pop rbp)\n\
+    (x86_pop rbx)\n\
+    (x86_ret var1001_ul))";
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+
+  // dump_and_clear_code();
+  holder.clear();
+}
+
+void Test::func_gvn() {
+  Kind kind = Uint64;
+  Func &f = func.reset(&holder, Name{&holder, "fgvn"}, FuncType{&holder, {kind, kind}, {kind}});
+  Var p = f.param(0);
+  Var i = f.param(1);
+  Var x{f, kind};
+  Const eight{f, uint64_t(8)};
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * uint64_t fgvn(uint64_t *p, uint64_t i) { // p is passed as uint64_t
+   *   uint64_t x = p[i];
+   *   if (x != 0) {
+   *     p[i] = x + i * 8;
+   *   } else {
+   *     return 0;
+   *   }
+   *   return x;
+   * }
+   */
+  // two distinct but equal address computations
+  Expr addr1 = Tuple{f, ADD, p, Binary{f, SHL, i, Const{f, uint64_t(3)}}};
+  Expr addr2 = Tuple{f, ADD, p, Binary{f, SHL, i, Const{f, uint64_t(3)}}};
+  f.set_body( //
+      Block{f,
+            {Assign{f, ASSIGN, x, Mem{f, kind, {addr1}}},
+             If{f, Binary{f, NEQ, x, Zero(kind)},
+                Assign{f, ASSIGN, Mem{f, kind, {addr2}}, Tuple{f, ADD, x, Tuple{f, MUL, i, eight}}},
+                Return{f, Zero(kind)}},
+             Return{f, x}}});
+
+  compile(f);
+
+  // the address p + i * 8 is computed only once
+  Chars expected = "(block\n\
+    label_0\n\
+    (_set var1000_ul var1001_ul)\n\
+    (= var1004_ul (+ var1000_ul (<< var1001_ul 3)))\n\
+    (= var1003_ul (mem_ul var1004_ul))\n\
+    (asm_cmp var1003_ul 0)\n\
+    (asm_je label_1)\n\
+    (= (mem_ul var1004_ul) (+ var1003_ul (* var1001_ul 8)))\n\
+    (goto label_2)\n\
+    label_1\n\
+    (return 0)\n\
+    label_2\n\
+    (= var1002_ul var1003_ul)\n\
+    (return var1002_ul))";
+  TEST(to_string(f.get_compiled(NOARCH)), ==, expected);
+
+  // dump_and_clear_code();
+  holder.clear();
+}
+
+void Test::func_sccp() {
+  Kind kind = Uint64;
+  Func &f = func.reset(&holder, Name{&holder, "fsccp"}, FuncType{&holder, {kind}, {kind}});
+  Var n = f.param(0);
+  Var r = f.result(0);
+  Var x{f, kind}, y{f, kind}, k{f, kind}, i{f, kind};
+  Const seven{f, uint64_t(7)};
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * uint64_t fsccp(uint64_t n) {
+   *   uint64_t x = 5, y = x * 3, k = 7, r, i;
+   *   if (y > 10) {
+   *     r = n + y;
+   *   } else {
+   *     r = n - y;
+   *   }
+   *   for (i = 0; i < n; i++) {
+   *     k |= 7;
+   *   }
+   *   r += k * 0x100000000;
+   *   return r;
+   * }
+   */
+  f.set_body( //
+      Block{f,
+            {Assign{f, ASSIGN, x, Const{f, uint64_t(5)}},
+             Assign{f, ASSIGN, y, Tuple{f, MUL, x, Const{f, uint64_t(3)}}},
+             If{f, Binary{f, GTR, y, Const{f, uint64_t(10)}}, //
+                Assign{f, ASSIGN, r, Tuple{f, ADD, n, y}},    //
+                Assign{f, ASSIGN, r, Binary{f, SUB, n, y}}},
+             Assign{f, ASSIGN, k, seven},
+             For{f, Assign{f, ASSIGN, i, Zero(kind)}, Binary{f, LSS, i, n}, Inc{f, i},
+                 Assign{f, OR_ASSIGN, k, seven}},
+             Assign{f, ADD_ASSIGN, r, Tuple{f, MUL, k, Const{f, uint64_t(0x100000000)}}},
+             Return{f, r}}});
+
+  compile(f);
+
+  // y and k are constants, and the else branch is removed
+  Chars expected = "(block\n\
+    label_0\n\
+    (_set var1000_ul)\n\
+    (= var1001_ul (+ var1000_ul 15))\n\
+    (= var1005_ul 0)\n\
+    (goto label_2)\n\
+    label_1\n\
+    (++ var1005_ul)\n\
+    label_2\n\
+    (asm_cmp var1005_ul var1000_ul)\n\
+    (asm_jb label_1)\n\
+    (+= var1001_ul 30064771072)\n\
+    (return var1001_ul))";
+  TEST(to_string(f.get_compiled(NOARCH)), ==, expected);
+
+  // immediates that do not fit 32 bits are loaded into a register
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_ul)\n\
+    (x86_lea var1001_ul (x86_mem_p 15 var1000_ul))\n\
+    (x86_mov var1005_ul 0)\n\
+    (x86_jmp label_2)\n\
+    label_1\n\
+    (x86_inc var1005_ul)\n\
+    label_2\n\
+    (x86_cmp var1005_ul var1000_ul)\n\
+    (x86_jb label_1)\n\
+    (x86_mov var1006_ul 30064771072)\n\
+    (x86_add var1001_ul var1006_ul)\n\
+    (x86_ret var1001_ul))";
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+
+  // dump_and_clear_code();
+  holder.clear();
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * int64_t fsccp2(int64_t n) {
+   *   int64_t x = -3;
+   *   if (x == -3) {
+   *     return n;
+   *   } else {
+   *     return -n;
+   *   }
+   * }
+   */
+  kind = Int64;
+  Func &f2 = func.reset(&holder, Name{&holder, "fsccp2"}, FuncType{&holder, {kind}, {kind}});
+  n = f2.param(0);
+  x = Var{f2, kind};
+  f2.set_body( //
+      Block{f2,
+            {Assign{f2, ASSIGN, x, Const{f2, int64_t(-3)}},
+             If{f2, Binary{f2, EQL, x, Const{f2, int64_t(-3)}}, //
+                Return{f2, n},                                  //
+                Return{f2, Unary{f2, NEG1, n}}}}});
+
+  compile(f2);
+
+  // equality comparisons are folded regardless of signedness
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_l)\n\
+    (= var1001_l var1000_l)\n\
+    (return var1001_l))";
+  TEST(to_string(f2.get_compiled(NOARCH)), ==, expected);
+
+  // dump_and_clear_code();
+  holder.clear();
+}
+
+void Test::func_dce() {
+  Kind kind = Uint64;
+  Chars expected[] = {"(block\n\
+    label_0\n\
+    (_set var1000_ul var1001_ul)\n\
+    (= var1002_ul var1000_ul)\n\
+    (return var1002_ul))",
+                      "(block\n\
+    label_0\n\
+    (_set var1000_ul var1001_ul)\n\
+    (= var1003_ul (/ var1000_ul var1001_ul))\n\
+    (= var1005_ul (mem_ul var1000_ul))\n\
+    (= var1002_ul var1000_ul)\n\
+    (return var1002_ul))"};
+  const Check checks[] = {CheckNone, CheckAll};
+
+  for (size_t j = 0; j < 2; j++) {
+    Func &f = func.reset(&holder, Name{&holder, "fdce"}, FuncType{&holder, {kind, kind}, {kind}});
+    Var a = f.param(0), b = f.param(1);
+    Var x{f, kind}, y{f, kind}, z{f, kind}, w{f, kind};
+
+    /**
+     * jit equivalent of C/C++ source code
+     *
+     * uint64_t fdce(uint64_t a, uint64_t b) {
+     *   uint64_t x = a / b, y = a % 3, z = *(uint64_t *)a, w = x + y + z;
+     *   return a;
+     * }
+     */
+    f.set_body( //
+        Block{f,
+              {Assign{f, ASSIGN, x, Binary{f, QUO, a, b}},
+               Assign{f, ASSIGN, y, Binary{f, REM, a, Const{f, uint64_t(3)}}},
+               Assign{f, ASSIGN, z, Mem{f, kind, {a}}},
+               Assign{f, ASSIGN, w, Tuple{f, kind, ADD, {x, y, z}}}, //
+               Return{f, a}}});
+
+    // all the assignments are dead. with CheckAll, the division by a non-constant
+    // and the memory access must be kept
+    comp.configure(checks[j]);
+    compile(f);
+    TEST(to_string(f.get_compiled(NOARCH)), ==, expected[j]);
+  }
+  comp.configure(CheckNone);
+}
+
+void Test::func_licm() {
+  Kind kind = Uint64;
+  Func &f = func.reset(&holder, Name{&holder, "flicm"}, FuncType{&holder, {kind, kind}, {kind}});
+  Var a = f.param(0), n = f.param(1);
+  Var total{f, kind}, i{f, kind}, s{f, kind};
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * uint64_t flicm(uint64_t a, uint64_t n) {
+   *   uint64_t total = 0, i, s;
+   *   for (i = 0; i < n; i++) {
+   *     s = n * 3;
+   *     total += *(uint64_t *)(a + 8) * s + i;
+   *   }
+   *   return total;
+   * }
+   */
+  f.set_body( //
+      Block{f,
+            {Assign{f, ASSIGN, total, Zero(kind)},
+             For{f, Assign{f, ASSIGN, i, Zero(kind)}, Binary{f, LSS, i, n}, Inc{f, i},
+                 Block{f,
+                       {Assign{f, ASSIGN, s, Tuple{f, MUL, n, Const{f, uint64_t(3)}}},
+                        Assign{f, ADD_ASSIGN, total,
+                               Tuple{f, ADD,
+                                     Tuple{f, MUL,
+                                           Mem{f, kind, {Tuple{f, ADD, a, Const{f, uint64_t(8)}}}},
+                                           s},
+                                     i}}}}},
+             Return{f, total}}});
+
+  compile(f);
+
+  // n * 3 and the load from a + 8 are moved before the loop,
+  // after checking that the loop runs at least once: the load may trap
+  Chars expected = "(block\n\
+    label_0\n\
+    (_set var1000_ul var1001_ul)\n\
+    (= var1003_ul 0)\n\
+    (= var1004_ul 0)\n\
+    (asm_cmp var1004_ul var1001_ul)\n\
+    (asm_jae label_4)\n\
+    (= var1005_ul (* var1001_ul 3))\n\
+    (= var1006_ul (* var1005_ul (mem_ul (+ var1000_ul 8))))\n\
+    label_4\n\
+    (goto label_2)\n\
+    label_1\n\
+    (+= var1003_ul (+ var1004_ul var1006_ul))\n\
+    (++ var1004_ul)\n\
+    label_2\n\
+    (asm_cmp var1004_ul var1001_ul)\n\
+    (asm_jb label_1)\n\
+    (= var1002_ul var1003_ul)\n\
+    (return var1002_ul))";
+  TEST(to_string(f.get_compiled(NOARCH)), ==, expected);
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * uint64_t flicm2(uint64_t a, uint64_t n, uint64_t d) {
+   *   uint64_t total = 0, i;
+   *   for (i = 0; i < n; i++) {
+   *     total += *(uint64_t *)a + n / d;
+   *     if (total > n) {
+   *       total += n % d;
+   *     } else {
+   *       total += i;
+   *     }
+   *   }
+   *   return total;
+   * }
+   */
+  Func &f2 =
+      func.reset(&holder, Name{&holder, "flicm2"}, FuncType{&holder, {kind, kind, kind}, {kind}});
+  a = f2.param(0), n = f2.param(1);
+  Var d = f2.param(2);
+  total = Var{f2, kind}, i = Var{f2, kind};
+  f2.set_body( //
+      Block{f2,
+            {Assign{f2, ASSIGN, total, Zero(kind)},
+             For{f2, Assign{f2, ASSIGN, i, Zero(kind)}, Binary{f2, LSS, i, n}, Inc{f2, i},
+                 Block{f2,
+                       {Assign{f2, ADD_ASSIGN, total,
+                               Tuple{f2, ADD, Mem{f2, kind, {a}}, Binary{f2, QUO, n, d}}},
+                        If{f2, Binary{f2, GTR, total, n},
+                           Assign{f2, ADD_ASSIGN, total, Binary{f2, REM, n, d}},
+                           Assign{f2, ADD_ASSIGN, total, i}}}}},
+             Return{f2, total}}});
+
+  compile(f2);
+
+  // the load and the division may trap: they are moved before the loop
+  // only after checking that the loop runs at least once.
+  // the remainder is not always executed by the loop, thus it is not moved
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_ul var1001_ul var1002_ul)\n\
+    (= var1004_ul 0)\n\
+    (= var1005_ul 0)\n\
+    (asm_cmp var1005_ul var1001_ul)\n\
+    (asm_jae label_6)\n\
+    (= var1006_ul (+ (mem_ul var1000_ul) (/ var1001_ul var1002_ul)))\n\
+    label_6\n\
+    (goto label_2)\n\
+    label_1\n\
+    (+= var1004_ul var1006_ul)\n\
+    (asm_cmp var1004_ul var1001_ul)\n\
+    (asm_jbe label_4)\n\
+    (+= var1004_ul (% var1001_ul var1002_ul))\n\
+    (goto label_5)\n\
+    label_4\n\
+    (+= var1004_ul var1005_ul)\n\
+    label_5\n\
+    (++ var1005_ul)\n\
+    label_2\n\
+    (asm_cmp var1005_ul var1001_ul)\n\
+    (asm_jb label_1)\n\
+    (= var1003_ul var1004_ul)\n\
+    (return var1003_ul))";
+  TEST(to_string(f2.get_compiled(NOARCH)), ==, expected);
+}
+
+void Test::func_isel() {
+  Func &f = func.reset(&holder, Name{&holder, "fisel"},
+                       FuncType{&holder, {Int32, Int32, Float64, Float64}, {Int64, Float64, Bool}});
+  Var a = f.param(0), b = f.param(1), x = f.param(2), y = f.param(3);
+  Var ret0 = f.result(0), ret1 = f.result(1), ret2 = f.result(2);
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * std::tuple<int64_t, double, bool> fisel(int32_t a, int32_t b, double x, double y) {
+   *   return {(int64_t)((a & b) | ~a), x * y + (double)b, x < y};
+   * }
+   */
+
+  f.set_body(Block{
+      f,
+      {Assign{f, ASSIGN, ret0,
+              Unary{f, Int64, CAST, Tuple{f, OR, Tuple{f, AND, a, b}, Unary{f, XOR1, a}}}},
+       Assign{f, ASSIGN, ret1, Tuple{f, ADD, Tuple{f, MUL, x, y}, Unary{f, Float64, CAST, b}}},
+       Assign{f, ASSIGN, ret2, Binary{f, LSS, x, y}}, //
+       Return{f, {ret0, ret1, ret2}}}});
+
+  compile(f, OptNone);
+
+  // each Unary, Binary and Tuple is lowered to x86_64 instructions
+  Chars expected = "(block\n\
+    label_0\n\
+    (_set var1000_i var1001_i var1002_lf var1003_lf)\n\
+    (x86_mov var1007_i var1000_i)\n\
+    (x86_and var1007_i var1001_i)\n\
+    (x86_mov var1008_i var1000_i)\n\
+    (x86_not var1008_i)\n\
+    (x86_mov var1009_i var1007_i)\n\
+    (x86_or var1009_i var1008_i)\n\
+    (x86_movsx var1004_l var1009_i)\n\
+    (x86_movsd var100a_lf var1002_lf)\n\
+    (x86_mulsd var100a_lf var1003_lf)\n\
+    (x86_cvtsi2sd var100b_lf var1001_i)\n\
+    (x86_movsd var1005_lf var100a_lf)\n\
+    (x86_addsd var1005_lf var100b_lf)\n\
+    (x86_ucomisd var1003_lf var1002_lf)\n\
+    (x86_seta var1006_e)\n\
+    (x86_ret var1004_l var1005_lf var1006_e))";
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+}
+
+void Test::func_isel_fixed() {
+  Func &f = func.reset(&holder, Name{&holder, "fisel_fixed"},
+                       FuncType{&holder, {Uint64, Uint64, Int8, Int8, Uint32, Float64},
+                                {Uint64, Int8, Uint64, Float64, Uint64, Int8}});
+  Var a = f.param(0), b = f.param(1), c = f.param(2), d = f.param(3);
+  Var e = f.param(4), x = f.param(5);
+  Var ret[6];
+  for (uint32_t i = 0; i < 6; i++) {
+    ret[i] = f.result(i);
+  }
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * std::tuple<uint64_t, int8_t, uint64_t, double, uint64_t, int8_t>
+   * fisel_fixed(uint64_t a, uint64_t b, int8_t c, int8_t d, uint32_t e, double x) {
+   *   return {a / b, c % d, a << b, (double)a + 1.5, (uint64_t)x + e, std::max(c, d)};
+   * }
+   */
+
+  f.set_body(Block{
+      f,
+      {Assign{f, ASSIGN, ret[0], Binary{f, QUO, a, b}}, //
+       Assign{f, ASSIGN, ret[1], Binary{f, REM, c, d}}, //
+       Assign{f, ASSIGN, ret[2], Binary{f, SHL, a, b}}, //
+       Assign{f, ASSIGN, ret[3], Tuple{f, ADD, Unary{f, Float64, CAST, a}, Const{f, 1.5}}},
+       Assign{f, ASSIGN, ret[4],
+              Tuple{f, ADD, Unary{f, Uint64, CAST, x}, Unary{f, Uint64, CAST, e}}},
+       Assign{f, ASSIGN, ret[5], Tuple{f, MAX, c, d}}, //
+       Return{f, {ret[0], ret[1], ret[2], ret[3], ret[4], ret[5]}}}});
+
+  compile(f, OptNone);
+
+  // division, shifts by a variable amount and unsigned 64-bit conversions
+  // use fixed registers or several instructions
+  Chars expected = "(block\n\
+    label_0\n\
+    (x86_push rbx)\n\
+    (_set var1000_ul var1001_ul var1002_b var1003_b var1004_ui var1005_lf)\n\
+    (x86_mov rax var1000_ul)\n\
+    (x86_xor rdx rdx)\n\
+    (x86_div var1001_ul)\n\
+    (x86_mov var1006_ul rax)\n\
+    (x86_movsx var100c_i var1002_b)\n\
+    (x86_movsx var100d_i var1003_b)\n\
+    (x86_mov eax var100c_i)\n\
+    (x86_mov edx eax)\n\
+    (x86_sar edx 31)\n\
+    (x86_idiv var100d_i)\n\
+    (x86_mov var100e_i edx)\n\
+    (x86_mov var1007_b var100e_b)\n\
+    (x86_mov rcx var1001_ul)\n\
+    (x86_mov var1008_ul var1000_ul)\n\
+    (x86_shl var1008_ul cl)\n\
+    (x86_test var1000_ul var1000_ul)\n\
+    (x86_js label_1)\n\
+    (x86_cvtsi2sd var100f_lf var1000_ul)\n\
+    (x86_jmp label_2)\n\
+    label_1\n\
+    (x86_mov var1010_ul var1000_ul)\n\
+    (x86_shr var1010_ul 1)\n\
+    (x86_mov var1011_ul var1000_ul)\n\
+    (x86_and var1011_ul 1)\n\
+    (x86_or var1010_ul var1011_ul)\n\
+    (x86_cvtsi2sd var100f_lf var1010_ul)\n\
+    (x86_addsd var100f_lf var100f_lf)\n\
+    label_2\n\
+    (x86_mov var1013_ul 4609434218613702656)\n\
+    (x86_movq var1012_lf var1013_ul)\n\
+    (x86_movsd var1009_lf var100f_lf)\n\
+    (x86_addsd var1009_lf var1012_lf)\n\
+    (x86_mov var1016_ul 4890909195324358656)\n\
+    (x86_movq var1015_lf var1016_ul)\n\
+    (x86_ucomisd var1005_lf var1015_lf)\n\
+    (x86_jae label_3)\n\
+    (x86_cvttsd2si var1014_ul var1005_lf)\n\
+    (x86_jmp label_4)\n\
+    label_3\n\
+    (x86_movsd var1017_lf var1005_lf)\n\
+    (x86_subsd var1017_lf var1015_lf)\n\
+    (x86_cvttsd2si var1014_ul var1017_lf)\n\
+    (x86_mov var1018_ul 9223372036854775808)\n\
+    (x86_xor var1014_ul var1018_ul)\n\
+    label_4\n\
+    (x86_mov var1019_ui var1004_ui)\n\
+    (x86_lea var100a_ul (x86_mem_p var1014_ul var1019_ul 1))\n\
+    (x86_movsx var101a_i var1002_b)\n\
+    (x86_movsx var101b_i var1003_b)\n\
+    (x86_mov var101c_i var101a_i)\n\
+    (x86_cmp var101c_i var101b_i)\n\
+    (x86_cmovl var101c_i var101b_i)\n\
+    (x86_mov var100b_b var101c_b)\n\
+    (x86_pop rbx)\n\
+    (x86_ret var1006_ul var1007_b var1008_ul var1009_lf var100a_ul var100b_b))";
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+}
+
+void Test::func_lea() {
+  Kind kind = Uint64;
+  Func &f = func.reset(&holder, Name{&holder, "flea"},
+                       FuncType{&holder, {kind, kind}, {kind, kind, kind}});
+  Var a = f.param(0), b = f.param(1);
+  Var ret0 = f.result(0), ret1 = f.result(1), ret2 = f.result(2);
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * std::tuple<uint64_t, uint64_t, uint64_t> flea(uint64_t a, uint64_t b) {
+   *   return {a + b * 4 + 12, *(uint64_t *)(a + (b << 3) + 16), b * 9 - 5};
+   * }
+   */
+
+  Expr b4 = Tuple{f, MUL, b, Const{f, uint64_t(4)}};
+  Expr b_shl3 = Binary{f, SHL, b, Const{f, uint64_t(3)}};
+  f.set_body(Block{
+      f,
+      {Assign{f, ASSIGN, ret0, Tuple{f, kind, ADD, {a, b4, Const{f, uint64_t(12)}}}},
+       Assign{f, ASSIGN, ret1,
+              Mem{f, kind, {Tuple{f, kind, ADD, {a, b_shl3, Const{f, uint64_t(16)}}}}}},
+       Assign{f, ASSIGN, ret2,
+              Binary{f, SUB, Tuple{f, MUL, b, Const{f, uint64_t(9)}}, Const{f, uint64_t(5)}}},
+       Return{f, {ret0, ret1, ret2}}}});
+
+  compile(f, OptNone);
+
+  // address arithmetic is folded into LEA and memory operands
+  Chars expected = "(block\n\
+    label_0\n\
+    (_set var1000_ul var1001_ul)\n\
+    (x86_lea var1002_ul (x86_mem_p 12 var1000_ul var1001_ul 4))\n\
+    (x86_mov var1003_ul (x86_mem_ul 16 var1000_ul var1001_ul 8))\n\
+    (x86_lea var1005_ul (x86_mem_p var1001_ul var1001_ul 8))\n\
+    (x86_lea var1004_ul (x86_mem_p -5 var1005_ul))\n\
+    (x86_ret var1002_ul var1003_ul var1004_ul))";
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+  // LEA and two-operand IMUL have no 8-bit form: 8-bit additions and subtractions
+  // are computed by ADD and SUB, 8-bit multiplications by a 32-bit IMUL
+  kind = Uint8;
+  Func &g = func.reset(&holder, Name{&holder, "flea8"},
+                       FuncType{&holder, {kind, kind}, {kind, kind, kind}});
+  a = g.param(0), b = g.param(1);
+  ret0 = g.result(0), ret1 = g.result(1), ret2 = g.result(2);
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * std::tuple<uint8_t, uint8_t, uint8_t> flea8(uint8_t a, uint8_t b) {
+   *   return {a + b + 1, a * b, b * 9 - 5};
+   * }
+   */
+  g.set_body(Block{
+      g,
+      {Assign{g, ASSIGN, ret0, Tuple{g, kind, ADD, {a, b, Const{g, uint8_t(1)}}}},
+       Assign{g, ASSIGN, ret1, Tuple{g, MUL, a, b}},
+       Assign{g, ASSIGN, ret2,
+              Binary{g, SUB, Tuple{g, MUL, b, Const{g, uint8_t(9)}}, Const{g, uint8_t(5)}}},
+       Return{g, {ret0, ret1, ret2}}}});
+
+  compile(g, OptNone);
+
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_ub var1001_ub)\n\
+    (x86_mov var1002_ub 1)\n\
+    (x86_add var1002_ub var1000_ub)\n\
+    (x86_add var1002_ub var1001_ub)\n\
+    (x86_movzx var1005_ui var1000_ub)\n\
+    (x86_movzx var1006_ui var1001_ub)\n\
+    (x86_mov var1007_ui var1005_ui)\n\
+    (x86_imul var1007_ui var1006_ui)\n\
+    (x86_mov var1003_ub var1007_ub)\n\
+    (x86_movzx var1009_ui var1001_ub)\n\
+    (x86_mov var100a_ui var1009_ui)\n\
+    (x86_mov var100b_ui 9)\n\
+    (x86_imul var100a_ui var100b_ui)\n\
+    (x86_mov var1008_ub var100a_ub)\n\
+    (x86_mov var1004_ub var1008_ub)\n\
+    (x86_sub var1004_ub 5)\n\
+    (x86_ret var1002_ub var1003_ub var1004_ub))";
+  TEST(to_string(g.get_compiled(X64)), ==, expected);
+}
+
+void Test::func_select() {
+  Kind kind = Int64;
+  Func &f = func.reset(&holder, Name{&holder, "fselect"},
+                       FuncType{&holder, {kind, kind}, {kind, kind}});
+  Var a = f.param(0), b = f.param(1);
+  Var ret0 = f.result(0), ret1 = f.result(1);
+  Const one{f, int64_t(1)};
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * std::tuple<int64_t, int64_t> fselect(int64_t a, int64_t b) {
+   *   int64_t ret0, ret1;
+   *   if (a < b) {
+   *     ret0 = a;
+   *   } else {
+   *     ret0 = b + 1;
+   *   }
+   *   if (a == 7) {
+   *     ret1 = 1;
+   *   } else {
+   *     ret1 = 0;
+   *   }
+   *   return {ret0, ret1};
+   * }
+   */
+
+  f.set_body(Block{f,
+                   {If{f, Binary{f, LSS, a, b}, Assign{f, ASSIGN, ret0, a},
+                       Assign{f, ASSIGN, ret0, Tuple{f, ADD, b, one}}},
+                    If{f, Binary{f, EQL, a, Const{f, int64_t(7)}}, Assign{f, ASSIGN, ret1, one},
+                       Assign{f, ASSIGN, ret1, Const{f, int64_t(0)}}},
+                    Return{f, {ret0, ret1}}}});
+
+  compile(f, OptIfConversion);
+
+  // small if-else diamonds are compiled without branches
+  Chars expected = "(block\n\
+    label_0\n\
+    (_set var1000_l var1001_l)\n\
+    (= var1002_l (select (< var1000_l var1001_l) var1000_l (+ var1001_l 1)))\n\
+    (= var1003_l (cast int64 (== var1000_l 7)))\n\
+    (return var1002_l var1003_l))";
+  TEST(to_string(f.get_compiled(NOARCH)), ==, expected);
+
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_l var1001_l)\n\
+    (x86_lea var1004_l (x86_mem_p 1 var1001_l))\n\
+    (x86_cmp var1000_l var1001_l)\n\
+    (x86_mov var1002_l var1004_l)\n\
+    (x86_cmovl var1002_l var1000_l)\n\
+    (x86_cmp var1000_l 7)\n\
+    (x86_sete var1005_e)\n\
+    (x86_movzx var1003_l var1005_e)\n\
+    (x86_ret var1002_l var1003_l))";
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+}
+
+void Test::func_div64() {
+  Func &f = func.reset(&holder, Name{&holder, "fdiv64"},
+                       FuncType{&holder, {Uint64, Int64}, {Uint64, Int64}});
+  Var a = f.param(0), b = f.param(1);
+  Var ret0 = f.result(0), ret1 = f.result(1);
+
+  /**
+   * jit equivalent of C/C++ source code
+   *
+   * std::tuple<uint64_t, int64_t> fdiv64(uint64_t a, int64_t b) {
+   *   return {a / 10, b % -7};
+   * }
+   */
+
+  f.set_body(Block{f,
+                   {Assign{f, ASSIGN, ret0, Binary{f, QUO, a, Const{f, uint64_t(10)}}},
+                    Assign{f, ASSIGN, ret1, Binary{f, REM, b, Const{f, int64_t(-7)}}},
+                    Return{f, {ret0, ret1}}}});
+
+  compile(f);
+
+  // 64-bit division by a constant is lowered to a multiply-high,
+  // compiled to one-operand MUL or IMUL which write %rdx:%rax
+  Chars expected = "(block\n\
+    label_0\n\
+    (_set var1000_ul var1001_l)\n\
+    (= var1002_ul (>> (mulhi var1000_ul 14757395258967641293) 3))\n\
+    (= var1003_l (- var1001_l (* (- (>> var1001_l 63) (>> (+ var1001_l (mulhi var1001_l -7905747460161236406)) 2)) -7)))\n\
+    (return var1002_ul var1003_l))";
+  TEST(to_string(f.get_compiled(NOARCH)), ==, expected);
+
+  expected = "(block\n\
+    label_0\n\
+    (_set var1000_ul var1001_l)\n\
+    (x86_mov var1004_ul 14757395258967641293)\n\
+    (x86_mov rax var1000_ul)\n\
+    (x86_mul var1004_ul)\n\
+    (x86_mov var1005_ul rdx)\n\
+    (x86_shr var1002_ul 3)\n\
+    (x86_mov var1006_l var1001_l)\n\
+    (x86_sar var1006_l 63)\n\
+    (x86_mov var1008_l -7905747460161236406)\n\
+    (x86_mov rax var1001_l)\n\
+    (x86_imul1 var1008_l)\n\
+    (x86_mov var1007_l rdx)\n\
+    (x86_lea var1009_l (x86_mem_p var1001_l var1007_l 1))\n\
+    (x86_sar var100a_l 2)\n\
+    (x86_sub var100b_l var100a_l)\n\
+    (x86_mov var100d_l -7)\n\
+    (x86_imul var100c_l var100d_l)\n\
+    (x86_mov var1003_l var1001_l)\n\
+    (x86_sub var1003_l var100c_l)\n\
+    (x86_ret var1002_ul var1003_l))";
+  TEST(to_string(f.get_compiled(X64)), ==, expected);
+}
+
 } // namespace onejit
@@ -44,29 +44,53 @@ FuncType Test::ftype() {
 
 void Test::run() {
   stl_bitset();
-  stl_graph();
+  stl_graph(false);
+  stl_graph(true);
   arch();
   kind();
   const_expr();
   simple_expr();
   nested_expr();
+  intern_expr();
   x64_expr();
   eval_expr();
   optimize();
   regallocator();
+  regallocator_linear();
+  regallocator_classes();
+  execarena();
+  linker();
+  x64_relax();
+  x64_jump_table();
   func_fib();
   func_loop();
+  func_loop_signed();
   func_switch1();
   func_switch2();
+  func_switch3();
+  func_switch4();
   func_cond();
   func_and_or();
+  func_coalesce();
+  func_spill();
+  func_spill_float();
+  func_remat();
+  func_gvn();
+  func_sccp();
+  func_dce();
+  func_licm();
+  func_isel();
+  func_isel_fixed();
+  func_lea();
+  func_select();
+  func_div64();
 
   Fmt{stdout} << testcount() << " tests passed\n";
 }
 
-void Test::compile(Func &f) {
-  // implies comp.compile(f, OptAll);
-  comp.compile_x64(f, OptAll);
+void Test::compile(Func &f, Opt flags) {
+  // implies comp.compile(f, flags);
+  comp.compile_x64(f, flags);
 
   CRange<Error> errors = comp.errors();
   if (errors) {
@@ -28,6 +28,9 @@ void Test::optimize() {
                     Float32, Float64}) {
     optimize_expr_kind(kind);
     optimize_assign_kind(kind);
+    if (!kind.is_float()) {
+      optimize_div_kind(kind);
+    }
   }
 }
 
@@ -214,4 +217,66 @@ void Test::optimize_assign_kind(Kind kind) {
   }
 }
 
+// evaluate expr, replacing x with its value xval
+static Value eval_at(Expr expr, Var x, Value xval) {
+  if (expr == x) {
+    return xval;
+  }
+  Array<Value> vals;
+  for (uint32_t i = 0, n = expr.children(); i < n; i++) {
+    vals.append(eval_at(expr.child_is<Expr>(i), x, xval));
+  }
+  switch (expr.type()) {
+  case CONST:
+    return expr.is<Const>().val();
+  case UNARY:
+    return eval_unary(expr.kind(), Op1(expr.op()), vals[0]);
+  case BINARY:
+    return eval_binary(Op2(expr.op()), vals[0], vals[1]);
+  case TUPLE:
+    return eval_tuple(expr.kind(), OpN(expr.op()), vals);
+  default:
+    return Value{};
+  }
+}
+
+void Test::optimize_div_kind(Kind kind) {
+  Func &f = func;
+  Var x{f, kind};
+
+  static const int64_t divisors[] = {3,   5,    7,     10,         16,          25,
+                                     100, 127,  641,   1024,       65535,       1000000007,
+                                     -3,  -7,   -16,   -100,       -1000000007, 0x123456789};
+  static const int64_t xs[] = {0,    1,      2,      3,    6,    7,    99,   100,
+                               101,  127,    128,    255,  1000, 65535, -1,  -2,
+                               -7,   -99,    -100,   -128, -129, -32768, -65536,
+                               0x123456789abcdef, -0x123456789abcdef};
+  for (int64_t d : divisors) {
+    Value y = Value{d}.cast(kind);
+    if (!y || (kind.is_unsigned() && d < 0) || y.cast(Int64).int64() != d) {
+      continue;
+    }
+    for (Op2 op : {QUO, REM}) {
+      Expr expr = Binary{f, op, x, Const{f, y}};
+      Expr optimized = opt.optimize(f, expr).is<Expr>();
+      // division and remainder by constant are replaced by shifts, masks and multiplications
+      TEST(optimized, !=, expr);
+      for (int64_t xi : xs) {
+        const Value xval = Value{xi}.cast(kind);
+        TEST(eval_at(optimized, x, xval), ==, eval_binary(op, xval, y));
+      }
+      for (Value xval : {Value::max(kind), Value::max(kind) - Value::one(kind),
+                         Value::min(kind).cast(Int64).cast(kind)}) {
+        TEST(eval_at(optimized, x, xval), ==, eval_binary(op, xval, y));
+      }
+    }
+  }
+
+  // optimize() on (/= x 10) should return (= x ...)
+  Assign st{f, QUO_ASSIGN, x, Const{f, Value{int64_t(10)}.cast(kind)}};
+  Node optimized = opt.optimize(f, st);
+  TEST(optimized.type(), ==, STMT_2);
+  TEST(optimized.op(), ==, ASSIGN);
+}
+
 } // namespace onejit
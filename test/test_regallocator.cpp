@@ -16,6 +16,7 @@
 #include "test.hpp"
 
 #include <onejit/reg/allocator.hpp>
+#include <onejit/reg/liveness.hpp>
 
 #include <cstdio>
 
@@ -56,7 +57,7 @@ void Test::regallocator() {
   graph.set(Reg(4), Reg(5), true);
   String result;
   run_allocator(result, allocator, Color(5));
-  Chars expected = "4 3 2 1 0 4 3 2 1 0 ";
+  Chars expected = "4 1 2 3 0 4 0 1 2 3 ";
   TEST(result, ==, expected);
 
   // also connect register 2..7 together
@@ -67,27 +68,27 @@ void Test::regallocator() {
   }
   // and try again
   run_allocator(result, allocator, Color(5));
-  expected = "1 0 5 4 3 2 1 0 4 3 ";
+  expected = "3 2 5 0 1 2 3 4 1 0 ";
   TEST(result, ==, expected);
 
   // retry with fewer available registers
   run_allocator(result, allocator, Color(4));
-  expected = "3 2 5 1 0 4 3 2 1 0 ";
+  expected = "2 3 5 0 1 4 2 3 0 1 ";
   TEST(result, ==, expected);
 
   // retry with fewer available registers
   run_allocator(result, allocator, Color(3));
-  expected = "2 1 6 5 0 4 3 2 1 0 ";
+  expected = "0 2 6 5 1 4 3 0 1 2 ";
   TEST(result, ==, expected);
 
   // retry with fewer available registers
   run_allocator(result, allocator, Color(2));
-  expected = "1 0 7 6 5 4 3 2 1 0 ";
+  expected = "0 1 7 6 5 4 3 2 0 1 ";
   TEST(result, ==, expected);
 
   // and with more available registers
   run_allocator(result, allocator, Color(6));
-  expected = "3 2 5 1 0 4 3 2 1 0 ";
+  expected = "4 3 0 1 2 3 4 5 1 0 ";
   TEST(result, ==, expected);
 
   // test hints
@@ -95,7 +96,99 @@ void Test::regallocator() {
   allocator.add_hint(Reg(1), Color(1));
   allocator.add_hint(Reg(3), Color(2));
   run_allocator(result, allocator, Color(5));
-  expected = "0 1 5 2 4 3 1 0 4 2 ";
+  expected = "0 1 5 2 3 0 1 4 3 2 ";
+  TEST(result, ==, expected);
+}
+
+void Test::regallocator_linear() {
+  const Interval intervals[] = {{0, 10}, {1, 3}, {2, 5}, {4, 8}, {6, 9}, {11, 12}, {NoPos, 0}};
+  enum : size_t { nreg = sizeof(intervals) / sizeof(intervals[0]) };
+  Allocator allocator;
+  TEST(allocator.reset(nreg, false), ==, true);
+  TEST(allocator.graph().size(), ==, 0);
+
+  String result;
+  allocator.allocate_regs(View<Interval>{intervals, nreg}, Color(2));
+  to_string(result, allocator.get_colors());
+  // reg 0 is spilled to color 2, because its interval ends last.
+  // reg 6 has an empty interval, thus it's not colored
+  Chars expected = "2 1 0 1 0 0 4294967295 ";
+  TEST(result, ==, expected);
+
+  allocator.allocate_regs(View<Interval>{intervals, nreg}, Color(3));
+  to_string(result, allocator.get_colors());
+  expected = "0 1 2 1 2 0 4294967295 ";
+  TEST(result, ==, expected);
+
+  // test hints
+  allocator.add_hint(Reg(1), Color(2));
+  allocator.allocate_regs(View<Interval>{intervals, nreg}, Color(3));
+  to_string(result, allocator.get_colors());
+  expected = "0 2 1 2 1 0 4294967295 ";
+  TEST(result, ==, expected);
+
+  // colors 0 and 1 are clobbered by calls, and reg 2 is live across a call
+  const Color clobbered[] = {0, 1};
+  TEST(allocator.set_clobbered(RegClass(0), View<Color>{clobbered, 2}), ==, true);
+  allocator.add_call_crossing(Reg(2));
+  allocator.allocate_regs(View<Interval>{intervals, nreg}, Color(3));
+  to_string(result, allocator.get_colors());
+  // reg 2 can only use color 2, which is taken by reg 1 due to its hint: reg 2 is spilled
+  expected = "0 2 3 1 2 0 4294967295 ";
+  TEST(result, ==, expected);
+
+  // reg 0 is expensive to spill, for example because it's used inside a loop:
+  // the cheaper regs are spilled instead, even if reg 0's interval ends last
+  Allocator allocator2;
+  TEST(allocator2.reset(nreg, false), ==, true);
+  allocator2.set_spill_cost(Reg(0), 100);
+  allocator2.allocate_regs(View<Interval>{intervals, nreg}, Color(2));
+  to_string(result, allocator2.get_colors());
+  expected = "0 1 2 1 2 0 4294967295 ";
+  TEST(result, ==, expected);
+}
+
+void Test::regallocator_classes() {
+  enum : size_t { nreg = 6 };
+  Allocator allocator{nreg};
+  Graph &graph = allocator.graph();
+  // registers 0..2 belong to class 0, registers 3..5 to class 1.
+  // connect together the registers of each class
+  for (Reg r1 = 0; r1 < nreg; r1++) {
+    allocator.set_class(r1, RegClass(r1 / 3));
+    for (Reg r2 = r1 / 3 * 3; r2 < r1 / 3 * 3 + 3; r2++) {
+      graph.set(r1, r2, true);
+    }
+  }
+  const Color num_colors[] = {3, 2};
+  String result;
+  TEST(allocator.allocate_regs(View<Color>{num_colors, 2}), ==, true);
+  to_string(result, allocator.get_colors());
+  // each class is colored independently: class 1 has only 2 colors,
+  // thus reg 3 is spilled to color 2
+  Chars expected = "2 0 1 2 0 1 ";
+  TEST(result, ==, expected);
+
+  const Interval intervals[] = {{0, 4}, {1, 4}, {2, 4}, {0, 4}, {1, 4}, {2, 4}};
+  allocator.allocate_regs(View<Interval>{intervals, nreg}, View<Color>{num_colors, 2});
+  to_string(result, allocator.get_colors());
+  // same with linear scan: reg 5 is spilled because its interval does not end earlier
+  expected = "0 1 2 0 1 2 ";
+  TEST(result, ==, expected);
+
+  Allocator allocator2{nreg};
+  Graph &graph2 = allocator2.graph();
+  for (Reg r1 = 0; r1 < nreg; r1++) {
+    allocator2.set_class(r1, RegClass(r1 / 3));
+    for (Reg r2 = r1 / 3 * 3; r2 < r1 / 3 * 3 + 3; r2++) {
+      graph2.set(r1, r2, true);
+    }
+    allocator2.set_spill_cost(r1, r1 == 4 ? 1 : 10);
+  }
+  TEST(allocator2.allocate_regs(View<Color>{num_colors, 2}), ==, true);
+  to_string(result, allocator2.get_colors());
+  // reg 4 has the lowest spill cost, thus it is spilled instead of reg 3
+  expected = "2 0 1 0 2 1 ";
   TEST(result, ==, expected);
 }
 
@@ -49,11 +49,29 @@ void Test::stl_bitset() {
     s.set(i, i & 1);
     TEST(s[i], ==, i & 1);
   }
+  TEST(s.count(), ==, n / 2);
+
+  BitSet t{n};
+  t.fill(false);
+  t.set(0, true);
+  t.set(1, true);
+  TEST(t.set_union(s), ==, true);
+  TEST(t.set_union(s), ==, false);
+  TEST(t.count(), ==, n / 2 + 1);
+  TEST(t == s, ==, false);
+  t.set_difference(s);
+  TEST(t.count(), ==, 1);
+  TEST(t[0], ==, true);
+  t.set(0, false);
+  t.set_union(s);
+  TEST(t == s, ==, true);
 }
 
-void Test::stl_graph() {
+void Test::stl_graph(bool sparse) {
   Graph::Node a, b, n = 14;
-  Graph g{n};
+  Graph g;
+  TEST(g.reset(n, sparse), ==, true);
+  TEST(g.is_sparse(), ==, sparse);
   for (a = 0; a < n; a++) {
     TEST(g.degree(a), ==, 0);
     for (b = 0; b < n; b++) {
@@ -132,6 +150,32 @@ void Test::stl_graph() {
     TEST(g.degree(a), ==, 0);
     TEST(g.first_set(a), ==, Graph::NoPos);
   }
+
+  // connect each node to the next one, then duplicate the graph
+  for (a = 0; a + 1 < n; a++) {
+    g.set(a, a + 1, true);
+  }
+  Graph g2;
+  TEST(g2.dup(g), ==, true);
+  TEST(g2.is_sparse(), ==, sparse);
+  for (a = 0; a < n; a++) {
+    TEST(g2.degree(a), ==, g.degree(a));
+    for (b = 0; b < n; b++) {
+      TEST(g2(a, b), ==, g(a, b));
+    }
+  }
+  g2.remove(1);
+  TEST(g2.degree(0), ==, 0);
+  TEST(g2.degree(2), ==, 1);
+  TEST(g2.first_set(2), ==, 3);
+  TEST(g.degree(0), ==, 1);
+
+  // shrinking must release the removed nodes, and resetting to zero nodes must work
+  TEST(g.reset(n / 2, sparse), ==, true);
+  TEST(g.size(), ==, n / 2);
+  TEST(g.degree(0), ==, 0);
+  TEST(g.reset(0, sparse), ==, true);
+  TEST(g.size(), ==, 0);
 }
 
 } // namespace onejit